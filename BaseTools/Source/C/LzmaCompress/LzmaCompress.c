@@ -5,7 +5,7 @@
     LzmaUtil.c -- Test application for LZMA compression
     2018-04-30 : Igor Pavlov : Public domain
 
-  Copyright (c) 2006 - 2019, Intel Corporation. All rights reserved.<BR>
+  Copyright (c) 2006 - 2020, Intel Corporation. All rights reserved.<BR>
   SPDX-License-Identifier: BSD-2-Clause-Patent
 
 **/
@@ -24,9 +24,18 @@
 #include "Sdk/C/Bra.h"
 #include "CommonLib.h"
 #include "ParseInf.h"
+#include "Common/PiFirmwareFile.h"
 
 #define LZMA_HEADER_SIZE (LZMA_PROPS_SIZE + 8)
 
+//
+// A LZMA chunked section starts with this header, followed by the chunks, each
+// a LZMA GUIDed section aligned on 4 bytes. See MdeModulePkg/Include/Guid/LzmaDecompress.h.
+//
+#define LZMA_CHUNKED_SECTION_SIGNATURE  SIGNATURE_32 ('L', 'Z', 'C', 'H')
+#define LZMA_CHUNKED_HEADER_SIZE        16
+#define LZMA_CHUNK_MAX_SIZE             0x800000
+
 typedef enum {
   NoConverter,
   X86Converter,
@@ -44,6 +53,11 @@ static CONVERTER_TYPE mConType = NoConverter;
 
 UINT64 mDictionarySize = 31;
 UINT64 mCompressionMode = 2;
+UINT64 mChunkSize = 0;
+
+static EFI_GUID mLzmaCustomDecompressGuid = {
+  0xEE4E5898, 0x3914, 0x4259, { 0x9D, 0x6E, 0xDC, 0x7B, 0xD7, 0x94, 0x03, 0xCF }
+};
 
 #define UTILITY_NAME "LzmaCompress"
 #define UTILITY_MAJOR_VERSION 0
@@ -60,6 +74,10 @@ void PrintHelp(char *buffer)
              "  -d: decode file\n"
              "  -o FileName, --output FileName: specify the output filename\n"
              "  --f86: enable converter for x86 code\n"
+             "  --chunk-size Size: compress the input in independent chunks of Size bytes,\n"
+             "                     as LZMA GUIDed sections, so that they can be decompressed\n"
+             "                     in parallel. Size must not be larger than 0x800000.\n"
+             "                     Only used with -e, -d recognizes chunked input.\n"
              "  -v, --verbose: increase output messages\n"
              "  -q, --quiet: reduce output messages\n"
              "  --debug [0-9]: set debug level\n"
@@ -94,30 +112,31 @@ void PrintVersion(char *buffer)
   sprintf (buffer, "%s Version %d.%d %s ", UTILITY_NAME, UTILITY_MAJOR_VERSION, UTILITY_MINOR_VERSION, __BUILD_VERSION);
 }
 
-static SRes Encode(ISeqOutStream *outStream, ISeqInStream *inStream, UInt64 fileSize, CLzmaEncProps *props)
+static void SetUInt32(Byte *buffer, UInt32 value)
+{
+  int i;
+  for (i = 0; i < 4; i++)
+    buffer[i] = (Byte)(value >> (8 * i));
+}
+
+static UInt32 GetUInt32(const Byte *buffer)
+{
+  return (UInt32)buffer[0] | ((UInt32)buffer[1] << 8) | ((UInt32)buffer[2] << 16) | ((UInt32)buffer[3] << 24);
+}
+
+//
+// Compress inSize bytes of inBuffer into a LZMA stream, with its header, at
+// outBuffer + headerSize. The returned size includes headerSize.
+//
+static SRes EncodeBuffer(Byte *inBuffer, size_t inSize, CLzmaEncProps *props, size_t headerSize, Byte **outBufferPtr, size_t *outSizePtr)
 {
   SRes res;
-  size_t inSize = (size_t)fileSize;
-  Byte *inBuffer = 0;
   Byte *outBuffer = 0;
   Byte *filteredStream = 0;
   size_t outSize;
 
-  if (inSize != 0) {
-    inBuffer = (Byte *)MyAlloc(inSize);
-    if (inBuffer == 0)
-      return SZ_ERROR_MEM;
-  } else {
-    return SZ_ERROR_INPUT_EOF;
-  }
-
-  if (SeqInStream_Read(inStream, inBuffer, inSize) != SZ_OK) {
-    res = SZ_ERROR_READ;
-    goto Done;
-  }
-
   // we allocate 105% of original size + 64KB for output buffer
-  outSize = (size_t)fileSize / 20 * 21 + (1 << 16);
+  outSize = headerSize + inSize / 20 * 21 + (1 << 16);
   outBuffer = (Byte *)MyAlloc(outSize);
   if (outBuffer == 0) {
     res = SZ_ERROR_MEM;
@@ -127,7 +146,7 @@ static SRes Encode(ISeqOutStream *outStream, ISeqInStream *inStream, UInt64 file
   {
     int i;
     for (i = 0; i < 8; i++)
-      outBuffer[i + LZMA_PROPS_SIZE] = (Byte)(fileSize >> (8 * i));
+      outBuffer[headerSize + i + LZMA_PROPS_SIZE] = (Byte)((UInt64)inSize >> (8 * i));
   }
 
   if (mConType != NoConverter)
@@ -149,27 +168,150 @@ static SRes Encode(ISeqOutStream *outStream, ISeqInStream *inStream, UInt64 file
   }
 
   {
-    size_t outSizeProcessed = outSize - LZMA_HEADER_SIZE;
+    size_t outSizeProcessed = outSize - headerSize - LZMA_HEADER_SIZE;
     size_t outPropsSize = LZMA_PROPS_SIZE;
 
-    res = LzmaEncode(outBuffer + LZMA_HEADER_SIZE, &outSizeProcessed,
+    res = LzmaEncode(outBuffer + headerSize + LZMA_HEADER_SIZE, &outSizeProcessed,
         mConType != NoConverter ? filteredStream : inBuffer, inSize,
-        props, outBuffer, &outPropsSize, 0,
+        props, outBuffer + headerSize, &outPropsSize, 0,
         NULL, &g_Alloc, &g_Alloc);
 
     if (res != SZ_OK)
       goto Done;
 
-    outSize = LZMA_HEADER_SIZE + outSizeProcessed;
+    outSize = headerSize + LZMA_HEADER_SIZE + outSizeProcessed;
+  }
+
+  *outBufferPtr = outBuffer;
+  *outSizePtr = outSize;
+  outBuffer = 0;
+
+Done:
+  MyFree(outBuffer);
+  MyFree(filteredStream);
+
+  return res;
+}
+
+static SRes Encode(ISeqOutStream *outStream, ISeqInStream *inStream, UInt64 fileSize, CLzmaEncProps *props)
+{
+  SRes res;
+  size_t inSize = (size_t)fileSize;
+  Byte *inBuffer = 0;
+  Byte *outBuffer = 0;
+  size_t outSize;
+
+  if (inSize != 0) {
+    inBuffer = (Byte *)MyAlloc(inSize);
+    if (inBuffer == 0)
+      return SZ_ERROR_MEM;
+  } else {
+    return SZ_ERROR_INPUT_EOF;
   }
 
+  if (SeqInStream_Read(inStream, inBuffer, inSize) != SZ_OK) {
+    res = SZ_ERROR_READ;
+    goto Done;
+  }
+
+  res = EncodeBuffer(inBuffer, inSize, props, 0, &outBuffer, &outSize);
+  if (res != SZ_OK)
+    goto Done;
+
   if (outStream->Write(outStream, outBuffer, outSize) != outSize)
     res = SZ_ERROR_WRITE;
 
 Done:
   MyFree(outBuffer);
   MyFree(inBuffer);
-  MyFree(filteredStream);
+
+  return res;
+}
+
+//
+// Compress the input in chunks of mChunkSize bytes, each as a LZMA GUIDed section
+// aligned on 4 bytes, after a LZMA chunked section header.
+//
+static SRes EncodeChunked(ISeqOutStream *outStream, ISeqInStream *inStream, UInt64 fileSize, CLzmaEncProps *props)
+{
+  SRes res;
+  size_t inSize = (size_t)fileSize;
+  Byte *inBuffer = 0;
+  Byte *outBuffer = 0;
+  size_t outSize;
+  size_t chunkSize = (size_t)mChunkSize;
+  UInt32 chunkCount;
+  UInt32 index;
+  Byte header[LZMA_CHUNKED_HEADER_SIZE];
+  Byte padding[4] = { 0 };
+  EFI_GUID_DEFINED_SECTION *section;
+
+  if (inSize == 0)
+    return SZ_ERROR_INPUT_EOF;
+  if (fileSize > 0xFFFFFFFF)
+    return SZ_ERROR_UNSUPPORTED;
+
+  inBuffer = (Byte *)MyAlloc(inSize);
+  if (inBuffer == 0)
+    return SZ_ERROR_MEM;
+
+  if (SeqInStream_Read(inStream, inBuffer, inSize) != SZ_OK) {
+    res = SZ_ERROR_READ;
+    goto Done;
+  }
+
+  chunkCount = (UInt32)((inSize + chunkSize - 1) / chunkSize);
+  SetUInt32(header, LZMA_CHUNKED_SECTION_SIGNATURE);
+  SetUInt32(header + 4, chunkCount);
+  SetUInt32(header + 8, (UInt32)chunkSize);
+  SetUInt32(header + 12, (UInt32)inSize);
+  if (outStream->Write(outStream, header, sizeof(header)) != sizeof(header)) {
+    res = SZ_ERROR_WRITE;
+    goto Done;
+  }
+
+  res = SZ_OK;
+  for (index = 0; index < chunkCount; index++) {
+    size_t offset = (size_t)index * chunkSize;
+    size_t size = inSize - offset < chunkSize ? inSize - offset : chunkSize;
+
+    res = EncodeBuffer(inBuffer + offset, size, props, sizeof(EFI_GUID_DEFINED_SECTION), &outBuffer, &outSize);
+    if (res != SZ_OK)
+      goto Done;
+    if (outSize > 0xFFFFFF) {
+      res = SZ_ERROR_UNSUPPORTED;
+      goto Done;
+    }
+
+    section = (EFI_GUID_DEFINED_SECTION *)outBuffer;
+    section->CommonHeader.Size[0] = (UINT8)outSize;
+    section->CommonHeader.Size[1] = (UINT8)(outSize >> 8);
+    section->CommonHeader.Size[2] = (UINT8)(outSize >> 16);
+    section->CommonHeader.Type = EFI_SECTION_GUID_DEFINED;
+    memcpy(&section->SectionDefinitionGuid, &mLzmaCustomDecompressGuid, sizeof(EFI_GUID));
+    section->DataOffset = (UINT16)sizeof(EFI_GUID_DEFINED_SECTION);
+    section->Attributes = EFI_GUIDED_SECTION_PROCESSING_REQUIRED;
+
+    if (outStream->Write(outStream, outBuffer, outSize) != outSize) {
+      res = SZ_ERROR_WRITE;
+      goto Done;
+    }
+    //
+    // The header size is a multiple of 4, so align the chunk size.
+    //
+    if (index + 1 < chunkCount && (outSize & 3) != 0) {
+      if (outStream->Write(outStream, padding, 4 - (outSize & 3)) != 4 - (outSize & 3)) {
+        res = SZ_ERROR_WRITE;
+        goto Done;
+      }
+    }
+    MyFree(outBuffer);
+    outBuffer = 0;
+  }
+
+Done:
+  MyFree(outBuffer);
+  MyFree(inBuffer);
 
   return res;
 }
@@ -238,6 +380,109 @@ Done:
   return res;
 }
 
+static SRes DecodeChunked(ISeqOutStream *outStream, ISeqInStream *inStream, UInt64 fileSize)
+{
+  SRes res;
+  size_t inSize = (size_t)fileSize;
+  Byte *inBuffer = 0;
+  Byte *outBuffer = 0;
+  size_t outSize;
+  size_t offset;
+  UInt32 chunkCount;
+  UInt32 chunkSize;
+  UInt32 index;
+  ELzmaStatus status;
+
+  if (inSize < LZMA_CHUNKED_HEADER_SIZE)
+    return SZ_ERROR_INPUT_EOF;
+
+  inBuffer = (Byte *)MyAlloc(inSize);
+  if (inBuffer == 0)
+    return SZ_ERROR_MEM;
+
+  if (SeqInStream_Read(inStream, inBuffer, inSize) != SZ_OK) {
+    res = SZ_ERROR_READ;
+    goto Done;
+  }
+
+  chunkCount = GetUInt32(inBuffer + 4);
+  chunkSize = GetUInt32(inBuffer + 8);
+  outSize = GetUInt32(inBuffer + 12);
+  if (GetUInt32(inBuffer) != LZMA_CHUNKED_SECTION_SIGNATURE || chunkCount == 0 || chunkSize == 0 ||
+      outSize <= (UInt64)(chunkCount - 1) * chunkSize || outSize > (UInt64)chunkCount * chunkSize) {
+    res = SZ_ERROR_DATA;
+    goto Done;
+  }
+
+  outBuffer = (Byte *)MyAlloc(outSize);
+  if (outBuffer == 0) {
+    res = SZ_ERROR_MEM;
+    goto Done;
+  }
+
+  offset = LZMA_CHUNKED_HEADER_SIZE;
+  for (index = 0; index < chunkCount; index++) {
+    EFI_GUID_DEFINED_SECTION *section;
+    size_t sectionSize;
+    size_t destSize;
+    size_t srcSize;
+
+    if (inSize - offset < sizeof(EFI_GUID_DEFINED_SECTION)) {
+      res = SZ_ERROR_DATA;
+      goto Done;
+    }
+    section = (EFI_GUID_DEFINED_SECTION *)(inBuffer + offset);
+    sectionSize = section->CommonHeader.Size[0] | (section->CommonHeader.Size[1] << 8) | (section->CommonHeader.Size[2] << 16);
+    if (sectionSize > inSize - offset ||
+        section->DataOffset < sizeof(EFI_GUID_DEFINED_SECTION) ||
+        section->DataOffset + LZMA_HEADER_SIZE > sectionSize ||
+        memcmp(&section->SectionDefinitionGuid, &mLzmaCustomDecompressGuid, sizeof(EFI_GUID)) != 0) {
+      res = SZ_ERROR_DATA;
+      goto Done;
+    }
+
+    destSize = outSize - (size_t)index * chunkSize < chunkSize ? outSize - (size_t)index * chunkSize : chunkSize;
+    srcSize = sectionSize - section->DataOffset - LZMA_HEADER_SIZE;
+    res = LzmaDecode(outBuffer + (size_t)index * chunkSize, &destSize,
+        (Byte *)section + section->DataOffset + LZMA_HEADER_SIZE, &srcSize,
+        (Byte *)section + section->DataOffset, LZMA_PROPS_SIZE, LZMA_FINISH_END, &status, &g_Alloc);
+    if (res != SZ_OK)
+      goto Done;
+
+    offset += (sectionSize + 3) & ~(size_t)3;
+    if (offset > inSize)
+      offset = inSize;
+  }
+
+  if (outStream->Write(outStream, outBuffer, outSize) != outSize)
+    res = SZ_ERROR_WRITE;
+
+Done:
+  MyFree(outBuffer);
+  MyFree(inBuffer);
+
+  return res;
+}
+
+//
+// Return whether the input starts with the LZMA chunked section signature. The
+// file position is left at the start of the input.
+//
+static Bool IsChunked(CSzFile *inFile, UInt64 fileSize)
+{
+  Byte signature[4];
+  size_t size = sizeof(signature);
+  Int64 pos = 0;
+  Bool chunked = False;
+
+  if (fileSize >= LZMA_CHUNKED_HEADER_SIZE &&
+      File_Read(inFile, signature, &size) == 0 && size == sizeof(signature)) {
+    chunked = (Bool)(GetUInt32(signature) == LZMA_CHUNKED_SECTION_SIGNATURE);
+  }
+  File_Seek(inFile, &pos, SZ_SEEK_SET);
+  return chunked;
+}
+
 int main2(int numArgs, const char *args[], char *rs)
 {
   CFileSeqInStream inStream;
@@ -272,6 +517,15 @@ int main2(int numArgs, const char *args[], char *rs)
       modeWasSet = True;
     } else if (strcmp(args[param], "--f86") == 0) {
       mConType = X86Converter;
+    } else if (strcmp(args[param], "--chunk-size") == 0) {
+      if (numArgs < (param + 2)) {
+        return PrintUserError(rs);
+      }
+      if (AsciiStringToUint64(args[param + 1], FALSE, &mChunkSize) != EFI_SUCCESS ||
+          mChunkSize == 0 || mChunkSize > LZMA_CHUNK_MAX_SIZE) {
+        return PrintError(rs, kInvalidParamValMessage);
+      }
+      param++;
     } else if (strcmp(args[param], "-o") == 0 ||
                strcmp(args[param], "--output") == 0) {
       if (numArgs < (param + 2)) {
@@ -338,6 +592,10 @@ int main2(int numArgs, const char *args[], char *rs)
     return PrintUserError(rs);
   }
 
+  if (mChunkSize != 0 && mConType != NoConverter) {
+    return PrintError(rs, "--chunk-size can not be used with --f86");
+  }
+
   {
     size_t t4 = sizeof(UInt32);
     size_t t8 = sizeof(UInt64);
@@ -360,14 +618,26 @@ int main2(int numArgs, const char *args[], char *rs)
     if (!mQuietMode) {
       printf("Encoding\n");
     }
-    res = Encode(&outStream.vt, &inStream.vt, fileSize, &props);
+    if (mChunkSize != 0) {
+      res = EncodeChunked(&outStream.vt, &inStream.vt, fileSize, &props);
+    } else {
+      res = Encode(&outStream.vt, &inStream.vt, fileSize, &props);
+    }
   }
   else
   {
     if (!mQuietMode) {
       printf("Decoding\n");
     }
-    res = Decode(&outStream.vt, &inStream.vt, fileSize);
+    //
+    // Chunked input is recognized by its signature whatever the options are, as
+    // the tools that decode GUIDed sections don't pass --chunk-size.
+    //
+    if (IsChunked(&inStream.file, fileSize)) {
+      res = DecodeChunked(&outStream.vt, &inStream.vt, fileSize);
+    } else {
+      res = Decode(&outStream.vt, &inStream.vt, fileSize);
+    }
   }
 
   File_Close(&outStream.file);
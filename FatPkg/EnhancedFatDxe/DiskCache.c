@@ -1,19 +1,110 @@
 /** @file
   Cache implementation for EFI FAT File system driver.
 
-Copyright (c) 2005 - 2013, Intel Corporation. All rights reserved.<BR>
+  Both caches are set associative: a page may be held by any of the
+  FAT_CACHE_GROUP_WAYS tags of its group, and the least recently used one is
+  replaced when the group is full.
+
+Copyright (c) 2005 - 2020, Intel Corporation. All rights reserved.<BR>
 SPDX-License-Identifier: BSD-2-Clause-Patent
 
 **/
 
 #include "Fat.h"
 
+/**
+
+  Return the address of the cache page held by the cache tag.
+
+  @param  DiskCache             - The disk cache.
+  @param  CacheTag              - The Cache Tag of the page.
+
+  @return The address of the cache page.
+
+**/
+STATIC
+UINT8 *
+FatCachePageAddress (
+  IN DISK_CACHE         *DiskCache,
+  IN CACHE_TAG          *CacheTag
+  )
+{
+  return DiskCache->CacheBase + ((UINTN) (CacheTag - DiskCache->CacheTag) << DiskCache->PageAlignment);
+}
+
+/**
+
+  Find the cache tag that holds a page.
+
+  @param  DiskCache             - The disk cache.
+  @param  PageNo                - PageNo to match with the cache.
+
+  @return The Cache Tag of the page, or NULL if the page is not in the cache.
+
+**/
+STATIC
+CACHE_TAG *
+FatLookupCachePage (
+  IN DISK_CACHE         *DiskCache,
+  IN UINTN              PageNo
+  )
+{
+  CACHE_TAG   *CacheTag;
+  UINTN       Way;
+
+  CacheTag = &DiskCache->CacheTag[(PageNo & DiskCache->GroupMask) * FAT_CACHE_GROUP_WAYS];
+  for (Way = 0; Way < FAT_CACHE_GROUP_WAYS; Way++, CacheTag++) {
+    if (CacheTag->RealSize > 0 && CacheTag->PageNo == PageNo) {
+      return CacheTag;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+
+  Find the cache tag to replace by a page: a free one of the group of the page,
+  or else the least recently used one.
+
+  @param  DiskCache             - The disk cache.
+  @param  PageNo                - PageNo that will replace the cache tag.
+
+  @return The Cache Tag to replace.
+
+**/
+STATIC
+CACHE_TAG *
+FatFindVictimCachePage (
+  IN DISK_CACHE         *DiskCache,
+  IN UINTN              PageNo
+  )
+{
+  CACHE_TAG   *CacheTag;
+  CACHE_TAG   *Victim;
+  UINTN       Way;
+
+  CacheTag = &DiskCache->CacheTag[(PageNo & DiskCache->GroupMask) * FAT_CACHE_GROUP_WAYS];
+  Victim   = CacheTag;
+  for (Way = 0; Way < FAT_CACHE_GROUP_WAYS; Way++, CacheTag++) {
+    if (CacheTag->RealSize == 0) {
+      return CacheTag;
+    }
+    if (CacheTag->LastUsed < Victim->LastUsed) {
+      Victim = CacheTag;
+    }
+  }
+
+  return Victim;
+}
+
 /**
 
   This function is used by the Data Cache.
 
-  When this function is called by write command, all entries in this range
-  are older than the contents in disk, so they are invalid; just mark them invalid.
+  When this function is called by write command, the entries in this range are
+  older than the contents in disk. The entries that the range covers entirely are
+  just marked invalid, the others get the written data.
 
   When this function is called by read command, if any entry in this range
   is dirty, it means that the relative info directly readed from media is older than
@@ -21,60 +112,72 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 
   @param  Volume                - FAT file system volume.
   @param  IoMode                - This function is called by read command or write command
-  @param  StartPageNo           - First PageNo to be checked in the cache.
-  @param  EndPageNo             - Last PageNo to be checked in the cache.
-  @param  Buffer                - The user buffer need to update. Only when doing the read command
-                          and there is dirty cache in the cache range, this parameter will be used.
+  @param  EntryPos              - The starting byte of the range, relative to the data region.
+  @param  Length                - The number of bytes in the range.
+  @param  Buffer                - The user buffer of the range. When doing the read command
+                          and there is dirty cache in the cache range, it is updated.
 
 **/
 STATIC
 VOID
 FatFlushDataCacheRange (
-  IN  FAT_VOLUME         *Volume,
-  IN  IO_MODE            IoMode,
-  IN  UINTN              StartPageNo,
-  IN  UINTN              EndPageNo,
-  OUT UINT8              *Buffer
+  IN     FAT_VOLUME         *Volume,
+  IN     IO_MODE            IoMode,
+  IN     UINT64             EntryPos,
+  IN     UINTN              Length,
+  IN OUT UINT8              *Buffer
   )
 {
   UINTN       PageNo;
-  UINTN       GroupNo;
-  UINTN       GroupMask;
+  UINTN       EndPageNo;
   UINTN       PageSize;
   UINT8       PageAlignment;
   DISK_CACHE  *DiskCache;
   CACHE_TAG   *CacheTag;
-  UINT8       *BaseAddress;
+  UINT8       *PageAddress;
+  UINT64      PagePos;
+  UINT64      Start;
+  UINT64      End;
 
   DiskCache     = &Volume->DiskCache[CacheData];
-  BaseAddress   = DiskCache->CacheBase;
-  GroupMask     = DiskCache->GroupMask;
   PageAlignment = DiskCache->PageAlignment;
   PageSize      = (UINTN)1 << PageAlignment;
+  EndPageNo     = (UINTN) RShiftU64 (EntryPos + Length - 1, PageAlignment);
 
-  for (PageNo = StartPageNo; PageNo < EndPageNo; PageNo++) {
-    GroupNo   = PageNo & GroupMask;
-    CacheTag  = &DiskCache->CacheTag[GroupNo];
-    if (CacheTag->RealSize > 0 && CacheTag->PageNo == PageNo) {
+  for (PageNo = (UINTN) RShiftU64 (EntryPos, PageAlignment); PageNo <= EndPageNo; PageNo++) {
+    CacheTag = FatLookupCachePage (DiskCache, PageNo);
+    if (CacheTag == NULL) {
+      continue;
+    }
+
+    PageAddress = FatCachePageAddress (DiskCache, CacheTag);
+    PagePos     = LShiftU64 (PageNo, PageAlignment);
+    Start       = MAX (PagePos, EntryPos);
+    End         = MIN (PagePos + PageSize, EntryPos + Length);
+    if (IoMode == ReadDisk) {
       //
       // When reading data form disk directly, if some dirty data
       // in cache is in this rang, this data in the Buffer need to
       // be updated with the cache's dirty data.
       //
-      if (IoMode == ReadDisk) {
-        if (CacheTag->Dirty) {
-          CopyMem (
-            Buffer + ((PageNo - StartPageNo) << PageAlignment),
-            BaseAddress + (GroupNo << PageAlignment),
-            PageSize
-            );
-        }
-      } else {
-        //
-        // Make all valid entries in this range invalid.
-        //
-        CacheTag->RealSize = 0;
+      if (CacheTag->Dirty) {
+        CopyMem (
+          Buffer + (UINTN) (Start - EntryPos),
+          PageAddress + (UINTN) (Start - PagePos),
+          (UINTN) (End - Start)
+          );
       }
+    } else if (Start == PagePos && End == PagePos + PageSize) {
+      //
+      // Make the entries that are written entirely invalid.
+      //
+      CacheTag->RealSize = 0;
+    } else {
+      CopyMem (
+        PageAddress + (UINTN) (Start - PagePos),
+        Buffer + (UINTN) (Start - EntryPos),
+        (UINTN) (End - Start)
+        );
     }
   }
 }
@@ -104,7 +207,6 @@ FatExchangeCachePage (
   )
 {
   EFI_STATUS  Status;
-  UINTN       GroupNo;
   UINTN       PageNo;
   UINTN       WriteCount;
   UINTN       RealSize;
@@ -116,9 +218,8 @@ FatExchangeCachePage (
 
   DiskCache     = &Volume->DiskCache[DataType];
   PageNo        = CacheTag->PageNo;
-  GroupNo       = PageNo & DiskCache->GroupMask;
   PageAlignment = DiskCache->PageAlignment;
-  PageAddress   = DiskCache->CacheBase + (GroupNo << PageAlignment);
+  PageAddress   = FatCachePageAddress (DiskCache, CacheTag);
   EntryPos      = DiskCache->BaseAddress + LShiftU64 (PageNo, PageAlignment);
   RealSize      = CacheTag->RealSize;
   if (IoMode == ReadDisk) {
@@ -154,20 +255,65 @@ FatExchangeCachePage (
 
 /**
 
-  Get one cache page by specified PageNo.
+  Write the dirty data cache pages of a range back to the disk, so that the disk
+  holds the current data of the range.
+
+  @param  Volume                - FAT file system volume.
+  @param  EntryPos              - The starting byte of the range, relative to the data region.
+  @param  Length                - The number of bytes in the range.
+
+  @retval EFI_SUCCESS           - The dirty pages of the range are written back.
+  @return Others                - An error occurred when writing a page back.
+
+**/
+STATIC
+EFI_STATUS
+FatWriteBackDataCacheRange (
+  IN FAT_VOLUME         *Volume,
+  IN UINT64             EntryPos,
+  IN UINTN              Length
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       PageNo;
+  UINTN       EndPageNo;
+  UINT8       PageAlignment;
+  DISK_CACHE  *DiskCache;
+  CACHE_TAG   *CacheTag;
+
+  DiskCache     = &Volume->DiskCache[CacheData];
+  PageAlignment = DiskCache->PageAlignment;
+  EndPageNo     = (UINTN) RShiftU64 (EntryPos + Length - 1, PageAlignment);
+
+  for (PageNo = (UINTN) RShiftU64 (EntryPos, PageAlignment); PageNo <= EndPageNo; PageNo++) {
+    CacheTag = FatLookupCachePage (DiskCache, PageNo);
+    if (CacheTag != NULL && CacheTag->Dirty) {
+      Status = FatExchangeCachePage (Volume, CacheData, WriteDisk, CacheTag, NULL);
+      if (EFI_ERROR (Status)) {
+        return Status;
+      }
+    }
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+
+  Load a page into the cache tag that the page replaces.
 
   @param  Volume                - FAT file system volume.
   @param  CacheDataType         - The cache type: CACHE_FAT or CACHE_DATA.
-  @param  PageNo                - PageNo to match with the cache.
-  @param  CacheTag              - The Cache Tag for the current cache page.
+  @param  PageNo                - PageNo to load.
+  @param  CacheTag              - The Cache Tag that the page replaces.
 
-  @retval EFI_SUCCESS           - Get the cache page successfully.
+  @retval EFI_SUCCESS           - The page is loaded.
   @return other                 - An error occurred when accessing data.
 
 **/
 STATIC
 EFI_STATUS
-FatGetCachePage (
+FatLoadCachePage (
   IN FAT_VOLUME         *Volume,
   IN CACHE_DATA_TYPE    CacheDataType,
   IN UINTN              PageNo,
@@ -175,15 +321,6 @@ FatGetCachePage (
   )
 {
   EFI_STATUS  Status;
-  UINTN       OldPageNo;
-
-  OldPageNo = CacheTag->PageNo;
-  if (CacheTag->RealSize > 0 && OldPageNo == PageNo) {
-    //
-    // Cache Hit occurred
-    //
-    return EFI_SUCCESS;
-  }
 
   //
   // Write dirty cache page back to disk
@@ -197,12 +334,81 @@ FatGetCachePage (
   //
   // Load new data from disk;
   //
-  CacheTag->PageNo  = PageNo;
-  Status            = FatExchangeCachePage (Volume, CacheDataType, ReadDisk, CacheTag, NULL);
+  CacheTag->PageNo    = PageNo;
+  CacheTag->LastUsed  = ++Volume->DiskCache[CacheDataType].Tick;
+  Status              = FatExchangeCachePage (Volume, CacheDataType, ReadDisk, CacheTag, NULL);
+  if (EFI_ERROR (Status)) {
+    CacheTag->RealSize = 0;
+  }
 
   return Status;
 }
 
+/**
+
+  Get one cache page by specified PageNo.
+
+  A miss in the FAT cache on the page that follows the previous miss comes from
+  a walk of a cluster chain, so the page after it is read ahead as well, if that
+  does not write a dirty page back.
+
+  @param  Volume                - FAT file system volume.
+  @param  CacheDataType         - The cache type: CACHE_FAT or CACHE_DATA.
+  @param  PageNo                - PageNo to match with the cache.
+  @param  CacheTag              - Return the Cache Tag for the current cache page.
+
+  @retval EFI_SUCCESS           - Get the cache page successfully.
+  @return other                 - An error occurred when accessing data.
+
+**/
+STATIC
+EFI_STATUS
+FatGetCachePage (
+  IN  FAT_VOLUME         *Volume,
+  IN  CACHE_DATA_TYPE    CacheDataType,
+  IN  UINTN              PageNo,
+  OUT CACHE_TAG          **CacheTag
+  )
+{
+  EFI_STATUS  Status;
+  DISK_CACHE  *DiskCache;
+  CACHE_TAG   *NextCacheTag;
+  BOOLEAN     Sequential;
+
+  DiskCache = &Volume->DiskCache[CacheDataType];
+  *CacheTag = FatLookupCachePage (DiskCache, PageNo);
+  if (*CacheTag != NULL) {
+    //
+    // Cache Hit occurred
+    //
+    (*CacheTag)->LastUsed = ++DiskCache->Tick;
+    return EFI_SUCCESS;
+  }
+
+  Sequential                = (BOOLEAN) (PageNo == DiskCache->LastMissPageNo + 1);
+  DiskCache->LastMissPageNo = PageNo;
+
+  *CacheTag = FatFindVictimCachePage (DiskCache, PageNo);
+  Status    = FatLoadCachePage (Volume, CacheDataType, PageNo, *CacheTag);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (CacheDataType == CacheFat && Sequential &&
+      DiskCache->BaseAddress + LShiftU64 (PageNo + 1, DiskCache->PageAlignment) < DiskCache->LimitAddress &&
+      FatLookupCachePage (DiskCache, PageNo + 1) == NULL) {
+    NextCacheTag = FatFindVictimCachePage (DiskCache, PageNo + 1);
+    if (NextCacheTag != *CacheTag && !(NextCacheTag->RealSize > 0 && NextCacheTag->Dirty)) {
+      //
+      // The read-ahead page is only a hint, ignore its errors.
+      //
+      FatLoadCachePage (Volume, CacheDataType, PageNo + 1, NextCacheTag);
+    }
+  }
+
+  return EFI_SUCCESS;
+}
+
 /**
 
   Read Length bytes from the position of Offset into Buffer, or
@@ -237,14 +443,11 @@ FatAccessUnalignedCachePage (
   VOID        *Destination;
   DISK_CACHE  *DiskCache;
   CACHE_TAG   *CacheTag;
-  UINTN       GroupNo;
 
   DiskCache = &Volume->DiskCache[CacheDataType];
-  GroupNo   = PageNo & DiskCache->GroupMask;
-  CacheTag  = &DiskCache->CacheTag[GroupNo];
-  Status    = FatGetCachePage (Volume, CacheDataType, PageNo, CacheTag);
+  Status    = FatGetCachePage (Volume, CacheDataType, PageNo, &CacheTag);
   if (!EFI_ERROR (Status)) {
-    Source      = DiskCache->CacheBase + (GroupNo << DiskCache->PageAlignment) + Offset;
+    Source      = FatCachePageAddress (DiskCache, CacheTag) + Offset;
     Destination = Buffer;
     if (IoMode != ReadDisk) {
       CacheTag->Dirty   = TRUE;
@@ -271,9 +474,8 @@ FatAccessUnalignedCachePage (
      page hit, just return the cache page; else update the related cache page and return
      the right cache page.
   2. Access of Data cache (CACHE_DATA):
-     The access data will be divided into UnderRun data, Aligned data and OverRun data;
-     The UnderRun data and OverRun data will be accessed by the Data cache,
-     but the Aligned data will be accessed with disk directly.
+     The accesses smaller than a cache page go through the Data cache, the
+     larger ones are accessed with disk directly.
 
   @param  Volume                - FAT file system volume.
   @param  CacheDataType         - The type of cache: CACHE_DATA or CACHE_FAT.
@@ -301,13 +503,9 @@ FatAccessCache (
 {
   EFI_STATUS  Status;
   UINTN       PageSize;
-  UINTN       UnderRun;
-  UINTN       OverRun;
-  UINTN       AlignedSize;
+  UINTN       PageOffset;
   UINTN       Length;
   UINTN       PageNo;
-  UINTN       AlignedPageCount;
-  UINTN       OverRunPageNo;
   DISK_CACHE  *DiskCache;
   UINT64      EntryPos;
   UINT8       PageAlignment;
@@ -320,60 +518,51 @@ FatAccessCache (
   PageAlignment = DiskCache->PageAlignment;
   PageSize      = (UINTN)1 << PageAlignment;
   PageNo        = (UINTN) RShiftU64 (EntryPos, PageAlignment);
-  UnderRun      = ((UINTN) EntryPos) & (PageSize - 1);
+  PageOffset    = ((UINTN) EntryPos) & (PageSize - 1);
 
-  if (UnderRun > 0) {
-    Length = PageSize - UnderRun;
-    if (Length > BufferSize) {
-      Length = BufferSize;
+  if (BufferSize >= PageSize) {
+    //
+    // Accessing fat table cannot have large data
+    //
+    ASSERT (CacheDataType == CacheData);
+
+    //
+    // Stream the large data between the disk and Buffer in a single access,
+    // instead of loading the pages at its ends and evicting pages that are
+    // used again. If the data overlaps the relative cache range, these cache
+    // pages need to be updated.
+    //
+    // A non-blocking read only lands in Buffer after this function returns, so
+    // the dirty data of the cache cannot be copied over it; write the dirty
+    // pages back first and let the read get their data from the disk.
+    //
+    if (IoMode == ReadDisk && Task != NULL) {
+      Status = FatWriteBackDataCacheRange (Volume, EntryPos, BufferSize);
+      if (EFI_ERROR (Status)) {
+        return Status;
+      }
+    }
+
+    Status = FatDiskIo (Volume, IoMode, Offset, BufferSize, Buffer, Task);
+    if (!EFI_ERROR (Status)) {
+      FatFlushDataCacheRange (Volume, IoMode, EntryPos, BufferSize, Buffer);
     }
+    return Status;
+  }
 
-    Status = FatAccessUnalignedCachePage (Volume, CacheDataType, IoMode, PageNo, UnderRun, Length, Buffer);
+  while (BufferSize > 0) {
+    Length = MIN (PageSize - PageOffset, BufferSize);
+    Status = FatAccessUnalignedCachePage (Volume, CacheDataType, IoMode, PageNo, PageOffset, Length, Buffer);
     if (EFI_ERROR (Status)) {
       return Status;
     }
 
     Buffer     += Length;
     BufferSize -= Length;
+    PageOffset  = 0;
     PageNo++;
   }
 
-  AlignedPageCount  = BufferSize >> PageAlignment;
-  OverRunPageNo     = PageNo + AlignedPageCount;
-  //
-  // The access of the Aligned data
-  //
-  if (AlignedPageCount > 0) {
-    //
-    // Accessing fat table cannot have alignment data
-    //
-    ASSERT (CacheDataType == CacheData);
-
-    EntryPos    = Volume->RootPos + LShiftU64 (PageNo, PageAlignment);
-    AlignedSize = AlignedPageCount << PageAlignment;
-    Status      = FatDiskIo (Volume, IoMode, EntryPos, AlignedSize, Buffer, Task);
-    if (EFI_ERROR (Status)) {
-      return Status;
-    }
-    //
-    // If these access data over laps the relative cache range, these cache pages need
-    // to be updated.
-    //
-    FatFlushDataCacheRange (Volume, IoMode, PageNo, OverRunPageNo, Buffer);
-    Buffer      += AlignedSize;
-    BufferSize  -= AlignedSize;
-  }
-  //
-  // The access of the OverRun data
-  //
-  OverRun = BufferSize;
-  if (OverRun > 0) {
-    //
-    // Last read is not a complete page
-    //
-    Status = FatAccessUnalignedCachePage (Volume, CacheDataType, IoMode, OverRunPageNo, 0, OverRun, Buffer);
-  }
-
   return Status;
 }
 
@@ -396,8 +585,8 @@ FatVolumeFlushCache (
 {
   EFI_STATUS      Status;
   CACHE_DATA_TYPE CacheDataType;
-  UINTN           GroupIndex;
-  UINTN           GroupMask;
+  UINTN           TagIndex;
+  UINTN           TagCount;
   DISK_CACHE      *DiskCache;
   CACHE_TAG       *CacheTag;
 
@@ -407,9 +596,9 @@ FatVolumeFlushCache (
       //
       // Data cache or fat cache is dirty, write the dirty data back
       //
-      GroupMask = DiskCache->GroupMask;
-      for (GroupIndex = 0; GroupIndex <= GroupMask; GroupIndex++) {
-        CacheTag = &DiskCache->CacheTag[GroupIndex];
+      TagCount = (DiskCache->GroupMask + 1) * FAT_CACHE_GROUP_WAYS;
+      for (TagIndex = 0; TagIndex < TagCount; TagIndex++) {
+        CacheTag = &DiskCache->CacheTag[TagIndex];
         if (CacheTag->RealSize > 0 && CacheTag->Dirty) {
           //
           // Write back all Dirty Data Cache Page to disk
@@ -431,6 +620,75 @@ FatVolumeFlushCache (
   return Status;
 }
 
+/**
+
+  Return the number of groups of the data cache, sized from the free memory,
+  but not larger than the data region of the volume needs.
+
+  @param  Volume                - FAT file system volume.
+  @param  PageAlignment         - The page alignment of the data cache.
+
+  @return The number of groups, a power of two.
+
+**/
+STATIC
+UINTN
+FatGetDataCacheGroupCount (
+  IN FAT_VOLUME         *Volume,
+  IN UINT8              PageAlignment
+  )
+{
+  EFI_STATUS             Status;
+  EFI_MEMORY_DESCRIPTOR  *MemoryMap;
+  EFI_MEMORY_DESCRIPTOR  *Entry;
+  UINTN                  MemoryMapSize;
+  UINTN                  MapKey;
+  UINTN                  DescriptorSize;
+  UINT32                 DescriptorVersion;
+  UINT64                 FreePages;
+  UINT64                 GroupCount;
+
+  FreePages     = 0;
+  MemoryMapSize = 0;
+  Status        = gBS->GetMemoryMap (&MemoryMapSize, NULL, &MapKey, &DescriptorSize, &DescriptorVersion);
+  while (Status == EFI_BUFFER_TOO_SMALL) {
+    //
+    // Allocating the memory map may add descriptors to it.
+    //
+    MemoryMapSize += 4 * DescriptorSize;
+    MemoryMap      = AllocatePool (MemoryMapSize);
+    if (MemoryMap == NULL) {
+      break;
+    }
+
+    Status = gBS->GetMemoryMap (&MemoryMapSize, MemoryMap, &MapKey, &DescriptorSize, &DescriptorVersion);
+    if (!EFI_ERROR (Status)) {
+      for (Entry = MemoryMap;
+           (UINTN) Entry < (UINTN) MemoryMap + MemoryMapSize;
+           Entry = NEXT_MEMORY_DESCRIPTOR (Entry, DescriptorSize)) {
+        if (Entry->Type == EfiConventionalMemory) {
+          FreePages += Entry->NumberOfPages;
+        }
+      }
+    }
+
+    FreePool (MemoryMap);
+  }
+
+  GroupCount = DivU64x32 (
+                 RShiftU64 (EFI_PAGES_TO_SIZE (FreePages), PageAlignment),
+                 FAT_DATACACHE_MEMORY_RATIO * FAT_CACHE_GROUP_WAYS
+                 );
+  GroupCount = MIN (
+                 GroupCount,
+                 DivU64x32 (RShiftU64 (Volume->VolumeSize - Volume->RootPos, PageAlignment), FAT_CACHE_GROUP_WAYS)
+                 );
+  GroupCount = MIN (GroupCount, FAT_DATACACHE_GROUP_MAX_COUNT);
+  GroupCount = MAX (GroupCount, FAT_DATACACHE_GROUP_MIN_COUNT);
+
+  return GetPowerOfTwo32 ((UINT32) GroupCount);
+}
+
 /**
 
   Initialize the disk cache according to Volume's FatType.
@@ -448,8 +706,10 @@ FatInitializeDiskCache (
 {
   DISK_CACHE  *DiskCache;
   UINTN       FatCacheGroupCount;
+  UINTN       DataCacheGroupCount;
   UINTN       DataCacheSize;
   UINTN       FatCacheSize;
+  UINTN       TagSize;
   UINT8       *CacheBuffer;
 
   DiskCache = Volume->DiskCache;
@@ -466,24 +726,34 @@ FatInitializeDiskCache (
     DiskCache[CacheData].PageAlignment = FAT_DATACACHE_PAGE_MAX_ALIGNMENT;
   }
 
-  DiskCache[CacheData].GroupMask     = FAT_DATACACHE_GROUP_COUNT - 1;
+  DataCacheGroupCount                 = FatGetDataCacheGroupCount (Volume, DiskCache[CacheData].PageAlignment);
+  DiskCache[CacheData].GroupMask     = DataCacheGroupCount - 1;
   DiskCache[CacheData].BaseAddress   = Volume->RootPos;
   DiskCache[CacheData].LimitAddress  = Volume->VolumeSize;
   DiskCache[CacheFat].GroupMask      = FatCacheGroupCount - 1;
   DiskCache[CacheFat].BaseAddress    = Volume->FatPos;
   DiskCache[CacheFat].LimitAddress   = Volume->FatPos + Volume->FatSize;
-  FatCacheSize                        = FatCacheGroupCount << DiskCache[CacheFat].PageAlignment;
-  DataCacheSize                       = FAT_DATACACHE_GROUP_COUNT << DiskCache[CacheData].PageAlignment;
+  FatCacheSize                        = (FatCacheGroupCount * FAT_CACHE_GROUP_WAYS) << DiskCache[CacheFat].PageAlignment;
+  DataCacheSize                       = (DataCacheGroupCount * FAT_CACHE_GROUP_WAYS) << DiskCache[CacheData].PageAlignment;
+  TagSize                             = (FatCacheGroupCount + DataCacheGroupCount) * FAT_CACHE_GROUP_WAYS * sizeof (CACHE_TAG);
+  DiskCache[CacheFat].Tick           = 0;
+  DiskCache[CacheData].Tick          = 0;
+  DiskCache[CacheFat].LastMissPageNo  = MAX_UINTN;
+  DiskCache[CacheData].LastMissPageNo = MAX_UINTN;
   //
-  // Allocate the Fat Cache buffer
+  // Allocate the cache tags and the Fat Cache buffer. The pages are only read
+  // after they are loaded, so only the tags need to be zeroed.
   //
-  CacheBuffer = AllocateZeroPool (FatCacheSize + DataCacheSize);
+  CacheBuffer = AllocatePool (TagSize + FatCacheSize + DataCacheSize);
   if (CacheBuffer == NULL) {
     return EFI_OUT_OF_RESOURCES;
   }
+  ZeroMem (CacheBuffer, TagSize);
 
   Volume->CacheBuffer             = CacheBuffer;
-  DiskCache[CacheFat].CacheBase  = CacheBuffer;
-  DiskCache[CacheData].CacheBase = CacheBuffer + FatCacheSize;
+  DiskCache[CacheFat].CacheTag   = (CACHE_TAG *) CacheBuffer;
+  DiskCache[CacheData].CacheTag  = DiskCache[CacheFat].CacheTag + FatCacheGroupCount * FAT_CACHE_GROUP_WAYS;
+  DiskCache[CacheFat].CacheBase  = CacheBuffer + TagSize;
+  DiskCache[CacheData].CacheBase = CacheBuffer + TagSize + FatCacheSize;
   return EFI_SUCCESS;
 }
@@ -1,7 +1,7 @@
 /** @file
   Main header file for EFI FAT file system driver.
 
-Copyright (c) 2005 - 2013, Intel Corporation. All rights reserved.<BR>
+Copyright (c) 2005 - 2020, Intel Corporation. All rights reserved.<BR>
 SPDX-License-Identifier: BSD-2-Clause-Patent
 
 **/
@@ -80,9 +80,19 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #define FAT_FATCACHE_PAGE_MAX_ALIGNMENT   15
 #define FAT_DATACACHE_PAGE_MIN_ALIGNMENT  13
 #define FAT_DATACACHE_PAGE_MAX_ALIGNMENT  16
-#define FAT_DATACACHE_GROUP_COUNT         64
 #define FAT_FATCACHE_GROUP_MIN_COUNT      1
-#define FAT_FATCACHE_GROUP_MAX_COUNT      16
+#define FAT_FATCACHE_GROUP_MAX_COUNT      4
+
+//
+// Each group of the disk caches holds FAT_CACHE_GROUP_WAYS pages, replaced least
+// recently used first. The data cache takes 1/FAT_DATACACHE_MEMORY_RATIO of the
+// free memory, with at least FAT_DATACACHE_GROUP_MIN_COUNT and at most
+// FAT_DATACACHE_GROUP_MAX_COUNT groups.
+//
+#define FAT_CACHE_GROUP_WAYS              4
+#define FAT_DATACACHE_GROUP_MIN_COUNT     16
+#define FAT_DATACACHE_GROUP_MAX_COUNT     64
+#define FAT_DATACACHE_MEMORY_RATIO        256
 
 //
 // Used in 8.3 generation algorithm
@@ -146,6 +156,7 @@ typedef enum {
 typedef struct {
   UINTN   PageNo;
   UINTN   RealSize;
+  UINTN   LastUsed;
   BOOLEAN Dirty;
 } CACHE_TAG;
 
@@ -156,7 +167,12 @@ typedef struct {
   BOOLEAN   Dirty;
   UINT8     PageAlignment;
   UINTN     GroupMask;
-  CACHE_TAG CacheTag[FAT_DATACACHE_GROUP_COUNT];
+  UINTN     Tick;
+  UINTN     LastMissPageNo;
+  //
+  // The FAT_CACHE_GROUP_WAYS tags of each group, in group order
+  //
+  CACHE_TAG *CacheTag;
 } DISK_CACHE;
 
 //
@@ -229,6 +245,17 @@ typedef struct {
   LIST_ENTRY          Link;
 } FAT_SUBTASK;
 
+//
+// A run of contiguous clusters of an opened file
+//
+typedef struct {
+  UINTN               FileCluster;  // index of the first cluster in the file
+  UINTN               Cluster;      // first cluster on the volume
+  UINTN               Count;        // number of clusters
+} FAT_EXTENT;
+
+#define FAT_EXTENT_MIN_COUNT  8
+
 //
 // FAT_OFILE - Each opened file
 //
@@ -253,6 +280,16 @@ struct _FAT_OFILE {
   UINTN               FileCurrentCluster;
   UINTN               FileLastCluster;
 
+  //
+  // The runs of contiguous clusters of the file, in file order. They are mapped
+  // as positions in the file are sought, and discarded when the cluster chain
+  // of the file is cut.
+  //
+  FAT_EXTENT          *Extents;
+  UINTN               ExtentCount;
+  UINTN               ExtentMaxCount;
+  UINTN               ExtentClusters;
+
   //
   // Dirty is set if there have been any updates to the
   // file
@@ -723,9 +760,8 @@ FatInitializeDiskCache (
      page hit, just return the cache page; else update the related cache page and return
      the right cache page.
   2. Access of Data cache (CACHE_DATA):
-     The access data will be divided into UnderRun data, Aligned data and OverRun data;
-     The UnderRun data and OverRun data will be accessed by the Data cache,
-     but the Aligned data will be accessed with disk directly.
+     The accesses smaller than a cache page go through the Data cache, the
+     larger ones are accessed with disk directly.
 
   @param  Volume                - FAT file system volume.
   @param  CacheDataType         - The type of cache: CACHE_DATA or CACHE_FAT.
@@ -937,6 +973,7 @@ FatPhysicalFileSize (
 
   @retval EFI_SUCCESS           - Set the info successfully.
   @retval EFI_VOLUME_CORRUPTED  - Cluster chain corrupt.
+  @retval EFI_OUT_OF_RESOURCES  - Not enough memory to map the cluster chain.
 
 **/
 EFI_STATUS
@@ -946,6 +983,18 @@ FatOFilePosition (
   IN UINTN                PosLimit
   );
 
+/**
+
+  Discard the cluster runs mapped for the open file.
+
+  @param  OFile                 - The open file.
+
+**/
+VOID
+FatDiscardOFileExtents (
+  IN FAT_OFILE            *OFile
+  );
+
 /**
 
   Update the free cluster info of FatInfoSector of the volume.
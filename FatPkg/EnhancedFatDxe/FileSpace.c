@@ -1,7 +1,7 @@
 /** @file
   Routines dealing with disk spaces and FAT table entries.
 
-Copyright (c) 2005 - 2013, Intel Corporation. All rights reserved.<BR>
+Copyright (c) 2005 - 2020, Intel Corporation. All rights reserved.<BR>
 SPDX-License-Identifier: BSD-2-Clause-Patent
 
 
@@ -397,10 +397,11 @@ FatShrinkEof (
     OFile->FileCluster      = FAT_CLUSTER_FREE;
   }
   //
-  // Set CurrentCluster == FileCluster
+  // Set CurrentCluster == FileCluster and discard the mapped cluster runs
   // to force a recalculation of Position related stuffs
   //
   OFile->FileCurrentCluster = OFile->FileCluster;
+  FatDiscardOFileExtents (OFile);
   OFile->FileLastCluster    = LastCluster;
   OFile->Dirty              = TRUE;
   //
@@ -513,6 +514,7 @@ FatGrowEof (
       } else {
         OFile->FileCluster        = NewCluster;
         OFile->FileCurrentCluster = NewCluster;
+        FatDiscardOFileExtents (OFile);
       }
 
       LastCluster = NewCluster;
@@ -543,17 +545,131 @@ Done:
   return Status;
 }
 
+/**
+
+  Discard the cluster runs mapped for the open file.
+
+  @param  OFile                 - The open file.
+
+**/
+VOID
+FatDiscardOFileExtents (
+  IN FAT_OFILE            *OFile
+  )
+{
+  if (OFile->Extents != NULL) {
+    FreePool (OFile->Extents);
+  }
+
+  OFile->Extents        = NULL;
+  OFile->ExtentCount    = 0;
+  OFile->ExtentMaxCount = 0;
+  OFile->ExtentClusters = 0;
+}
+
+/**
+
+  Map the cluster runs of the open file, walking its cluster chain from where
+  the previous mapping stopped.
+
+  @param  OFile                 - The open file.
+  @param  ClusterCount          - The number of clusters of the file that must be mapped.
+  @param  ClusterLimit          - The number of clusters that is worth mapping while
+                                  the last run goes on.
+
+  @retval EFI_SUCCESS           - The clusters are mapped.
+  @retval EFI_VOLUME_CORRUPTED  - Cluster chain corrupt.
+  @retval EFI_OUT_OF_RESOURCES  - Not enough memory to map the cluster chain.
+
+**/
+STATIC
+EFI_STATUS
+FatMapOFileExtents (
+  IN FAT_OFILE            *OFile,
+  IN UINTN                ClusterCount,
+  IN UINTN                ClusterLimit
+  )
+{
+  FAT_VOLUME  *Volume;
+  FAT_EXTENT  *Extent;
+  FAT_EXTENT  *Extents;
+  UINTN       Cluster;
+
+  if (OFile->ExtentClusters >= ClusterLimit) {
+    return EFI_SUCCESS;
+  }
+
+  //
+  // Continue from the last mapped cluster, the file may have grown since
+  //
+  Volume = OFile->Volume;
+  if (OFile->ExtentCount == 0) {
+    Extent  = NULL;
+    Cluster = OFile->FileCluster;
+  } else {
+    Extent  = &OFile->Extents[OFile->ExtentCount - 1];
+    Cluster = FatGetFatEntry (Volume, Extent->Cluster + Extent->Count - 1);
+  }
+
+  while (OFile->ExtentClusters < ClusterLimit) {
+    if (Cluster < FAT_MIN_CLUSTER || Cluster > Volume->MaxCluster + 1) {
+      if (OFile->ExtentClusters < ClusterCount) {
+        DEBUG ((EFI_D_INIT | EFI_D_ERROR, "FatOFilePosition:"" cluster chain corrupt\n"));
+        return EFI_VOLUME_CORRUPTED;
+      }
+      break;
+    }
+
+    if (Extent == NULL || Extent->Cluster + Extent->Count != Cluster) {
+      if (OFile->ExtentClusters >= ClusterCount) {
+        //
+        // The run that holds the required clusters is complete
+        //
+        break;
+      }
+
+      if (OFile->ExtentCount == OFile->ExtentMaxCount) {
+        Extents = ReallocatePool (
+                    OFile->ExtentMaxCount * sizeof (FAT_EXTENT),
+                    MAX (OFile->ExtentMaxCount * 2, FAT_EXTENT_MIN_COUNT) * sizeof (FAT_EXTENT),
+                    OFile->Extents
+                    );
+        if (Extents == NULL) {
+          return EFI_OUT_OF_RESOURCES;
+        }
+        OFile->Extents        = Extents;
+        OFile->ExtentMaxCount = MAX (OFile->ExtentMaxCount * 2, FAT_EXTENT_MIN_COUNT);
+      }
+
+      Extent              = &OFile->Extents[OFile->ExtentCount++];
+      Extent->FileCluster = OFile->ExtentClusters;
+      Extent->Cluster     = Cluster;
+      Extent->Count       = 0;
+    }
+
+    Extent->Count++;
+    OFile->ExtentClusters++;
+    Cluster = FatGetFatEntry (Volume, Cluster);
+  }
+
+  return EFI_SUCCESS;
+}
+
 /**
 
   Seek OFile to requested position, and calculate the number of
   consecutive clusters from the position in the file
 
+  The clusters are found in the cluster runs mapped for the file with a binary
+  search, so the cluster chain is only walked once however the file is sought.
+
   @param  OFile                 - The open file.
   @param  Position              - The file's position which will be accessed.
   @param  PosLimit              - The maximum length current reading/writing may access
 
   @retval EFI_SUCCESS           - Set the info successfully.
   @retval EFI_VOLUME_CORRUPTED  - Cluster chain corrupt.
+  @retval EFI_OUT_OF_RESOURCES  - Not enough memory to map the cluster chain.
 
 **/
 EFI_STATUS
@@ -563,11 +679,19 @@ FatOFilePosition (
   IN UINTN                PosLimit
   )
 {
+  EFI_STATUS  Status;
   FAT_VOLUME  *Volume;
   UINTN       ClusterSize;
   UINTN       Cluster;
   UINTN       StartPos;
   UINTN       Run;
+  UINTN       FileCluster;
+  UINTN       ClusterLimit;
+  UINTN       RunClusters;
+  UINTN       Low;
+  UINTN       High;
+  UINTN       Middle;
+  FAT_EXTENT  *Extent;
 
   Volume      = OFile->Volume;
   ClusterSize = Volume->ClusterSize;
@@ -583,38 +707,40 @@ FatOFilePosition (
     Run             = OFile->FileSize - Position;
   } else {
     //
-    // Run the file's cluster chain to find the current position
-    // If possible, run from the current cluster rather than
-    // start from beginning
-    // Assumption: OFile->Position is always consistent with
-    // OFile->FileCurrentCluster.
-    // OFile->Position is not modified outside this function;
-    // OFile->FileCurrentCluster is modified outside this function
-    // to be the same as OFile->FileCluster
-    // when OFile->FileCluster is updated, so make a check of this
-    // and invalidate the original OFile->Position in this case
+    // Map the file's cluster chain up to the cluster of the position, and
+    // on while the run goes on and the access may need it
     //
-    Cluster     = OFile->FileCurrentCluster;
-    StartPos    = OFile->Position;
-    if (Position < StartPos || OFile->FileCluster == Cluster) {
-      StartPos  = 0;
-      Cluster   = OFile->FileCluster;
+    FileCluster  = Position >> Volume->ClusterAlignment;
+    StartPos     = FileCluster << Volume->ClusterAlignment;
+    Run          = ClusterSize - (Position - StartPos);
+    ClusterLimit = FileCluster + 1;
+    if (PosLimit > Run) {
+      ClusterLimit += ((PosLimit - Run - 1) >> Volume->ClusterAlignment) + 1;
     }
 
-    while (StartPos + ClusterSize <= Position) {
-      StartPos += ClusterSize;
-      if (Cluster == FAT_CLUSTER_FREE || (Cluster >= FAT_CLUSTER_SPECIAL)) {
-        DEBUG ((EFI_D_INIT | EFI_D_ERROR, "FatOFilePosition:"" cluster chain corrupt\n"));
-        return EFI_VOLUME_CORRUPTED;
-      }
-
-      Cluster = FatGetFatEntry (Volume, Cluster);
+    Status = FatMapOFileExtents (OFile, FileCluster + 1, ClusterLimit);
+    if (EFI_ERROR (Status)) {
+      return Status;
     }
 
-    if (Cluster < FAT_MIN_CLUSTER || Cluster > Volume->MaxCluster + 1) {
-      return EFI_VOLUME_CORRUPTED;
+    //
+    // Find the run of the cluster
+    //
+    Low  = 0;
+    High = OFile->ExtentCount - 1;
+    while (Low < High) {
+      Middle = (Low + High + 1) / 2;
+      if (OFile->Extents[Middle].FileCluster <= FileCluster) {
+        Low  = Middle;
+      } else {
+        High = Middle - 1;
+      }
     }
 
+    Extent  = &OFile->Extents[Low];
+    Cluster = Extent->Cluster + (FileCluster - Extent->FileCluster);
+    ASSERT (FileCluster - Extent->FileCluster < Extent->Count);
+
     OFile->PosDisk            = Volume->FirstClusterPos +
                                 LShiftU64 (Cluster - FAT_MIN_CLUSTER, Volume->ClusterAlignment) +
                                 Position - StartPos;
@@ -624,13 +750,8 @@ FatOFilePosition (
     //
     // Compute the number of consecutive clusters in the file
     //
-    Run = StartPos + ClusterSize - Position;
-    if (!FAT_END_OF_FAT_CHAIN (Cluster)) {
-      while ((FatGetFatEntry (Volume, Cluster) == Cluster + 1) && Run < PosLimit) {
-        Run     += ClusterSize;
-        Cluster += 1;
-      }
-    }
+    RunClusters = MIN (Extent->FileCluster + Extent->Count, ClusterLimit) - FileCluster - 1;
+    Run        += RunClusters << Volume->ClusterAlignment;
   }
 
   OFile->PosRem = Run;
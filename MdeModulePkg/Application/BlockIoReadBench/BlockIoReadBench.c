@@ -0,0 +1,312 @@
+/** @file
+  A shell application that measures the sequential read throughput of a block
+  device, such as an NVMe namespace.
+
+  "BlockIoReadBench" lists the block devices that are not partitions.
+  "BlockIoReadBench <Index> [ChunkKB]" reads the device of that index from LBA 0
+  to its last block with BlockIo ReadBlocks() requests of ChunkKB kilobytes,
+  1024 by default, and prints the elapsed time and the throughput.
+
+  Copyright (c) 2020, Intel Corporation. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+#include <Library/UefiLib.h>
+#include <Library/UefiApplicationEntryPoint.h>
+#include <Library/BaseLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/DevicePathLib.h>
+#include <Library/TimerLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiRuntimeServicesTableLib.h>
+
+#include <Protocol/BlockIo.h>
+#include <Protocol/ShellParameters.h>
+
+#define BLOCK_IO_READ_BENCH_DEFAULT_CHUNK_KB  1024
+
+/**
+  Returns the current time of the clock the benchmark is measured with.
+
+  This is the performance counter of the TimerLib instance if it reports a
+  frequency, the real time clock otherwise. Most real time clocks only count
+  whole seconds.
+
+  @return The time in nanoseconds since an arbitrary origin.
+
+**/
+UINT64
+GetBenchmarkTime (
+  VOID
+  )
+{
+  UINT64        StartValue;
+  UINT64        EndValue;
+  UINT64        Counter;
+  EFI_TIME      Time;
+  UINTN         Year;
+  UINTN         Month;
+  UINTN         Days;
+
+  if (GetPerformanceCounterProperties (&StartValue, &EndValue) != 0) {
+    Counter = GetPerformanceCounter ();
+    if (EndValue < StartValue) {
+      return GetTimeInNanoSecond (StartValue - Counter);
+    }
+
+    return GetTimeInNanoSecond (Counter - StartValue);
+  }
+
+  if (EFI_ERROR (gRT->GetTime (&Time, NULL))) {
+    return 0;
+  }
+
+  //
+  // Count the days with years starting on March 1st, which puts the leap day
+  // at the end of the year.
+  //
+  Year  = Time.Year - ((Time.Month <= 2) ? 1 : 0);
+  Month = (Time.Month <= 2) ? Time.Month + 9 : Time.Month - 3;
+  Days  = Year * 365 + Year / 4 - Year / 100 + Year / 400 + (Month * 153 + 2) / 5 + Time.Day;
+
+  return MultU64x32 (
+           MultU64x32 (Days, 24 * 60 * 60) + Time.Hour * 60 * 60 + Time.Minute * 60 + Time.Second,
+           1000000000
+           ) + Time.Nanosecond;
+}
+
+/**
+  Lists the block devices that are not partitions, and returns the one of an
+  index.
+
+  @param[in]  Index         The index of the device to return, or MAX_UINTN to
+                            print the list of the devices.
+  @param[out] BlockIo       Returns the Block I/O protocol of the device.
+
+  @retval EFI_SUCCESS       The device of the index was found, or the list was
+                            printed.
+  @retval EFI_NOT_FOUND     There is no device of the index.
+
+**/
+EFI_STATUS
+FindBlockDevice (
+  IN  UINTN                 Index,
+  OUT EFI_BLOCK_IO_PROTOCOL **BlockIo
+  )
+{
+  EFI_STATUS                Status;
+  EFI_HANDLE                *Handles;
+  UINTN                     HandleCount;
+  UINTN                     HandleIndex;
+  UINTN                     DeviceIndex;
+  EFI_BLOCK_IO_PROTOCOL     *DeviceBlockIo;
+  CHAR16                    *DevicePathText;
+
+  Status = gBS->LocateHandleBuffer (
+                  ByProtocol,
+                  &gEfiBlockIoProtocolGuid,
+                  NULL,
+                  &HandleCount,
+                  &Handles
+                  );
+  if (EFI_ERROR (Status)) {
+    return EFI_NOT_FOUND;
+  }
+
+  Status      = (Index == MAX_UINTN) ? EFI_SUCCESS : EFI_NOT_FOUND;
+  DeviceIndex = 0;
+  for (HandleIndex = 0; HandleIndex < HandleCount; HandleIndex++) {
+    gBS->HandleProtocol (Handles[HandleIndex], &gEfiBlockIoProtocolGuid, (VOID **) &DeviceBlockIo);
+    if (DeviceBlockIo->Media->LogicalPartition) {
+      continue;
+    }
+
+    if (DeviceIndex == Index) {
+      *BlockIo = DeviceBlockIo;
+      Status   = EFI_SUCCESS;
+      break;
+    }
+
+    if (Index == MAX_UINTN) {
+      DevicePathText = ConvertDevicePathToText (DevicePathFromHandle (Handles[HandleIndex]), TRUE, TRUE);
+      Print (
+        L"%2Lu: %Lu blocks of %d bytes%s %s\n",
+        (UINT64) DeviceIndex,
+        DeviceBlockIo->Media->MediaPresent ? DeviceBlockIo->Media->LastBlock + 1 : 0,
+        DeviceBlockIo->Media->BlockSize,
+        DeviceBlockIo->Media->MediaPresent ? L"" : L" (no media)",
+        (DevicePathText != NULL) ? DevicePathText : L""
+        );
+      if (DevicePathText != NULL) {
+        FreePool (DevicePathText);
+      }
+    }
+    DeviceIndex++;
+  }
+
+  FreePool (Handles);
+  return Status;
+}
+
+/**
+  Reads a whole block device and prints the throughput.
+
+  @param[in] BlockIo        The Block I/O protocol of the device.
+  @param[in] ChunkSize      The number of bytes to read with each request.
+
+  @retval EFI_SUCCESS           The device was read.
+  @retval EFI_NO_MEDIA          There is no media in the device.
+  @retval EFI_OUT_OF_RESOURCES  No memory for the buffer.
+  @return other                 ReadBlocks() failed.
+
+**/
+EFI_STATUS
+BenchmarkBlockIoRead (
+  IN EFI_BLOCK_IO_PROTOCOL  *BlockIo,
+  IN UINTN                  ChunkSize
+  )
+{
+  EFI_STATUS                Status;
+  EFI_BLOCK_IO_MEDIA        *Media;
+  UINTN                     ChunkBlocks;
+  UINTN                     Blocks;
+  VOID                      *Buffer;
+  EFI_LBA                   Lba;
+  UINT64                    Begin;
+  UINT64                    ElapsedUs;
+  UINT64                    TotalBytes;
+
+  Media = BlockIo->Media;
+  if (!Media->MediaPresent) {
+    return EFI_NO_MEDIA;
+  }
+
+  //
+  // Read whole blocks, into a buffer aligned as the device requires.
+  //
+  ChunkBlocks = MAX (ChunkSize / Media->BlockSize, 1);
+  ChunkSize   = ChunkBlocks * Media->BlockSize;
+  Buffer      = AllocateAlignedPages (
+                  EFI_SIZE_TO_PAGES (ChunkSize),
+                  (Media->IoAlign > EFI_PAGE_SIZE) ? Media->IoAlign : 0
+                  );
+  if (Buffer == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Print (
+    L"Reading %Lu blocks of %d bytes in chunks of %Lu KB\n",
+    Media->LastBlock + 1,
+    Media->BlockSize,
+    (UINT64) (ChunkSize / SIZE_1KB)
+    );
+  if (GetPerformanceCounterProperties (NULL, NULL) == 0) {
+    Print (L"No performance counter, timing with the real time clock\n");
+  }
+
+  Status = EFI_SUCCESS;
+  Begin  = GetBenchmarkTime ();
+  for (Lba = 0; Lba <= Media->LastBlock; Lba += Blocks) {
+    Blocks = ChunkBlocks;
+    if (Media->LastBlock - Lba + 1 < Blocks) {
+      Blocks = (UINTN) (Media->LastBlock - Lba + 1);
+    }
+
+    Status = BlockIo->ReadBlocks (BlockIo, Media->MediaId, Lba, Blocks * Media->BlockSize, Buffer);
+    if (EFI_ERROR (Status)) {
+      Print (L"ReadBlocks failed at LBA 0x%Lx - %r\n", Lba, Status);
+      break;
+    }
+  }
+  ElapsedUs = DivU64x32 (GetBenchmarkTime () - Begin, 1000);
+
+  FreeAlignedPages (Buffer, EFI_SIZE_TO_PAGES (ChunkSize));
+
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  TotalBytes = MultU64x32 (Media->LastBlock + 1, Media->BlockSize);
+  Print (L"Read %Lu MB in %Lu us", DivU64x32 (TotalBytes, SIZE_1MB), ElapsedUs);
+  if (ElapsedUs != 0) {
+    //
+    // Count in KB so that the product with 1000000 cannot overflow.
+    //
+    Print (
+      L", %Lu MB/s",
+      DivU64x64Remainder (
+        MultU64x32 (DivU64x32 (TotalBytes, SIZE_1KB), 1000000),
+        MultU64x32 (ElapsedUs, SIZE_1KB),
+        NULL
+        )
+      );
+  }
+  Print (L"\n");
+
+  return EFI_SUCCESS;
+}
+
+/**
+  The user Entry Point for Application. The user code starts with this function
+  as the real entry point for the image goes into a library that calls this
+  function.
+
+  @param[in] ImageHandle    The firmware allocated handle for the EFI image.
+  @param[in] SystemTable    A pointer to the EFI System Table.
+
+  @retval EFI_SUCCESS       The entry point is executed successfully.
+  @retval other             Some error occurs when executing this entry point.
+
+**/
+EFI_STATUS
+EFIAPI
+UefiMain (
+  IN EFI_HANDLE        ImageHandle,
+  IN EFI_SYSTEM_TABLE  *SystemTable
+  )
+{
+  EFI_STATUS                     Status;
+  EFI_SHELL_PARAMETERS_PROTOCOL  *ShellParameters;
+  EFI_BLOCK_IO_PROTOCOL          *BlockIo;
+  UINTN                          Index;
+  UINTN                          ChunkKb;
+
+  Status = gBS->HandleProtocol (
+                  ImageHandle,
+                  &gEfiShellParametersProtocolGuid,
+                  (VOID **) &ShellParameters
+                  );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if ((ShellParameters->Argc < 2) || (ShellParameters->Argc > 3)) {
+    Print (L"Usage: BlockIoReadBench <Index> [ChunkKB]\n");
+    return FindBlockDevice (MAX_UINTN, &BlockIo);
+  }
+
+  Index   = StrDecimalToUintn (ShellParameters->Argv[1]);
+  ChunkKb = BLOCK_IO_READ_BENCH_DEFAULT_CHUNK_KB;
+  if (ShellParameters->Argc == 3) {
+    ChunkKb = StrDecimalToUintn (ShellParameters->Argv[2]);
+  }
+  if ((ChunkKb == 0) || (ChunkKb > MAX_UINTN / SIZE_1KB)) {
+    Print (L"Invalid chunk size %s\n", ShellParameters->Argv[2]);
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Status = FindBlockDevice (Index, &BlockIo);
+  if (EFI_ERROR (Status)) {
+    Print (L"No block device %Lu\n", (UINT64) Index);
+    return Status;
+  }
+
+  Status = BenchmarkBlockIoRead (BlockIo, ChunkKb * SIZE_1KB);
+  if (EFI_ERROR (Status)) {
+    Print (L"BlockIoReadBench failed - %r\n", Status);
+  }
+
+  return Status;
+}
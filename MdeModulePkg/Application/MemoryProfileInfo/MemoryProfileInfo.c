@@ -620,6 +620,39 @@ DumpMemoryProfileMemoryRange (
   return (VOID *) Descriptor;
 }
 
+/**
+  Dump memory profile pool slab information.
+
+  @param[in] SlabInfo           Pointer to the first memory profile pool slab record.
+  @param[in] ProfileEnd         End address of the memory profile.
+
+**/
+VOID
+DumpMemoryProfilePoolSlabInfo (
+  IN MEMORY_PROFILE_POOL_SLAB_INFO  *SlabInfo,
+  IN UINTN                          ProfileEnd
+  )
+{
+  UINTN                         SlabIndex;
+
+  SlabIndex = 0;
+  while (((UINTN) SlabInfo + sizeof (MEMORY_PROFILE_POOL_SLAB_INFO) <= ProfileEnd) &&
+         (SlabInfo->Header.Signature == MEMORY_PROFILE_POOL_SLAB_INFO_SIGNATURE)) {
+    Print (L"MEMORY_PROFILE_POOL_SLAB_INFO (0x%x)\n", SlabIndex);
+    Print (L"  Signature                     - 0x%08x\n", SlabInfo->Header.Signature);
+    Print (L"  Length                        - 0x%04x\n", SlabInfo->Header.Length);
+    Print (L"  Revision                      - 0x%04x\n", SlabInfo->Header.Revision);
+    Print (L"  MemoryType                    - 0x%08x (%a)\n", SlabInfo->MemoryType, ProfileMemoryTypeToStr (SlabInfo->MemoryType));
+    Print (L"  ObjectSize                    - 0x%08x\n", SlabInfo->ObjectSize);
+    Print (L"  AllocCount                    - 0x%016lx\n", SlabInfo->AllocCount);
+    Print (L"  MagazineHitCount              - 0x%016lx\n", SlabInfo->MagazineHitCount);
+    Print (L"  SlabPageAllocCount            - 0x%016lx\n", SlabInfo->SlabPageAllocCount);
+    Print (L"  SlabPageFreeCount             - 0x%016lx\n", SlabInfo->SlabPageFreeCount);
+    SlabInfo = (MEMORY_PROFILE_POOL_SLAB_INFO *) ((UINTN) SlabInfo + SlabInfo->Header.Length);
+    SlabIndex++;
+  }
+}
+
 /**
   Scan memory profile by Signature.
 
@@ -678,6 +711,7 @@ DumpMemoryProfile (
   MEMORY_PROFILE_CONTEXT        *Context;
   MEMORY_PROFILE_FREE_MEMORY    *FreeMemory;
   MEMORY_PROFILE_MEMORY_RANGE   *MemoryRange;
+  MEMORY_PROFILE_POOL_SLAB_INFO *SlabInfo;
 
   Context = (MEMORY_PROFILE_CONTEXT *) ScanMemoryProfileBySignature (ProfileBuffer, ProfileSize, MEMORY_PROFILE_CONTEXT_SIGNATURE);
   if (Context != NULL) {
@@ -693,6 +727,11 @@ DumpMemoryProfile (
   if (MemoryRange != NULL) {
     DumpMemoryProfileMemoryRange (MemoryRange);
   }
+
+  SlabInfo = (MEMORY_PROFILE_POOL_SLAB_INFO *) ScanMemoryProfileBySignature (ProfileBuffer, ProfileSize, MEMORY_PROFILE_POOL_SLAB_INFO_SIGNATURE);
+  if (SlabInfo != NULL) {
+    DumpMemoryProfilePoolSlabInfo (SlabInfo, (UINTN) (ProfileBuffer + ProfileSize));
+  }
 }
 
 /**
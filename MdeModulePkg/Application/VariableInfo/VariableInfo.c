@@ -3,7 +3,10 @@
   this utility will print out the statistics information. You can use console
   redirection to capture the data.
 
-  Copyright (c) 2006 - 2016, Intel Corporation. All rights reserved.<BR>
+  "VariableInfo -e [Count]" instead measures how long it takes to enumerate all
+  the variables with GetNextVariableName(), Count times.
+
+  Copyright (c) 2006 - 2020, Intel Corporation. All rights reserved.<BR>
   SPDX-License-Identifier: BSD-2-Clause-Patent
 
 **/
@@ -16,12 +19,15 @@
 #include <Library/MemoryAllocationLib.h>
 #include <Library/DebugLib.h>
 #include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiRuntimeServicesTableLib.h>
+#include <Library/TimerLib.h>
 
 #include <Guid/VariableFormat.h>
 #include <Guid/SmmVariableCommon.h>
 #include <Guid/PiSmmCommunicationRegionTable.h>
 #include <Protocol/SmmCommunication.h>
 #include <Protocol/SmmVariable.h>
+#include <Protocol/ShellParameters.h>
 
 EFI_SMM_COMMUNICATION_PROTOCOL  *mSmmCommunication = NULL;
 
@@ -188,6 +194,141 @@ PrintInfoFromSmm (
   return Status;
 }
 
+/**
+  Returns the current time of the clock the benchmark is measured with.
+
+  This is the performance counter of the TimerLib instance if it reports a
+  frequency, the real time clock otherwise. Most real time clocks only count
+  whole seconds.
+
+  @return The time in nanoseconds since an arbitrary origin.
+
+**/
+UINT64
+GetBenchmarkTime (
+  VOID
+  )
+{
+  UINT64        StartValue;
+  UINT64        EndValue;
+  UINT64        Counter;
+  EFI_TIME      Time;
+  UINTN         Year;
+  UINTN         Month;
+  UINTN         Days;
+
+  if (GetPerformanceCounterProperties (&StartValue, &EndValue) != 0) {
+    Counter = GetPerformanceCounter ();
+    if (EndValue < StartValue) {
+      return GetTimeInNanoSecond (StartValue - Counter);
+    }
+
+    return GetTimeInNanoSecond (Counter - StartValue);
+  }
+
+  if (EFI_ERROR (gRT->GetTime (&Time, NULL))) {
+    return 0;
+  }
+
+  //
+  // Count the days with years starting on March 1st, which puts the leap day
+  // at the end of the year.
+  //
+  Year  = Time.Year - ((Time.Month <= 2) ? 1 : 0);
+  Month = (Time.Month <= 2) ? Time.Month + 9 : Time.Month - 3;
+  Days  = Year * 365 + Year / 4 - Year / 100 + Year / 400 + (Month * 153 + 2) / 5 + Time.Day;
+
+  return MultU64x32 (
+           MultU64x32 (Days, 24 * 60 * 60) + Time.Hour * 60 * 60 + Time.Minute * 60 + Time.Second,
+           1000000000
+           ) + Time.Nanosecond;
+}
+
+/**
+  This function measures the enumeration of all the variables with
+  GetNextVariableName(), and prints the number of variables and the time of
+  each enumeration.
+
+  @param[in] Count          The number of enumerations to measure.
+
+  @retval EFI_SUCCESS           All the variables were enumerated Count times.
+  @retval EFI_OUT_OF_RESOURCES  No memory for the variable name.
+  @return other                 GetNextVariableName() failed.
+
+**/
+EFI_STATUS
+BenchmarkVariableEnumeration (
+  IN UINTN      Count
+  )
+{
+  EFI_STATUS    Status;
+  CHAR16        *VariableName;
+  UINTN         NameBufferSize;
+  UINTN         NameSize;
+  CHAR16        *NewName;
+  EFI_GUID      VendorGuid;
+  UINTN         VariableCount;
+  UINTN         Pass;
+  UINT64        Begin;
+  UINT64        Elapsed;
+
+  NameBufferSize = 0x100;
+  VariableName   = AllocateZeroPool (NameBufferSize);
+  if (VariableName == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  if (GetPerformanceCounterProperties (NULL, NULL) == 0) {
+    Print (L"No performance counter, timing with the real time clock\n");
+  }
+
+  Status = EFI_SUCCESS;
+  for (Pass = 0; Pass < Count; Pass++) {
+    VariableName[0] = L'\0';
+    VariableCount   = 0;
+
+    Begin = GetBenchmarkTime ();
+    while (TRUE) {
+      NameSize = NameBufferSize;
+      Status   = gRT->GetNextVariableName (&NameSize, VariableName, &VendorGuid);
+      if (Status == EFI_BUFFER_TOO_SMALL) {
+        //
+        // Keep the name returned last, it is the input of the retry.
+        //
+        NewName = ReallocatePool (NameBufferSize, NameSize, VariableName);
+        if (NewName == NULL) {
+          Status = EFI_OUT_OF_RESOURCES;
+          break;
+        }
+        VariableName   = NewName;
+        NameBufferSize = NameSize;
+        continue;
+      }
+      if (EFI_ERROR (Status)) {
+        break;
+      }
+      VariableCount++;
+    }
+    Elapsed = GetBenchmarkTime () - Begin;
+
+    if (Status != EFI_NOT_FOUND) {
+      Print (L"GetNextVariableName failed after %Lu variables - %r\n", (UINT64) VariableCount, Status);
+      break;
+    }
+
+    Status = EFI_SUCCESS;
+    Print (
+      L"Pass %Lu: %Lu variables enumerated in %Lu us\n",
+      (UINT64) Pass + 1,
+      (UINT64) VariableCount,
+      DivU64x32 (Elapsed, 1000)
+      );
+  }
+
+  FreePool (VariableName);
+  return Status;
+}
+
 /**
   The user Entry Point for Application. The user code starts with this function
   as the real entry point for the image goes into a library that calls this
@@ -207,9 +348,29 @@ UefiMain (
   IN EFI_SYSTEM_TABLE  *SystemTable
   )
 {
-  EFI_STATUS            Status;
-  VARIABLE_INFO_ENTRY   *VariableInfo;
-  VARIABLE_INFO_ENTRY   *Entry;
+  EFI_STATUS                     Status;
+  VARIABLE_INFO_ENTRY            *VariableInfo;
+  VARIABLE_INFO_ENTRY            *Entry;
+  EFI_SHELL_PARAMETERS_PROTOCOL  *ShellParameters;
+  UINTN                          Count;
+
+  Status = gBS->HandleProtocol (
+                  ImageHandle,
+                  &gEfiShellParametersProtocolGuid,
+                  (VOID **) &ShellParameters
+                  );
+  if (!EFI_ERROR (Status) && (ShellParameters->Argc > 1)) {
+    if ((StrCmp (ShellParameters->Argv[1], L"-e") != 0) || (ShellParameters->Argc > 3)) {
+      Print (L"Usage: VariableInfo [-e [Count]]\n");
+      return EFI_INVALID_PARAMETER;
+    }
+
+    Count = 1;
+    if (ShellParameters->Argc == 3) {
+      Count = StrDecimalToUintn (ShellParameters->Argv[2]);
+    }
+    return BenchmarkVariableEnumeration (Count);
+  }
 
   Status = EfiGetSystemConfigurationTable (&gEfiVariableGuid, (VOID **)&Entry);
   if (EFI_ERROR (Status) || (Entry == NULL)) {
@@ -2,7 +2,7 @@
   NvmExpressDxe driver is used to manage non-volatile memory subsystem which follows
   NVM Express specification.
 
-  Copyright (c) 2013 - 2017, Intel Corporation. All rights reserved.<BR>
+  Copyright (c) 2013 - 2020, Intel Corporation. All rights reserved.<BR>
   SPDX-License-Identifier: BSD-2-Clause-Patent
 
 **/
@@ -510,7 +510,42 @@ UnregisterNvmeNamespace (
 }
 
 /**
-  Call back function when the timer event is signaled.
+  Starts the timer that processes the asynchronous tasks while there are
+  asynchronous commands outstanding, and stops it otherwise.
+
+  It must be called at TPL_NOTIFY.
+
+  @param[in]  Private   The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+
+**/
+VOID
+NvmeUpdateAsyncTimer (
+  IN NVME_CONTROLLER_PRIVATE_DATA         *Private
+  )
+{
+  BOOLEAN                              Busy;
+  EFI_STATUS                           Status;
+
+  Busy = !IsListEmpty (&Private->AsyncPassThruQueue) ||
+         !IsListEmpty (&Private->UnsubmittedSubtasks);
+  if (Busy == Private->TimerPolling) {
+    return;
+  }
+
+  if (Busy) {
+    Status = gBS->SetTimer (Private->TimerEvent, TimerPeriodic, NVME_HC_ASYNC_TIMER);
+  } else {
+    Status = gBS->SetTimer (Private->TimerEvent, TimerCancel, 0);
+  }
+  if (!EFI_ERROR (Status)) {
+    Private->TimerPolling = Busy;
+  }
+}
+
+/**
+  Call back function when the timer event is signaled. Submits the unsubmitted
+  asynchronous subtasks and reaps the completions of all the asynchronous I/O
+  queues.
 
   @param[in]  Event     The Event this notify function registered to.
   @param[in]  Context   Pointer to the context data registered to the
@@ -539,9 +574,6 @@ ProcessAsyncTaskList (
   EFI_STATUS                           Status;
 
   Private    = (NVME_CONTROLLER_PRIVATE_DATA*)Context;
-  QueueId    = 2;
-  Cq         = Private->CqBuffer[QueueId] + Private->CqHdbl[QueueId].Cqh;
-  HasNewItem = FALSE;
   PciIo      = Private->PciIo;
 
   //
@@ -615,82 +647,95 @@ ProcessAsyncTaskList (
     }
   }
 
-  while (Cq->Pt != Private->Pt[QueueId]) {
-    ASSERT (Cq->Sqid == QueueId);
+  for (QueueId = 2; QueueId < Private->QueueCount; QueueId++) {
+    if (Private->AsyncInFlight[QueueId] == 0) {
+      continue;
+    }
 
-    HasNewItem = TRUE;
+    Cq         = Private->CqBuffer[QueueId] + Private->CqHdbl[QueueId].Cqh;
+    HasNewItem = FALSE;
 
-    //
-    // Find the command with given Command Id.
-    //
-    for (Link = GetFirstNode (&Private->AsyncPassThruQueue);
-         !IsNull (&Private->AsyncPassThruQueue, Link);
-         Link = NextLink) {
-      NextLink = GetNextNode (&Private->AsyncPassThruQueue, Link);
-      AsyncRequest = NVME_PASS_THRU_ASYNC_REQ_FROM_THIS (Link);
-      if (AsyncRequest->CommandId == Cq->Cid) {
-        //
-        // Copy the Respose Queue entry for this command to the callers
-        // response buffer.
-        //
-        CopyMem (
-          AsyncRequest->Packet->NvmeCompletion,
-          Cq,
-          sizeof(EFI_NVM_EXPRESS_COMPLETION)
-          );
+    while (Cq->Pt != Private->Pt[QueueId]) {
+      ASSERT (Cq->Sqid == QueueId);
 
-        //
-        // Free the resources allocated before cmd submission
-        //
-        if (AsyncRequest->MapData != NULL) {
-          PciIo->Unmap (PciIo, AsyncRequest->MapData);
-        }
-        if (AsyncRequest->MapMeta != NULL) {
-          PciIo->Unmap (PciIo, AsyncRequest->MapMeta);
-        }
-        if (AsyncRequest->MapPrpList != NULL) {
-          PciIo->Unmap (PciIo, AsyncRequest->MapPrpList);
-        }
-        if (AsyncRequest->PrpListHost != NULL) {
-          PciIo->FreeBuffer (
-                   PciIo,
-                   AsyncRequest->PrpListNo,
-                   AsyncRequest->PrpListHost
-                   );
-        }
+      HasNewItem = TRUE;
 
-        RemoveEntryList (Link);
-        gBS->SignalEvent (AsyncRequest->CallerEvent);
-        FreePool (AsyncRequest);
+      //
+      // Find the command with given Command Id.
+      //
+      for (Link = GetFirstNode (&Private->AsyncPassThruQueue);
+           !IsNull (&Private->AsyncPassThruQueue, Link);
+           Link = NextLink) {
+        NextLink = GetNextNode (&Private->AsyncPassThruQueue, Link);
+        AsyncRequest = NVME_PASS_THRU_ASYNC_REQ_FROM_THIS (Link);
+        if ((AsyncRequest->QueueId == QueueId) &&
+            (AsyncRequest->CommandId == Cq->Cid)) {
+          //
+          // Copy the Respose Queue entry for this command to the callers
+          // response buffer.
+          //
+          CopyMem (
+            AsyncRequest->Packet->NvmeCompletion,
+            Cq,
+            sizeof(EFI_NVM_EXPRESS_COMPLETION)
+            );
 
-        //
-        // Update submission queue head.
-        //
-        Private->AsyncSqHead = Cq->Sqhd;
-        break;
+          //
+          // Free the resources allocated before cmd submission
+          //
+          if (AsyncRequest->MapData != NULL) {
+            PciIo->Unmap (PciIo, AsyncRequest->MapData);
+          }
+          if (AsyncRequest->MapMeta != NULL) {
+            PciIo->Unmap (PciIo, AsyncRequest->MapMeta);
+          }
+          if (AsyncRequest->MapPrpList != NULL) {
+            PciIo->Unmap (PciIo, AsyncRequest->MapPrpList);
+          }
+          if (AsyncRequest->PrpListHost != NULL) {
+            PciIo->FreeBuffer (
+                     PciIo,
+                     AsyncRequest->PrpListNo,
+                     AsyncRequest->PrpListHost
+                     );
+          }
+
+          RemoveEntryList (Link);
+          gBS->SignalEvent (AsyncRequest->CallerEvent);
+          FreePool (AsyncRequest);
+          Private->AsyncInFlight[QueueId]--;
+
+          //
+          // Update submission queue head.
+          //
+          Private->AsyncSqHead[QueueId] = Cq->Sqhd;
+          break;
+        }
+      }
+
+      Private->CqHdbl[QueueId].Cqh++;
+      if (Private->CqHdbl[QueueId].Cqh > NVME_ASYNC_CCQ_SIZE) {
+        Private->CqHdbl[QueueId].Cqh = 0;
+        Private->Pt[QueueId] ^= 1;
       }
-    }
 
-    Private->CqHdbl[QueueId].Cqh++;
-    if (Private->CqHdbl[QueueId].Cqh > NVME_ASYNC_CCQ_SIZE) {
-      Private->CqHdbl[QueueId].Cqh = 0;
-      Private->Pt[QueueId] ^= 1;
+      Cq = Private->CqBuffer[QueueId] + Private->CqHdbl[QueueId].Cqh;
     }
 
-    Cq = Private->CqBuffer[QueueId] + Private->CqHdbl[QueueId].Cqh;
+    if (HasNewItem) {
+      Data  = ReadUnaligned32 ((UINT32*)&Private->CqHdbl[QueueId]);
+      PciIo->Mem.Write (
+                   PciIo,
+                   EfiPciIoWidthUint32,
+                   NVME_BAR,
+                   NVME_CQHDBL_OFFSET(QueueId, Private->Cap.Dstrd),
+                   1,
+                   &Data
+                   );
+    }
   }
 
-  if (HasNewItem) {
-    Data  = ReadUnaligned32 ((UINT32*)&Private->CqHdbl[QueueId]);
-    PciIo->Mem.Write (
-                 PciIo,
-                 EfiPciIoWidthUint32,
-                 NVME_BAR,
-                 NVME_CQHDBL_OFFSET(QueueId, Private->Cap.Dstrd),
-                 1,
-                 &Data
-                 );
-  }
+  NvmeUpdateAsyncTimer (Private);
 }
 
 /**
@@ -957,14 +1002,16 @@ NvmExpressDriverBindingStart (
     // 4th 4kB boundary is the start of I/O completion queue #1.
     // 5th 4kB boundary is the start of I/O submission queue #2.
     // 6th 4kB boundary is the start of I/O completion queue #2.
+    // And so on for the other asynchronous I/O queues.
     //
-    // Allocate 6 pages of memory, then map it for bus master read and write.
+    // Allocate NVME_QUEUE_BUFFER_PAGES pages of memory, then map it for bus
+    // master read and write.
     //
     Status = PciIo->AllocateBuffer (
                       PciIo,
                       AllocateAnyPages,
                       EfiBootServicesData,
-                      6,
+                      NVME_QUEUE_BUFFER_PAGES,
                       (VOID**)&Private->Buffer,
                       0
                       );
@@ -972,7 +1019,7 @@ NvmExpressDriverBindingStart (
       goto Exit;
     }
 
-    Bytes = EFI_PAGES_TO_SIZE (6);
+    Bytes = EFI_PAGES_TO_SIZE (NVME_QUEUE_BUFFER_PAGES);
     Status = PciIo->Map (
                       PciIo,
                       EfiPciIoOperationBusMasterCommonBuffer,
@@ -982,7 +1029,7 @@ NvmExpressDriverBindingStart (
                       &Private->Mapping
                       );
 
-    if (EFI_ERROR (Status) || (Bytes != EFI_PAGES_TO_SIZE (6))) {
+    if (EFI_ERROR (Status) || (Bytes != EFI_PAGES_TO_SIZE (NVME_QUEUE_BUFFER_PAGES))) {
       goto Exit;
     }
 
@@ -1009,7 +1056,8 @@ NvmExpressDriverBindingStart (
     }
 
     //
-    // Start the asynchronous I/O completion monitor
+    // Create the asynchronous I/O completion monitor. It is started when
+    // asynchronous commands are submitted.
     //
     Status = gBS->CreateEvent (
                     EVT_TIMER | EVT_NOTIFY_SIGNAL,
@@ -1022,15 +1070,6 @@ NvmExpressDriverBindingStart (
       goto Exit;
     }
 
-    Status = gBS->SetTimer (
-                    Private->TimerEvent,
-                    TimerPeriodic,
-                    NVME_HC_ASYNC_TIMER
-                    );
-    if (EFI_ERROR (Status)) {
-      goto Exit;
-    }
-
     Status = gBS->InstallMultipleProtocolInterfaces (
                     &Controller,
                     &gEfiNvmExpressPassThruProtocolGuid,
@@ -1093,7 +1132,7 @@ Exit:
   }
 
   if ((Private != NULL) && (Private->Buffer != NULL)) {
-    PciIo->FreeBuffer (PciIo, 6, Private->Buffer);
+    PciIo->FreeBuffer (PciIo, NVME_QUEUE_BUFFER_PAGES, Private->Buffer);
   }
 
   if ((Private != NULL) && (Private->ControllerData != NULL)) {
@@ -1216,7 +1255,7 @@ NvmExpressDriverBindingStop (
       }
 
       if (Private->Buffer != NULL) {
-        Private->PciIo->FreeBuffer (Private->PciIo, 6, Private->Buffer);
+        Private->PciIo->FreeBuffer (Private->PciIo, NVME_QUEUE_BUFFER_PAGES, Private->Buffer);
       }
 
       FreePool (Private->ControllerData);
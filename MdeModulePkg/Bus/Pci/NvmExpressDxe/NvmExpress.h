@@ -3,7 +3,7 @@
   NVM Express specification.
 
   (C) Copyright 2016 Hewlett Packard Enterprise Development LP<BR>
-  Copyright (c) 2013 - 2019, Intel Corporation. All rights reserved.<BR>
+  Copyright (c) 2013 - 2020, Intel Corporation. All rights reserved.<BR>
   SPDX-License-Identifier: BSD-2-Clause-Patent
 
 **/
@@ -59,8 +59,19 @@ extern EFI_DRIVER_SUPPORTED_EFI_VERSION_PROTOCOL  gNvmExpressDriverSupportedEfiV
 #define NVME_ASQ_SIZE                             1     // Number of admin submission queue entries, which is 0-based
 #define NVME_ACQ_SIZE                             1     // Number of admin completion queue entries, which is 0-based
 
-#define NVME_CSQ_SIZE                             1     // Number of I/O submission queue entries, which is 0-based
-#define NVME_CCQ_SIZE                             1     // Number of I/O completion queue entries, which is 0-based
+//
+// Number of synchronous I/O submission and completion queue entries, which is
+// 0-based. The synchronous I/O submission queue size is 4kB in total, so that
+// the commands a large blocking request is split into can be pipelined.
+//
+#define NVME_CSQ_SIZE                             63
+#define NVME_CCQ_SIZE                             63
+
+//
+// Number of command packets NvmeRead() and NvmeWrite() hand to
+// NvmePipelinedPassThru() at a time.
+//
+#define NVME_PIPELINE_PACKETS                     256
 
 //
 // Number of asynchronous I/O submission queue entries, which is 0-based.
@@ -73,7 +84,16 @@ extern EFI_DRIVER_SUPPORTED_EFI_VERSION_PROTOCOL  gNvmExpressDriverSupportedEfiV
 //
 #define NVME_ASYNC_CCQ_SIZE                       255
 
-#define NVME_MAX_QUEUES                           3     // Number of queues supported by the driver
+//
+// Number of asynchronous I/O queue pairs the driver tries to create. Fewer are
+// used if the controller allocates fewer I/O queues.
+//
+#define NVME_ASYNC_QUEUES                         4
+
+#define NVME_MAX_QUEUES                           (2 + NVME_ASYNC_QUEUES) // Number of queues supported by the driver
+#define NVME_QUEUE_BUFFER_PAGES                   (2 * NVME_MAX_QUEUES)   // Pages of the submission & completion queues
+
+#define NVME_FEATURE_NUMBER_OF_QUEUES             0x07  // Set Features identifier of Number of Queues
 
 #define NVME_CONTROLLER_ID                        0
 
@@ -83,9 +103,11 @@ extern EFI_DRIVER_SUPPORTED_EFI_VERSION_PROTOCOL  gNvmExpressDriverSupportedEfiV
 #define NVME_GENERIC_TIMEOUT                      EFI_TIMER_PERIOD_SECONDS (5)
 
 //
-// Nvme async transfer timer interval, set by experience.
+// Nvme async transfer timer interval while asynchronous commands are
+// outstanding, which is rounded up to the platform timer tick. The timer is
+// stopped while no asynchronous command is outstanding.
 //
-#define NVME_HC_ASYNC_TIMER                       EFI_TIMER_PERIOD_MILLISECONDS (1)
+#define NVME_HC_ASYNC_TIMER                       EFI_TIMER_PERIOD_MICROSECONDS (100)
 
 //
 // Unique signature for private data structure.
@@ -116,13 +138,14 @@ struct _NVME_CONTROLLER_PRIVATE_DATA {
   NVME_ADMIN_CONTROLLER_DATA          *ControllerData;
 
   //
-  // 6 x 4kB aligned buffers will be carved out of this buffer.
+  // NVME_QUEUE_BUFFER_PAGES x 4kB aligned buffers will be carved out of this buffer.
   // 1st 4kB boundary is the start of the admin submission queue.
   // 2nd 4kB boundary is the start of the admin completion queue.
   // 3rd 4kB boundary is the start of I/O submission queue #1.
   // 4th 4kB boundary is the start of I/O completion queue #1.
   // 5th 4kB boundary is the start of I/O submission queue #2.
   // 6th 4kB boundary is the start of I/O completion queue #2.
+  // And so on for the other asynchronous I/O queues.
   //
   UINT8                               *Buffer;
   UINT8                               *BufferPciAddr;
@@ -140,7 +163,24 @@ struct _NVME_CONTROLLER_PRIVATE_DATA {
   //
   NVME_SQTDBL                         SqTdbl[NVME_MAX_QUEUES];
   NVME_CQHDBL                         CqHdbl[NVME_MAX_QUEUES];
-  UINT16                              AsyncSqHead;
+
+  //
+  // Number of queues created, including the admin queue. Queue #1 is for
+  // blocking I/O, and queues #2 and above are for non-blocking I/O.
+  //
+  UINT16                              QueueCount;
+
+  //
+  // Submission queue heads and numbers of commands in flight of the
+  // asynchronous I/O queues.
+  //
+  UINT16                              AsyncSqHead[NVME_MAX_QUEUES];
+  UINT32                              AsyncInFlight[NVME_MAX_QUEUES];
+
+  //
+  // Number of synchronous I/O queue entries as created, which is 0-based.
+  //
+  UINT16                              SyncQueueSize;
 
   //
   // Flag to indicate internal IO queue creation.
@@ -161,6 +201,7 @@ struct _NVME_CONTROLLER_PRIVATE_DATA {
   // For Non-blocking operations.
   //
   EFI_EVENT                           TimerEvent;
+  BOOLEAN                             TimerPolling;
   LIST_ENTRY                          AsyncPassThruQueue;
   LIST_ENTRY                          UnsubmittedSubtasks;
 };
@@ -292,6 +333,7 @@ typedef struct {
   LIST_ENTRY                               Link;
 
   EFI_NVM_EXPRESS_PASS_THRU_COMMAND_PACKET *Packet;
+  UINT16                                   QueueId;
   UINT16                                   CommandId;
   VOID                                     *MapPrpList;
   UINTN                                    PrpListNo;
@@ -308,6 +350,27 @@ typedef struct {
       NVME_PASS_THRU_ASYNC_REQ_SIG                       \
       )
 
+//
+// Buffers mapped for an Nvme command, released when the command completes.
+//
+typedef struct {
+  VOID                                     *MapData;
+  VOID                                     *MapMeta;
+  VOID                                     *MapPrpList;
+  UINTN                                    PrpListNo;
+  VOID                                     *PrpListHost;
+} NVME_PASS_THRU_MAPPING;
+
+//
+// Nvme command in flight on the synchronous I/O queue during a pipelined
+// passthru, tracked by its submission queue slot.
+//
+typedef struct {
+  EFI_NVM_EXPRESS_PASS_THRU_COMMAND_PACKET *Packet;
+  UINT16                                   CommandId;
+  NVME_PASS_THRU_MAPPING                   Mapping;
+} NVME_PIPELINED_COMMAND;
+
 /**
   Retrieves a Unicode string that is the user readable name of the driver.
 
@@ -600,6 +663,68 @@ NvmExpressPassThru (
   IN     EFI_EVENT                                   Event OPTIONAL
   );
 
+/**
+  Call back function when the timer event is signaled. Submits the unsubmitted
+  asynchronous subtasks and reaps the completions of all the asynchronous I/O
+  queues.
+
+  @param[in]  Event     The Event this notify function registered to.
+  @param[in]  Context   Pointer to the context data registered to the
+                        Event.
+
+**/
+VOID
+EFIAPI
+ProcessAsyncTaskList (
+  IN EFI_EVENT                    Event,
+  IN VOID*                        Context
+  );
+
+/**
+  Starts the timer that processes the asynchronous tasks while there are
+  asynchronous commands outstanding, and stops it otherwise.
+
+  It must be called at TPL_NOTIFY.
+
+  @param[in]  Private   The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+
+**/
+VOID
+NvmeUpdateAsyncTimer (
+  IN NVME_CONTROLLER_PRIVATE_DATA         *Private
+  );
+
+/**
+  Sends a series of NVM Express I/O Command Packets to a namespace through the
+  synchronous I/O queue, and waits for all of them to complete.
+
+  As many commands as the queue holds are placed in the submission queue before
+  its doorbell is rung once, and the completions that have been posted are
+  reaped together before the completion queue head doorbell is written once.
+  The queue is refilled as commands complete.
+
+  @param[in]     Private             The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+  @param[in]     NamespaceId         The namespace ID the command packets are sent to.
+  @param[in,out] Packets             The NVM Express I/O Command Packets to send.
+  @param[in]     PacketCount         The number of command packets in Packets.
+
+  @retval EFI_SUCCESS                All the command packets completed successfully.
+  @retval EFI_DEVICE_ERROR           A command packet completed with an error, or
+                                     the queue doorbells could not be written.
+                                     The command packets not yet submitted are not sent.
+  @retval EFI_OUT_OF_RESOURCES       The buffers of a command packet could not be mapped.
+  @retval EFI_TIMEOUT                A timeout occurred while waiting for completions.
+                                     The controller was reset.
+
+**/
+EFI_STATUS
+NvmePipelinedPassThru (
+  IN     NVME_CONTROLLER_PRIVATE_DATA                *Private,
+  IN     UINT32                                      NamespaceId,
+  IN OUT EFI_NVM_EXPRESS_PASS_THRU_COMMAND_PACKET    **Packets,
+  IN     UINTN                                       PacketCount
+  );
+
 /**
   Used to retrieve the next namespace ID for this NVM Express controller.
 
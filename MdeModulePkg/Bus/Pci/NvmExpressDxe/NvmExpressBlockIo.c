@@ -2,7 +2,7 @@
   NvmExpressDxe driver is used to manage non-volatile memory subsystem which follows
   NVM Express specification.
 
-  Copyright (c) 2013 - 2018, Intel Corporation. All rights reserved.<BR>
+  Copyright (c) 2013 - 2020, Intel Corporation. All rights reserved.<BR>
   SPDX-License-Identifier: BSD-2-Clause-Patent
 
 **/
@@ -141,6 +141,119 @@ WriteSectors (
   return Status;
 }
 
+/**
+  Read or write some sectors that span several commands. The commands are
+  submitted back-to-back to the synchronous I/O queue of the controller, which
+  rings its doorbells once for as many commands as the queue holds.
+
+  @param  Device                 The pointer to the NVME_DEVICE_PRIVATE_DATA data structure.
+  @param  Buffer                 The buffer to be read into or written from.
+  @param  Lba                    The start block number.
+  @param  Blocks                 On input, total block number to be transferred.
+                                 On output, the block number that is not transferred.
+  @param  MaxTransferBlocks      The maximum block number of a command.
+  @param  IsRead                 TRUE to read the sectors, FALSE to write them.
+
+  @retval EFI_SUCCESS            Datum are transferred.
+  @retval EFI_OUT_OF_RESOURCES   The command packets could not be allocated.
+  @retval Others                 Fail to transfer all the datum.
+
+**/
+EFI_STATUS
+ReadWriteSectorsPipelined (
+  IN     NVME_DEVICE_PRIVATE_DATA      *Device,
+  IN     UINT64                        Buffer,
+  IN     UINT64                        Lba,
+  IN OUT UINTN                         *Blocks,
+  IN     UINT32                        MaxTransferBlocks,
+  IN     BOOLEAN                       IsRead
+  )
+{
+  NVME_CONTROLLER_PRIVATE_DATA             *Private;
+  EFI_NVM_EXPRESS_PASS_THRU_COMMAND_PACKET *CommandPackets;
+  EFI_NVM_EXPRESS_PASS_THRU_COMMAND_PACKET **Packets;
+  EFI_NVM_EXPRESS_COMMAND                  *Commands;
+  EFI_NVM_EXPRESS_COMPLETION               *Completions;
+  EFI_STATUS                               Status;
+  UINTN                                    MaxCount;
+  UINTN                                    Count;
+  UINTN                                    Transferred;
+  UINT32                                   BlockSize;
+  UINT32                                   CommandBlocks;
+
+  Private   = Device->Controller;
+  BlockSize = Device->Media.BlockSize;
+
+  MaxCount       = MIN (NVME_PIPELINE_PACKETS, (*Blocks + MaxTransferBlocks - 1) / MaxTransferBlocks);
+  CommandPackets = AllocatePool (MaxCount * sizeof (EFI_NVM_EXPRESS_PASS_THRU_COMMAND_PACKET));
+  Packets        = AllocatePool (MaxCount * sizeof (EFI_NVM_EXPRESS_PASS_THRU_COMMAND_PACKET *));
+  Commands       = AllocatePool (MaxCount * sizeof (EFI_NVM_EXPRESS_COMMAND));
+  Completions    = AllocatePool (MaxCount * sizeof (EFI_NVM_EXPRESS_COMPLETION));
+  if ((CommandPackets == NULL) || (Packets == NULL) || (Commands == NULL) || (Completions == NULL)) {
+    Status = EFI_OUT_OF_RESOURCES;
+    goto EXIT;
+  }
+
+  Status = EFI_SUCCESS;
+  while ((*Blocks > 0) && !EFI_ERROR (Status)) {
+    ZeroMem (CommandPackets, MaxCount * sizeof (EFI_NVM_EXPRESS_PASS_THRU_COMMAND_PACKET));
+    ZeroMem (Commands, MaxCount * sizeof (EFI_NVM_EXPRESS_COMMAND));
+    ZeroMem (Completions, MaxCount * sizeof (EFI_NVM_EXPRESS_COMPLETION));
+
+    Transferred = 0;
+    for (Count = 0; (Count < MaxCount) && (Transferred < *Blocks); Count++) {
+      CommandBlocks = (UINT32)MIN (*Blocks - Transferred, MaxTransferBlocks);
+
+      Packets[Count]                        = &CommandPackets[Count];
+      CommandPackets[Count].NvmeCmd         = &Commands[Count];
+      CommandPackets[Count].NvmeCompletion  = &Completions[Count];
+
+      Commands[Count].Cdw0.Opcode           = IsRead ? NVME_IO_READ_OPC : NVME_IO_WRITE_OPC;
+      Commands[Count].Nsid                  = Device->NamespaceId;
+      CommandPackets[Count].TransferBuffer  = (VOID *)(UINTN)(Buffer + MultU64x32 (Transferred, BlockSize));
+      CommandPackets[Count].TransferLength  = CommandBlocks * BlockSize;
+      CommandPackets[Count].CommandTimeout  = NVME_GENERIC_TIMEOUT;
+      CommandPackets[Count].QueueType       = NVME_IO_QUEUE;
+
+      Commands[Count].Cdw10 = (UINT32)(Lba + Transferred);
+      Commands[Count].Cdw11 = (UINT32)RShiftU64(Lba + Transferred, 32);
+      Commands[Count].Cdw12 = (CommandBlocks - 1) & 0xFFFF;
+      if (!IsRead) {
+        //
+        // Set Force Unit Access bit (bit 30) to use write-through behaviour
+        //
+        Commands[Count].Cdw12 |= BIT30;
+      }
+      Commands[Count].Flags = CDW10_VALID | CDW11_VALID | CDW12_VALID;
+
+      Transferred += CommandBlocks;
+    }
+
+    Status = NvmePipelinedPassThru (Private, Device->NamespaceId, Packets, Count);
+    if (!EFI_ERROR (Status)) {
+      Buffer  += MultU64x32 (Transferred, BlockSize);
+      Lba     += Transferred;
+      *Blocks -= Transferred;
+    }
+  }
+
+EXIT:
+  if (CommandPackets != NULL) {
+    FreePool (CommandPackets);
+  }
+  if (Packets != NULL) {
+    FreePool (Packets);
+  }
+  if (Commands != NULL) {
+    FreePool (Commands);
+  }
+  if (Completions != NULL) {
+    FreePool (Completions);
+  }
+
+  return Status;
+}
+
 /**
   Read some blocks from the device.
 
@@ -195,21 +308,11 @@ NvmeRead (
     MaxTransferBlocks = 1024;
   }
 
-  while (Blocks > 0) {
-    if (Blocks > MaxTransferBlocks) {
-      Status = ReadSectors (Device, (UINT64)(UINTN)Buffer, Lba, MaxTransferBlocks);
-
-      Blocks -= MaxTransferBlocks;
-      Buffer  = (VOID *)(UINTN)((UINT64)(UINTN)Buffer + MaxTransferBlocks * BlockSize);
-      Lba    += MaxTransferBlocks;
-    } else {
-      Status = ReadSectors (Device, (UINT64)(UINTN)Buffer, Lba, (UINT32)Blocks);
-      Blocks = 0;
-    }
-
-    if (EFI_ERROR(Status)) {
-      break;
-    }
+  if (Blocks > MaxTransferBlocks) {
+    Status = ReadWriteSectorsPipelined (Device, (UINT64)(UINTN)Buffer, Lba, &Blocks, MaxTransferBlocks, TRUE);
+  } else if (Blocks > 0) {
+    Status = ReadSectors (Device, (UINT64)(UINTN)Buffer, Lba, (UINT32)Blocks);
+    Blocks = 0;
   }
 
   DEBUG ((DEBUG_BLKIO, "%a: Lba = 0x%08Lx, Original = 0x%08Lx, "
@@ -273,21 +376,11 @@ NvmeWrite (
     MaxTransferBlocks = 1024;
   }
 
-  while (Blocks > 0) {
-    if (Blocks > MaxTransferBlocks) {
-      Status = WriteSectors (Device, (UINT64)(UINTN)Buffer, Lba, MaxTransferBlocks);
-
-      Blocks -= MaxTransferBlocks;
-      Buffer  = (VOID *)(UINTN)((UINT64)(UINTN)Buffer + MaxTransferBlocks * BlockSize);
-      Lba    += MaxTransferBlocks;
-    } else {
-      Status = WriteSectors (Device, (UINT64)(UINTN)Buffer, Lba, (UINT32)Blocks);
-      Blocks = 0;
-    }
-
-    if (EFI_ERROR(Status)) {
-      break;
-    }
+  if (Blocks > MaxTransferBlocks) {
+    Status = ReadWriteSectorsPipelined (Device, (UINT64)(UINTN)Buffer, Lba, &Blocks, MaxTransferBlocks, FALSE);
+  } else if (Blocks > 0) {
+    Status = WriteSectors (Device, (UINT64)(UINTN)Buffer, Lba, (UINT32)Blocks);
+    Blocks = 0;
   }
 
   DEBUG ((DEBUG_BLKIO, "%a: Lba = 0x%08Lx, Original = 0x%08Lx, "
@@ -796,6 +889,13 @@ NvmeAsyncRead (
     }
   }
 
+  //
+  // Submit the subtasks now rather than on the next tick of the timer.
+  //
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+  ProcessAsyncTaskList (Private->TimerEvent, Private);
+  gBS->RestoreTPL (OldTpl);
+
   DEBUG ((DEBUG_BLKIO, "%a: Lba = 0x%08Lx, Original = 0x%08Lx, "
     "Remaining = 0x%08Lx, BlockSize = 0x%x, Status = %r\n", __FUNCTION__, Lba,
     (UINT64)OrginalBlocks, (UINT64)Blocks, BlockSize, Status));
@@ -916,6 +1016,13 @@ NvmeAsyncWrite (
     }
   }
 
+  //
+  // Submit the subtasks now rather than on the next tick of the timer.
+  //
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+  ProcessAsyncTaskList (Private->TimerEvent, Private);
+  gBS->RestoreTPL (OldTpl);
+
   DEBUG ((DEBUG_BLKIO, "%a: Lba = 0x%08Lx, Original = 0x%08Lx, "
     "Remaining = 0x%08Lx, BlockSize = 0x%x, Status = %r\n", __FUNCTION__, Lba,
     (UINT64)OrginalBlocks, (UINT64)Blocks, BlockSize, Status));
@@ -2,7 +2,7 @@
   NvmExpressDxe driver is used to manage non-volatile memory subsystem which follows
   NVM Express specification.
 
-  Copyright (c) 2013 - 2019, Intel Corporation. All rights reserved.<BR>
+  Copyright (c) 2013 - 2020, Intel Corporation. All rights reserved.<BR>
   SPDX-License-Identifier: BSD-2-Clause-Patent
 
 **/
@@ -563,6 +563,72 @@ NvmeIdentifyNamespace (
   return Status;
 }
 
+/**
+  Request the I/O queues of the driver from the controller, and set the number
+  of queues the driver creates as per the I/O queues the controller allocates.
+
+  @param  Private          The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+
+**/
+VOID
+NvmeSetNumberOfQueues (
+  IN NVME_CONTROLLER_PRIVATE_DATA      *Private
+  )
+{
+  EFI_NVM_EXPRESS_PASS_THRU_COMMAND_PACKET CommandPacket;
+  EFI_NVM_EXPRESS_COMMAND                  Command;
+  EFI_NVM_EXPRESS_COMPLETION               Completion;
+  EFI_STATUS                               Status;
+  NVME_ADMIN_SET_FEATURES                  SetFeatures;
+  UINT32                                   Allocated;
+
+  ZeroMem (&CommandPacket, sizeof(EFI_NVM_EXPRESS_PASS_THRU_COMMAND_PACKET));
+  ZeroMem (&Command, sizeof(EFI_NVM_EXPRESS_COMMAND));
+  ZeroMem (&Completion, sizeof(EFI_NVM_EXPRESS_COMPLETION));
+  ZeroMem (&SetFeatures, sizeof(NVME_ADMIN_SET_FEATURES));
+
+  CommandPacket.NvmeCmd        = &Command;
+  CommandPacket.NvmeCompletion = &Completion;
+
+  Command.Cdw0.Opcode = NVME_ADMIN_SET_FEATURES_CMD;
+  CommandPacket.CommandTimeout = NVME_GENERIC_TIMEOUT;
+  CommandPacket.QueueType      = NVME_ADMIN_QUEUE;
+
+  SetFeatures.Fid = NVME_FEATURE_NUMBER_OF_QUEUES;
+  CopyMem (&CommandPacket.NvmeCmd->Cdw10, &SetFeatures, sizeof (NVME_ADMIN_SET_FEATURES));
+  //
+  // The numbers of I/O submission and completion queues requested are 0-based.
+  //
+  CommandPacket.NvmeCmd->Cdw11 = ((NVME_MAX_QUEUES - 2) << 16) | (NVME_MAX_QUEUES - 2);
+  CommandPacket.NvmeCmd->Flags = CDW10_VALID | CDW11_VALID;
+
+  Status = Private->Passthru.PassThru (
+                               &Private->Passthru,
+                               0,
+                               &CommandPacket,
+                               NULL
+                               );
+  if (EFI_ERROR (Status)) {
+    //
+    // Create one blocking and one non-blocking I/O queue pair, as before the
+    // feature was used.
+    //
+    DEBUG ((DEBUG_WARN, "NvmeSetNumberOfQueues: failed to set the number of queues (%r)\n", Status));
+    Private->QueueCount = 3;
+    return;
+  }
+
+  //
+  // The controller returns the numbers of I/O submission and completion queues
+  // allocated, which are 0-based too and may exceed the requested ones.
+  //
+  Allocated = MIN (Completion.DW0 & 0xFFFF, Completion.DW0 >> 16) + 1;
+  Private->QueueCount = (UINT16)MAX (MIN (Allocated + 1, NVME_MAX_QUEUES), 3);
+
+  DEBUG ((DEBUG_INFO, "NvmeSetNumberOfQueues: %d I/O queues allocated, %d asynchronous I/O queues used\n",
+    Allocated, Private->QueueCount - 2));
+}
+
 /**
   Create io completion queue.
 
@@ -588,7 +654,7 @@ NvmeCreateIoCompletionQueue (
   Status = EFI_SUCCESS;
   Private->CreateIoQueue = TRUE;
 
-  for (Index = 1; Index < NVME_MAX_QUEUES; Index++) {
+  for (Index = 1; Index < Private->QueueCount; Index++) {
     ZeroMem (&CommandPacket, sizeof(EFI_NVM_EXPRESS_PASS_THRU_COMMAND_PACKET));
     ZeroMem (&Command, sizeof(EFI_NVM_EXPRESS_COMMAND));
     ZeroMem (&Completion, sizeof(EFI_NVM_EXPRESS_COMPLETION));
@@ -604,7 +670,7 @@ NvmeCreateIoCompletionQueue (
     CommandPacket.QueueType      = NVME_ADMIN_QUEUE;
 
     if (Index == 1) {
-      QueueSize = NVME_CCQ_SIZE;
+      QueueSize = Private->SyncQueueSize;
     } else {
       if (Private->Cap.Mqes > NVME_ASYNC_CCQ_SIZE) {
         QueueSize = NVME_ASYNC_CCQ_SIZE;
@@ -660,7 +726,7 @@ NvmeCreateIoSubmissionQueue (
   Status = EFI_SUCCESS;
   Private->CreateIoQueue = TRUE;
 
-  for (Index = 1; Index < NVME_MAX_QUEUES; Index++) {
+  for (Index = 1; Index < Private->QueueCount; Index++) {
     ZeroMem (&CommandPacket, sizeof(EFI_NVM_EXPRESS_PASS_THRU_COMMAND_PACKET));
     ZeroMem (&Command, sizeof(EFI_NVM_EXPRESS_COMMAND));
     ZeroMem (&Completion, sizeof(EFI_NVM_EXPRESS_COMPLETION));
@@ -676,7 +742,7 @@ NvmeCreateIoSubmissionQueue (
     CommandPacket.QueueType      = NVME_ADMIN_QUEUE;
 
     if (Index == 1) {
-      QueueSize = NVME_CSQ_SIZE;
+      QueueSize = Private->SyncQueueSize;
     } else {
       if (Private->Cap.Mqes > NVME_ASYNC_CSQ_SIZE) {
         QueueSize = NVME_ASYNC_CSQ_SIZE;
@@ -731,6 +797,7 @@ NvmeControllerInit (
   NVME_ACQ                        Acq;
   UINT8                           Sn[21];
   UINT8                           Mn[41];
+  UINT32                          Index;
   //
   // Save original PCI attributes and enable this controller.
   //
@@ -799,19 +866,24 @@ NvmeControllerInit (
   //
   ASSERT ((Private->Cap.Mpsmin + 12) <= EFI_PAGE_SHIFT);
 
-  Private->Cid[0] = 0;
-  Private->Cid[1] = 0;
-  Private->Cid[2] = 0;
-  Private->Pt[0]  = 0;
-  Private->Pt[1]  = 0;
-  Private->Pt[2]  = 0;
-  Private->SqTdbl[0].Sqt = 0;
-  Private->SqTdbl[1].Sqt = 0;
-  Private->SqTdbl[2].Sqt = 0;
-  Private->CqHdbl[0].Cqh = 0;
-  Private->CqHdbl[1].Cqh = 0;
-  Private->CqHdbl[2].Cqh = 0;
-  Private->AsyncSqHead   = 0;
+  for (Index = 0; Index < NVME_MAX_QUEUES; Index++) {
+    Private->Cid[Index]           = 0;
+    Private->Pt[Index]            = 0;
+    Private->SqTdbl[Index].Sqt    = 0;
+    Private->CqHdbl[Index].Cqh    = 0;
+    Private->AsyncSqHead[Index]   = 0;
+    Private->AsyncInFlight[Index] = 0;
+  }
+
+  //
+  // The synchronous I/O submission and completion queues have the same size,
+  // so that the completion queue never overflows.
+  //
+  if (Private->Cap.Mqes > NVME_CSQ_SIZE) {
+    Private->SyncQueueSize = NVME_CSQ_SIZE;
+  } else {
+    Private->SyncQueueSize = Private->Cap.Mqes;
+  }
 
   Status = NvmeDisableController (Private);
 
@@ -840,19 +912,13 @@ NvmeControllerInit (
   //
   // Address of I/O submission & completion queue.
   //
-  ZeroMem (Private->Buffer, EFI_PAGES_TO_SIZE (6));
-  Private->SqBuffer[0]        = (NVME_SQ *)(UINTN)(Private->Buffer);
-  Private->SqBufferPciAddr[0] = (NVME_SQ *)(UINTN)(Private->BufferPciAddr);
-  Private->CqBuffer[0]        = (NVME_CQ *)(UINTN)(Private->Buffer + 1 * EFI_PAGE_SIZE);
-  Private->CqBufferPciAddr[0] = (NVME_CQ *)(UINTN)(Private->BufferPciAddr + 1 * EFI_PAGE_SIZE);
-  Private->SqBuffer[1]        = (NVME_SQ *)(UINTN)(Private->Buffer + 2 * EFI_PAGE_SIZE);
-  Private->SqBufferPciAddr[1] = (NVME_SQ *)(UINTN)(Private->BufferPciAddr + 2 * EFI_PAGE_SIZE);
-  Private->CqBuffer[1]        = (NVME_CQ *)(UINTN)(Private->Buffer + 3 * EFI_PAGE_SIZE);
-  Private->CqBufferPciAddr[1] = (NVME_CQ *)(UINTN)(Private->BufferPciAddr + 3 * EFI_PAGE_SIZE);
-  Private->SqBuffer[2]        = (NVME_SQ *)(UINTN)(Private->Buffer + 4 * EFI_PAGE_SIZE);
-  Private->SqBufferPciAddr[2] = (NVME_SQ *)(UINTN)(Private->BufferPciAddr + 4 * EFI_PAGE_SIZE);
-  Private->CqBuffer[2]        = (NVME_CQ *)(UINTN)(Private->Buffer + 5 * EFI_PAGE_SIZE);
-  Private->CqBufferPciAddr[2] = (NVME_CQ *)(UINTN)(Private->BufferPciAddr + 5 * EFI_PAGE_SIZE);
+  ZeroMem (Private->Buffer, EFI_PAGES_TO_SIZE (NVME_QUEUE_BUFFER_PAGES));
+  for (Index = 0; Index < NVME_MAX_QUEUES; Index++) {
+    Private->SqBuffer[Index]        = (NVME_SQ *)(UINTN)(Private->Buffer + (2 * Index) * EFI_PAGE_SIZE);
+    Private->SqBufferPciAddr[Index] = (NVME_SQ *)(UINTN)(Private->BufferPciAddr + (2 * Index) * EFI_PAGE_SIZE);
+    Private->CqBuffer[Index]        = (NVME_CQ *)(UINTN)(Private->Buffer + (2 * Index + 1) * EFI_PAGE_SIZE);
+    Private->CqBufferPciAddr[Index] = (NVME_CQ *)(UINTN)(Private->BufferPciAddr + (2 * Index + 1) * EFI_PAGE_SIZE);
+  }
 
   DEBUG ((EFI_D_INFO, "Private->Buffer = [%016X]\n", (UINT64)(UINTN)Private->Buffer));
   DEBUG ((EFI_D_INFO, "Admin     Submission Queue size (Aqa.Asqs) = [%08X]\n", Aqa.Asqs));
@@ -861,8 +927,10 @@ NvmeControllerInit (
   DEBUG ((EFI_D_INFO, "Admin     Completion Queue (CqBuffer[0]) = [%016X]\n", Private->CqBuffer[0]));
   DEBUG ((EFI_D_INFO, "Sync  I/O Submission Queue (SqBuffer[1]) = [%016X]\n", Private->SqBuffer[1]));
   DEBUG ((EFI_D_INFO, "Sync  I/O Completion Queue (CqBuffer[1]) = [%016X]\n", Private->CqBuffer[1]));
-  DEBUG ((EFI_D_INFO, "Async I/O Submission Queue (SqBuffer[2]) = [%016X]\n", Private->SqBuffer[2]));
-  DEBUG ((EFI_D_INFO, "Async I/O Completion Queue (CqBuffer[2]) = [%016X]\n", Private->CqBuffer[2]));
+  for (Index = 2; Index < NVME_MAX_QUEUES; Index++) {
+    DEBUG ((EFI_D_INFO, "Async I/O Submission Queue (SqBuffer[%d]) = [%016X]\n", Index, Private->SqBuffer[Index]));
+    DEBUG ((EFI_D_INFO, "Async I/O Completion Queue (CqBuffer[%d]) = [%016X]\n", Index, Private->CqBuffer[Index]));
+  }
 
   //
   // Program admin queue attributes.
@@ -939,17 +1007,18 @@ NvmeControllerInit (
   DEBUG ((EFI_D_INFO, "    NN        : 0x%x\n", Private->ControllerData->Nn));
 
   //
-  // Create two I/O completion queues.
-  // One for blocking I/O, one for non-blocking I/O.
+  // Create the I/O completion queues.
+  // One for blocking I/O, the others for non-blocking I/O.
   //
+  NvmeSetNumberOfQueues (Private);
   Status = NvmeCreateIoCompletionQueue (Private);
   if (EFI_ERROR(Status)) {
    return Status;
   }
 
   //
-  // Create two I/O Submission queues.
-  // One for blocking I/O, one for non-blocking I/O.
+  // Create the I/O Submission queues.
+  // One for blocking I/O, the others for non-blocking I/O.
   //
   Status = NvmeCreateIoSubmissionQueue (Private);
 
@@ -3,7 +3,7 @@
   NVM Express specification.
 
   (C) Copyright 2014 Hewlett-Packard Development Company, L.P.<BR>
-  Copyright (c) 2013 - 2018, Intel Corporation. All rights reserved.<BR>
+  Copyright (c) 2013 - 2020, Intel Corporation. All rights reserved.<BR>
   SPDX-License-Identifier: BSD-2-Clause-Patent
 
 **/
@@ -405,165 +405,75 @@ AbortAsyncPassThruTasks (
 
 
 /**
-  Sends an NVM Express Command Packet to an NVM Express controller or namespace. This function supports
-  both blocking I/O and non-blocking I/O. The blocking I/O functionality is required, and the non-blocking
-  I/O functionality is optional.
-
-
-  @param[in]     This                A pointer to the EFI_NVM_EXPRESS_PASS_THRU_PROTOCOL instance.
-  @param[in]     NamespaceId         A 32 bit namespace ID as defined in the NVMe specification to which the NVM Express Command
-                                     Packet will be sent.  A value of 0 denotes the NVM Express controller, a value of all 0xFF's
-                                     (all bytes are 0xFF) in the namespace ID specifies that the command packet should be sent to
-                                     all valid namespaces.
-  @param[in,out] Packet              A pointer to the NVM Express Command Packet.
-  @param[in]     Event               If non-blocking I/O is not supported then Event is ignored, and blocking I/O is performed.
-                                     If Event is NULL, then blocking I/O is performed. If Event is not NULL and non-blocking I/O
-                                     is supported, then non-blocking I/O is performed, and Event will be signaled when the NVM
-                                     Express Command Packet completes.
+  Releases the buffers mapped for an NVMe command.
 
-  @retval EFI_SUCCESS                The NVM Express Command Packet was sent by the host. TransferLength bytes were transferred
-                                     to, or from DataBuffer.
-  @retval EFI_BAD_BUFFER_SIZE        The NVM Express Command Packet was not executed. The number of bytes that could be transferred
-                                     is returned in TransferLength.
-  @retval EFI_NOT_READY              The NVM Express Command Packet could not be sent because the controller is not ready. The caller
-                                     may retry again later.
-  @retval EFI_DEVICE_ERROR           A device error occurred while attempting to send the NVM Express Command Packet.
-  @retval EFI_INVALID_PARAMETER      NamespaceId or the contents of EFI_NVM_EXPRESS_PASS_THRU_COMMAND_PACKET are invalid. The NVM
-                                     Express Command Packet was not sent, so no additional status information is available.
-  @retval EFI_UNSUPPORTED            The command described by the NVM Express Command Packet is not supported by the NVM Express
-                                     controller. The NVM Express Command Packet was not sent so no additional status information
-                                     is available.
-  @retval EFI_TIMEOUT                A timeout occurred while waiting for the NVM Express Command Packet to execute.
+  @param[in]     PciIo          A pointer to the EFI_PCI_IO_PROTOCOL instance.
+  @param[in,out] Mapping        The buffers mapped for the command.
 
 **/
-EFI_STATUS
-EFIAPI
-NvmExpressPassThru (
-  IN     EFI_NVM_EXPRESS_PASS_THRU_PROTOCOL          *This,
-  IN     UINT32                                      NamespaceId,
-  IN OUT EFI_NVM_EXPRESS_PASS_THRU_COMMAND_PACKET    *Packet,
-  IN     EFI_EVENT                                   Event OPTIONAL
+VOID
+NvmeReleaseMapping (
+  IN     EFI_PCI_IO_PROTOCOL       *PciIo,
+  IN OUT NVME_PASS_THRU_MAPPING    *Mapping
   )
 {
-  NVME_CONTROLLER_PRIVATE_DATA   *Private;
-  EFI_STATUS                     Status;
-  EFI_STATUS                     PreviousStatus;
-  EFI_PCI_IO_PROTOCOL            *PciIo;
-  NVME_SQ                        *Sq;
-  NVME_CQ                        *Cq;
-  UINT16                         QueueId;
-  UINT32                         Bytes;
-  UINT16                         Offset;
-  EFI_EVENT                      TimerEvent;
-  EFI_PCI_IO_PROTOCOL_OPERATION  Flag;
-  EFI_PHYSICAL_ADDRESS           PhyAddr;
-  VOID                           *MapData;
-  VOID                           *MapMeta;
-  VOID                           *MapPrpList;
-  UINTN                          MapLength;
-  UINT64                         *Prp;
-  VOID                           *PrpListHost;
-  UINTN                          PrpListNo;
-  UINT32                         Attributes;
-  UINT32                         IoAlign;
-  UINT32                         MaxTransLen;
-  UINT32                         Data;
-  NVME_PASS_THRU_ASYNC_REQ       *AsyncRequest;
-  EFI_TPL                        OldTpl;
-
-  //
-  // check the data fields in Packet parameter.
-  //
-  if ((This == NULL) || (Packet == NULL)) {
-    return EFI_INVALID_PARAMETER;
-  }
-
-  if ((Packet->NvmeCmd == NULL) || (Packet->NvmeCompletion == NULL)) {
-    return EFI_INVALID_PARAMETER;
-  }
-
-  if (Packet->QueueType != NVME_ADMIN_QUEUE && Packet->QueueType != NVME_IO_QUEUE) {
-    return EFI_INVALID_PARAMETER;
-  }
-
-  //
-  // 'Attributes' with neither EFI_NVM_EXPRESS_PASS_THRU_ATTRIBUTES_LOGICAL nor
-  // EFI_NVM_EXPRESS_PASS_THRU_ATTRIBUTES_PHYSICAL set is an illegal
-  // configuration.
-  //
-  Attributes  = This->Mode->Attributes;
-  if ((Attributes & (EFI_NVM_EXPRESS_PASS_THRU_ATTRIBUTES_PHYSICAL |
-    EFI_NVM_EXPRESS_PASS_THRU_ATTRIBUTES_LOGICAL)) == 0) {
-    return EFI_INVALID_PARAMETER;
-  }
-
-  //
-  // Buffer alignment check for TransferBuffer & MetadataBuffer.
-  //
-  IoAlign     = This->Mode->IoAlign;
-  if (IoAlign > 0 && (((UINTN) Packet->TransferBuffer & (IoAlign - 1)) != 0)) {
-    return EFI_INVALID_PARAMETER;
+  if (Mapping->MapData != NULL) {
+    PciIo->Unmap (PciIo, Mapping->MapData);
   }
 
-  if (IoAlign > 0 && (((UINTN) Packet->MetadataBuffer & (IoAlign - 1)) != 0)) {
-    return EFI_INVALID_PARAMETER;
+  if (Mapping->MapMeta != NULL) {
+    PciIo->Unmap (PciIo, Mapping->MapMeta);
   }
 
-  Private     = NVME_CONTROLLER_PRIVATE_DATA_FROM_PASS_THRU (This);
-
-  //
-  // Check NamespaceId is valid or not.
-  //
-  if ((NamespaceId > Private->ControllerData->Nn) &&
-      (NamespaceId != (UINT32) -1)) {
-    return EFI_INVALID_PARAMETER;
+  if (Mapping->MapPrpList != NULL) {
+    PciIo->Unmap (PciIo, Mapping->MapPrpList);
   }
 
-  //
-  // Check whether TransferLength exceeds the maximum data transfer size.
-  //
-  if (Private->ControllerData->Mdts != 0) {
-    MaxTransLen = (1 << (Private->ControllerData->Mdts)) *
-                  (1 << (Private->Cap.Mpsmin + 12));
-    if (Packet->TransferLength > MaxTransLen) {
-      Packet->TransferLength = MaxTransLen;
-      return EFI_BAD_BUFFER_SIZE;
-    }
+  if (Mapping->PrpListHost != NULL) {
+    PciIo->FreeBuffer (PciIo, Mapping->PrpListNo, Mapping->PrpListHost);
   }
 
-  PciIo       = Private->PciIo;
-  MapData     = NULL;
-  MapMeta     = NULL;
-  MapPrpList  = NULL;
-  PrpListHost = NULL;
-  PrpListNo   = 0;
-  Prp         = NULL;
-  TimerEvent  = NULL;
-  Status      = EFI_SUCCESS;
+  ZeroMem (Mapping, sizeof (NVME_PASS_THRU_MAPPING));
+}
 
-  if (Packet->QueueType == NVME_ADMIN_QUEUE) {
-    QueueId = 0;
-  } else {
-    if (Event == NULL) {
-      QueueId = 1;
-    } else {
-      QueueId = 2;
+/**
+  Builds the submission queue entry of an NVM Express Command Packet. The data
+  and metadata buffers are mapped to the PCI controller specific addresses, and
+  a PRP list is created if the transfer spans more than two memory pages.
+
+  @param[in]     Private        The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+  @param[in]     QueueId        The queue the command is submitted to.
+  @param[in]     Packet         A pointer to the NVM Express Command Packet.
+  @param[out]    Sq             The submission queue entry to build.
+  @param[out]    Mapping        The buffers mapped for the command, to be
+                                released when the command completes.
+
+  @retval EFI_SUCCESS           The submission queue entry is built.
+  @retval EFI_INVALID_PARAMETER The contents of the command packet are invalid.
+  @retval EFI_UNSUPPORTED       The command is not supported.
+  @retval EFI_OUT_OF_RESOURCES  The buffers of the command could not be mapped.
 
-      //
-      // Submission queue full check.
-      //
-      if ((Private->SqTdbl[QueueId].Sqt + 1) % (NVME_ASYNC_CSQ_SIZE + 1) ==
-          Private->AsyncSqHead) {
-        return EFI_NOT_READY;
-      }
-    }
-  }
-  Sq  = Private->SqBuffer[QueueId] + Private->SqTdbl[QueueId].Sqt;
-  Cq  = Private->CqBuffer[QueueId] + Private->CqHdbl[QueueId].Cqh;
+**/
+EFI_STATUS
+NvmeBuildSubmissionEntry (
+  IN     NVME_CONTROLLER_PRIVATE_DATA              *Private,
+  IN     UINT16                                    QueueId,
+  IN     EFI_NVM_EXPRESS_PASS_THRU_COMMAND_PACKET  *Packet,
+     OUT NVME_SQ                                   *Sq,
+     OUT NVME_PASS_THRU_MAPPING                    *Mapping
+  )
+{
+  EFI_STATUS                     Status;
+  EFI_PCI_IO_PROTOCOL            *PciIo;
+  EFI_PCI_IO_PROTOCOL_OPERATION  Flag;
+  EFI_PHYSICAL_ADDRESS           PhyAddr;
+  UINTN                          MapLength;
+  UINT64                         *Prp;
+  UINT32                         Bytes;
+  UINT16                         Offset;
 
-  if (Packet->NvmeCmd->Nsid != NamespaceId) {
-    return EFI_INVALID_PARAMETER;
-  }
+  PciIo = Private->PciIo;
+  ZeroMem (Mapping, sizeof (NVME_PASS_THRU_MAPPING));
 
   ZeroMem (Sq, sizeof (NVME_SQ));
   Sq->Opc  = (UINT8)Packet->NvmeCmd->Cdw0.Opcode;
@@ -617,7 +527,7 @@ NvmExpressPassThru (
                         Packet->TransferBuffer,
                         &MapLength,
                         &PhyAddr,
-                        &MapData
+                        &Mapping->MapData
                         );
       if (EFI_ERROR (Status) || (Packet->TransferLength != MapLength)) {
         return EFI_OUT_OF_RESOURCES;
@@ -635,14 +545,10 @@ NvmExpressPassThru (
                         Packet->MetadataBuffer,
                         &MapLength,
                         &PhyAddr,
-                        &MapMeta
+                        &Mapping->MapMeta
                         );
       if (EFI_ERROR (Status) || (Packet->MetadataLength != MapLength)) {
-        PciIo->Unmap (
-                 PciIo,
-                 MapData
-                 );
-
+        NvmeReleaseMapping (PciIo, Mapping);
         return EFI_OUT_OF_RESOURCES;
       }
       Sq->Mptr = PhyAddr;
@@ -660,10 +566,14 @@ NvmExpressPassThru (
     // Create PrpList for remaining data buffer.
     //
     PhyAddr = (Sq->Prp[0] + EFI_PAGE_SIZE) & ~(EFI_PAGE_SIZE - 1);
-    Prp = NvmeCreatePrpList (PciIo, PhyAddr, EFI_SIZE_TO_PAGES(Offset + Bytes) - 1, &PrpListHost, &PrpListNo, &MapPrpList);
+    Prp = NvmeCreatePrpList (PciIo, PhyAddr, EFI_SIZE_TO_PAGES(Offset + Bytes) - 1, &Mapping->PrpListHost, &Mapping->PrpListNo, &Mapping->MapPrpList);
     if (Prp == NULL) {
-      Status = EFI_OUT_OF_RESOURCES;
-      goto EXIT;
+      //
+      // The PRP list buffer has been freed if it was allocated.
+      //
+      Mapping->PrpListHost = NULL;
+      NvmeReleaseMapping (PciIo, Mapping);
+      return EFI_OUT_OF_RESOURCES;
     }
 
     Sq->Prp[1] = (UINT64)(UINTN)Prp;
@@ -696,15 +606,238 @@ NvmExpressPassThru (
     Sq->Payload.Raw.Cdw15 = Packet->NvmeCmd->Cdw15;
   }
 
+  return EFI_SUCCESS;
+}
+
+/**
+  Resets the NVMe controller to abort the outstanding commands after a timeout
+  occurs for an NVMe command, and aborts the asynchronous PassThru requests.
+
+  @param[in] Private        The pointer to the NVME_CONTROLLER_PRIVATE_DATA
+                            data structure.
+
+  @retval EFI_TIMEOUT       The controller has been reset.
+  @retval EFI_DEVICE_ERROR  The controller could not be reset.
+  @return Others            The asynchronous PassThru requests could not be
+                            aborted.
+
+**/
+EFI_STATUS
+NvmeResetOnTimeout (
+  IN NVME_CONTROLLER_PRIVATE_DATA    *Private
+  )
+{
+  EFI_STATUS                         Status;
+
   //
-  // Ring the submission queue doorbell.
+  // Disable the timer to trigger the process of async transfers temporarily.
   //
-  if ((Event != NULL) && (QueueId != 0)) {
-    Private->SqTdbl[QueueId].Sqt =
-      (Private->SqTdbl[QueueId].Sqt + 1) % (NVME_ASYNC_CSQ_SIZE + 1);
+  Status = gBS->SetTimer (Private->TimerEvent, TimerCancel, 0);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+  Private->TimerPolling = FALSE;
+
+  //
+  // Reset the NVMe controller.
+  //
+  Status = NvmeControllerInit (Private);
+  if (!EFI_ERROR (Status)) {
+    Status = AbortAsyncPassThruTasks (Private);
+    if (!EFI_ERROR (Status)) {
+      //
+      // Re-enable the timer to trigger the process of async transfers.
+      //
+      Status = gBS->SetTimer (Private->TimerEvent, TimerPeriodic, NVME_HC_ASYNC_TIMER);
+      if (!EFI_ERROR (Status)) {
+        Private->TimerPolling = TRUE;
+        //
+        // Return EFI_TIMEOUT to indicate a timeout occurs for NVMe PassThru command.
+        //
+        Status = EFI_TIMEOUT;
+      }
+    }
+  } else {
+    Status = EFI_DEVICE_ERROR;
+  }
+
+  return Status;
+}
+
+/**
+  Sends an NVM Express Command Packet to an NVM Express controller or namespace. This function supports
+  both blocking I/O and non-blocking I/O. The blocking I/O functionality is required, and the non-blocking
+  I/O functionality is optional.
+
+
+  @param[in]     This                A pointer to the EFI_NVM_EXPRESS_PASS_THRU_PROTOCOL instance.
+  @param[in]     NamespaceId         A 32 bit namespace ID as defined in the NVMe specification to which the NVM Express Command
+                                     Packet will be sent.  A value of 0 denotes the NVM Express controller, a value of all 0xFF's
+                                     (all bytes are 0xFF) in the namespace ID specifies that the command packet should be sent to
+                                     all valid namespaces.
+  @param[in,out] Packet              A pointer to the NVM Express Command Packet.
+  @param[in]     Event               If non-blocking I/O is not supported then Event is ignored, and blocking I/O is performed.
+                                     If Event is NULL, then blocking I/O is performed. If Event is not NULL and non-blocking I/O
+                                     is supported, then non-blocking I/O is performed, and Event will be signaled when the NVM
+                                     Express Command Packet completes.
+
+  @retval EFI_SUCCESS                The NVM Express Command Packet was sent by the host. TransferLength bytes were transferred
+                                     to, or from DataBuffer.
+  @retval EFI_BAD_BUFFER_SIZE        The NVM Express Command Packet was not executed. The number of bytes that could be transferred
+                                     is returned in TransferLength.
+  @retval EFI_NOT_READY              The NVM Express Command Packet could not be sent because the controller is not ready. The caller
+                                     may retry again later.
+  @retval EFI_DEVICE_ERROR           A device error occurred while attempting to send the NVM Express Command Packet.
+  @retval EFI_INVALID_PARAMETER      NamespaceId or the contents of EFI_NVM_EXPRESS_PASS_THRU_COMMAND_PACKET are invalid. The NVM
+                                     Express Command Packet was not sent, so no additional status information is available.
+  @retval EFI_UNSUPPORTED            The command described by the NVM Express Command Packet is not supported by the NVM Express
+                                     controller. The NVM Express Command Packet was not sent so no additional status information
+                                     is available.
+  @retval EFI_TIMEOUT                A timeout occurred while waiting for the NVM Express Command Packet to execute.
+
+**/
+EFI_STATUS
+EFIAPI
+NvmExpressPassThru (
+  IN     EFI_NVM_EXPRESS_PASS_THRU_PROTOCOL          *This,
+  IN     UINT32                                      NamespaceId,
+  IN OUT EFI_NVM_EXPRESS_PASS_THRU_COMMAND_PACKET    *Packet,
+  IN     EFI_EVENT                                   Event OPTIONAL
+  )
+{
+  NVME_CONTROLLER_PRIVATE_DATA   *Private;
+  EFI_STATUS                     Status;
+  EFI_STATUS                     PreviousStatus;
+  EFI_PCI_IO_PROTOCOL            *PciIo;
+  NVME_SQ                        *Sq;
+  NVME_CQ                        *Cq;
+  UINT16                         QueueId;
+  UINT16                         QueueSize;
+  UINT16                         Index;
+  EFI_EVENT                      TimerEvent;
+  NVME_PASS_THRU_MAPPING         Mapping;
+  UINT32                         Attributes;
+  UINT32                         IoAlign;
+  UINT32                         MaxTransLen;
+  UINT32                         Data;
+  NVME_PASS_THRU_ASYNC_REQ       *AsyncRequest;
+  EFI_TPL                        OldTpl;
+
+  //
+  // check the data fields in Packet parameter.
+  //
+  if ((This == NULL) || (Packet == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if ((Packet->NvmeCmd == NULL) || (Packet->NvmeCompletion == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (Packet->QueueType != NVME_ADMIN_QUEUE && Packet->QueueType != NVME_IO_QUEUE) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  //
+  // 'Attributes' with neither EFI_NVM_EXPRESS_PASS_THRU_ATTRIBUTES_LOGICAL nor
+  // EFI_NVM_EXPRESS_PASS_THRU_ATTRIBUTES_PHYSICAL set is an illegal
+  // configuration.
+  //
+  Attributes  = This->Mode->Attributes;
+  if ((Attributes & (EFI_NVM_EXPRESS_PASS_THRU_ATTRIBUTES_PHYSICAL |
+    EFI_NVM_EXPRESS_PASS_THRU_ATTRIBUTES_LOGICAL)) == 0) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  //
+  // Buffer alignment check for TransferBuffer & MetadataBuffer.
+  //
+  IoAlign     = This->Mode->IoAlign;
+  if (IoAlign > 0 && (((UINTN) Packet->TransferBuffer & (IoAlign - 1)) != 0)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (IoAlign > 0 && (((UINTN) Packet->MetadataBuffer & (IoAlign - 1)) != 0)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Private     = NVME_CONTROLLER_PRIVATE_DATA_FROM_PASS_THRU (This);
+
+  //
+  // Check NamespaceId is valid or not.
+  //
+  if ((NamespaceId > Private->ControllerData->Nn) &&
+      (NamespaceId != (UINT32) -1)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  //
+  // Check whether TransferLength exceeds the maximum data transfer size.
+  //
+  if (Private->ControllerData->Mdts != 0) {
+    MaxTransLen = (1 << (Private->ControllerData->Mdts)) *
+                  (1 << (Private->Cap.Mpsmin + 12));
+    if (Packet->TransferLength > MaxTransLen) {
+      Packet->TransferLength = MaxTransLen;
+      return EFI_BAD_BUFFER_SIZE;
+    }
+  }
+
+  PciIo       = Private->PciIo;
+  TimerEvent  = NULL;
+  Status      = EFI_SUCCESS;
+
+  //
+  // The admin and synchronous I/O completion queues have the same size as
+  // their submission queues.
+  //
+  if (Packet->QueueType == NVME_ADMIN_QUEUE) {
+    QueueId   = 0;
+    QueueSize = NVME_ASQ_SIZE;
   } else {
-    Private->SqTdbl[QueueId].Sqt ^= 1;
+    if (Event == NULL) {
+      QueueId   = 1;
+      QueueSize = Private->SyncQueueSize;
+    } else {
+      QueueSize = NVME_ASYNC_CSQ_SIZE;
+
+      //
+      // Use the asynchronous I/O queue with the fewest commands in flight
+      // whose submission queue is not full.
+      //
+      QueueId = 0;
+      for (Index = 2; Index < Private->QueueCount; Index++) {
+        if ((Private->SqTdbl[Index].Sqt + 1) % (NVME_ASYNC_CSQ_SIZE + 1) ==
+            Private->AsyncSqHead[Index]) {
+          continue;
+        }
+        if ((QueueId == 0) ||
+            (Private->AsyncInFlight[Index] < Private->AsyncInFlight[QueueId])) {
+          QueueId = Index;
+        }
+      }
+
+      if (QueueId == 0) {
+        return EFI_NOT_READY;
+      }
+    }
+  }
+  Sq  = Private->SqBuffer[QueueId] + Private->SqTdbl[QueueId].Sqt;
+  Cq  = Private->CqBuffer[QueueId] + Private->CqHdbl[QueueId].Cqh;
+
+  if (Packet->NvmeCmd->Nsid != NamespaceId) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Status = NvmeBuildSubmissionEntry (Private, QueueId, Packet, Sq, &Mapping);
+  if (EFI_ERROR (Status)) {
+    return Status;
   }
+
+  //
+  // Ring the submission queue doorbell.
+  //
+  Private->SqTdbl[QueueId].Sqt = (Private->SqTdbl[QueueId].Sqt + 1) % (QueueSize + 1);
   Data = ReadUnaligned32 ((UINT32*)&Private->SqTdbl[QueueId]);
   Status = PciIo->Mem.Write (
                PciIo,
@@ -732,16 +865,19 @@ NvmExpressPassThru (
 
     AsyncRequest->Signature     = NVME_PASS_THRU_ASYNC_REQ_SIG;
     AsyncRequest->Packet        = Packet;
+    AsyncRequest->QueueId       = QueueId;
     AsyncRequest->CommandId     = Sq->Cid;
     AsyncRequest->CallerEvent   = Event;
-    AsyncRequest->MapData       = MapData;
-    AsyncRequest->MapMeta       = MapMeta;
-    AsyncRequest->MapPrpList    = MapPrpList;
-    AsyncRequest->PrpListNo     = PrpListNo;
-    AsyncRequest->PrpListHost   = PrpListHost;
+    AsyncRequest->MapData       = Mapping.MapData;
+    AsyncRequest->MapMeta       = Mapping.MapMeta;
+    AsyncRequest->MapPrpList    = Mapping.MapPrpList;
+    AsyncRequest->PrpListNo     = Mapping.PrpListNo;
+    AsyncRequest->PrpListHost   = Mapping.PrpListHost;
 
     OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
     InsertTailList (&Private->AsyncPassThruQueue, &AsyncRequest->Link);
+    Private->AsyncInFlight[QueueId]++;
+    NvmeUpdateAsyncTimer (Private);
     gBS->RestoreTPL (OldTpl);
 
     return EFI_SUCCESS;
@@ -801,40 +937,12 @@ NvmExpressPassThru (
     //
     DEBUG ((DEBUG_ERROR, "NvmExpressPassThru: Timeout occurs for an NVMe command.\n"));
 
-    //
-    // Disable the timer to trigger the process of async transfers temporarily.
-    //
-    Status = gBS->SetTimer (Private->TimerEvent, TimerCancel, 0);
-    if (EFI_ERROR (Status)) {
-      goto EXIT;
-    }
-
-    //
-    // Reset the NVMe controller.
-    //
-    Status = NvmeControllerInit (Private);
-    if (!EFI_ERROR (Status)) {
-      Status = AbortAsyncPassThruTasks (Private);
-      if (!EFI_ERROR (Status)) {
-        //
-        // Re-enable the timer to trigger the process of async transfers.
-        //
-        Status = gBS->SetTimer (Private->TimerEvent, TimerPeriodic, NVME_HC_ASYNC_TIMER);
-        if (!EFI_ERROR (Status)) {
-          //
-          // Return EFI_TIMEOUT to indicate a timeout occurs for NVMe PassThru command.
-          //
-          Status = EFI_TIMEOUT;
-        }
-      }
-    } else {
-      Status = EFI_DEVICE_ERROR;
-    }
-
+    Status = NvmeResetOnTimeout (Private);
     goto EXIT;
   }
 
-  if ((Private->CqHdbl[QueueId].Cqh ^= 1) == 0) {
+  Private->CqHdbl[QueueId].Cqh = (Private->CqHdbl[QueueId].Cqh + 1) % (QueueSize + 1);
+  if (Private->CqHdbl[QueueId].Cqh == 0) {
     Private->Pt[QueueId] ^= 1;
   }
 
@@ -862,34 +970,222 @@ NvmExpressPassThru (
   }
 
 EXIT:
-  if (MapData != NULL) {
-    PciIo->Unmap (
-             PciIo,
-             MapData
-             );
+  NvmeReleaseMapping (PciIo, &Mapping);
+
+  if (TimerEvent != NULL) {
+    gBS->CloseEvent (TimerEvent);
   }
+  return Status;
+}
 
-  if (MapMeta != NULL) {
-    PciIo->Unmap (
-             PciIo,
-             MapMeta
-             );
+/**
+  Sends a series of NVM Express I/O Command Packets to a namespace through the
+  synchronous I/O queue, and waits for all of them to complete.
+
+  As many commands as the queue holds are placed in the submission queue before
+  its doorbell is rung once, and the completions that have been posted are
+  reaped together before the completion queue head doorbell is written once.
+  The queue is refilled as commands complete.
+
+  @param[in]     Private             The pointer to the NVME_CONTROLLER_PRIVATE_DATA data structure.
+  @param[in]     NamespaceId         The namespace ID the command packets are sent to.
+  @param[in,out] Packets             The NVM Express I/O Command Packets to send.
+  @param[in]     PacketCount         The number of command packets in Packets.
+
+  @retval EFI_SUCCESS                All the command packets completed successfully.
+  @retval EFI_DEVICE_ERROR           A command packet completed with an error, or
+                                     the queue doorbells could not be written.
+                                     The command packets not yet submitted are not sent.
+  @retval EFI_OUT_OF_RESOURCES       The buffers of a command packet could not be mapped.
+  @retval EFI_TIMEOUT                A timeout occurred while waiting for completions.
+                                     The controller was reset.
+
+**/
+EFI_STATUS
+NvmePipelinedPassThru (
+  IN     NVME_CONTROLLER_PRIVATE_DATA                *Private,
+  IN     UINT32                                      NamespaceId,
+  IN OUT EFI_NVM_EXPRESS_PASS_THRU_COMMAND_PACKET    **Packets,
+  IN     UINTN                                       PacketCount
+  )
+{
+  EFI_STATUS                     Status;
+  EFI_STATUS                     WriteStatus;
+  EFI_PCI_IO_PROTOCOL            *PciIo;
+  NVME_PIPELINED_COMMAND         *Commands;
+  NVME_SQ                        *Sq;
+  NVME_CQ                        *Cq;
+  UINT16                         QueueSize;
+  UINTN                          Submitted;
+  UINTN                          Queued;
+  UINTN                          InFlight;
+  UINTN                          Index;
+  UINT64                         Timeout;
+  EFI_EVENT                      TimerEvent;
+  UINT32                         Data;
+
+  PciIo      = Private->PciIo;
+  QueueSize  = Private->SyncQueueSize;
+  TimerEvent = NULL;
+
+  //
+  // One submission queue entry is always left empty, so at most QueueSize
+  // commands are in flight.
+  //
+  Commands = AllocateZeroPool (QueueSize * sizeof (NVME_PIPELINED_COMMAND));
+  if (Commands == NULL) {
+    return EFI_OUT_OF_RESOURCES;
   }
 
-  if (MapPrpList != NULL) {
-    PciIo->Unmap (
-             PciIo,
-             MapPrpList
-             );
+  Timeout = 0;
+  for (Index = 0; Index < PacketCount; Index++) {
+    ASSERT (Packets[Index]->QueueType == NVME_IO_QUEUE);
+    ASSERT (Packets[Index]->NvmeCmd->Nsid == NamespaceId);
+    Timeout = MAX (Timeout, Packets[Index]->CommandTimeout);
+  }
+
+  Status = gBS->CreateEvent (
+                  EVT_TIMER,
+                  TPL_CALLBACK,
+                  NULL,
+                  NULL,
+                  &TimerEvent
+                  );
+  if (EFI_ERROR (Status)) {
+    goto EXIT;
+  }
+
+  Submitted = 0;
+  InFlight  = 0;
+  while (TRUE) {
+    //
+    // Fill the free submission queue entries, then ring the doorbell once for
+    // all of them. No more commands are submitted once one fails.
+    //
+    Queued = 0;
+    while (!EFI_ERROR (Status) && (Submitted < PacketCount) && (InFlight < QueueSize)) {
+      for (Index = 0; Index < QueueSize; Index++) {
+        if (Commands[Index].Packet == NULL) {
+          break;
+        }
+      }
+      ASSERT (Index < QueueSize);
+
+      Sq     = Private->SqBuffer[1] + Private->SqTdbl[1].Sqt;
+      Status = NvmeBuildSubmissionEntry (Private, 1, Packets[Submitted], Sq, &Commands[Index].Mapping);
+      if (EFI_ERROR (Status)) {
+        break;
+      }
+      Commands[Index].Packet    = Packets[Submitted];
+      Commands[Index].CommandId = Sq->Cid;
+
+      Private->SqTdbl[1].Sqt = (Private->SqTdbl[1].Sqt + 1) % (QueueSize + 1);
+      Submitted++;
+      InFlight++;
+      Queued++;
+    }
+
+    if (Queued != 0) {
+      Data = ReadUnaligned32 ((UINT32*)&Private->SqTdbl[1]);
+      WriteStatus = PciIo->Mem.Write (
+                               PciIo,
+                               EfiPciIoWidthUint32,
+                               NVME_BAR,
+                               NVME_SQTDBL_OFFSET(1, Private->Cap.Dstrd),
+                               1,
+                               &Data
+                               );
+      if (EFI_ERROR (WriteStatus) && !EFI_ERROR (Status)) {
+        Status = EFI_DEVICE_ERROR;
+      }
+    }
+
+    if (InFlight == 0) {
+      break;
+    }
+
+    //
+    // Wait for the next completion queue entry to get filled in.
+    //
+    Cq = Private->CqBuffer[1] + Private->CqHdbl[1].Cqh;
+    gBS->SetTimer (TimerEvent, TimerRelative, Timeout);
+    while ((Cq->Pt == Private->Pt[1]) && EFI_ERROR (gBS->CheckEvent (TimerEvent))) {
+    }
+
+    if (Cq->Pt == Private->Pt[1]) {
+      DEBUG ((DEBUG_ERROR, "NvmePipelinedPassThru: Timeout occurs for an NVMe command.\n"));
+
+      Status = NvmeResetOnTimeout (Private);
+      goto EXIT;
+    }
+
+    //
+    // Reap all the completion queue entries that have been filled in, then
+    // write the completion queue head doorbell once for all of them.
+    //
+    while (Cq->Pt != Private->Pt[1]) {
+      for (Index = 0; Index < QueueSize; Index++) {
+        if ((Commands[Index].Packet != NULL) && (Commands[Index].CommandId == Cq->Cid)) {
+          break;
+        }
+      }
+
+      ASSERT (Index < QueueSize);
+      if (Index < QueueSize) {
+        if ((Cq->Sct != 0) || (Cq->Sc != 0)) {
+          if (!EFI_ERROR (Status)) {
+            Status = EFI_DEVICE_ERROR;
+          }
+          //
+          // Dump every completion entry status for debugging.
+          //
+          DEBUG_CODE_BEGIN();
+            NvmeDumpStatus(Cq);
+          DEBUG_CODE_END();
+        }
+        CopyMem (Commands[Index].Packet->NvmeCompletion, Cq, sizeof (EFI_NVM_EXPRESS_COMPLETION));
+
+        NvmeReleaseMapping (PciIo, &Commands[Index].Mapping);
+        Commands[Index].Packet = NULL;
+        InFlight--;
+      }
+
+      Private->CqHdbl[1].Cqh = (Private->CqHdbl[1].Cqh + 1) % (QueueSize + 1);
+      if (Private->CqHdbl[1].Cqh == 0) {
+        Private->Pt[1] ^= 1;
+      }
+      Cq = Private->CqBuffer[1] + Private->CqHdbl[1].Cqh;
+    }
+
+    Data = ReadUnaligned32 ((UINT32*)&Private->CqHdbl[1]);
+    WriteStatus = PciIo->Mem.Write (
+                             PciIo,
+                             EfiPciIoWidthUint32,
+                             NVME_BAR,
+                             NVME_CQHDBL_OFFSET(1, Private->Cap.Dstrd),
+                             1,
+                             &Data
+                             );
+    if (EFI_ERROR (WriteStatus) && !EFI_ERROR (Status)) {
+      Status = EFI_DEVICE_ERROR;
+    }
   }
 
-  if (Prp != NULL) {
-    PciIo->FreeBuffer (PciIo, PrpListNo, PrpListHost);
+EXIT:
+  //
+  // Release the buffers of the commands that were aborted by a controller reset.
+  //
+  for (Index = 0; Index < QueueSize; Index++) {
+    if (Commands[Index].Packet != NULL) {
+      NvmeReleaseMapping (PciIo, &Commands[Index].Mapping);
+    }
   }
 
   if (TimerEvent != NULL) {
     gBS->CloseEvent (TimerEvent);
   }
+  FreePool (Commands);
+
   return Status;
 }
 
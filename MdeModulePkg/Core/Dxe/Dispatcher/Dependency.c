@@ -19,6 +19,18 @@ BOOLEAN *mDepexEvaluationStack        = NULL;
 BOOLEAN *mDepexEvaluationStackEnd     = NULL;
 BOOLEAN *mDepexEvaluationStackPointer = NULL;
 
+//
+// Hash of the EFI_DEP_PUSH opcodes waiting for their protocol to be installed,
+// keyed by protocol GUID. Protocols may be installed by event notification
+// functions while a depex is evaluated, so the waiters and the incremental
+// dispatch state of the drivers are protected by mDepexWaiterLock.
+//
+#define DEPEX_WAITER_HASH_SIZE  64
+
+LIST_ENTRY  mDepexWaiterHash[DEPEX_WAITER_HASH_SIZE];
+BOOLEAN     mDepexWaiterHashInitialized = FALSE;
+EFI_LOCK    mDepexWaiterLock = EFI_INITIALIZE_LOCK_VARIABLE (TPL_HIGH_LEVEL);
+
 //
 // Worker functions
 //
@@ -172,6 +184,7 @@ CorePreProcessDepex (
     DriverEntry->Unrequested = TRUE;
   } else {
     DriverEntry->Dependent = TRUE;
+    DriverEntry->DepexEvaluationPending = TRUE;
   }
 
   if (*Iterator == EFI_DEP_BEFORE) {
@@ -188,6 +201,284 @@ CorePreProcessDepex (
 }
 
 
+/**
+  Computes the mDepexWaiterHash bucket of a protocol GUID. The GUID may be
+  unaligned as it is read from a depex.
+
+  @param  Protocol              The protocol GUID.
+
+  @return The bucket list head of the protocol GUID.
+
+**/
+STATIC
+LIST_ENTRY *
+CoreGetDepexWaiterBucket (
+  IN  CONST EFI_GUID          *Protocol
+  )
+{
+  CONST UINT32  *Data;
+  UINT32        Hash;
+
+  Data = (CONST UINT32 *)Protocol;
+  Hash = ReadUnaligned32 (&Data[0]) ^ ReadUnaligned32 (&Data[1]) ^
+         ReadUnaligned32 (&Data[2]) ^ ReadUnaligned32 (&Data[3]);
+  Hash ^= Hash >> 16;
+  Hash ^= Hash >> 8;
+
+  return &mDepexWaiterHash[Hash & (DEPEX_WAITER_HASH_SIZE - 1)];
+}
+
+
+/**
+  Stop every EFI_DEP_PUSH opcode of a driver depex from waiting on its
+  protocol. The caller must hold mDepexWaiterLock.
+
+  @param  DriverEntry           DriverEntry element to update.
+
+**/
+STATIC
+VOID
+CoreUnlinkDepexWaiters (
+  IN  EFI_CORE_DRIVER_ENTRY   *DriverEntry
+  )
+{
+  UINTN                  Index;
+  EFI_CORE_DEPEX_WAITER  *Waiter;
+
+  for (Index = 0; Index < DriverEntry->DepexWaiterCount; Index++) {
+    Waiter = &DriverEntry->DepexWaiters[Index];
+    if (Waiter->Waiting) {
+      RemoveEntryList (&Waiter->Link);
+      Waiter->Waiting = FALSE;
+    }
+  }
+
+  DriverEntry->DepexWaitCount = 0;
+}
+
+
+/**
+  Prepare the evaluation of the depex of a driver. Every EFI_DEP_PUSH opcode
+  whose protocol was not installed yet starts waiting on its protocol, so
+  that the depex is evaluated again once one of them gets installed.
+
+  The waiters are linked before the depex is evaluated, so a protocol
+  installed during the evaluation is not missed.
+
+  @param  DriverEntry           DriverEntry element whose depex is evaluated.
+
+**/
+VOID
+CoreBeginDepexEvaluation (
+  IN  EFI_CORE_DRIVER_ENTRY   *DriverEntry
+  )
+{
+  UINT8                  *Iterator;
+  UINT8                  *End;
+  UINTN                  Count;
+  UINTN                  Index;
+  BOOLEAN                AndOnly;
+  EFI_CORE_DEPEX_WAITER  *Waiter;
+
+  if (DriverEntry->Depex == NULL) {
+    //
+    // A NULL Depex waits on the architectural protocols, which the dispatcher
+    // checks on every pass.
+    //
+    return;
+  }
+
+  //
+  // Count the EFI_DEP_PUSH opcodes still FALSE, and check whether the depex
+  // only ANDs them. Such a depex can not be TRUE before all of them are.
+  //
+  Count    = 0;
+  AndOnly  = TRUE;
+  Iterator = DriverEntry->Depex;
+  End      = Iterator + DriverEntry->DepexSize;
+  while (Iterator < End && *Iterator != EFI_DEP_END) {
+    switch (*Iterator) {
+    case EFI_DEP_PUSH:
+      if (Iterator + sizeof (EFI_GUID) < End) {
+        Count++;
+      }
+      Iterator += sizeof (EFI_GUID);
+      break;
+    case EFI_DEP_REPLACE_TRUE:
+      Iterator += sizeof (EFI_GUID);
+      break;
+    case EFI_DEP_SOR:
+    case EFI_DEP_AND:
+    case EFI_DEP_TRUE:
+      break;
+    case EFI_DEP_BEFORE:
+    case EFI_DEP_AFTER:
+      Iterator += sizeof (EFI_GUID);
+      AndOnly = FALSE;
+      break;
+    default:
+      AndOnly = FALSE;
+      break;
+    }
+    Iterator++;
+  }
+
+  if (Count != 0 && DriverEntry->DepexWaiters == NULL) {
+    //
+    // EFI_DEP_PUSH opcodes only ever turn into EFI_DEP_REPLACE_TRUE, so the
+    // first allocation is large enough for every later evaluation.
+    //
+    DriverEntry->DepexWaiters = AllocateZeroPool (Count * sizeof (EFI_CORE_DEPEX_WAITER));
+    if (DriverEntry->DepexWaiters == NULL) {
+      //
+      // Fall back to evaluating the depex on every pass.
+      //
+      DriverEntry->DepexEvaluationPending = TRUE;
+      return;
+    }
+  }
+
+  CoreAcquireLock (&mDepexWaiterLock);
+
+  if (!mDepexWaiterHashInitialized) {
+    for (Index = 0; Index < DEPEX_WAITER_HASH_SIZE; Index++) {
+      InitializeListHead (&mDepexWaiterHash[Index]);
+    }
+    mDepexWaiterHashInitialized = TRUE;
+  }
+
+  CoreUnlinkDepexWaiters (DriverEntry);
+
+  Index    = 0;
+  Iterator = DriverEntry->Depex;
+  while (Index < Count) {
+    if (*Iterator == EFI_DEP_PUSH) {
+      Waiter              = &DriverEntry->DepexWaiters[Index++];
+      Waiter->Opcode      = Iterator;
+      Waiter->DriverEntry = DriverEntry;
+      Waiter->Waiting     = TRUE;
+      InsertTailList (CoreGetDepexWaiterBucket ((EFI_GUID *)(Iterator + 1)), &Waiter->Link);
+    }
+    if (*Iterator == EFI_DEP_PUSH || *Iterator == EFI_DEP_REPLACE_TRUE ||
+        *Iterator == EFI_DEP_BEFORE || *Iterator == EFI_DEP_AFTER) {
+      Iterator += sizeof (EFI_GUID);
+    }
+    Iterator++;
+  }
+
+  DriverEntry->DepexWaiterCount       = Count;
+  DriverEntry->DepexWaitCount         = Count;
+  DriverEntry->DepexAndOnly           = AndOnly;
+  DriverEntry->DepexEvaluationPending = FALSE;
+
+  CoreReleaseLock (&mDepexWaiterLock);
+}
+
+
+/**
+  Complete the evaluation of the depex of a driver. The EFI_DEP_PUSH opcodes
+  found TRUE by CoreIsSchedulable() stop waiting on their protocol.
+
+  @param  DriverEntry           DriverEntry element whose depex was evaluated.
+  @param  Schedulable           The result of CoreIsSchedulable().
+
+**/
+VOID
+CoreEndDepexEvaluation (
+  IN  EFI_CORE_DRIVER_ENTRY   *DriverEntry,
+  IN  BOOLEAN                 Schedulable
+  )
+{
+  UINTN                  Index;
+  EFI_CORE_DEPEX_WAITER  *Waiter;
+
+  if (DriverEntry->DepexWaiters == NULL) {
+    return;
+  }
+
+  CoreAcquireLock (&mDepexWaiterLock);
+
+  if (Schedulable) {
+    CoreUnlinkDepexWaiters (DriverEntry);
+  } else {
+    for (Index = 0; Index < DriverEntry->DepexWaiterCount; Index++) {
+      Waiter = &DriverEntry->DepexWaiters[Index];
+      if (Waiter->Waiting && *Waiter->Opcode == EFI_DEP_REPLACE_TRUE) {
+        RemoveEntryList (&Waiter->Link);
+        Waiter->Waiting = FALSE;
+        DriverEntry->DepexWaitCount--;
+      }
+    }
+
+    //
+    // The protocols of the remaining opcodes may have been installed while
+    // the depex was evaluated.
+    //
+    if (DriverEntry->DepexAndOnly && DriverEntry->DepexWaitCount == 0) {
+      DriverEntry->DepexEvaluationPending = TRUE;
+    }
+  }
+
+  CoreReleaseLock (&mDepexWaiterLock);
+
+  if (Schedulable) {
+    FreePool (DriverEntry->DepexWaiters);
+    DriverEntry->DepexWaiters     = NULL;
+    DriverEntry->DepexWaiterCount = 0;
+  }
+}
+
+
+/**
+  Mark the drivers whose depex is waiting on a protocol for evaluation by the
+  dispatcher. Called every time a protocol interface is installed.
+
+  A depex that only ANDs its EFI_DEP_PUSH opcodes is evaluated again once all
+  of them have had their protocol installed, any other depex as soon as one
+  of them has.
+
+  @param  Protocol              The protocol that was installed.
+
+**/
+VOID
+CoreWakeDepexWaiters (
+  IN  EFI_GUID                *Protocol
+  )
+{
+  LIST_ENTRY             *Bucket;
+  LIST_ENTRY             *Link;
+  LIST_ENTRY             *NextLink;
+  EFI_CORE_DEPEX_WAITER  *Waiter;
+  EFI_CORE_DRIVER_ENTRY  *DriverEntry;
+
+  if (!mDepexWaiterHashInitialized) {
+    return;
+  }
+
+  CoreAcquireLock (&mDepexWaiterLock);
+
+  Bucket = CoreGetDepexWaiterBucket (Protocol);
+  for (Link = Bucket->ForwardLink; Link != Bucket; Link = NextLink) {
+    NextLink = Link->ForwardLink;
+    Waiter   = BASE_CR (Link, EFI_CORE_DEPEX_WAITER, Link);
+    if (!CompareGuid (Protocol, (EFI_GUID *)(Waiter->Opcode + 1))) {
+      continue;
+    }
+
+    RemoveEntryList (&Waiter->Link);
+    Waiter->Waiting = FALSE;
+
+    DriverEntry = Waiter->DriverEntry;
+    DriverEntry->DepexWaitCount--;
+    if (!DriverEntry->DepexAndOnly || DriverEntry->DepexWaitCount == 0) {
+      DriverEntry->DepexEvaluationPending = TRUE;
+    }
+  }
+
+  CoreReleaseLock (&mDepexWaiterLock);
+}
+
+
 
 /**
   This is the POSTFIX version of the dependency evaluator.  This code does
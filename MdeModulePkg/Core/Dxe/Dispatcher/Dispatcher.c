@@ -11,7 +11,8 @@
   Step #2 - Dispatch. Remove driver from the mScheduledQueue and load and
             start it. After mScheduledQueue is drained check the
             mDiscoveredList to see if any item has a Depex that is ready to
-            be placed on the mScheduledQueue.
+            be placed on the mScheduledQueue. A Depex is only evaluated again
+            once a protocol it is waiting on has been installed.
 
   Step #3 - Adding to the mScheduledQueue requires that you process Before
             and After dependencies. This is done recursively as the call to add
@@ -272,6 +273,7 @@ CoreGetDepexSectionAndPreProccess (
       //
       DriverEntry->Depex = NULL;
       DriverEntry->Dependent = TRUE;
+      DriverEntry->DepexEvaluationPending = TRUE;
       DriverEntry->DepexProtocolError = FALSE;
     }
   } else {
@@ -325,6 +327,7 @@ CoreSchedule (
       CoreAcquireDispatcherLock ();
       DriverEntry->Unrequested  = FALSE;
       DriverEntry->Dependent    = TRUE;
+      DriverEntry->DepexEvaluationPending = TRUE;
       CoreReleaseDispatcherLock ();
 
       DEBUG ((DEBUG_DISPATCH, "Schedule FFS(%g) - EFI_SUCCESS\n", DriverName));
@@ -385,6 +388,71 @@ CoreTrust (
   return EFI_NOT_FOUND;
 }
 
+/**
+  Decompress on the APs the sections of the drivers at the head of the
+  mScheduledQueue, up to PcdDxeSectionPrefetchCount of them, so that they do
+  not need to be decompressed on the BSP when the drivers are loaded. Nothing
+  is done before the MP Services Protocol is installed.
+
+**/
+VOID
+CorePrefetchScheduledDrivers (
+  VOID
+  )
+{
+  EFI_STATUS                      Status;
+  EFI_MP_SERVICES_PROTOCOL        *MpServices;
+  LIST_ENTRY                      *Link;
+  EFI_CORE_DRIVER_ENTRY           *DriverEntry;
+  UINTN                           *StreamHandles;
+  UINTN                           StreamCount;
+  UINTN                           MaxStreamCount;
+
+  MaxStreamCount = PcdGet32 (PcdDxeSectionPrefetchCount);
+  if (MaxStreamCount == 0) {
+    return;
+  }
+
+  Status = CoreLocateProtocol (&gEfiMpServiceProtocolGuid, NULL, (VOID **)&MpServices);
+  if (EFI_ERROR (Status)) {
+    return;
+  }
+
+  StreamHandles = AllocatePool (MaxStreamCount * sizeof (UINTN));
+  if (StreamHandles == NULL) {
+    return;
+  }
+
+  StreamCount = 0;
+  for (Link = mScheduledQueue.ForwardLink;
+       Link != &mScheduledQueue && StreamCount < MaxStreamCount;
+       Link = Link->ForwardLink) {
+    DriverEntry = CR (Link, EFI_CORE_DRIVER_ENTRY, ScheduledLink, EFI_CORE_DRIVER_ENTRY_SIGNATURE);
+    if (DriverEntry->SectionsPrefetched) {
+      continue;
+    }
+    DriverEntry->SectionsPrefetched = TRUE;
+
+    if (DriverEntry->ImageHandle != NULL) {
+      //
+      // Untrusted driver already loaded
+      //
+      continue;
+    }
+
+    Status = FvOpenFileSectionStream (DriverEntry->Fv, &DriverEntry->FileName, &StreamHandles[StreamCount]);
+    if (!EFI_ERROR (Status)) {
+      StreamCount++;
+    }
+  }
+
+  if (StreamCount > 0) {
+    CorePrefetchSections (MpServices, StreamHandles, StreamCount);
+  }
+
+  FreePool (StreamHandles);
+}
+
 /**
   This is the main Dispatcher for DXE and it exits when there are no more
   drivers to run. Drain the mScheduledQueue and load and start a PE
@@ -410,7 +478,12 @@ CoreDispatcher (
   LIST_ENTRY                      *Link;
   EFI_CORE_DRIVER_ENTRY           *DriverEntry;
   BOOLEAN                         ReadyToRun;
+  BOOLEAN                         Schedulable;
   EFI_EVENT                       DxeDispatchEvent;
+  UINTN                           PassCount;
+  UINTN                           EvaluatedCount;
+  UINTN                           SkippedCount;
+  UINTN                           DispatchedCount;
 
   PERF_FUNCTION_BEGIN ();
 
@@ -435,6 +508,11 @@ CoreDispatcher (
     return Status;
   }
 
+  PassCount       = 0;
+  EvaluatedCount  = 0;
+  SkippedCount    = 0;
+  DispatchedCount = 0;
+
   ReturnStatus = EFI_NOT_FOUND;
   do {
     //
@@ -448,6 +526,13 @@ CoreDispatcher (
                       EFI_CORE_DRIVER_ENTRY_SIGNATURE
                       );
 
+      //
+      // Decompress the upcoming drivers on the APs
+      //
+      if (!DriverEntry->SectionsPrefetched) {
+        CorePrefetchScheduledDrivers ();
+      }
+
       //
       // Load the DXE Driver image into memory. If the Driver was transitioned from
       // Untrused to Scheduled it would have already been loaded so we may need to
@@ -531,6 +616,7 @@ CoreDispatcher (
       }
 
       ReturnStatus = EFI_SUCCESS;
+      DispatchedCount++;
     }
 
     //
@@ -545,6 +631,7 @@ CoreDispatcher (
     //
     // Search DriverList for items to place on Scheduled Queue
     //
+    PassCount++;
     ReadyToRun = FALSE;
     for (Link = mDiscoveredList.ForwardLink; Link != &mDiscoveredList; Link = Link->ForwardLink) {
       DriverEntry = CR (Link, EFI_CORE_DRIVER_ENTRY, Link, EFI_CORE_DRIVER_ENTRY_SIGNATURE);
@@ -557,9 +644,23 @@ CoreDispatcher (
       }
 
       if (DriverEntry->Dependent) {
-        if (CoreIsSchedulable (DriverEntry)) {
-          CoreInsertOnScheduledQueueWhileProcessingBeforeAndAfter (DriverEntry);
-          ReadyToRun = TRUE;
+        //
+        // Skip the Depex if none of the protocols it is waiting on has been
+        // installed since its last evaluation. A NULL Depex waits on the
+        // architectural protocols.
+        //
+        if (!DriverEntry->DepexEvaluationPending ||
+            (DriverEntry->Depex == NULL && EFI_ERROR (CoreAllEfiServicesAvailable ()))) {
+          SkippedCount++;
+        } else {
+          EvaluatedCount++;
+          CoreBeginDepexEvaluation (DriverEntry);
+          Schedulable = CoreIsSchedulable (DriverEntry);
+          CoreEndDepexEvaluation (DriverEntry, Schedulable);
+          if (Schedulable) {
+            CoreInsertOnScheduledQueueWhileProcessingBeforeAndAfter (DriverEntry);
+            ReadyToRun = TRUE;
+          }
         }
       } else {
         if (DriverEntry->Unrequested) {
@@ -571,6 +672,17 @@ CoreDispatcher (
     }
   } while (ReadyToRun);
 
+  CoreFlushPrefetchedSections ();
+
+  DEBUG ((
+    DEBUG_DISPATCH,
+    "Dispatch trace: %d passes, %d drivers dispatched, %d DXE DEPEX evaluated, %d skipped\n",
+    PassCount,
+    DispatchedCount,
+    EvaluatedCount,
+    SkippedCount
+    ));
+
   //
   // Close DXE dispatch Event
   //
@@ -47,6 +47,7 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include <Protocol/HiiPackageList.h>
 #include <Protocol/SmmBase2.h>
 #include <Protocol/PeCoffImageEmulator.h>
+#include <Protocol/MpService.h>
 #include <Guid/MemoryTypeInformation.h>
 #include <Guid/FirmwareFileSystem2.h>
 #include <Guid/FirmwareFileSystem3.h>
@@ -137,6 +138,8 @@ typedef struct {
 } KNOWN_HANDLE;
 
 
+typedef struct _EFI_CORE_DEPEX_WAITER  EFI_CORE_DEPEX_WAITER;
+
 #define EFI_CORE_DRIVER_ENTRY_SIGNATURE SIGNATURE_32('d','r','v','r')
 typedef struct {
   UINTN                           Signature;
@@ -165,9 +168,84 @@ typedef struct {
 
   EFI_HANDLE                      ImageHandle;
   BOOLEAN                         IsFvImage;
+  BOOLEAN                         SectionsPrefetched;
+
+  //
+  // The depex of a Dependent driver is only evaluated again once a protocol
+  // it is waiting on has been installed. DepexWaitCount is the number of
+  // EFI_DEP_PUSH opcodes still waiting on their protocol.
+  //
+  BOOLEAN                         DepexEvaluationPending;
+  BOOLEAN                         DepexAndOnly;
+  UINTN                           DepexWaitCount;
+  UINTN                           DepexWaiterCount;
+  EFI_CORE_DEPEX_WAITER           *DepexWaiters;
 
 } EFI_CORE_DRIVER_ENTRY;
 
+///
+/// An EFI_DEP_PUSH opcode of a driver depex waiting for its protocol to be
+/// installed. Waiting opcodes are linked in a hash keyed by protocol GUID.
+///
+struct _EFI_CORE_DEPEX_WAITER {
+  LIST_ENTRY                      Link;
+  UINT8                           *Opcode;
+  EFI_CORE_DRIVER_ENTRY           *DriverEntry;
+  BOOLEAN                         Waiting;
+};
+
+//
+// The data structures of the red-black trees indexing the DXE core maps.
+// The nodes are embedded in the indexed structures.
+//
+typedef struct _CORE_RB_NODE  CORE_RB_NODE;
+
+struct _CORE_RB_NODE {
+  CORE_RB_NODE          *Parent;
+  CORE_RB_NODE          *Left;
+  CORE_RB_NODE          *Right;
+  BOOLEAN               Red;
+};
+
+/**
+  Compare two nodes of a red-black tree.
+
+  @param  Node1                  The first node to compare
+  @param  Node2                  The second node to compare
+
+  @retval <0                     Node1 is ordered before Node2.
+  @retval 0                      Node1 and Node2 are ordered the same.
+  @retval >0                     Node1 is ordered after Node2.
+
+**/
+typedef
+INTN
+(*CORE_RB_COMPARE) (
+  IN CORE_RB_NODE       *Node1,
+  IN CORE_RB_NODE       *Node2
+  );
+
+/**
+  Refresh the data a red-black tree caches in a node from its children.
+
+  @param  Node                   The node to update
+
+**/
+typedef
+VOID
+(*CORE_RB_UPDATE) (
+  IN OUT CORE_RB_NODE   *Node
+  );
+
+typedef struct {
+  CORE_RB_NODE          *Root;
+  CORE_RB_COMPARE       Compare;
+  ///
+  /// Optional, invoked whenever the children of a node change
+  ///
+  CORE_RB_UPDATE        Update;
+} CORE_RB_TREE;
+
 //
 //The data structure of GCD memory map entry
 //
@@ -183,6 +261,10 @@ typedef struct {
   EFI_GCD_IO_TYPE       GcdIoType;
   EFI_HANDLE            ImageHandle;
   EFI_HANDLE            DeviceHandle;
+  ///
+  /// Node of the address ordered index of the GCD map
+  ///
+  CORE_RB_NODE          IndexNode;
 } EFI_GCD_MAP_ENTRY;
 
 
@@ -520,6 +602,48 @@ CorePreProcessDepex (
   );
 
 
+/**
+  Prepare the evaluation of the depex of a driver. Every EFI_DEP_PUSH opcode
+  whose protocol was not installed yet starts waiting on its protocol, so
+  that the depex is evaluated again once one of them gets installed.
+
+  @param  DriverEntry           DriverEntry element whose depex is evaluated.
+
+**/
+VOID
+CoreBeginDepexEvaluation (
+  IN  EFI_CORE_DRIVER_ENTRY   *DriverEntry
+  );
+
+
+/**
+  Complete the evaluation of the depex of a driver. The EFI_DEP_PUSH opcodes
+  found TRUE by CoreIsSchedulable() stop waiting on their protocol.
+
+  @param  DriverEntry           DriverEntry element whose depex was evaluated.
+  @param  Schedulable           The result of CoreIsSchedulable().
+
+**/
+VOID
+CoreEndDepexEvaluation (
+  IN  EFI_CORE_DRIVER_ENTRY   *DriverEntry,
+  IN  BOOLEAN                 Schedulable
+  );
+
+
+/**
+  Mark the drivers whose depex is waiting on a protocol for evaluation by the
+  dispatcher. Called every time a protocol interface is installed.
+
+  @param  Protocol              The protocol that was installed.
+
+**/
+VOID
+CoreWakeDepexWaiters (
+  IN  EFI_GUID                *Protocol
+  );
+
+
 
 /**
   Terminates all boot services.
@@ -2481,6 +2605,63 @@ CloseSectionStream (
   IN  BOOLEAN                                   FreeStreamBuffer
   );
 
+/**
+  Decompresses the encapsulation sections at the top level of section streams
+  on the APs. The new section streams are produced from the decompressed data
+  when the encapsulation sections are first searched by GetSection().
+
+  Only the EFI standard compression and the LZMA and Brotli GUIDed sections
+  are decompressed, as their decoders are known to be safe to run on an AP.
+
+  @param  MpServices             The MP Services Protocol.
+  @param  StreamHandles          The section streams to decompress.
+  @param  StreamCount            The number of section streams.
+
+**/
+VOID
+CorePrefetchSections (
+  IN  EFI_MP_SERVICES_PROTOCOL                  *MpServices,
+  IN  UINTN                                     *StreamHandles,
+  IN  UINTN                                     StreamCount
+  );
+
+/**
+  Frees the decompressed sections of CorePrefetchSections() that were not
+  consumed.
+
+**/
+VOID
+CoreFlushPrefetchedSections (
+  VOID
+  );
+
+/**
+  Opens the section stream of a given FFS File. The section stream is kept
+  open in the FFS file list entry, so that the sections extracted from it are
+  cached until the firmware volume is closed.
+
+  @param  This                       Indicates the calling context.
+  @param  NameGuid                   Pointer to an EFI_GUID, which is the
+                                     filename.
+  @param  StreamHandle               Returns the section stream handle of the
+                                     file.
+
+  @retval EFI_SUCCESS                The section stream of the file is open.
+  @retval EFI_UNSUPPORTED            The firmware volume is not produced by the
+                                     DXE core.
+  @retval EFI_NOT_FOUND              The file does not exist or has no sections.
+  @retval EFI_DEVICE_ERROR           Device error.
+  @retval EFI_ACCESS_DENIED          Could not read.
+  @retval EFI_INVALID_PARAMETER      Invalid parameter.
+
+**/
+EFI_STATUS
+FvOpenFileSectionStream (
+  IN CONST  EFI_FIRMWARE_VOLUME2_PROTOCOL  *This,
+  IN CONST  EFI_GUID                       *NameGuid,
+  OUT       UINTN                          *StreamHandle
+  );
+
 /**
   Creates and initializes the DebugImageInfo Table.  Also creates the configuration
   table and registers it into the system table.
@@ -2650,6 +2831,74 @@ CoreReleaseLock (
   IN EFI_LOCK  *Lock
   );
 
+/**
+  Add a node to a tree. Nodes that compare equal are kept in insertion order.
+
+  @param  Tree                   The tree to add the node to
+  @param  Node                   The node to add
+
+**/
+VOID
+CoreRbTreeInsert (
+  IN OUT CORE_RB_TREE    *Tree,
+  IN OUT CORE_RB_NODE    *Node
+  );
+
+/**
+  Remove a node from a tree.
+
+  @param  Tree                   The tree to remove the node from
+  @param  Node                   The node to remove
+
+**/
+VOID
+CoreRbTreeRemove (
+  IN OUT CORE_RB_TREE    *Tree,
+  IN OUT CORE_RB_NODE    *Node
+  );
+
+/**
+  Refresh the data a tree caches after a node changed in place. The change
+  must not move the node relative to its neighbours.
+
+  @param  Tree                   The tree the node belongs to
+  @param  Node                   The node that changed
+
+**/
+VOID
+CoreRbTreeUpdate (
+  IN     CORE_RB_TREE    *Tree,
+  IN OUT CORE_RB_NODE    *Node
+  );
+
+/**
+  Make a copy of a node take its place in a tree.
+
+  @param  Tree                   The tree the node belongs to
+  @param  Node                   The node in the tree
+  @param  Replacement            The copy of Node that replaces it
+
+**/
+VOID
+CoreRbTreeReplace (
+  IN OUT CORE_RB_TREE    *Tree,
+  IN OUT CORE_RB_NODE    *Node,
+  IN OUT CORE_RB_NODE    *Replacement
+  );
+
+/**
+  Get the node that follows a node in tree order.
+
+  @param  Node                   The current node
+
+  @return The next node, or NULL if Node is the last one
+
+**/
+CORE_RB_NODE *
+CoreRbTreeNext (
+  IN CORE_RB_NODE        *Node
+  );
+
 /**
   Read data from Firmware Block by FVB protocol Read.
   The data may cross the multi block ranges.
@@ -10,17 +10,59 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include "DxeMain.h"
 #include "Event.h"
 
+//
+// The timer database is a hierarchical timer wheel. Level 0 has one slot per
+// 2^TIMER_WHEEL_GRANULARITY_SHIFT units of 100ns, and every higher level has
+// slots TIMER_WHEEL_SLOTS times wider than the level below it. A timer is put
+// in O(1) into the slot of the lowest level that covers the distance between
+// its trigger time and mEfiTimerWheelTime, and it is cascaded down to lower
+// levels as the wheel turns. Level 0 slots are kept sorted by trigger time so
+// that timers expire in the same order as with a single sorted list.
+//
+#define TIMER_WHEEL_GRANULARITY_SHIFT  10
+#define TIMER_WHEEL_SLOT_SHIFT         6
+#define TIMER_WHEEL_SLOTS              (1 << TIMER_WHEEL_SLOT_SHIFT)
+#define TIMER_WHEEL_SLOT_MASK          (TIMER_WHEEL_SLOTS - 1)
+#define TIMER_WHEEL_LEVELS             4
+
+typedef struct {
+  ///
+  /// Bitmap of the slots that may be non-empty. Bits of cancelled timers are
+  /// cleared lazily when the slot is found to be empty.
+  ///
+  UINT64          Occupied;
+  LIST_ENTRY      Slot[TIMER_WHEEL_SLOTS];
+} TIMER_WHEEL_LEVEL;
+
 //
 // Internal data
 //
 
-LIST_ENTRY       mEfiTimerList = INITIALIZE_LIST_HEAD_VARIABLE (mEfiTimerList);
+TIMER_WHEEL_LEVEL mEfiTimerWheel[TIMER_WHEEL_LEVELS];
+//
+// Level 0 slot (in units of 2^TIMER_WHEEL_GRANULARITY_SHIFT) the wheel is at
+//
+UINT64           mEfiTimerWheelTime = 0;
+//
+// Lower bound of the earliest trigger time in the timer database
+//
+UINT64           mEfiTimerNextTrigger = MAX_UINT64;
 EFI_LOCK         mEfiTimerLock = EFI_INITIALIZE_LOCK_VARIABLE (TPL_HIGH_LEVEL - 1);
 EFI_EVENT        mEfiCheckTimerEvent = NULL;
 
 EFI_LOCK         mEfiSystemTimeLock = EFI_INITIALIZE_LOCK_VARIABLE (TPL_HIGH_LEVEL);
 UINT64           mEfiSystemTime = 0;
 
+//
+// Tick coalescing state. mEfiTimerDefaultPeriod is the period the timer
+// architectural protocol was programmed with by the platform,
+// mEfiTimerProgrammedPeriod is the period the DXE core last set, and
+// mEfiTimerWakeupTime is the system time the next tick is expected at.
+//
+UINT64           mEfiTimerDefaultPeriod = 0;
+UINT64           mEfiTimerProgrammedPeriod = 0;
+UINT64           mEfiTimerWakeupTime = 0;
+
 //
 // Timer functions
 //
@@ -37,6 +79,11 @@ CoreInsertEventTimer (
   )
 {
   UINT64          TriggerTime;
+  UINT64          Expires;
+  UINT64          Delta;
+  UINTN           Level;
+  UINTN           Index;
+  LIST_ENTRY      *Slot;
   LIST_ENTRY      *Link;
   IEVENT          *Event2;
 
@@ -48,17 +95,233 @@ CoreInsertEventTimer (
   TriggerTime = Event->Timer.TriggerTime;
 
   //
-  // Insert the timer into the timer database in assending sorted order
+  // Find the lowest level whose range covers the trigger time. Timers that
+  // already expired go to the current slot, timers beyond the range of the
+  // wheel go to the last slot of the highest level and are re-inserted when
+  // that slot is cascaded.
   //
-  for (Link = mEfiTimerList.ForwardLink; Link != &mEfiTimerList; Link = Link->ForwardLink) {
-    Event2 = CR (Link, IEVENT, Timer.Link, EVENT_SIGNATURE);
-
-    if (Event2->Timer.TriggerTime > TriggerTime) {
+  Expires = RShiftU64 (TriggerTime, TIMER_WHEEL_GRANULARITY_SHIFT);
+  if (Expires < mEfiTimerWheelTime) {
+    Expires = mEfiTimerWheelTime;
+  }
+  Delta = Expires - mEfiTimerWheelTime;
+  for (Level = 0; Level < TIMER_WHEEL_LEVELS - 1; Level++) {
+    if (Delta < LShiftU64 (1, (Level + 1) * TIMER_WHEEL_SLOT_SHIFT)) {
       break;
     }
   }
+  if (Delta >= LShiftU64 (1, TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOT_SHIFT)) {
+    Expires = mEfiTimerWheelTime + LShiftU64 (1, TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOT_SHIFT) - 1;
+  }
+
+  Index = (UINTN) RShiftU64 (Expires, Level * TIMER_WHEEL_SLOT_SHIFT) & TIMER_WHEEL_SLOT_MASK;
+  Slot  = &mEfiTimerWheel[Level].Slot[Index];
+  mEfiTimerWheel[Level].Occupied |= LShiftU64 (1, Index);
+
+  Link = Slot;
+  if (Level == 0) {
+    //
+    // Insert the timer into the level 0 slot in assending sorted order
+    //
+    for (Link = Slot->ForwardLink; Link != Slot; Link = Link->ForwardLink) {
+      Event2 = CR (Link, IEVENT, Timer.Link, EVENT_SIGNATURE);
+
+      if (Event2->Timer.TriggerTime > TriggerTime) {
+        break;
+      }
+    }
+  }
 
   InsertTailList (Link, &Event->Timer.Link);
+
+  if (TriggerTime < mEfiTimerNextTrigger) {
+    mEfiTimerNextTrigger = TriggerTime;
+  }
+}
+
+/**
+  Re-inserts all the timers of the slot of a wheel level that the wheel has
+  just reached, so that they move to the lower levels.
+
+  @param  Level                  The level of the wheel to cascade.
+
+  @return The index of the slot that has been cascaded.
+
+**/
+UINTN
+CoreCascadeTimerWheel (
+  IN UINTN    Level
+  )
+{
+  UINTN           Index;
+  LIST_ENTRY      *Slot;
+  IEVENT          *Event;
+
+  ASSERT_LOCKED (&mEfiTimerLock);
+
+  Index = (UINTN) RShiftU64 (mEfiTimerWheelTime, Level * TIMER_WHEEL_SLOT_SHIFT) & TIMER_WHEEL_SLOT_MASK;
+  Slot  = &mEfiTimerWheel[Level].Slot[Index];
+  mEfiTimerWheel[Level].Occupied &= ~LShiftU64 (1, Index);
+
+  while (!IsListEmpty (Slot)) {
+    Event = CR (Slot->ForwardLink, IEVENT, Timer.Link, EVENT_SIGNATURE);
+    RemoveEntryList (&Event->Timer.Link);
+    CoreInsertEventTimer (Event);
+  }
+
+  return Index;
+}
+
+/**
+  Finds the first slot of a wheel level that holds timers, starting from a
+  given slot and wrapping around. Bits of empty slots are cleared on the way.
+
+  @param  Level                  The level of the wheel to search.
+  @param  Start                  The slot index to start the search at.
+
+  @return The number of slots between Start and the first non-empty slot, or
+          TIMER_WHEEL_SLOTS if the level is empty.
+
+**/
+UINTN
+CoreFindTimerWheelSlot (
+  IN UINTN    Level,
+  IN UINTN    Start
+  )
+{
+  TIMER_WHEEL_LEVEL   *WheelLevel;
+  UINT64              Bits;
+  UINTN               Index;
+
+  WheelLevel = &mEfiTimerWheel[Level];
+  while (WheelLevel->Occupied != 0) {
+    //
+    // Look at the slots at or after Start first, then wrap around
+    //
+    Bits = WheelLevel->Occupied & LShiftU64 (MAX_UINT64, Start);
+    if (Bits == 0) {
+      Bits = WheelLevel->Occupied;
+    }
+    Index = (UINTN) LowBitSet64 (Bits);
+
+    if (!IsListEmpty (&WheelLevel->Slot[Index])) {
+      return (Index - Start) & TIMER_WHEEL_SLOT_MASK;
+    }
+    WheelLevel->Occupied &= ~LShiftU64 (1, Index);
+  }
+
+  return TIMER_WHEEL_SLOTS;
+}
+
+/**
+  Computes the earliest time a timer of the timer database may expire at.
+  The result is exact for timers in level 0 of the wheel and a lower bound
+  for timers in the higher levels.
+
+  @return The earliest trigger time, or MAX_UINT64 if no timer is set.
+
+**/
+UINT64
+CoreGetNextTimerTrigger (
+  VOID
+  )
+{
+  UINT64          NextTrigger;
+  UINT64          BlockTime;
+  UINT64          SlotTime;
+  UINTN           Level;
+  UINTN           Index;
+  UINTN           Distance;
+  IEVENT          *Event;
+
+  ASSERT_LOCKED (&mEfiTimerLock);
+
+  NextTrigger = MAX_UINT64;
+
+  //
+  // Level 0 slots are sorted, so the head of the first non-empty slot is the
+  // earliest timer of the level.
+  //
+  Index    = (UINTN) mEfiTimerWheelTime & TIMER_WHEEL_SLOT_MASK;
+  Distance = CoreFindTimerWheelSlot (0, Index);
+  if (Distance < TIMER_WHEEL_SLOTS) {
+    Event = CR (
+              mEfiTimerWheel[0].Slot[(Index + Distance) & TIMER_WHEEL_SLOT_MASK].ForwardLink,
+              IEVENT,
+              Timer.Link,
+              EVENT_SIGNATURE
+              );
+    NextTrigger = Event->Timer.TriggerTime;
+  }
+
+  //
+  // The slot at the current index of a higher level has already been
+  // cascaded, so its timers belong to the next turn of that level. The
+  // timers of a slot can not expire before the wheel reaches that slot.
+  //
+  for (Level = 1; Level < TIMER_WHEEL_LEVELS; Level++) {
+    BlockTime = RShiftU64 (mEfiTimerWheelTime, Level * TIMER_WHEEL_SLOT_SHIFT);
+    Index     = (UINTN) BlockTime & TIMER_WHEEL_SLOT_MASK;
+    Distance  = CoreFindTimerWheelSlot (Level, (Index + 1) & TIMER_WHEEL_SLOT_MASK);
+    if (Distance < TIMER_WHEEL_SLOTS) {
+      SlotTime = LShiftU64 (
+                   BlockTime + Distance + 1,
+                   Level * TIMER_WHEEL_SLOT_SHIFT + TIMER_WHEEL_GRANULARITY_SHIFT
+                   );
+      if (SlotTime < NextTrigger) {
+        NextTrigger = SlotTime;
+      }
+    }
+  }
+
+  return NextTrigger;
+}
+
+/**
+  When tick coalescing is enabled, programs the timer architectural protocol
+  to interrupt at the next timer deadline instead of at a fixed period. The
+  period is bounded by the platform period and PcdDxeTimerCoalescingMaxPeriod.
+
+  @param  SystemTime             The current system time.
+
+**/
+VOID
+CoreCoalesceTimerTicks (
+  IN UINT64   SystemTime
+  )
+{
+  UINT64          Period;
+
+  ASSERT_LOCKED (&mEfiTimerLock);
+
+  if ((PcdGet64 (PcdDxeTimerCoalescingMaxPeriod) == 0) || (gTimer == NULL)) {
+    return;
+  }
+
+  if (mEfiTimerDefaultPeriod == 0) {
+    gTimer->GetTimerPeriod (gTimer, &mEfiTimerDefaultPeriod);
+    mEfiTimerProgrammedPeriod = mEfiTimerDefaultPeriod;
+    if (mEfiTimerDefaultPeriod == 0) {
+      //
+      // Timer interrupts are disabled, do not enable them
+      //
+      return;
+    }
+  }
+
+  Period = mEfiTimerDefaultPeriod;
+  if (mEfiTimerNextTrigger > SystemTime + mEfiTimerDefaultPeriod) {
+    Period = mEfiTimerNextTrigger - SystemTime;
+    if (Period > PcdGet64 (PcdDxeTimerCoalescingMaxPeriod)) {
+      Period = MAX (PcdGet64 (PcdDxeTimerCoalescingMaxPeriod), mEfiTimerDefaultPeriod);
+    }
+  }
+
+  if (Period != mEfiTimerProgrammedPeriod) {
+    gTimer->SetTimerPeriod (gTimer, Period);
+    mEfiTimerProgrammedPeriod = Period;
+  }
+  mEfiTimerWakeupTime = SystemTime + Period;
 }
 
 /**
@@ -97,6 +360,11 @@ CoreCheckTimers (
   )
 {
   UINT64                  SystemTime;
+  UINT64                  SystemTick;
+  UINT64                  NextTick;
+  UINTN                   Index;
+  UINTN                   Level;
+  LIST_ENTRY              *Slot;
   IEVENT                  *Event;
 
   //
@@ -104,53 +372,102 @@ CoreCheckTimers (
   //
   CoreAcquireLock (&mEfiTimerLock);
   SystemTime = CoreCurrentSystemTime ();
+  SystemTick = RShiftU64 (SystemTime, TIMER_WHEEL_GRANULARITY_SHIFT);
 
-  while (!IsListEmpty (&mEfiTimerList)) {
-    Event = CR (mEfiTimerList.ForwardLink, IEVENT, Timer.Link, EVENT_SIGNATURE);
-
+  for (;;) {
     //
-    // If this timer is not expired, then we're done
+    // Expire the timers of the current level 0 slot. The slot is sorted, so
+    // stop at the first timer that is not expired.
     //
-    if (Event->Timer.TriggerTime > SystemTime) {
-      break;
-    }
+    Index = (UINTN) mEfiTimerWheelTime & TIMER_WHEEL_SLOT_MASK;
+    Slot  = &mEfiTimerWheel[0].Slot[Index];
+    while (!IsListEmpty (Slot)) {
+      Event = CR (Slot->ForwardLink, IEVENT, Timer.Link, EVENT_SIGNATURE);
 
-    //
-    // Remove this timer from the timer queue
-    //
+      //
+      // If this timer is not expired, then we're done
+      //
+      if (Event->Timer.TriggerTime > SystemTime) {
+        break;
+      }
 
-    RemoveEntryList (&Event->Timer.Link);
-    Event->Timer.Link.ForwardLink = NULL;
+      //
+      // Remove this timer from the timer queue
+      //
 
-    //
-    // Signal it
-    //
-    CoreSignalEvent (Event);
+      RemoveEntryList (&Event->Timer.Link);
+      Event->Timer.Link.ForwardLink = NULL;
 
-    //
-    // If this is a periodic timer, set it
-    //
-    if (Event->Timer.Period != 0) {
       //
-      // Compute the timers new trigger time
+      // Signal it
       //
-      Event->Timer.TriggerTime = Event->Timer.TriggerTime + Event->Timer.Period;
+      CoreSignalEvent (Event);
 
       //
-      // If that's before now, then reset the timer to start from now
+      // If this is a periodic timer, set it
       //
-      if (Event->Timer.TriggerTime <= SystemTime) {
-        Event->Timer.TriggerTime = SystemTime;
-        CoreSignalEvent (mEfiCheckTimerEvent);
+      if (Event->Timer.Period != 0) {
+        //
+        // Compute the timers new trigger time
+        //
+        Event->Timer.TriggerTime = Event->Timer.TriggerTime + Event->Timer.Period;
+
+        //
+        // If that's before now, then reset the timer to start from now
+        //
+        if (Event->Timer.TriggerTime <= SystemTime) {
+          Event->Timer.TriggerTime = SystemTime;
+          CoreSignalEvent (mEfiCheckTimerEvent);
+        }
+
+        //
+        // Add the timer
+        //
+        CoreInsertEventTimer (Event);
       }
+    }
 
-      //
-      // Add the timer
-      //
-      CoreInsertEventTimer (Event);
+    if (mEfiTimerWheelTime >= SystemTick) {
+      break;
+    }
+
+    //
+    // Turn the wheel to the next slot that holds timers, either in level 0 or
+    // to be cascaded from a higher level, but not past the current time.
+    // Slots in between are empty and need no processing.
+    //
+    if (IsListEmpty (Slot)) {
+      mEfiTimerWheel[0].Occupied &= ~LShiftU64 (1, Index);
+    }
+    NextTick = RShiftU64 (CoreGetNextTimerTrigger (), TIMER_WHEEL_GRANULARITY_SHIFT);
+    if (NextTick <= mEfiTimerWheelTime) {
+      NextTick = mEfiTimerWheelTime + 1;
+    }
+    if (NextTick > SystemTick) {
+      NextTick = SystemTick;
+    }
+    mEfiTimerWheelTime = NextTick;
+
+    if ((mEfiTimerWheelTime & TIMER_WHEEL_SLOT_MASK) == 0) {
+      for (Level = 1; Level < TIMER_WHEEL_LEVELS; Level++) {
+        if (CoreCascadeTimerWheel (Level) != 0) {
+          break;
+        }
+      }
     }
   }
 
+  //
+  // Find the next deadline for CoreTimerTick(). If it has already been reached
+  // while the timers were processed, check them again.
+  //
+  mEfiTimerNextTrigger = CoreGetNextTimerTrigger ();
+  if (mEfiTimerNextTrigger <= CoreCurrentSystemTime ()) {
+    CoreSignalEvent (mEfiCheckTimerEvent);
+  }
+
+  CoreCoalesceTimerTicks (SystemTime);
+
   CoreReleaseLock (&mEfiTimerLock);
 }
 
@@ -165,6 +482,15 @@ CoreInitializeTimer (
   )
 {
   EFI_STATUS  Status;
+  UINTN       Level;
+  UINTN       Index;
+
+  for (Level = 0; Level < TIMER_WHEEL_LEVELS; Level++) {
+    mEfiTimerWheel[Level].Occupied = 0;
+    for (Index = 0; Index < TIMER_WHEEL_SLOTS; Index++) {
+      InitializeListHead (&mEfiTimerWheel[Level].Slot[Index]);
+    }
+  }
 
   Status = CoreCreateEventInternal (
              EVT_NOTIFY_SIGNAL,
@@ -191,8 +517,6 @@ CoreTimerTick (
   IN UINT64   Duration
   )
 {
-  IEVENT          *Event;
-
   //
   // Check runtiem flag in case there are ticks while exiting boot services
   //
@@ -204,15 +528,11 @@ CoreTimerTick (
   mEfiSystemTime += Duration;
 
   //
-  // If the head of the list is expired, fire the timer event
+  // If the earliest timer is expired, fire the timer event
   // to process it
   //
-  if (!IsListEmpty (&mEfiTimerList)) {
-    Event = CR (mEfiTimerList.ForwardLink, IEVENT, Timer.Link, EVENT_SIGNATURE);
-
-    if (Event->Timer.TriggerTime <= mEfiSystemTime) {
-      CoreSignalEvent (mEfiCheckTimerEvent);
-    }
+  if (mEfiTimerNextTrigger <= mEfiSystemTime) {
+    CoreSignalEvent (mEfiCheckTimerEvent);
   }
 
   CoreReleaseLock (&mEfiSystemTimeLock);
@@ -276,7 +596,10 @@ CoreSetTimer (
 
     if (Type == TimerPeriodic) {
       if (TriggerTime == 0) {
-        gTimer->GetTimerPeriod (gTimer, &TriggerTime);
+        TriggerTime = mEfiTimerDefaultPeriod;
+        if (TriggerTime == 0) {
+          gTimer->GetTimerPeriod (gTimer, &TriggerTime);
+        }
       }
       Event->Timer.Period = TriggerTime;
     }
@@ -287,6 +610,16 @@ CoreSetTimer (
     if (TriggerTime == 0) {
       CoreSignalEvent (mEfiCheckTimerEvent);
     }
+
+    //
+    // If ticks are coalesced past the trigger time of this timer, go back to
+    // the platform period so that the timer does not expire late
+    //
+    if ((mEfiTimerProgrammedPeriod > mEfiTimerDefaultPeriod) &&
+        (Event->Timer.TriggerTime < mEfiTimerWakeupTime)) {
+      gTimer->SetTimerPeriod (gTimer, mEfiTimerDefaultPeriod);
+      mEfiTimerProgrammedPeriod = mEfiTimerDefaultPeriod;
+    }
   }
 
   CoreReleaseLock (&mEfiTimerLock);
@@ -404,43 +404,30 @@ FvReadFile (
 
 
 /**
-  Locates a section in a given FFS File and
-  copies it to the supplied buffer (not including section header).
+  Opens the section stream of a given FFS File. The section stream is kept
+  open in the FFS file list entry, so that the sections extracted from it are
+  cached until the firmware volume is closed.
 
   @param  This                       Indicates the calling context.
   @param  NameGuid                   Pointer to an EFI_GUID, which is the
                                      filename.
-  @param  SectionType                Indicates the section type to return.
-  @param  SectionInstance            Indicates which instance of sections with a
-                                     type of SectionType to return.
-  @param  Buffer                     Buffer is a pointer to pointer to a buffer
-                                     in which the file or section contents or are
-                                     returned.
-  @param  BufferSize                 BufferSize is a pointer to caller allocated
-                                     UINTN.
-  @param  AuthenticationStatus       AuthenticationStatus is a pointer to a
-                                     caller allocated UINT32 in which the
-                                     authentication status is returned.
+  @param  StreamHandle               Returns the section stream handle of the
+                                     file.
 
-  @retval EFI_SUCCESS                Successfully read the file section into
-                                     buffer.
-  @retval EFI_WARN_BUFFER_TOO_SMALL  Buffer too small.
-  @retval EFI_NOT_FOUND              Section not found.
+  @retval EFI_SUCCESS                The section stream of the file is open.
+  @retval EFI_UNSUPPORTED            The firmware volume is not produced by the
+                                     DXE core.
+  @retval EFI_NOT_FOUND              The file does not exist or has no sections.
   @retval EFI_DEVICE_ERROR           Device error.
   @retval EFI_ACCESS_DENIED          Could not read.
   @retval EFI_INVALID_PARAMETER      Invalid parameter.
 
 **/
 EFI_STATUS
-EFIAPI
-FvReadFileSection (
+FvOpenFileSectionStream (
   IN CONST  EFI_FIRMWARE_VOLUME2_PROTOCOL  *This,
   IN CONST  EFI_GUID                       *NameGuid,
-  IN        EFI_SECTION_TYPE               SectionType,
-  IN        UINTN                          SectionInstance,
-  IN OUT    VOID                           **Buffer,
-  IN OUT    UINTN                          *BufferSize,
-  OUT       UINT32                         *AuthenticationStatus
+  OUT       UINTN                          *StreamHandle
   )
 {
   EFI_STATUS                        Status;
@@ -450,11 +437,16 @@ FvReadFileSection (
   UINTN                             FileSize;
   UINT8                             *FileBuffer;
   FFS_FILE_LIST_ENTRY               *FfsEntry;
+  UINT32                            AuthenticationStatus;
 
-  if (NameGuid == NULL || Buffer == NULL) {
+  if (NameGuid == NULL || StreamHandle == NULL) {
     return EFI_INVALID_PARAMETER;
   }
 
+  if (This->ReadSection != FvReadFileSection) {
+    return EFI_UNSUPPORTED;
+  }
+
   FvDevice = FV_DEVICE_FROM_THIS (This);
 
   //
@@ -467,7 +459,7 @@ FvReadFileSection (
             &FileSize,
             &FileType,
             &FileAttributes,
-            AuthenticationStatus
+            &AuthenticationStatus
             );
   //
   // Get the last key used by our call to FvReadFile as it is the FfsEntry for this file.
@@ -486,8 +478,7 @@ FvReadFileSection (
   // Check to see that the file actually HAS sections before we go any further.
   //
   if (FileType == EFI_FV_FILETYPE_RAW) {
-    Status = EFI_NOT_FOUND;
-    goto Done;
+    return EFI_NOT_FOUND;
   }
 
   //
@@ -500,15 +491,76 @@ FvReadFileSection (
                &FfsEntry->StreamHandle
                );
     if (EFI_ERROR (Status)) {
-      goto Done;
+      return Status;
     }
   }
 
+  *StreamHandle = FfsEntry->StreamHandle;
+  return EFI_SUCCESS;
+}
+
+
+
+/**
+  Locates a section in a given FFS File and
+  copies it to the supplied buffer (not including section header).
+
+  @param  This                       Indicates the calling context.
+  @param  NameGuid                   Pointer to an EFI_GUID, which is the
+                                     filename.
+  @param  SectionType                Indicates the section type to return.
+  @param  SectionInstance            Indicates which instance of sections with a
+                                     type of SectionType to return.
+  @param  Buffer                     Buffer is a pointer to pointer to a buffer
+                                     in which the file or section contents or are
+                                     returned.
+  @param  BufferSize                 BufferSize is a pointer to caller allocated
+                                     UINTN.
+  @param  AuthenticationStatus       AuthenticationStatus is a pointer to a
+                                     caller allocated UINT32 in which the
+                                     authentication status is returned.
+
+  @retval EFI_SUCCESS                Successfully read the file section into
+                                     buffer.
+  @retval EFI_WARN_BUFFER_TOO_SMALL  Buffer too small.
+  @retval EFI_NOT_FOUND              Section not found.
+  @retval EFI_DEVICE_ERROR           Device error.
+  @retval EFI_ACCESS_DENIED          Could not read.
+  @retval EFI_INVALID_PARAMETER      Invalid parameter.
+
+**/
+EFI_STATUS
+EFIAPI
+FvReadFileSection (
+  IN CONST  EFI_FIRMWARE_VOLUME2_PROTOCOL  *This,
+  IN CONST  EFI_GUID                       *NameGuid,
+  IN        EFI_SECTION_TYPE               SectionType,
+  IN        UINTN                          SectionInstance,
+  IN OUT    VOID                           **Buffer,
+  IN OUT    UINTN                          *BufferSize,
+  OUT       UINT32                         *AuthenticationStatus
+  )
+{
+  EFI_STATUS                        Status;
+  FV_DEVICE                         *FvDevice;
+  UINTN                             StreamHandle;
+
+  if (NameGuid == NULL || Buffer == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  FvDevice = FV_DEVICE_FROM_THIS (This);
+
+  Status = FvOpenFileSectionStream (This, NameGuid, &StreamHandle);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
   //
   // If SectionType == 0 We need the whole section stream
   //
   Status = GetSection (
-             FfsEntry->StreamHandle,
+             StreamHandle,
              (SectionType == 0) ? NULL : &SectionType,
              NULL,
              (SectionType == 0) ? 0 : SectionInstance,
@@ -529,7 +581,6 @@ FvReadFileSection (
   // Close of stream defered to close of FfsHeader list to allow SEP to cache data
   //
 
-Done:
   return Status;
 }
 
@@ -42,6 +42,38 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #define NONEXCLUSIVE_MEMORY_ATTRIBUTES (EFI_MEMORY_XP | EFI_MEMORY_RP | \
                                         EFI_MEMORY_RO)
 
+#define GCD_MAP_ENTRY_FROM_INDEX_NODE(a) \
+  CR (a, EFI_GCD_MAP_ENTRY, IndexNode, EFI_GCD_MAP_SIGNATURE)
+
+/**
+  Compare the base addresses of two GCD map entries.
+
+  @param  Node1                  The index node of the first entry
+  @param  Node2                  The index node of the second entry
+
+  @retval <0                     The first entry starts below the second one.
+  @retval 0                      Both entries start at the same address.
+  @retval >0                     The first entry starts above the second one.
+
+**/
+STATIC
+INTN
+CompareGcdMapIndexNode (
+  IN CORE_RB_NODE        *Node1,
+  IN CORE_RB_NODE        *Node2
+  )
+{
+  EFI_GCD_MAP_ENTRY  *Entry1;
+  EFI_GCD_MAP_ENTRY  *Entry2;
+
+  Entry1 = GCD_MAP_ENTRY_FROM_INDEX_NODE (Node1);
+  Entry2 = GCD_MAP_ENTRY_FROM_INDEX_NODE (Node2);
+  if (Entry1->BaseAddress < Entry2->BaseAddress) {
+    return -1;
+  }
+  return (Entry1->BaseAddress > Entry2->BaseAddress) ? 1 : 0;
+}
+
 //
 // Module Variables
 //
@@ -50,6 +82,12 @@ EFI_LOCK           mGcdIoSpaceLock     = EFI_INITIALIZE_LOCK_VARIABLE (TPL_NOTIF
 LIST_ENTRY         mGcdMemorySpaceMap  = INITIALIZE_LIST_HEAD_VARIABLE (mGcdMemorySpaceMap);
 LIST_ENTRY         mGcdIoSpaceMap      = INITIALIZE_LIST_HEAD_VARIABLE (mGcdIoSpaceMap);
 
+//
+// Address ordered indexes of the entries of the GCD maps
+//
+CORE_RB_TREE       mGcdMemorySpaceIndex = { NULL, CompareGcdMapIndexNode, NULL };
+CORE_RB_TREE       mGcdIoSpaceIndex     = { NULL, CompareGcdMapIndexNode, NULL };
+
 EFI_GCD_MAP_ENTRY mGcdMemorySpaceMapEntryTemplate = {
   EFI_GCD_MAP_SIGNATURE,
   {
@@ -63,7 +101,13 @@ EFI_GCD_MAP_ENTRY mGcdMemorySpaceMapEntryTemplate = {
   EfiGcdMemoryTypeNonExistent,
   (EFI_GCD_IO_TYPE) 0,
   NULL,
-  NULL
+  NULL,
+  {
+    NULL,
+    NULL,
+    NULL,
+    FALSE
+  }
 };
 
 EFI_GCD_MAP_ENTRY mGcdIoSpaceMapEntryTemplate = {
@@ -79,7 +123,13 @@ EFI_GCD_MAP_ENTRY mGcdIoSpaceMapEntryTemplate = {
   (EFI_GCD_MEMORY_TYPE) 0,
   EfiGcdIoTypeNonExistent,
   NULL,
-  NULL
+  NULL,
+  {
+    NULL,
+    NULL,
+    NULL,
+    FALSE
+  }
 };
 
 GCD_ATTRIBUTE_CONVERSION_ENTRY mAttributeConversionTable[] = {
@@ -368,6 +418,63 @@ PageAlignLength (
 // GCD Memory Space Worker Functions
 //
 
+/**
+  Get the address ordered index of a GCD map.
+
+  @param  Map                    The GCD memory or I/O space map.
+
+  @return The index of Map.
+
+**/
+STATIC
+CORE_RB_TREE *
+CoreGetGcdMapIndex (
+  IN LIST_ENTRY  *Map
+  )
+{
+  if (Map == &mGcdMemorySpaceMap) {
+    return &mGcdMemorySpaceIndex;
+  }
+  ASSERT (Map == &mGcdIoSpaceMap);
+  return &mGcdIoSpaceIndex;
+}
+
+
+/**
+  Find the GCD map entry that covers an address.
+
+  @param  Address                The address to look up.
+  @param  Map                    The GCD memory or I/O space map.
+
+  @return The entry covering Address, or NULL.
+
+**/
+STATIC
+EFI_GCD_MAP_ENTRY *
+CoreLookupGcdMapEntry (
+  IN EFI_PHYSICAL_ADDRESS  Address,
+  IN LIST_ENTRY            *Map
+  )
+{
+  CORE_RB_NODE       *Node;
+  EFI_GCD_MAP_ENTRY  *Entry;
+
+  Node = CoreGetGcdMapIndex (Map)->Root;
+  while (Node != NULL) {
+    Entry = GCD_MAP_ENTRY_FROM_INDEX_NODE (Node);
+    if (Address < Entry->BaseAddress) {
+      Node = Node->Left;
+    } else if (Address > Entry->EndAddress) {
+      Node = Node->Right;
+    } else {
+      return Entry;
+    }
+  }
+
+  return NULL;
+}
+
+
 /**
   Allocate pool for two entries.
 
@@ -418,6 +525,7 @@ CoreAllocateGcdMapEntry (
   @param  Length                 The length of the new range in bytes
   @param  TopEntry               Top pad entry to insert if needed.
   @param  BottomEntry            Bottom pad entry to insert if needed.
+  @param  Map                    Boundary.
 
   @retval EFI_SUCCESS            The new range was inserted into the linked list
 
@@ -429,7 +537,8 @@ CoreInsertGcdMapEntry (
   IN EFI_PHYSICAL_ADDRESS  BaseAddress,
   IN UINT64                Length,
   IN EFI_GCD_MAP_ENTRY     *TopEntry,
-  IN EFI_GCD_MAP_ENTRY     *BottomEntry
+  IN EFI_GCD_MAP_ENTRY     *BottomEntry,
+  IN LIST_ENTRY            *Map
   )
 {
   ASSERT (Length != 0);
@@ -441,6 +550,7 @@ CoreInsertGcdMapEntry (
     Entry->BaseAddress      = BaseAddress;
     BottomEntry->EndAddress = BaseAddress - 1;
     InsertTailList (Link, &BottomEntry->Link);
+    CoreRbTreeInsert (CoreGetGcdMapIndex (Map), &BottomEntry->IndexNode);
   }
 
   if ((BaseAddress + Length - 1) < Entry->EndAddress) {
@@ -450,6 +560,7 @@ CoreInsertGcdMapEntry (
     TopEntry->BaseAddress = BaseAddress + Length;
     Entry->EndAddress     = BaseAddress + Length - 1;
     InsertHeadList (Link, &TopEntry->Link);
+    CoreRbTreeInsert (CoreGetGcdMapIndex (Map), &TopEntry->IndexNode);
   }
 
   return EFI_SUCCESS;
@@ -523,6 +634,7 @@ CoreMergeGcdMapEntry (
     Entry->BaseAddress = AdjacentEntry->BaseAddress;
   }
   RemoveEntryList (AdjacentLink);
+  CoreRbTreeRemove (CoreGetGcdMapIndex (Map), &AdjacentEntry->IndexNode);
   CoreFreePool (AdjacentEntry);
 
   return EFI_SUCCESS;
@@ -594,31 +706,27 @@ CoreSearchGcdMapEntry (
   IN  LIST_ENTRY            *Map
   )
 {
-  LIST_ENTRY         *Link;
-  EFI_GCD_MAP_ENTRY  *Entry;
+  EFI_GCD_MAP_ENTRY  *StartEntry;
+  EFI_GCD_MAP_ENTRY  *EndEntry;
 
   ASSERT (Length != 0);
 
   *StartLink = NULL;
   *EndLink   = NULL;
 
-  Link = Map->ForwardLink;
-  while (Link != Map) {
-    Entry = CR (Link, EFI_GCD_MAP_ENTRY, Link, EFI_GCD_MAP_SIGNATURE);
-    if (BaseAddress >= Entry->BaseAddress && BaseAddress <= Entry->EndAddress) {
-      *StartLink = Link;
-    }
-    if (*StartLink != NULL) {
-      if ((BaseAddress + Length - 1) >= Entry->BaseAddress &&
-          (BaseAddress + Length - 1) <= Entry->EndAddress     ) {
-        *EndLink = Link;
-        return EFI_SUCCESS;
-      }
-    }
-    Link = Link->ForwardLink;
+  StartEntry = CoreLookupGcdMapEntry (BaseAddress, Map);
+  if (StartEntry == NULL) {
+    return EFI_NOT_FOUND;
   }
 
-  return EFI_NOT_FOUND;
+  EndEntry = CoreLookupGcdMapEntry (BaseAddress + Length - 1, Map);
+  if (EndEntry == NULL || EndEntry->BaseAddress < StartEntry->BaseAddress) {
+    return EFI_NOT_FOUND;
+  }
+
+  *StartLink = &StartEntry->Link;
+  *EndLink   = &EndEntry->Link;
+  return EFI_SUCCESS;
 }
 
 
@@ -908,7 +1016,7 @@ CoreConvertSpace (
   Link = StartLink;
   while (Link != EndLink->ForwardLink) {
     Entry = CR (Link, EFI_GCD_MAP_ENTRY, Link, EFI_GCD_MAP_SIGNATURE);
-    CoreInsertGcdMapEntry (Link, Entry, BaseAddress, Length, TopEntry, BottomEntry);
+    CoreInsertGcdMapEntry (Link, Entry, BaseAddress, Length, TopEntry, BottomEntry, Map);
     switch (Operation) {
     //
     // Add operations
@@ -1270,7 +1378,7 @@ CoreAllocateSpace (
   Link = StartLink;
   while (Link != EndLink->ForwardLink) {
     Entry = CR (Link, EFI_GCD_MAP_ENTRY, Link, EFI_GCD_MAP_SIGNATURE);
-    CoreInsertGcdMapEntry (Link, Entry, *BaseAddress, Length, TopEntry, BottomEntry);
+    CoreInsertGcdMapEntry (Link, Entry, *BaseAddress, Length, TopEntry, BottomEntry, Map);
     Entry->ImageHandle  = ImageHandle;
     Entry->DeviceHandle = DeviceHandle;
     Link = Link->ForwardLink;
@@ -2432,6 +2540,7 @@ CoreInitializeGcdServices (
   Entry->EndAddress = LShiftU64 (1, SizeOfMemorySpace) - 1;
 
   InsertHeadList (&mGcdMemorySpaceMap, &Entry->Link);
+  CoreRbTreeInsert (&mGcdMemorySpaceIndex, &Entry->IndexNode);
 
   CoreDumpGcdMemorySpaceMap (TRUE);
 
@@ -2444,6 +2553,7 @@ CoreInitializeGcdServices (
   Entry->EndAddress = LShiftU64 (1, SizeOfIoSpace) - 1;
 
   InsertHeadList (&mGcdIoSpaceMap, &Entry->Link);
+  CoreRbTreeInsert (&mGcdIoSpaceIndex, &Entry->IndexNode);
 
   CoreDumpGcdIoSpaceMap (TRUE);
 
@@ -11,12 +11,15 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 
 
 //
-// mProtocolDatabase     - A list of all protocols in the system.  (simple list for now)
+// mProtocolDatabase     - A list of all protocols in the system, in creation order
+// mProtocolDatabaseHash - GUID hash index of mProtocolDatabase, used for lookups
 // gHandleList           - A list of all the handles in the system
 // gProtocolDatabaseLock - Lock to protect the mProtocolDatabase
 // gHandleDatabaseKey    -  The Key to show that the handle has been created/modified
 //
 LIST_ENTRY      mProtocolDatabase     = INITIALIZE_LIST_HEAD_VARIABLE (mProtocolDatabase);
+LIST_ENTRY      mProtocolDatabaseHash[PROTOCOL_DATABASE_HASH_SIZE];
+BOOLEAN         mProtocolDatabaseHashInitialized = FALSE;
 LIST_ENTRY      gHandleList           = INITIALIZE_LIST_HEAD_VARIABLE (gHandleList);
 EFI_LOCK        gProtocolDatabaseLock = EFI_INITIALIZE_LOCK_VARIABLE (TPL_NOTIFY);
 UINT64          gHandleDatabaseKey    = 0;
@@ -84,6 +87,36 @@ CoreValidateHandle (
 
 
 
+/**
+  Computes the mProtocolDatabaseHash bucket of a protocol GUID.
+
+  @param  Protocol               The ID of the protocol
+
+  @return The bucket list head of the protocol GUID
+
+**/
+LIST_ENTRY *
+CoreGetProtocolHashBucket (
+  IN EFI_GUID   *Protocol
+  )
+{
+  UINT32              *Data;
+  UINT32              Hash;
+
+  //
+  // GUIDs are already well distributed, folding the four DWORDs together
+  // is enough to spread them over the buckets.
+  //
+  Data = (UINT32 *) Protocol;
+  Hash = Data[0] ^ Data[1] ^ Data[2] ^ Data[3];
+  Hash ^= Hash >> 16;
+  Hash ^= Hash >> 8;
+
+  return &mProtocolDatabaseHash[Hash & (PROTOCOL_DATABASE_HASH_SIZE - 1)];
+}
+
+
+
 /**
   Finds the protocol entry for the requested protocol.
   The gProtocolDatabaseLock must be owned
@@ -100,22 +133,32 @@ CoreFindProtocolEntry (
   IN BOOLEAN    Create
   )
 {
+  LIST_ENTRY          *Bucket;
   LIST_ENTRY          *Link;
   PROTOCOL_ENTRY      *Item;
   PROTOCOL_ENTRY      *ProtEntry;
+  UINTN               Index;
 
   ASSERT_LOCKED(&gProtocolDatabaseLock);
 
+  if (!mProtocolDatabaseHashInitialized) {
+    for (Index = 0; Index < PROTOCOL_DATABASE_HASH_SIZE; Index++) {
+      InitializeListHead (&mProtocolDatabaseHash[Index]);
+    }
+    mProtocolDatabaseHashInitialized = TRUE;
+  }
+
   //
-  // Search the database for the matching GUID
+  // Search the hash bucket of the GUID for the matching entry
   //
 
   ProtEntry = NULL;
-  for (Link = mProtocolDatabase.ForwardLink;
-       Link != &mProtocolDatabase;
+  Bucket    = CoreGetProtocolHashBucket (Protocol);
+  for (Link = Bucket->ForwardLink;
+       Link != Bucket;
        Link = Link->ForwardLink) {
 
-    Item = CR(Link, PROTOCOL_ENTRY, AllEntries, PROTOCOL_ENTRY_SIGNATURE);
+    Item = CR(Link, PROTOCOL_ENTRY, HashLink, PROTOCOL_ENTRY_SIGNATURE);
     if (CompareGuid (&Item->ProtocolID, Protocol)) {
 
       //
@@ -141,12 +184,14 @@ CoreFindProtocolEntry (
       ProtEntry->Signature = PROTOCOL_ENTRY_SIGNATURE;
       CopyGuid ((VOID *)&ProtEntry->ProtocolID, Protocol);
       InitializeListHead (&ProtEntry->Protocols);
+      ProtEntry->InterfaceCount = 0;
       InitializeListHead (&ProtEntry->Notify);
 
       //
-      // Add it to protocol database
+      // Add it to protocol database and to the hash index
       //
       InsertTailList (&mProtocolDatabase, &ProtEntry->AllEntries);
+      InsertHeadList (Bucket, &ProtEntry->HashLink);
     }
   }
 
@@ -465,6 +510,12 @@ CoreInstallProtocolInterfaceNotify (
   // protocol entry
   //
   InsertTailList (&ProtEntry->Protocols, &Prot->ByProtocol);
+  ProtEntry->InterfaceCount++;
+
+  //
+  // Let the dispatcher evaluate the depex of the drivers waiting on this protocol
+  //
+  CoreWakeDepexWaiters (&ProtEntry->ProtocolID);
 
   //
   // Notify the notification list for this protocol
@@ -30,6 +30,12 @@ typedef struct {
 
 #define PROTOCOL_ENTRY_SIGNATURE        SIGNATURE_32('p','r','t','e')
 
+///
+/// Number of buckets in the GUID hash index of the protocol database.
+/// Must be a power of 2.
+///
+#define PROTOCOL_DATABASE_HASH_SIZE     128
+
 ///
 /// PROTOCOL_ENTRY - each different protocol has 1 entry in the protocol
 /// database.  Each handler that supports this protocol is listed, along
@@ -39,10 +45,14 @@ typedef struct {
   UINTN               Signature;
   /// Link Entry inserted to mProtocolDatabase
   LIST_ENTRY          AllEntries;
+  /// Link Entry inserted to the mProtocolDatabaseHash bucket of ProtocolID
+  LIST_ENTRY          HashLink;
   /// ID of the protocol
   EFI_GUID            ProtocolID;
   /// All protocol interfaces
   LIST_ENTRY          Protocols;
+  /// Number of entries in Protocols
+  UINTN               InterfaceCount;
   /// Registerd notification handlers
   LIST_ENTRY          Notify;
 } PROTOCOL_ENTRY;
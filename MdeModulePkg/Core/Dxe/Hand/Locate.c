@@ -645,6 +645,7 @@ CoreLocateHandleBuffer (
 {
   EFI_STATUS          Status;
   UINTN               BufferSize;
+  PROTOCOL_ENTRY      *ProtEntry;
 
   if (NumberHandles == NULL) {
     return EFI_INVALID_PARAMETER;
@@ -657,24 +658,43 @@ CoreLocateHandleBuffer (
   BufferSize = 0;
   *NumberHandles = 0;
   *Buffer = NULL;
-  Status = CoreLocateHandle (
-             SearchType,
-             Protocol,
-             SearchKey,
-             &BufferSize,
-             *Buffer
-             );
-  //
-  // LocateHandleBuffer() returns incorrect status code if SearchType is
-  // invalid.
-  //
-  // Add code to correctly handle expected errors from CoreLocateHandle().
-  //
-  if (EFI_ERROR(Status) && Status != EFI_BUFFER_TOO_SMALL) {
-    if (Status != EFI_INVALID_PARAMETER) {
-      Status = EFI_NOT_FOUND;
+
+  if ((SearchType == ByProtocol) && (Protocol != NULL)) {
+    //
+    // A handle holds at most one interface of a given protocol, so the
+    // interface count of the protocol entry is the number of matching
+    // handles. This avoids walking the handles twice.
+    //
+    CoreAcquireProtocolLock ();
+    ProtEntry = CoreFindProtocolEntry (Protocol, FALSE);
+    if (ProtEntry != NULL) {
+      BufferSize = ProtEntry->InterfaceCount * sizeof (EFI_HANDLE);
+    }
+    CoreReleaseProtocolLock ();
+
+    if (BufferSize == 0) {
+      return EFI_NOT_FOUND;
+    }
+  } else {
+    Status = CoreLocateHandle (
+               SearchType,
+               Protocol,
+               SearchKey,
+               &BufferSize,
+               *Buffer
+               );
+    //
+    // LocateHandleBuffer() returns incorrect status code if SearchType is
+    // invalid.
+    //
+    // Add code to correctly handle expected errors from CoreLocateHandle().
+    //
+    if (EFI_ERROR(Status) && Status != EFI_BUFFER_TOO_SMALL) {
+      if (Status != EFI_INVALID_PARAMETER) {
+        Status = EFI_NOT_FOUND;
+      }
+      return Status;
     }
-    return Status;
   }
 
   *Buffer = AllocatePool (BufferSize);
@@ -0,0 +1,451 @@
+/** @file
+  Intrusive red-black tree used to index the DXE core maps.
+
+  The tree nodes are embedded in the indexed structures, so that the memory
+  map and the GCD maps can be indexed with their locks held and before pool
+  is available, where no node could be allocated. A tree may cache data
+  computed from the subtree of each node; the update callback is invoked
+  whenever the children of a node change.
+
+Copyright (c) 2019, Intel Corporation. All rights reserved.<BR>
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include "DxeMain.h"
+
+/**
+  Refresh the data a tree caches in a node.
+
+  @param  Tree                   The tree the node belongs to
+  @param  Node                   The node to update
+
+**/
+STATIC
+VOID
+CoreRbTreeUpdateNode (
+  IN     CORE_RB_TREE    *Tree,
+  IN OUT CORE_RB_NODE    *Node
+  )
+{
+  if (Tree->Update != NULL) {
+    Tree->Update (Node);
+  }
+}
+
+/**
+  Refresh the data a tree caches from a node up to the root.
+
+  @param  Tree                   The tree the node belongs to
+  @param  Node                   The lowest node to update, may be NULL
+
+**/
+STATIC
+VOID
+CoreRbTreeUpdatePath (
+  IN     CORE_RB_TREE    *Tree,
+  IN OUT CORE_RB_NODE    *Node
+  )
+{
+  if (Tree->Update == NULL) {
+    return;
+  }
+  while (Node != NULL) {
+    Tree->Update (Node);
+    Node = Node->Parent;
+  }
+}
+
+/**
+  Make a node take the place of another one under the parent of the latter.
+
+  @param  Tree                   The tree the nodes belong to
+  @param  Node                   The node being replaced
+  @param  Replacement            The node taking its place, may be NULL
+
+**/
+STATIC
+VOID
+CoreRbTreeReplaceChild (
+  IN OUT CORE_RB_TREE    *Tree,
+  IN     CORE_RB_NODE    *Node,
+  IN     CORE_RB_NODE    *Replacement
+  )
+{
+  if (Node->Parent == NULL) {
+    Tree->Root = Replacement;
+  } else if (Node->Parent->Left == Node) {
+    Node->Parent->Left = Replacement;
+  } else {
+    Node->Parent->Right = Replacement;
+  }
+  if (Replacement != NULL) {
+    Replacement->Parent = Node->Parent;
+  }
+}
+
+/**
+  Rotate a node to the left.
+
+  @param  Tree                   The tree the node belongs to
+  @param  Node                   The node whose right child moves up
+
+**/
+STATIC
+VOID
+CoreRbTreeRotateLeft (
+  IN OUT CORE_RB_TREE    *Tree,
+  IN OUT CORE_RB_NODE    *Node
+  )
+{
+  CORE_RB_NODE  *Child;
+
+  Child = Node->Right;
+  Node->Right = Child->Left;
+  if (Child->Left != NULL) {
+    Child->Left->Parent = Node;
+  }
+  CoreRbTreeReplaceChild (Tree, Node, Child);
+  Child->Left  = Node;
+  Node->Parent = Child;
+
+  CoreRbTreeUpdateNode (Tree, Node);
+  CoreRbTreeUpdateNode (Tree, Child);
+}
+
+/**
+  Rotate a node to the right.
+
+  @param  Tree                   The tree the node belongs to
+  @param  Node                   The node whose left child moves up
+
+**/
+STATIC
+VOID
+CoreRbTreeRotateRight (
+  IN OUT CORE_RB_TREE    *Tree,
+  IN OUT CORE_RB_NODE    *Node
+  )
+{
+  CORE_RB_NODE  *Child;
+
+  Child = Node->Left;
+  Node->Left = Child->Right;
+  if (Child->Right != NULL) {
+    Child->Right->Parent = Node;
+  }
+  CoreRbTreeReplaceChild (Tree, Node, Child);
+  Child->Right = Node;
+  Node->Parent = Child;
+
+  CoreRbTreeUpdateNode (Tree, Node);
+  CoreRbTreeUpdateNode (Tree, Child);
+}
+
+/**
+  Check whether a node is red. Missing nodes are black.
+
+  @param  Node                   The node to check, may be NULL
+
+  @retval TRUE                   The node is red.
+  @retval FALSE                  The node is black.
+
+**/
+STATIC
+BOOLEAN
+CoreRbTreeIsRed (
+  IN CORE_RB_NODE        *Node
+  )
+{
+  return (BOOLEAN) (Node != NULL && Node->Red);
+}
+
+/**
+  Add a node to a tree. Nodes that compare equal are kept in insertion order.
+
+  @param  Tree                   The tree to add the node to
+  @param  Node                   The node to add
+
+**/
+VOID
+CoreRbTreeInsert (
+  IN OUT CORE_RB_TREE    *Tree,
+  IN OUT CORE_RB_NODE    *Node
+  )
+{
+  CORE_RB_NODE  *Parent;
+  CORE_RB_NODE  *Current;
+  CORE_RB_NODE  *Grandparent;
+  CORE_RB_NODE  *Uncle;
+  BOOLEAN       Left;
+
+  Node->Left  = NULL;
+  Node->Right = NULL;
+  Node->Red   = TRUE;
+
+  Parent  = NULL;
+  Current = Tree->Root;
+  Left    = FALSE;
+  while (Current != NULL) {
+    Parent  = Current;
+    Left    = (BOOLEAN) (Tree->Compare (Node, Current) < 0);
+    Current = Left ? Current->Left : Current->Right;
+  }
+
+  Node->Parent = Parent;
+  if (Parent == NULL) {
+    Tree->Root = Node;
+  } else if (Left) {
+    Parent->Left = Node;
+  } else {
+    Parent->Right = Node;
+  }
+  CoreRbTreeUpdatePath (Tree, Node);
+
+  //
+  // Restore the red-black properties
+  //
+  Current = Node;
+  while (CoreRbTreeIsRed (Current->Parent)) {
+    Parent      = Current->Parent;
+    Grandparent = Parent->Parent;
+    if (Parent == Grandparent->Left) {
+      Uncle = Grandparent->Right;
+      if (CoreRbTreeIsRed (Uncle)) {
+        Parent->Red      = FALSE;
+        Uncle->Red       = FALSE;
+        Grandparent->Red = TRUE;
+        Current = Grandparent;
+        continue;
+      }
+      if (Current == Parent->Right) {
+        CoreRbTreeRotateLeft (Tree, Parent);
+        Current = Parent;
+        Parent  = Current->Parent;
+      }
+      Parent->Red      = FALSE;
+      Grandparent->Red = TRUE;
+      CoreRbTreeRotateRight (Tree, Grandparent);
+    } else {
+      Uncle = Grandparent->Left;
+      if (CoreRbTreeIsRed (Uncle)) {
+        Parent->Red      = FALSE;
+        Uncle->Red       = FALSE;
+        Grandparent->Red = TRUE;
+        Current = Grandparent;
+        continue;
+      }
+      if (Current == Parent->Left) {
+        CoreRbTreeRotateRight (Tree, Parent);
+        Current = Parent;
+        Parent  = Current->Parent;
+      }
+      Parent->Red      = FALSE;
+      Grandparent->Red = TRUE;
+      CoreRbTreeRotateLeft (Tree, Grandparent);
+    }
+  }
+  Tree->Root->Red = FALSE;
+}
+
+/**
+  Remove a node from a tree.
+
+  @param  Tree                   The tree to remove the node from
+  @param  Node                   The node to remove
+
+**/
+VOID
+CoreRbTreeRemove (
+  IN OUT CORE_RB_TREE    *Tree,
+  IN OUT CORE_RB_NODE    *Node
+  )
+{
+  CORE_RB_NODE  *Spliced;
+  CORE_RB_NODE  *Child;
+  CORE_RB_NODE  *Parent;
+  CORE_RB_NODE  *Sibling;
+  BOOLEAN       SplicedRed;
+
+  //
+  // Splice out the node itself, or its successor if it has two children
+  //
+  Spliced = Node;
+  if (Node->Left != NULL && Node->Right != NULL) {
+    Spliced = Node->Right;
+    while (Spliced->Left != NULL) {
+      Spliced = Spliced->Left;
+    }
+  }
+
+  Child      = (Spliced->Left != NULL) ? Spliced->Left : Spliced->Right;
+  Parent     = Spliced->Parent;
+  SplicedRed = Spliced->Red;
+  CoreRbTreeReplaceChild (Tree, Spliced, Child);
+
+  if (Spliced != Node) {
+    //
+    // The successor takes the place of the node
+    //
+    if (Parent == Node) {
+      Parent = Spliced;
+    }
+    Spliced->Left  = Node->Left;
+    Spliced->Right = Node->Right;
+    Spliced->Red   = Node->Red;
+    if (Spliced->Left != NULL) {
+      Spliced->Left->Parent = Spliced;
+    }
+    if (Spliced->Right != NULL) {
+      Spliced->Right->Parent = Spliced;
+    }
+    CoreRbTreeReplaceChild (Tree, Node, Spliced);
+  }
+  CoreRbTreeUpdatePath (Tree, Parent);
+
+  Node->Parent = NULL;
+  Node->Left   = NULL;
+  Node->Right  = NULL;
+
+  if (SplicedRed) {
+    return;
+  }
+
+  //
+  // Restore the red-black properties
+  //
+  while (Child != Tree->Root && !CoreRbTreeIsRed (Child)) {
+    if (Child == Parent->Left) {
+      Sibling = Parent->Right;
+      if (CoreRbTreeIsRed (Sibling)) {
+        Sibling->Red = FALSE;
+        Parent->Red  = TRUE;
+        CoreRbTreeRotateLeft (Tree, Parent);
+        Sibling = Parent->Right;
+      }
+      if (!CoreRbTreeIsRed (Sibling->Left) && !CoreRbTreeIsRed (Sibling->Right)) {
+        Sibling->Red = TRUE;
+        Child  = Parent;
+        Parent = Child->Parent;
+        continue;
+      }
+      if (!CoreRbTreeIsRed (Sibling->Right)) {
+        Sibling->Left->Red = FALSE;
+        Sibling->Red       = TRUE;
+        CoreRbTreeRotateRight (Tree, Sibling);
+        Sibling = Parent->Right;
+      }
+      Sibling->Red        = Parent->Red;
+      Parent->Red         = FALSE;
+      Sibling->Right->Red = FALSE;
+      CoreRbTreeRotateLeft (Tree, Parent);
+    } else {
+      Sibling = Parent->Left;
+      if (CoreRbTreeIsRed (Sibling)) {
+        Sibling->Red = FALSE;
+        Parent->Red  = TRUE;
+        CoreRbTreeRotateRight (Tree, Parent);
+        Sibling = Parent->Left;
+      }
+      if (!CoreRbTreeIsRed (Sibling->Left) && !CoreRbTreeIsRed (Sibling->Right)) {
+        Sibling->Red = TRUE;
+        Child  = Parent;
+        Parent = Child->Parent;
+        continue;
+      }
+      if (!CoreRbTreeIsRed (Sibling->Left)) {
+        Sibling->Right->Red = FALSE;
+        Sibling->Red        = TRUE;
+        CoreRbTreeRotateLeft (Tree, Sibling);
+        Sibling = Parent->Left;
+      }
+      Sibling->Red       = Parent->Red;
+      Parent->Red        = FALSE;
+      Sibling->Left->Red = FALSE;
+      CoreRbTreeRotateRight (Tree, Parent);
+    }
+    Child = Tree->Root;
+  }
+  if (Child != NULL) {
+    Child->Red = FALSE;
+  }
+}
+
+/**
+  Refresh the data a tree caches after a node changed in place. The change
+  must not move the node relative to its neighbours.
+
+  @param  Tree                   The tree the node belongs to
+  @param  Node                   The node that changed
+
+**/
+VOID
+CoreRbTreeUpdate (
+  IN     CORE_RB_TREE    *Tree,
+  IN OUT CORE_RB_NODE    *Node
+  )
+{
+  CoreRbTreeUpdatePath (Tree, Node);
+}
+
+/**
+  Make a copy of a node take its place in a tree.
+
+  @param  Tree                   The tree the node belongs to
+  @param  Node                   The node in the tree
+  @param  Replacement            The copy of Node that replaces it
+
+**/
+VOID
+CoreRbTreeReplace (
+  IN OUT CORE_RB_TREE    *Tree,
+  IN OUT CORE_RB_NODE    *Node,
+  IN OUT CORE_RB_NODE    *Replacement
+  )
+{
+  Replacement->Left  = Node->Left;
+  Replacement->Right = Node->Right;
+  Replacement->Red   = Node->Red;
+
+  CoreRbTreeReplaceChild (Tree, Node, Replacement);
+  if (Replacement->Left != NULL) {
+    Replacement->Left->Parent = Replacement;
+  }
+  if (Replacement->Right != NULL) {
+    Replacement->Right->Parent = Replacement;
+  }
+
+  Node->Parent = NULL;
+  Node->Left   = NULL;
+  Node->Right  = NULL;
+}
+
+/**
+  Get the node that follows a node in tree order.
+
+  @param  Node                   The current node
+
+  @return The next node, or NULL if Node is the last one
+
+**/
+CORE_RB_NODE *
+CoreRbTreeNext (
+  IN CORE_RB_NODE        *Node
+  )
+{
+  CORE_RB_NODE  *Next;
+
+  if (Node->Right != NULL) {
+    Next = Node->Right;
+    while (Next->Left != NULL) {
+      Next = Next->Left;
+    }
+    return Next;
+  }
+
+  while (Node->Parent != NULL && Node == Node->Parent->Right) {
+    Node = Node->Parent;
+  }
+
+  return Node->Parent;
+}
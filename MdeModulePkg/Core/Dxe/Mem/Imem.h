@@ -41,8 +41,20 @@ typedef struct {
 
   UINT64          VirtualStart;
   UINT64          Attribute;
+
+  ///
+  /// Node of the address ordered index of the memory map
+  ///
+  CORE_RB_NODE    IndexNode;
+  ///
+  /// Size in bytes of the largest EfiConventionalMemory entry of the subtree
+  ///
+  UINT64          MaxFreeBytes;
 } MEMORY_MAP;
 
+#define MEMORY_MAP_FROM_INDEX_NODE(a) \
+  CR (a, MEMORY_MAP, IndexNode, MEMORY_MAP_SIGNATURE)
+
 //
 // Internal prototypes
 //
@@ -172,11 +184,116 @@ CoreInternalAllocatePages (
   IN BOOLEAN                NeedGuard
   );
 
+/**
+  Get the number of pool slab statistics records.
+
+  @return The number of pool bins and memory types that slabs were used for.
+
+**/
+UINTN
+CoreGetPoolSlabInfoCount (
+  VOID
+  );
+
+/**
+  Copy the pool slab statistics into memory profile records.
+
+  @param  SlabInfo               The buffer to hold the records.
+  @param  MaxCount               The number of records SlabInfo can hold.
+
+  @return The number of records copied.
+
+**/
+UINTN
+CoreCopyPoolSlabInfo (
+  OUT MEMORY_PROFILE_POOL_SLAB_INFO   *SlabInfo,
+  IN  UINTN                           MaxCount
+  );
+
+/**
+  Add a memory map entry to the address ordered index.
+  Caller must have the memory lock held
+
+  @param  Entry                  The entry to add
+
+**/
+VOID
+CoreInsertMemoryMapIndex (
+  IN OUT MEMORY_MAP      *Entry
+  );
+
+/**
+  Remove a memory map entry from the address ordered index.
+  Caller must have the memory lock held
+
+  @param  Entry                  The entry to remove
+
+**/
+VOID
+CoreRemoveMemoryMapIndex (
+  IN OUT MEMORY_MAP      *Entry
+  );
+
+/**
+  Refresh the index after the range of a memory map entry was clipped.
+  Caller must have the memory lock held
+
+  @param  Entry                  The entry whose Start or End was changed
+
+**/
+VOID
+CoreUpdateMemoryMapIndex (
+  IN OUT MEMORY_MAP      *Entry
+  );
+
+/**
+  Make a copy of a memory map entry take its place in the index.
+  Caller must have the memory lock held
+
+  @param  From                   The entry in the index
+  @param  To                     The copy of From that replaces it
+
+**/
+VOID
+CoreMoveMemoryMapIndex (
+  IN     MEMORY_MAP      *From,
+  IN OUT MEMORY_MAP      *To
+  );
+
+/**
+  Find the memory map entry that covers an address.
+  Caller must have the memory lock held
+
+  @param  Address                The address to look up
+
+  @return The entry covering Address, or NULL
+
+**/
+MEMORY_MAP *
+CoreLookupMemoryMapIndex (
+  IN UINT64              Address
+  );
+
+/**
+  Get the memory map entry that follows an entry in address order.
+  Caller must have the memory lock held
+
+  @param  Entry                  The current entry
+
+  @return The next entry, or NULL if Entry is the last one
+
+**/
+MEMORY_MAP *
+CoreGetNextMemoryMapIndex (
+  IN MEMORY_MAP          *Entry
+  );
+
 //
 // Internal Global data
 //
 
 extern EFI_LOCK           gMemoryLock;
 extern LIST_ENTRY         gMemoryMap;
+extern CORE_RB_TREE       gMemoryMapIndex;
 extern LIST_ENTRY         mGcdMemorySpaceMap;
 #endif
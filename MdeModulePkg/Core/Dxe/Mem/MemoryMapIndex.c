@@ -0,0 +1,213 @@
+/** @file
+  Address ordered index of the UEFI memory map.
+
+  Every entry of gMemoryMap is also a node of a red-black tree ordered by
+  start address, so that the entry covering an address and the neighbours of
+  an entry are found without walking the whole map. Each node also caches the
+  size of the largest EfiConventionalMemory entry of its subtree, which lets
+  the page allocator skip every part of the map that is too fragmented to
+  satisfy a request.
+
+Copyright (c) 2019, Intel Corporation. All rights reserved.<BR>
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include "DxeMain.h"
+#include "Imem.h"
+
+/**
+  Compare the start addresses of two memory map entries.
+
+  @param  Node1                  The index node of the first entry
+  @param  Node2                  The index node of the second entry
+
+  @retval <0                     The first entry starts below the second one.
+  @retval 0                      Both entries start at the same address.
+  @retval >0                     The first entry starts above the second one.
+
+**/
+STATIC
+INTN
+CompareMemoryMapIndexNode (
+  IN CORE_RB_NODE        *Node1,
+  IN CORE_RB_NODE        *Node2
+  )
+{
+  MEMORY_MAP  *Entry1;
+  MEMORY_MAP  *Entry2;
+
+  Entry1 = MEMORY_MAP_FROM_INDEX_NODE (Node1);
+  Entry2 = MEMORY_MAP_FROM_INDEX_NODE (Node2);
+  if (Entry1->Start < Entry2->Start) {
+    return -1;
+  }
+  return (Entry1->Start > Entry2->Start) ? 1 : 0;
+}
+
+/**
+  Recompute the largest free entry size of an index node from its children.
+
+  @param  Node                   The index node to update
+
+**/
+STATIC
+VOID
+UpdateMemoryMapIndexNode (
+  IN OUT CORE_RB_NODE    *Node
+  )
+{
+  MEMORY_MAP  *Entry;
+  MEMORY_MAP  *Child;
+  UINT64      MaxFreeBytes;
+
+  Entry = MEMORY_MAP_FROM_INDEX_NODE (Node);
+  MaxFreeBytes = 0;
+  if (Entry->Type == EfiConventionalMemory && Entry->End >= Entry->Start) {
+    MaxFreeBytes = Entry->End - Entry->Start + 1;
+  }
+  if (Node->Left != NULL) {
+    Child = MEMORY_MAP_FROM_INDEX_NODE (Node->Left);
+    if (Child->MaxFreeBytes > MaxFreeBytes) {
+      MaxFreeBytes = Child->MaxFreeBytes;
+    }
+  }
+  if (Node->Right != NULL) {
+    Child = MEMORY_MAP_FROM_INDEX_NODE (Node->Right);
+    if (Child->MaxFreeBytes > MaxFreeBytes) {
+      MaxFreeBytes = Child->MaxFreeBytes;
+    }
+  }
+  Entry->MaxFreeBytes = MaxFreeBytes;
+}
+
+//
+// Address ordered index of the memory map
+//
+CORE_RB_TREE  gMemoryMapIndex = {
+  NULL,
+  CompareMemoryMapIndexNode,
+  UpdateMemoryMapIndexNode
+};
+
+/**
+  Add a memory map entry to the address ordered index.
+  Caller must have the memory lock held
+
+  @param  Entry                  The entry to add
+
+**/
+VOID
+CoreInsertMemoryMapIndex (
+  IN OUT MEMORY_MAP      *Entry
+  )
+{
+  CoreRbTreeInsert (&gMemoryMapIndex, &Entry->IndexNode);
+}
+
+/**
+  Remove a memory map entry from the address ordered index.
+  Caller must have the memory lock held
+
+  @param  Entry                  The entry to remove
+
+**/
+VOID
+CoreRemoveMemoryMapIndex (
+  IN OUT MEMORY_MAP      *Entry
+  )
+{
+  CoreRbTreeRemove (&gMemoryMapIndex, &Entry->IndexNode);
+}
+
+/**
+  Refresh the index after the range of a memory map entry was clipped.
+  Caller must have the memory lock held
+
+  @param  Entry                  The entry whose Start or End was changed
+
+**/
+VOID
+CoreUpdateMemoryMapIndex (
+  IN OUT MEMORY_MAP      *Entry
+  )
+{
+  //
+  // Clipping keeps the entry between its neighbours, so only the cached
+  // free sizes need to be refreshed.
+  //
+  CoreRbTreeUpdate (&gMemoryMapIndex, &Entry->IndexNode);
+}
+
+/**
+  Make a copy of a memory map entry take its place in the index.
+  Caller must have the memory lock held
+
+  @param  From                   The entry in the index
+  @param  To                     The copy of From that replaces it
+
+**/
+VOID
+CoreMoveMemoryMapIndex (
+  IN     MEMORY_MAP      *From,
+  IN OUT MEMORY_MAP      *To
+  )
+{
+  CoreRbTreeReplace (&gMemoryMapIndex, &From->IndexNode, &To->IndexNode);
+}
+
+/**
+  Find the memory map entry that covers an address.
+  Caller must have the memory lock held
+
+  @param  Address                The address to look up
+
+  @return The entry covering Address, or NULL
+
+**/
+MEMORY_MAP *
+CoreLookupMemoryMapIndex (
+  IN UINT64              Address
+  )
+{
+  CORE_RB_NODE  *Node;
+  MEMORY_MAP    *Entry;
+
+  Node = gMemoryMapIndex.Root;
+  while (Node != NULL) {
+    Entry = MEMORY_MAP_FROM_INDEX_NODE (Node);
+    if (Address < Entry->Start) {
+      Node = Node->Left;
+    } else if (Address >= Entry->End) {
+      Node = Node->Right;
+    } else {
+      return Entry;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+  Get the memory map entry that follows an entry in address order.
+  Caller must have the memory lock held
+
+  @param  Entry                  The current entry
+
+  @return The next entry, or NULL if Entry is the last one
+
+**/
+MEMORY_MAP *
+CoreGetNextMemoryMapIndex (
+  IN MEMORY_MAP          *Entry
+  )
+{
+  CORE_RB_NODE  *Node;
+
+  Node = CoreRbTreeNext (&Entry->IndexNode);
+  if (Node == NULL) {
+    return NULL;
+  }
+
+  return MEMORY_MAP_FROM_INDEX_NODE (Node);
+}
@@ -1455,6 +1455,8 @@ MemoryProfileGetDataSize (
     }
   }
 
+  TotalSize += CoreGetPoolSlabInfoCount () * sizeof (MEMORY_PROFILE_POOL_SLAB_INFO);
+
   return TotalSize;
 }
 
@@ -1462,11 +1464,14 @@ MemoryProfileGetDataSize (
   Copy memory profile data.
 
   @param ProfileBuffer  The buffer to hold memory profile data.
+  @param ProfileSize    The size of ProfileBuffer, as returned by
+                        MemoryProfileGetDataSize().
 
 **/
 VOID
 MemoryProfileCopyData (
-  IN VOID   *ProfileBuffer
+  IN VOID   *ProfileBuffer,
+  IN UINTN  ProfileSize
   )
 {
   MEMORY_PROFILE_CONTEXT            *Context;
@@ -1528,6 +1533,14 @@ MemoryProfileCopyData (
 
     DriverInfo = (MEMORY_PROFILE_DRIVER_INFO *)  AllocInfo;
   }
+
+  //
+  // The pool slab statistics fill the rest of the buffer
+  //
+  CoreCopyPoolSlabInfo (
+    (MEMORY_PROFILE_POOL_SLAB_INFO *) DriverInfo,
+    ((UINTN) ProfileBuffer + ProfileSize - (UINTN) DriverInfo) / sizeof (MEMORY_PROFILE_POOL_SLAB_INFO)
+    );
 }
 
 /**
@@ -1573,7 +1586,7 @@ ProfileProtocolGetData (
   }
 
   *ProfileSize = Size;
-  MemoryProfileCopyData (ProfileBuffer);
+  MemoryProfileCopyData (ProfileBuffer, Size);
 
   mMemoryProfileGettingStatus = MemoryProfileGettingStatus;
   return EFI_SUCCESS;
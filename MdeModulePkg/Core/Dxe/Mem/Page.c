@@ -134,6 +134,7 @@ RemoveMemoryMapEntry (
 {
   RemoveEntryList (&Entry->Link);
   Entry->Link.ForwardLink = NULL;
+  CoreRemoveMemoryMapIndex (Entry);
 
   if (Entry->FromPages) {
     //
@@ -163,7 +164,6 @@ CoreAddRange (
   IN UINT64                   Attribute
   )
 {
-  LIST_ENTRY        *Link;
   MEMORY_MAP        *Entry;
 
   ASSERT ((Start & EFI_PAGE_MASK) == 0);
@@ -209,28 +209,25 @@ CoreAddRange (
   //
 
   // Two memory descriptors can only be merged if they have the same Type
-  // and the same Attribute
+  // and the same Attribute. The range does not overlap any descriptor, so
+  // only the descriptors covering the pages right below and right above it
+  // can be adjoining.
   //
 
-  Link = gMemoryMap.ForwardLink;
-  while (Link != &gMemoryMap) {
-    Entry = CR (Link, MEMORY_MAP, Link, MEMORY_MAP_SIGNATURE);
-    Link  = Link->ForwardLink;
-
-    if (Entry->Type != Type) {
-      continue;
-    }
-
-    if (Entry->Attribute != Attribute) {
-      continue;
-    }
-
-    if (Entry->End + 1 == Start) {
+  if (Start >= EFI_PAGE_SIZE) {
+    Entry = CoreLookupMemoryMapIndex (Start - EFI_PAGE_SIZE);
+    if (Entry != NULL && Entry->Type == Type && Entry->Attribute == Attribute &&
+        Entry->End + 1 == Start) {
 
       Start = Entry->Start;
       RemoveMemoryMapEntry (Entry);
+    }
+  }
 
-    } else if (Entry->Start == End + 1) {
+  if (End < MAX_UINT64) {
+    Entry = CoreLookupMemoryMapIndex (End + 1);
+    if (Entry != NULL && Entry->Type == Type && Entry->Attribute == Attribute &&
+        Entry->Start == End + 1) {
 
       End = Entry->End;
       RemoveMemoryMapEntry (Entry);
@@ -249,6 +246,7 @@ CoreAddRange (
   mMapStack[mMapDepth].VirtualStart  = 0;
   mMapStack[mMapDepth].Attribute     = Attribute;
   InsertTailList (&gMemoryMap, &mMapStack[mMapDepth].Link);
+  CoreInsertMemoryMapIndex (&mMapStack[mMapDepth]);
 
   mMapDepth += 1;
   ASSERT (mMapDepth < MAX_MAP_DEPTH);
@@ -322,7 +320,6 @@ CoreFreeMemoryMapStack (
 {
   MEMORY_MAP      *Entry;
   MEMORY_MAP      *Entry2;
-  LIST_ENTRY      *Link2;
 
   ASSERT_LOCKED (&gMemoryLock);
 
@@ -361,18 +358,17 @@ CoreFreeMemoryMapStack (
 
       CopyMem (Entry , &mMapStack[mMapDepth], sizeof (MEMORY_MAP));
       Entry->FromPages = TRUE;
+      CoreMoveMemoryMapIndex (&mMapStack[mMapDepth], Entry);
 
       //
-      // Find insertion location
+      // Find insertion location, the entries from pages are kept sorted
       //
-      for (Link2 = gMemoryMap.ForwardLink; Link2 != &gMemoryMap; Link2 = Link2->ForwardLink) {
-        Entry2 = CR (Link2, MEMORY_MAP, Link, MEMORY_MAP_SIGNATURE);
-        if (Entry2->FromPages && Entry2->Start > Entry->Start) {
-          break;
-        }
+      Entry2 = CoreGetNextMemoryMapIndex (Entry);
+      while (Entry2 != NULL && !Entry2->FromPages) {
+        Entry2 = CoreGetNextMemoryMapIndex (Entry2);
       }
 
-      InsertTailList (Link2, &Entry->Link);
+      InsertTailList ((Entry2 != NULL) ? &Entry2->Link : &gMemoryMap, &Entry->Link);
 
     } else {
       //
@@ -736,7 +732,6 @@ CoreConvertPagesEx (
   UINT64          RangeEnd;
   UINT64          Attribute;
   EFI_MEMORY_TYPE MemType;
-  LIST_ENTRY      *Link;
   MEMORY_MAP      *Entry;
 
   Entry = NULL;
@@ -762,15 +757,9 @@ CoreConvertPagesEx (
     //
     // Find the entry that the covers the range
     //
-    for (Link = gMemoryMap.ForwardLink; Link != &gMemoryMap; Link = Link->ForwardLink) {
-      Entry = CR (Link, MEMORY_MAP, Link, MEMORY_MAP_SIGNATURE);
+    Entry = CoreLookupMemoryMapIndex (Start);
 
-      if (Entry->Start <= Start && Entry->End > Start) {
-        break;
-      }
-    }
-
-    if (Link == &gMemoryMap) {
+    if (Entry == NULL) {
       DEBUG ((DEBUG_ERROR | DEBUG_PAGE, "ConvertPages: failed to find range %lx - %lx\n", Start, End));
       return EFI_NOT_FOUND;
     }
@@ -852,6 +841,7 @@ CoreConvertPagesEx (
       // Clip start
       //
       Entry->Start = RangeEnd + 1;
+      CoreUpdateMemoryMapIndex (Entry);
 
     } else if (Entry->End == RangeEnd) {
 
@@ -859,6 +849,7 @@ CoreConvertPagesEx (
       // Clip end
       //
       Entry->End = Start - 1;
+      CoreUpdateMemoryMapIndex (Entry);
 
     } else {
 
@@ -882,9 +873,11 @@ CoreConvertPagesEx (
 
       Entry->End = Start - 1;
       ASSERT (Entry->Start < Entry->End);
+      CoreUpdateMemoryMapIndex (Entry);
 
       Entry = &mMapStack[mMapDepth];
       InsertTailList (&gMemoryMap, &Entry->Link);
+      CoreInsertMemoryMapIndex (Entry);
 
       mMapDepth += 1;
       ASSERT (mMapDepth < MAX_MAP_DEPTH);
@@ -1008,6 +1001,125 @@ CoreUpdateMemoryAttributes (
 }
 
 
+/**
+  Internal function. Finds the highest free page range below the requested
+  address in a subtree of the memory map index.
+
+  Subtrees without a large enough EfiConventionalMemory entry, and subtrees
+  entirely outside of [MinAddress, MaxAddress], are skipped.
+
+  @param  Node                   The root of the subtree to search, may be NULL
+  @param  MaxAddress             The address that the range must be below,
+                                 aligned to the end of a page
+  @param  MinAddress             The address that the range must be above
+  @param  NumberOfBytes          Number of bytes needed
+  @param  Alignment              Bits to align with
+  @param  NeedGuard              Flag to indicate Guard page is needed or not
+
+  @return The last address of the range, or 0 if the range was not found
+
+**/
+STATIC
+UINT64
+CoreFindFreePagesInIndex (
+  IN CORE_RB_NODE     *Node,
+  IN UINT64           MaxAddress,
+  IN UINT64           MinAddress,
+  IN UINT64           NumberOfBytes,
+  IN UINTN            Alignment,
+  IN BOOLEAN          NeedGuard
+  )
+{
+  MEMORY_MAP      *Entry;
+  UINT64          Target;
+  UINT64          DescStart;
+  UINT64          DescEnd;
+  UINT64          DescNumberOfBytes;
+
+  if (Node == NULL) {
+    return 0;
+  }
+
+  Entry = MEMORY_MAP_FROM_INDEX_NODE (Node);
+  if (Entry->MaxFreeBytes < NumberOfBytes) {
+    return 0;
+  }
+
+  //
+  // Higher entries first, the first match is the best one
+  //
+  if (Entry->Start < MaxAddress) {
+    Target = CoreFindFreePagesInIndex (
+               Node->Right,
+               MaxAddress,
+               MinAddress,
+               NumberOfBytes,
+               Alignment,
+               NeedGuard
+               );
+    if (Target != 0) {
+      return Target;
+    }
+  }
+
+  DescStart = Entry->Start;
+  DescEnd = Entry->End;
+
+  //
+  // If it's not a free entry, or if desc is past max allowed address or below
+  // min allowed address, skip it
+  //
+  if ((Entry->Type == EfiConventionalMemory) &&
+      (DescStart < MaxAddress) && (DescEnd >= MinAddress)) {
+    //
+    // If desc ends past max allowed address, clip the end
+    //
+    if (DescEnd >= MaxAddress) {
+      DescEnd = MaxAddress;
+    }
+
+    DescEnd = ((DescEnd + 1) & (~(Alignment - 1))) - 1;
+
+    //
+    // Compute the number of bytes we can used from this
+    // descriptor, and see it's enough to satisfy the request.
+    // Skip if DescEnd is less than DescStart after alignment clipping, or if
+    // the start of the allocated range is below the min address allowed.
+    //
+    if (DescEnd >= DescStart) {
+      DescNumberOfBytes = DescEnd - DescStart + 1;
+
+      if ((DescNumberOfBytes >= NumberOfBytes) &&
+          ((DescEnd - NumberOfBytes + 1) >= MinAddress)) {
+        if (NeedGuard) {
+          DescEnd = AdjustMemoryS (
+                      DescEnd + 1 - DescNumberOfBytes,
+                      DescNumberOfBytes,
+                      NumberOfBytes
+                      );
+        }
+
+        if (DescEnd != 0) {
+          return DescEnd;
+        }
+      }
+    }
+  }
+
+  if (Entry->End >= MinAddress) {
+    return CoreFindFreePagesInIndex (
+             Node->Left,
+             MaxAddress,
+             MinAddress,
+             NumberOfBytes,
+             Alignment,
+             NeedGuard
+             );
+  }
+
+  return 0;
+}
+
 /**
   Internal function. Finds a consecutive free page range below
   the requested address.
@@ -1035,11 +1147,6 @@ CoreFindFreePagesI (
 {
   UINT64          NumberOfBytes;
   UINT64          Target;
-  UINT64          DescStart;
-  UINT64          DescEnd;
-  UINT64          DescNumberOfBytes;
-  LIST_ENTRY      *Link;
-  MEMORY_MAP      *Entry;
 
   if ((MaxAddress < EFI_PAGE_MASK) ||(NumberOfPages == 0)) {
     return 0;
@@ -1068,75 +1175,14 @@ CoreFindFreePagesI (
   }
 
   NumberOfBytes = LShiftU64 (NumberOfPages, EFI_PAGE_SHIFT);
-  Target = 0;
-
-  for (Link = gMemoryMap.ForwardLink; Link != &gMemoryMap; Link = Link->ForwardLink) {
-    Entry = CR (Link, MEMORY_MAP, Link, MEMORY_MAP_SIGNATURE);
-
-    //
-    // If it's not a free entry, don't bother with it
-    //
-    if (Entry->Type != EfiConventionalMemory) {
-      continue;
-    }
-
-    DescStart = Entry->Start;
-    DescEnd = Entry->End;
-
-    //
-    // If desc is past max allowed address or below min allowed address, skip it
-    //
-    if ((DescStart >= MaxAddress) || (DescEnd < MinAddress)) {
-      continue;
-    }
-
-    //
-    // If desc ends past max allowed address, clip the end
-    //
-    if (DescEnd >= MaxAddress) {
-      DescEnd = MaxAddress;
-    }
-
-    DescEnd = ((DescEnd + 1) & (~(Alignment - 1))) - 1;
-
-    // Skip if DescEnd is less than DescStart after alignment clipping
-    if (DescEnd < DescStart) {
-      continue;
-    }
-
-    //
-    // Compute the number of bytes we can used from this
-    // descriptor, and see it's enough to satisfy the request
-    //
-    DescNumberOfBytes = DescEnd - DescStart + 1;
-
-    if (DescNumberOfBytes >= NumberOfBytes) {
-      //
-      // If the start of the allocated range is below the min address allowed, skip it
-      //
-      if ((DescEnd - NumberOfBytes + 1) < MinAddress) {
-        continue;
-      }
-
-      //
-      // If this is the best match so far remember it
-      //
-      if (DescEnd > Target) {
-        if (NeedGuard) {
-          DescEnd = AdjustMemoryS (
-                      DescEnd + 1 - DescNumberOfBytes,
-                      DescNumberOfBytes,
-                      NumberOfBytes
-                      );
-          if (DescEnd == 0) {
-            continue;
-          }
-        }
-
-        Target = DescEnd;
-      }
-    }
-  }
+  Target = CoreFindFreePagesInIndex (
+             gMemoryMapIndex.Root,
+             MaxAddress,
+             MinAddress,
+             NumberOfBytes,
+             Alignment,
+             NeedGuard
+             );
 
   //
   // If this is a grow down, adjust target to be the allocation base
@@ -1477,7 +1523,6 @@ CoreInternalFreePages (
   )
 {
   EFI_STATUS      Status;
-  LIST_ENTRY      *Link;
   MEMORY_MAP      *Entry;
   UINTN           Alignment;
   BOOLEAN         IsGuarded;
@@ -1491,14 +1536,8 @@ CoreInternalFreePages (
   // Find the entry that the covers the range
   //
   IsGuarded = FALSE;
-  Entry = NULL;
-  for (Link = gMemoryMap.ForwardLink; Link != &gMemoryMap; Link = Link->ForwardLink) {
-    Entry = CR(Link, MEMORY_MAP, Link, MEMORY_MAP_SIGNATURE);
-    if (Entry->Start <= Memory && Entry->End > Memory) {
-        break;
-    }
-  }
-  if (Link == &gMemoryMap) {
+  Entry = CoreLookupMemoryMapIndex (Memory);
+  if (Entry == NULL) {
     Status = EFI_NOT_FOUND;
     goto Done;
   }
@@ -22,6 +22,7 @@ typedef struct {
 
 #define POOL_HEAD_SIGNATURE       SIGNATURE_32('p','h','d','0')
 #define POOLPAGE_HEAD_SIGNATURE   SIGNATURE_32('p','h','d','1')
+#define POOLSLAB_HEAD_SIGNATURE   SIGNATURE_32('p','h','d','2')
 typedef struct {
   UINT32          Signature;
   UINT32          Reserved;
@@ -60,6 +61,53 @@ STATIC CONST UINT16 mPoolSizeTable[] = {
 
 #define MAX_POOL_SIZE     (MAX_ADDRESS - POOL_OVERHEAD)
 
+//
+// When PcdDxePoolSlabEnable is TRUE, the allocations of the first
+// POOL_SLAB_CLASS_COUNT bins of the normal memory types are served from
+// slabs. A slab is one page holding objects of a single bin, tracked with
+// a free-object bitmap, so that allocations and frees do not need to carve
+// or coalesce pool blocks. Recently freed objects are kept in a small
+// magazine per bin and handed out first, and one empty slab per bin is
+// kept so that steady-state churn does not touch the memory map.
+//
+#define POOL_SLAB_CLASS_COUNT     5
+#define POOL_SLAB_MAGAZINE_SIZE   8
+#define POOL_SLAB_EMPTY_MAX       1
+#define POOL_SLAB_SIZE            EFI_PAGE_SIZE
+#define POOL_SLAB_HEADER_SIZE     64
+
+#define POOL_SLAB_SIGNATURE   SIGNATURE_32('p','s','l','b')
+typedef struct {
+  UINT32          Signature;
+  UINT16          Index;
+  UINT16          FreeCount;
+  ///
+  /// Bit N is set if object N of the slab is free.
+  ///
+  UINT32          FreeBitmap;
+  UINT32          Reserved;
+  ///
+  /// Link on POOL_SLAB_CLASS.SlabList while the slab has free objects.
+  ///
+  LIST_ENTRY      Link;
+} POOL_SLAB;
+
+typedef struct {
+  ///
+  /// Slabs with free objects, partially used slabs first.
+  ///
+  LIST_ENTRY      SlabList;
+  UINTN           EmptySlabCount;
+  UINTN           MagazineCount;
+  VOID            *Magazine[POOL_SLAB_MAGAZINE_SIZE];
+  UINT64          AllocCount;
+  UINT64          MagazineHitCount;
+  UINT64          SlabPageAllocCount;
+  UINT64          SlabPageFreeCount;
+} POOL_SLAB_CLASS;
+
+#define SLAB_CAPACITY(a)  ((POOL_SLAB_SIZE - POOL_SLAB_HEADER_SIZE) / LIST_TO_SIZE (a))
+
 //
 // Globals
 //
@@ -71,6 +119,7 @@ typedef struct {
     EFI_MEMORY_TYPE  MemoryType;
     LIST_ENTRY       FreeList[MAX_POOL_LIST];
     LIST_ENTRY       Link;
+    POOL_SLAB_CLASS  Slab[POOL_SLAB_CLASS_COUNT];
 } POOL;
 
 //
@@ -126,7 +175,12 @@ CoreInitializePool (
     for (Index=0; Index < MAX_POOL_LIST; Index++) {
       InitializeListHead (&mPoolHead[Type].FreeList[Index]);
     }
+    for (Index = 0; Index < POOL_SLAB_CLASS_COUNT; Index++) {
+      ZeroMem (&mPoolHead[Type].Slab[Index], sizeof (POOL_SLAB_CLASS));
+      InitializeListHead (&mPoolHead[Type].Slab[Index].SlabList);
+    }
   }
+  ASSERT (SLAB_CAPACITY (0) <= 32);
 }
 
 
@@ -176,6 +230,7 @@ LookupPoolHead (
     for (Index=0; Index < MAX_POOL_LIST; Index++) {
       InitializeListHead (&Pool->FreeList[Index]);
     }
+    ZeroMem (Pool->Slab, sizeof (Pool->Slab));
 
     InsertHeadList (&mPoolHeadList, &Pool->Link);
 
@@ -332,6 +387,104 @@ CoreAllocatePoolPagesI (
   return Buffer;
 }
 
+/**
+  Check whether an allocation of a given pool bin and type is served from
+  slabs.
+
+  @param  PoolType               The type of memory of the allocation
+  @param  Index                  The pool bin of the allocation
+  @param  Granularity            The page allocation granularity of PoolType
+
+  @retval TRUE                   The allocation is served from slabs.
+  @retval FALSE                  The allocation is served from the free lists.
+
+**/
+STATIC
+BOOLEAN
+IsPoolSlabAllocation (
+  IN EFI_MEMORY_TYPE  PoolType,
+  IN UINTN            Index,
+  IN UINTN            Granularity
+  )
+{
+  return (BOOLEAN) (PcdGetBool (PcdDxePoolSlabEnable) &&
+                    ((UINT32) PoolType < EfiMaxMemoryType) &&
+                    (Index < POOL_SLAB_CLASS_COUNT) &&
+                    (Granularity == POOL_SLAB_SIZE));
+}
+
+/**
+  Internal function.  Allocates an object from the slabs of a pool bin.
+
+  @param  Pool                   The pool head of the memory type
+  @param  Index                  The pool bin to allocate from
+
+  @return The allocated object, or NULL
+
+**/
+STATIC
+VOID *
+CoreAllocatePoolSlabObject (
+  IN POOL             *Pool,
+  IN UINTN            Index
+  )
+{
+  POOL_SLAB_CLASS   *SlabClass;
+  POOL_SLAB         *Slab;
+  UINTN             Object;
+
+  SlabClass = &Pool->Slab[Index];
+
+  //
+  // Recently freed objects are handed out first
+  //
+  if (SlabClass->MagazineCount > 0) {
+    SlabClass->MagazineCount--;
+    SlabClass->MagazineHitCount++;
+    SlabClass->AllocCount++;
+    return SlabClass->Magazine[SlabClass->MagazineCount];
+  }
+
+  //
+  // If no slab has free objects, get a new one
+  //
+  if (IsListEmpty (&SlabClass->SlabList)) {
+    Slab = CoreAllocatePoolPagesI (
+             Pool->MemoryType,
+             EFI_SIZE_TO_PAGES (POOL_SLAB_SIZE),
+             POOL_SLAB_SIZE,
+             FALSE
+             );
+    if (Slab == NULL) {
+      return NULL;
+    }
+
+    Slab->Signature  = POOL_SLAB_SIGNATURE;
+    Slab->Index      = (UINT16) Index;
+    Slab->FreeCount  = (UINT16) SLAB_CAPACITY (Index);
+    Slab->FreeBitmap = (UINT32) (LShiftU64 (1, SLAB_CAPACITY (Index)) - 1);
+    Slab->Reserved   = 0;
+    InsertHeadList (&SlabClass->SlabList, &Slab->Link);
+    SlabClass->EmptySlabCount++;
+    SlabClass->SlabPageAllocCount++;
+  }
+
+  Slab = CR (SlabClass->SlabList.ForwardLink, POOL_SLAB, Link, POOL_SLAB_SIGNATURE);
+  if (Slab->FreeCount == SLAB_CAPACITY (Index)) {
+    SlabClass->EmptySlabCount--;
+  }
+
+  Object = (UINTN) LowBitSet32 (Slab->FreeBitmap);
+  Slab->FreeBitmap &= ~(UINT32) (1 << Object);
+  Slab->FreeCount--;
+  if (Slab->FreeCount == 0) {
+    RemoveEntryList (&Slab->Link);
+  }
+
+  SlabClass->AllocCount++;
+  return (CHAR8 *) Slab + POOL_SLAB_HEADER_SIZE + Object * LIST_TO_SIZE (Index);
+}
+
 /**
   Internal function to allocate pool of a particular type.
   Caller must have the memory lock held
@@ -363,6 +516,7 @@ CoreAllocatePoolI (
   UINTN       Granularity;
   BOOLEAN     HasPoolTail;
   BOOLEAN     PageAsPool;
+  BOOLEAN     SlabObject;
 
   ASSERT_LOCKED (&mPoolMemoryLock);
 
@@ -398,6 +552,7 @@ CoreAllocatePoolI (
     return NULL;
   }
   Head = NULL;
+  SlabObject = FALSE;
 
   //
   // If allocation is over max size, just allocate pages for the request
@@ -416,6 +571,15 @@ CoreAllocatePoolI (
     goto Done;
   }
 
+  //
+  // Small allocations may be served from slabs
+  //
+  if (IsPoolSlabAllocation (PoolType, Index, Granularity)) {
+    Head = CoreAllocatePoolSlabObject (Pool, Index);
+    SlabObject = TRUE;
+    goto Done;
+  }
+
   //
   // If there's no free pool in the proper list size, go get some more pages
   //
@@ -495,7 +659,13 @@ Done:
     //
     // If we have a pool buffer, fill in the header & tail info
     //
-    Head->Signature = (PageAsPool) ? POOLPAGE_HEAD_SIGNATURE : POOL_HEAD_SIGNATURE;
+    if (PageAsPool) {
+      Head->Signature = POOLPAGE_HEAD_SIGNATURE;
+    } else if (SlabObject) {
+      Head->Signature = POOLSLAB_HEAD_SIGNATURE;
+    } else {
+      Head->Signature = POOL_HEAD_SIGNATURE;
+    }
     Head->Size      = Size;
     Head->Type      = (EFI_MEMORY_TYPE) PoolType;
     Buffer          = Head->Data;
@@ -653,6 +823,150 @@ CoreFreePoolPagesWithGuard (
   }
 }
 
+/**
+  Internal function.  Returns an object to the slabs of a pool bin.
+
+  @param  Pool                   The pool head of the memory type
+  @param  Index                  The pool bin of the object
+  @param  Buffer                 The object to free
+
+**/
+STATIC
+VOID
+CoreFreePoolSlabObject (
+  IN POOL             *Pool,
+  IN UINTN            Index,
+  IN VOID             *Buffer
+  )
+{
+  POOL_SLAB_CLASS   *SlabClass;
+  POOL_SLAB         *Slab;
+  UINTN             Object;
+
+  SlabClass = &Pool->Slab[Index];
+
+  //
+  // Mark the object free so that a double free is caught
+  //
+  ((POOL_FREE *) Buffer)->Signature = POOL_FREE_SIGNATURE;
+
+  if (SlabClass->MagazineCount < POOL_SLAB_MAGAZINE_SIZE) {
+    SlabClass->Magazine[SlabClass->MagazineCount] = Buffer;
+    SlabClass->MagazineCount++;
+    return;
+  }
+
+  Slab = (POOL_SLAB *) ((UINTN) Buffer & ~(UINTN) (POOL_SLAB_SIZE - 1));
+  ASSERT (Slab->Signature == POOL_SLAB_SIGNATURE);
+  ASSERT (Slab->Index == Index);
+
+  Object = ((UINTN) Buffer - (UINTN) Slab - POOL_SLAB_HEADER_SIZE) / LIST_TO_SIZE (Index);
+  ASSERT ((Slab->FreeBitmap & (1 << Object)) == 0);
+  Slab->FreeBitmap |= (UINT32) (1 << Object);
+  Slab->FreeCount++;
+
+  if (Slab->FreeCount == 1) {
+    InsertHeadList (&SlabClass->SlabList, &Slab->Link);
+  }
+
+  if (Slab->FreeCount == SLAB_CAPACITY (Index)) {
+    if (SlabClass->EmptySlabCount >= POOL_SLAB_EMPTY_MAX) {
+      //
+      // Enough empty slabs are kept, give the page back
+      //
+      RemoveEntryList (&Slab->Link);
+      Slab->Signature = 0;
+      SlabClass->SlabPageFreeCount++;
+      CoreFreePoolPagesI (
+        Pool->MemoryType,
+        (EFI_PHYSICAL_ADDRESS) (UINTN) Slab,
+        EFI_SIZE_TO_PAGES (POOL_SLAB_SIZE)
+        );
+    } else {
+      //
+      // Keep the empty slab behind the partially used ones
+      //
+      RemoveEntryList (&Slab->Link);
+      InsertTailList (&SlabClass->SlabList, &Slab->Link);
+      SlabClass->EmptySlabCount++;
+    }
+  }
+}
+
+/**
+  Get the number of pool slab statistics records.
+
+  @return The number of pool bins and memory types that slabs were used for.
+
+**/
+UINTN
+CoreGetPoolSlabInfoCount (
+  VOID
+  )
+{
+  UINTN             Type;
+  UINTN             Index;
+  UINTN             Count;
+
+  Count = 0;
+  for (Type = 0; Type < EfiMaxMemoryType; Type++) {
+    for (Index = 0; Index < POOL_SLAB_CLASS_COUNT; Index++) {
+      if (mPoolHead[Type].Slab[Index].AllocCount != 0) {
+        Count++;
+      }
+    }
+  }
+
+  return Count;
+}
+
+/**
+  Copy the pool slab statistics into memory profile records.
+
+  @param  SlabInfo               The buffer to hold the records.
+  @param  MaxCount               The number of records SlabInfo can hold.
+
+  @return The number of records copied.
+
+**/
+UINTN
+CoreCopyPoolSlabInfo (
+  OUT MEMORY_PROFILE_POOL_SLAB_INFO   *SlabInfo,
+  IN  UINTN                           MaxCount
+  )
+{
+  UINTN             Type;
+  UINTN             Index;
+  UINTN             Count;
+  POOL_SLAB_CLASS   *SlabClass;
+
+  Count = 0;
+  for (Type = 0; Type < EfiMaxMemoryType; Type++) {
+    for (Index = 0; Index < POOL_SLAB_CLASS_COUNT; Index++) {
+      SlabClass = &mPoolHead[Type].Slab[Index];
+      if (SlabClass->AllocCount == 0) {
+        continue;
+      }
+      if (Count >= MaxCount) {
+        return Count;
+      }
+
+      SlabInfo[Count].Header.Signature  = MEMORY_PROFILE_POOL_SLAB_INFO_SIGNATURE;
+      SlabInfo[Count].Header.Length     = sizeof (MEMORY_PROFILE_POOL_SLAB_INFO);
+      SlabInfo[Count].Header.Revision   = MEMORY_PROFILE_POOL_SLAB_INFO_REVISION;
+      SlabInfo[Count].MemoryType        = (UINT32) Type;
+      SlabInfo[Count].ObjectSize        = LIST_TO_SIZE (Index);
+      SlabInfo[Count].AllocCount        = SlabClass->AllocCount;
+      SlabInfo[Count].MagazineHitCount  = SlabClass->MagazineHitCount;
+      SlabInfo[Count].SlabPageAllocCount = SlabClass->SlabPageAllocCount;
+      SlabInfo[Count].SlabPageFreeCount = SlabClass->SlabPageFreeCount;
+      Count++;
+    }
+  }
+
+  return Count;
+}
+
 /**
   Internal function to free a pool entry.
   Caller must have the memory lock held
@@ -684,6 +998,7 @@ CoreFreePoolI (
   BOOLEAN     IsGuarded;
   BOOLEAN     HasPoolTail;
   BOOLEAN     PageAsPool;
+  BOOLEAN     SlabObject;
 
   ASSERT(Buffer != NULL);
   //
@@ -693,9 +1008,11 @@ CoreFreePoolI (
   ASSERT(Head != NULL);
 
   if (Head->Signature != POOL_HEAD_SIGNATURE &&
-      Head->Signature != POOLPAGE_HEAD_SIGNATURE) {
+      Head->Signature != POOLPAGE_HEAD_SIGNATURE &&
+      Head->Signature != POOLSLAB_HEAD_SIGNATURE) {
     ASSERT (Head->Signature == POOL_HEAD_SIGNATURE ||
-            Head->Signature == POOLPAGE_HEAD_SIGNATURE);
+            Head->Signature == POOLPAGE_HEAD_SIGNATURE ||
+            Head->Signature == POOLSLAB_HEAD_SIGNATURE);
     return EFI_INVALID_PARAMETER;
   }
 
@@ -704,6 +1021,7 @@ CoreFreePoolI (
   HasPoolTail = !(IsGuarded &&
                   ((PcdGet8 (PcdHeapGuardPropertyMask) & BIT7) == 0));
   PageAsPool = (Head->Signature == POOLPAGE_HEAD_SIGNATURE);
+  SlabObject = (Head->Signature == POOLSLAB_HEAD_SIGNATURE);
 
   if (HasPoolTail) {
     Tail = HEAD_TO_TAIL (Head);
@@ -757,6 +1075,14 @@ CoreFreePoolI (
   Index = SIZE_TO_LIST(Size);
   DEBUG_CLEAR_MEMORY (Head, Size);
 
+  //
+  // Slab objects go back to their slab
+  //
+  if (SlabObject) {
+    CoreFreePoolSlabObject (Pool, Index, Head);
+    return EFI_SUCCESS;
+  }
+
   //
   // If it's not on the list, it must be pool pages
   //
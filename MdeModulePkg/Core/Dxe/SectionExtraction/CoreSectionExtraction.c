@@ -92,6 +92,43 @@ typedef struct {
   VOID                        *Registration;
 } RPN_EVENT_CONTEXT;
 
+#define CORE_SECTION_PREFETCH_SIGNATURE SIGNATURE_32('S','X','P','F')
+#define PREFETCH_NODE_FROM_LINK(Node) \
+  CR (Node, CORE_SECTION_PREFETCH_NODE, Link, CORE_SECTION_PREFETCH_SIGNATURE)
+
+//
+// An encapsulation section decompressed ahead of time on an AP. The node is
+// consumed by CreateChildNode() when the child node of the section is created.
+//
+typedef struct {
+  UINT32                      Signature;
+  LIST_ENTRY                  Link;
+  UINTN                       StreamHandle;
+  EFI_COMMON_SECTION_HEADER   *SectionHeader;
+  //
+  // The compressed data of an EFI_SECTION_COMPRESSION section. GUIDed sections
+  // are decoded from SectionHeader.
+  //
+  VOID                        *CompressionSource;
+  VOID                        *OutputBuffer;
+  UINT32                      OutputSize;
+  VOID                        *ScratchBuffer;
+  UINT32                      AuthenticationStatus;
+  EFI_STATUS                  Status;
+} CORE_SECTION_PREFETCH_NODE;
+
+//
+// The work shared by the APs. Each AP decompresses the nodes whose index is
+// equal to its slot modulo SlotCount.
+//
+typedef struct {
+  EFI_MP_SERVICES_PROTOCOL    *MpServices;
+  CORE_SECTION_PREFETCH_NODE  **Nodes;
+  UINTN                       NodeCount;
+  UINTN                       *ProcessorSlot;
+  UINTN                       SlotCount;
+} CORE_SECTION_PREFETCH_WORK;
+
 
 /**
   The ExtractSection() function processes the input section and
@@ -197,6 +234,18 @@ EFI_GUIDED_SECTION_EXTRACTION_PROTOCOL mCustomGuidedSectionExtractionProtocol =
   CustomGuidedSectionExtract
 };
 
+//
+// The sections decompressed by CorePrefetchSections(), and the GUIDed sections
+// whose decoders may run on an AP.
+//
+LIST_ENTRY mSectionPrefetchList = INITIALIZE_LIST_HEAD_VARIABLE (mSectionPrefetchList);
+
+EFI_GUID   *mSectionPrefetchGuids[] = {
+  &gLzmaCustomDecompressGuid,
+  &gLzmaF86CustomDecompressGuid,
+  &gBrotliCustomDecompressGuid
+};
+
 
 /**
   Entry point of the section extraction code. Initializes an instance of the
@@ -641,6 +690,35 @@ CreateGuidedExtractionRpnEvent (
                                 );
 }
 
+/**
+  Worker function.  Removes the section decompressed ahead of time for an
+  encapsulation section from mSectionPrefetchList.
+
+  @param  SectionHeader          The encapsulation section.
+
+  @return The decompressed section, or NULL if the section was not decompressed
+          ahead of time.
+
+**/
+CORE_SECTION_PREFETCH_NODE *
+TakePrefetchedSection (
+  IN     EFI_COMMON_SECTION_HEADER             *SectionHeader
+  )
+{
+  LIST_ENTRY                                   *Link;
+  CORE_SECTION_PREFETCH_NODE                   *PrefetchNode;
+
+  for (Link = mSectionPrefetchList.ForwardLink; Link != &mSectionPrefetchList; Link = Link->ForwardLink) {
+    PrefetchNode = PREFETCH_NODE_FROM_LINK (Link);
+    if (PrefetchNode->SectionHeader == SectionHeader) {
+      RemoveEntryList (&PrefetchNode->Link);
+      return PrefetchNode;
+    }
+  }
+
+  return NULL;
+}
+
 /**
   Worker function.  Constructor for new child nodes.
 
@@ -685,6 +763,7 @@ CreateChildNode (
   UINT32                                       UncompressedLength;
   UINT8                                        CompressionType;
   UINT16                                       GuidedSectionAttributes;
+  CORE_SECTION_PREFETCH_NODE                   *PrefetchNode;
 
   CORE_SECTION_CHILD_NODE                      *Node;
 
@@ -740,10 +819,18 @@ CreateChildNode (
         CompressionType = CompressionHeader->CompressionType;
       }
 
-      //
-      // Allocate space for the new stream
-      //
-      if (UncompressedLength > 0) {
+      PrefetchNode = TakePrefetchedSection (SectionHeader);
+      if (PrefetchNode != NULL) {
+        //
+        // The stream was decompressed ahead of time
+        //
+        NewStreamBuffer = PrefetchNode->OutputBuffer;
+        NewStreamBufferSize = PrefetchNode->OutputSize;
+        CoreFreePool (PrefetchNode);
+      } else if (UncompressedLength > 0) {
+        //
+        // Allocate space for the new stream
+        //
         NewStreamBufferSize = UncompressedLength;
         NewStreamBuffer = AllocatePool (NewStreamBufferSize);
         if (NewStreamBuffer == NULL) {
@@ -836,20 +923,31 @@ CreateChildNode (
         GuidedSectionAttributes = GuidedHeader->Attributes;
       }
       if (VerifyGuidedSectionGuid (Node->EncapsulationGuid, &GuidedExtraction)) {
-        //
-        // NewStreamBuffer is always allocated by ExtractSection... No caller
-        // allocation here.
-        //
-        Status = GuidedExtraction->ExtractSection (
-                                     GuidedExtraction,
-                                     GuidedHeader,
-                                     &NewStreamBuffer,
-                                     &NewStreamBufferSize,
-                                     &AuthenticationStatus
-                                     );
-        if (EFI_ERROR (Status)) {
-          CoreFreePool (*ChildNode);
-          return EFI_PROTOCOL_ERROR;
+        PrefetchNode = TakePrefetchedSection (SectionHeader);
+        if (PrefetchNode != NULL) {
+          //
+          // The stream was extracted ahead of time
+          //
+          NewStreamBuffer = PrefetchNode->OutputBuffer;
+          NewStreamBufferSize = PrefetchNode->OutputSize;
+          AuthenticationStatus = PrefetchNode->AuthenticationStatus;
+          CoreFreePool (PrefetchNode);
+        } else {
+          //
+          // NewStreamBuffer is always allocated by ExtractSection... No caller
+          // allocation here.
+          //
+          Status = GuidedExtraction->ExtractSection (
+                                       GuidedExtraction,
+                                       GuidedHeader,
+                                       &NewStreamBuffer,
+                                       &NewStreamBufferSize,
+                                       &AuthenticationStatus
+                                       );
+          if (EFI_ERROR (Status)) {
+            CoreFreePool (*ChildNode);
+            return EFI_PROTOCOL_ERROR;
+          }
         }
 
         //
@@ -1376,10 +1474,25 @@ CloseSectionStream (
   EFI_TPL                                       OldTpl;
   EFI_STATUS                                    Status;
   LIST_ENTRY                                    *Link;
+  LIST_ENTRY                                    *NextLink;
   CORE_SECTION_CHILD_NODE                       *ChildNode;
+  CORE_SECTION_PREFETCH_NODE                    *PrefetchNode;
 
   OldTpl = CoreRaiseTpl (TPL_NOTIFY);
 
+  //
+  // Drop the sections of the stream decompressed ahead of time
+  //
+  for (Link = mSectionPrefetchList.ForwardLink; Link != &mSectionPrefetchList; Link = NextLink) {
+    NextLink = Link->ForwardLink;
+    PrefetchNode = PREFETCH_NODE_FROM_LINK (Link);
+    if (PrefetchNode->StreamHandle == StreamHandleToClose) {
+      RemoveEntryList (&PrefetchNode->Link);
+      CoreFreePool (PrefetchNode->OutputBuffer);
+      CoreFreePool (PrefetchNode);
+    }
+  }
+
   //
   // Locate target stream
   //
@@ -1599,3 +1712,453 @@ CustomGuidedSectionExtract (
 
   return EFI_SUCCESS;
 }
+
+
+/**
+  Worker function.  Prepares the decompression of an encapsulation section on
+  an AP. The output and scratch buffers are allocated on the BSP, as the APs
+  can not use the boot services.
+
+  @param  StreamHandle           The section stream holding the section.
+  @param  SectionHeader          The encapsulation section.
+  @param  SectionSize            The size of the encapsulation section.
+
+  @return The new prefetch node, or NULL if the section is not decompressed on
+          an AP.
+
+**/
+CORE_SECTION_PREFETCH_NODE *
+CreatePrefetchNode (
+  IN     UINTN                                 StreamHandle,
+  IN     EFI_COMMON_SECTION_HEADER             *SectionHeader,
+  IN     UINT32                                SectionSize
+  )
+{
+  EFI_STATUS                                   Status;
+  EFI_DECOMPRESS_PROTOCOL                      *Decompress;
+  EFI_GUIDED_SECTION_EXTRACTION_PROTOCOL       *GuidedExtraction;
+  EFI_GUID                                     *SectionDefinitionGuid;
+  VOID                                         *CompressionSource;
+  UINT32                                       CompressionSourceSize;
+  UINT32                                       UncompressedLength;
+  UINT8                                        CompressionType;
+  UINT32                                       OutputSize;
+  UINT32                                       ScratchSize;
+  UINT16                                       SectionAttribute;
+  UINTN                                        Index;
+  CORE_SECTION_PREFETCH_NODE                   *PrefetchNode;
+
+  CompressionSource = NULL;
+
+  switch (SectionHeader->Type) {
+    case EFI_SECTION_COMPRESSION:
+      if (IS_SECTION2 (SectionHeader)) {
+        if (SectionSize < sizeof (EFI_COMPRESSION_SECTION2)) {
+          return NULL;
+        }
+        CompressionSource = (UINT8 *) SectionHeader + sizeof (EFI_COMPRESSION_SECTION2);
+        CompressionSourceSize = SectionSize - sizeof (EFI_COMPRESSION_SECTION2);
+        UncompressedLength = ((EFI_COMPRESSION_SECTION2 *) SectionHeader)->UncompressedLength;
+        CompressionType = ((EFI_COMPRESSION_SECTION2 *) SectionHeader)->CompressionType;
+      } else {
+        if (SectionSize < sizeof (EFI_COMPRESSION_SECTION)) {
+          return NULL;
+        }
+        CompressionSource = (UINT8 *) SectionHeader + sizeof (EFI_COMPRESSION_SECTION);
+        CompressionSourceSize = SectionSize - sizeof (EFI_COMPRESSION_SECTION);
+        UncompressedLength = ((EFI_COMPRESSION_SECTION *) SectionHeader)->UncompressedLength;
+        CompressionType = ((EFI_COMPRESSION_SECTION *) SectionHeader)->CompressionType;
+      }
+
+      if (CompressionType != EFI_STANDARD_COMPRESSION || UncompressedLength == 0) {
+        return NULL;
+      }
+
+      //
+      // CreateChildNode() decompresses through the EFI Decompress Protocol, of
+      // which only the instance of the DXE core is known to be safe on an AP.
+      //
+      Status = CoreLocateProtocol (&gEfiDecompressProtocolGuid, NULL, (VOID **)&Decompress);
+      if (EFI_ERROR (Status) || Decompress != &gEfiDecompress) {
+        return NULL;
+      }
+
+      Status = UefiDecompressGetInfo (
+                 CompressionSource,
+                 CompressionSourceSize,
+                 &OutputSize,
+                 &ScratchSize
+                 );
+      if (EFI_ERROR (Status) || OutputSize != UncompressedLength) {
+        return NULL;
+      }
+      break;
+
+    case EFI_SECTION_GUID_DEFINED:
+      if (IS_SECTION2 (SectionHeader)) {
+        if (SectionSize < sizeof (EFI_GUID_DEFINED_SECTION2)) {
+          return NULL;
+        }
+        SectionDefinitionGuid = &((EFI_GUID_DEFINED_SECTION2 *) SectionHeader)->SectionDefinitionGuid;
+      } else {
+        if (SectionSize < sizeof (EFI_GUID_DEFINED_SECTION)) {
+          return NULL;
+        }
+        SectionDefinitionGuid = &((EFI_GUID_DEFINED_SECTION *) SectionHeader)->SectionDefinitionGuid;
+      }
+
+      for (Index = 0; Index < ARRAY_SIZE (mSectionPrefetchGuids); Index++) {
+        if (CompareGuid (SectionDefinitionGuid, mSectionPrefetchGuids[Index])) {
+          break;
+        }
+      }
+      if (Index == ARRAY_SIZE (mSectionPrefetchGuids)) {
+        return NULL;
+      }
+
+      //
+      // CreateChildNode() extracts through the GUIDed Section Extraction
+      // Protocol, of which only the instance of the DXE core decodes with
+      // ExtractGuidedSectionLib.
+      //
+      if (!VerifyGuidedSectionGuid (SectionDefinitionGuid, &GuidedExtraction) ||
+          GuidedExtraction != &mCustomGuidedSectionExtractionProtocol) {
+        return NULL;
+      }
+
+      Status = ExtractGuidedSectionGetInfo (
+                 SectionHeader,
+                 &OutputSize,
+                 &ScratchSize,
+                 &SectionAttribute
+                 );
+      if (EFI_ERROR (Status) || OutputSize == 0) {
+        return NULL;
+      }
+      break;
+
+    default:
+      return NULL;
+  }
+
+  PrefetchNode = AllocateZeroPool (sizeof (CORE_SECTION_PREFETCH_NODE));
+  if (PrefetchNode == NULL) {
+    return NULL;
+  }
+
+  PrefetchNode->OutputBuffer = AllocatePool (OutputSize);
+  if (ScratchSize > 0) {
+    PrefetchNode->ScratchBuffer = AllocatePool (ScratchSize);
+  }
+  if (PrefetchNode->OutputBuffer == NULL ||
+      (ScratchSize > 0 && PrefetchNode->ScratchBuffer == NULL)) {
+    if (PrefetchNode->OutputBuffer != NULL) {
+      CoreFreePool (PrefetchNode->OutputBuffer);
+    }
+    if (PrefetchNode->ScratchBuffer != NULL) {
+      CoreFreePool (PrefetchNode->ScratchBuffer);
+    }
+    CoreFreePool (PrefetchNode);
+    return NULL;
+  }
+
+  PrefetchNode->Signature = CORE_SECTION_PREFETCH_SIGNATURE;
+  PrefetchNode->StreamHandle = StreamHandle;
+  PrefetchNode->SectionHeader = SectionHeader;
+  PrefetchNode->CompressionSource = CompressionSource;
+  PrefetchNode->OutputSize = OutputSize;
+  PrefetchNode->Status = EFI_NOT_READY;
+
+  return PrefetchNode;
+}
+
+
+/**
+  Worker function.  Creates the prefetch nodes of the encapsulation sections
+  at the top level of a section stream, skipping the sections that already
+  have a child node or a prefetch node.
+
+  @param  Stream                 The section stream.
+  @param  PrefetchList           The list the new prefetch nodes are added to.
+
+  @return The number of prefetch nodes added to PrefetchList.
+
+**/
+UINTN
+CollectPrefetchNodes (
+  IN     CORE_SECTION_STREAM_NODE              *Stream,
+  IN OUT LIST_ENTRY                            *PrefetchList
+  )
+{
+  EFI_COMMON_SECTION_HEADER                    *SectionHeader;
+  UINTN                                        Offset;
+  UINT32                                       SectionSize;
+  BOOLEAN                                      Expanded;
+  LIST_ENTRY                                   *Link;
+  CORE_SECTION_CHILD_NODE                      *ChildNode;
+  CORE_SECTION_PREFETCH_NODE                   *PrefetchNode;
+  UINTN                                        Count;
+
+  Count = 0;
+  Offset = 0;
+  while (Offset + sizeof (EFI_COMMON_SECTION_HEADER) <= Stream->StreamLength) {
+    SectionHeader = (EFI_COMMON_SECTION_HEADER *) (Stream->StreamBuffer + Offset);
+    if (IS_SECTION2 (SectionHeader)) {
+      if (Offset + sizeof (EFI_COMMON_SECTION_HEADER2) > Stream->StreamLength) {
+        break;
+      }
+      SectionSize = SECTION2_SIZE (SectionHeader);
+    } else {
+      SectionSize = SECTION_SIZE (SectionHeader);
+    }
+    if (SectionSize < sizeof (EFI_COMMON_SECTION_HEADER) || SectionSize > Stream->StreamLength - Offset) {
+      break;
+    }
+
+    if (SectionHeader->Type == EFI_SECTION_COMPRESSION || SectionHeader->Type == EFI_SECTION_GUID_DEFINED) {
+      Expanded = FALSE;
+      for (Link = Stream->Children.ForwardLink; Link != &Stream->Children; Link = Link->ForwardLink) {
+        ChildNode = CHILD_SECTION_NODE_FROM_LINK (Link);
+        if (ChildNode->OffsetInStream == Offset) {
+          Expanded = TRUE;
+          break;
+        }
+      }
+      for (Link = mSectionPrefetchList.ForwardLink; Link != &mSectionPrefetchList; Link = Link->ForwardLink) {
+        PrefetchNode = PREFETCH_NODE_FROM_LINK (Link);
+        if (PrefetchNode->SectionHeader == SectionHeader) {
+          Expanded = TRUE;
+          break;
+        }
+      }
+
+      if (!Expanded) {
+        PrefetchNode = CreatePrefetchNode (Stream->StreamHandle, SectionHeader, SectionSize);
+        if (PrefetchNode != NULL) {
+          InsertTailList (PrefetchList, &PrefetchNode->Link);
+          Count++;
+        }
+      }
+    }
+
+    Offset = ALIGN_VALUE (Offset + SectionSize, 4);
+  }
+
+  return Count;
+}
+
+
+/**
+  Decompresses on an AP its share of the prefetch nodes of
+  CorePrefetchSections(). Only the decoders run on the AP, the buffers were
+  allocated on the BSP.
+
+  @param  Buffer                 The CORE_SECTION_PREFETCH_WORK shared by the APs.
+
+**/
+VOID
+EFIAPI
+SectionPrefetchProcedure (
+  IN OUT VOID                                  *Buffer
+  )
+{
+  CORE_SECTION_PREFETCH_WORK                   *Work;
+  CORE_SECTION_PREFETCH_NODE                   *PrefetchNode;
+  VOID                                         *OutputBuffer;
+  UINTN                                        ProcessorNumber;
+  UINTN                                        Index;
+
+  Work = (CORE_SECTION_PREFETCH_WORK *) Buffer;
+  if (EFI_ERROR (Work->MpServices->WhoAmI (Work->MpServices, &ProcessorNumber))) {
+    return;
+  }
+
+  for (Index = Work->ProcessorSlot[ProcessorNumber]; Index < Work->NodeCount; Index += Work->SlotCount) {
+    PrefetchNode = Work->Nodes[Index];
+    if (PrefetchNode->CompressionSource != NULL) {
+      PrefetchNode->Status = UefiDecompress (
+                               PrefetchNode->CompressionSource,
+                               PrefetchNode->OutputBuffer,
+                               PrefetchNode->ScratchBuffer
+                               );
+    } else {
+      OutputBuffer = PrefetchNode->OutputBuffer;
+      PrefetchNode->Status = ExtractGuidedSectionDecode (
+                               PrefetchNode->SectionHeader,
+                               &OutputBuffer,
+                               PrefetchNode->ScratchBuffer,
+                               &PrefetchNode->AuthenticationStatus
+                               );
+      if (!EFI_ERROR (PrefetchNode->Status) && OutputBuffer != PrefetchNode->OutputBuffer) {
+        //
+        // The section contents were returned in place, copy them like
+        // CustomGuidedSectionExtract() does.
+        //
+        CopyMem (PrefetchNode->OutputBuffer, OutputBuffer, PrefetchNode->OutputSize);
+      }
+    }
+  }
+}
+
+
+/**
+  Decompresses the encapsulation sections at the top level of section streams
+  on the APs. The new section streams are produced from the decompressed data
+  when the encapsulation sections are first searched by GetSection().
+
+  Only the EFI standard compression and the LZMA and Brotli GUIDed sections
+  are decompressed, as their decoders are known to be safe to run on an AP.
+
+  @param  MpServices             The MP Services Protocol.
+  @param  StreamHandles          The section streams to decompress.
+  @param  StreamCount            The number of section streams.
+
+**/
+VOID
+CorePrefetchSections (
+  IN  EFI_MP_SERVICES_PROTOCOL                  *MpServices,
+  IN  UINTN                                     *StreamHandles,
+  IN  UINTN                                     StreamCount
+  )
+{
+  EFI_STATUS                                    Status;
+  EFI_TPL                                       OldTpl;
+  UINTN                                         NumberOfProcessors;
+  UINTN                                         NumberOfEnabledProcessors;
+  UINTN                                         BspNumber;
+  UINTN                                         ProcessorNumber;
+  EFI_PROCESSOR_INFORMATION                     ProcessorInfo;
+  CORE_SECTION_STREAM_NODE                      *StreamNode;
+  CORE_SECTION_PREFETCH_NODE                    *PrefetchNode;
+  CORE_SECTION_PREFETCH_WORK                    Work;
+  LIST_ENTRY                                    PrefetchList;
+  LIST_ENTRY                                    *Link;
+  UINTN                                         Index;
+  UINTN                                         PrefetchCount;
+
+  Status = MpServices->GetNumberOfProcessors (MpServices, &NumberOfProcessors, &NumberOfEnabledProcessors);
+  if (EFI_ERROR (Status) || NumberOfEnabledProcessors < 2) {
+    return;
+  }
+
+  Status = MpServices->WhoAmI (MpServices, &BspNumber);
+  if (EFI_ERROR (Status)) {
+    return;
+  }
+
+  //
+  // Collect the encapsulation sections that have not been expanded yet
+  //
+  InitializeListHead (&PrefetchList);
+  ZeroMem (&Work, sizeof (Work));
+
+  OldTpl = CoreRaiseTpl (TPL_NOTIFY);
+  for (Index = 0; Index < StreamCount; Index++) {
+    Status = FindStreamNode (StreamHandles[Index], &StreamNode);
+    if (!EFI_ERROR (Status)) {
+      Work.NodeCount += CollectPrefetchNodes (StreamNode, &PrefetchList);
+    }
+  }
+  CoreRestoreTpl (OldTpl);
+
+  if (Work.NodeCount == 0) {
+    return;
+  }
+
+  //
+  // Hand the prefetch nodes out to the enabled APs
+  //
+  Work.MpServices = MpServices;
+  Work.Nodes = AllocatePool (Work.NodeCount * sizeof (CORE_SECTION_PREFETCH_NODE *));
+  Work.ProcessorSlot = AllocatePool (NumberOfProcessors * sizeof (UINTN));
+  if (Work.Nodes != NULL && Work.ProcessorSlot != NULL) {
+    Index = 0;
+    for (Link = PrefetchList.ForwardLink; Link != &PrefetchList; Link = Link->ForwardLink) {
+      Work.Nodes[Index++] = PREFETCH_NODE_FROM_LINK (Link);
+    }
+
+    for (ProcessorNumber = 0; ProcessorNumber < NumberOfProcessors; ProcessorNumber++) {
+      Work.ProcessorSlot[ProcessorNumber] = MAX_UINTN;
+      if (ProcessorNumber == BspNumber) {
+        continue;
+      }
+      Status = MpServices->GetProcessorInfo (MpServices, ProcessorNumber, &ProcessorInfo);
+      if (!EFI_ERROR (Status) && (ProcessorInfo.StatusFlag & PROCESSOR_ENABLED_BIT) != 0) {
+        Work.ProcessorSlot[ProcessorNumber] = Work.SlotCount++;
+      }
+    }
+
+    if (Work.SlotCount > 0) {
+      Status = MpServices->StartupAllAPs (
+                             MpServices,
+                             SectionPrefetchProcedure,
+                             FALSE,
+                             NULL,
+                             0,
+                             &Work,
+                             NULL
+                             );
+      DEBUG ((DEBUG_DISPATCH, "Decompress %Lu sections on %Lu APs - %r\n", (UINT64) Work.NodeCount, (UINT64) Work.SlotCount, Status));
+    }
+  }
+
+  //
+  // Keep the sections decompressed successfully for CreateChildNode(). The
+  // others are decompressed again on the BSP when they are searched.
+  //
+  PrefetchCount = 0;
+  OldTpl = CoreRaiseTpl (TPL_NOTIFY);
+  while (!IsListEmpty (&PrefetchList)) {
+    PrefetchNode = PREFETCH_NODE_FROM_LINK (GetFirstNode (&PrefetchList));
+    RemoveEntryList (&PrefetchNode->Link);
+    if (PrefetchNode->ScratchBuffer != NULL) {
+      CoreFreePool (PrefetchNode->ScratchBuffer);
+      PrefetchNode->ScratchBuffer = NULL;
+    }
+
+    if (!EFI_ERROR (PrefetchNode->Status) &&
+        !EFI_ERROR (FindStreamNode (PrefetchNode->StreamHandle, &StreamNode))) {
+      InsertTailList (&mSectionPrefetchList, &PrefetchNode->Link);
+      PrefetchCount++;
+    } else {
+      CoreFreePool (PrefetchNode->OutputBuffer);
+      CoreFreePool (PrefetchNode);
+    }
+  }
+  CoreRestoreTpl (OldTpl);
+
+  if (PrefetchCount < Work.NodeCount) {
+    DEBUG ((DEBUG_DISPATCH, "  %Lu sections left to decompress on the BSP\n", (UINT64) (Work.NodeCount - PrefetchCount)));
+  }
+
+  if (Work.Nodes != NULL) {
+    CoreFreePool (Work.Nodes);
+  }
+  if (Work.ProcessorSlot != NULL) {
+    CoreFreePool (Work.ProcessorSlot);
+  }
+}
+
+
+/**
+  Frees the decompressed sections of CorePrefetchSections() that were not
+  consumed.
+
+**/
+VOID
+CoreFlushPrefetchedSections (
+  VOID
+  )
+{
+  EFI_TPL                                       OldTpl;
+  CORE_SECTION_PREFETCH_NODE                    *PrefetchNode;
+
+  OldTpl = CoreRaiseTpl (TPL_NOTIFY);
+  while (!IsListEmpty (&mSectionPrefetchList)) {
+    PrefetchNode = PREFETCH_NODE_FROM_LINK (GetFirstNode (&mSectionPrefetchList));
+    RemoveEntryList (&PrefetchNode->Link);
+    CoreFreePool (PrefetchNode->OutputBuffer);
+    CoreFreePool (PrefetchNode);
+  }
+  CoreRestoreTpl (OldTpl);
+}
@@ -2,7 +2,7 @@
   Master header file for DxeIpl PEIM. All source files in this module should
   include this file for common definitions.
 
-Copyright (c) 2006 - 2019, Intel Corporation. All rights reserved.<BR>
+Copyright (c) 2006 - 2020, Intel Corporation. All rights reserved.<BR>
 SPDX-License-Identifier: BSD-2-Clause-Patent
 
 **/
@@ -23,10 +23,12 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include <Ppi/RecoveryModule.h>
 #include <Ppi/CapsuleOnDisk.h>
 #include <Ppi/VectorHandoffInfo.h>
+#include <Ppi/MpServices.h>
 
 #include <Guid/MemoryTypeInformation.h>
 #include <Guid/MemoryAllocationHob.h>
 #include <Guid/FirmwareFileSystem2.h>
+#include <Guid/LzmaDecompress.h>
 
 #include <Library/DebugLib.h>
 #include <Library/PeimEntryPoint.h>
@@ -42,10 +44,37 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include <Library/DebugAgentLib.h>
 #include <Library/PeiServicesTablePointerLib.h>
 #include <Library/PerformanceLib.h>
+#include <Library/SynchronizationLib.h>
 
 #define STACK_SIZE      0x20000
 #define BSP_STORE_SIZE  0x4000
 
+///
+/// One chunk of a LZMA chunked GUIDed section decoded by an AP.
+///
+typedef struct {
+  CONST VOID                              *Section;
+  RETURN_STATUS                           Status;
+  UINT32                                  AuthenticationStatus;
+} CHUNKED_SECTION_CHUNK;
+
+///
+/// Context shared by the processors decoding the chunks of a LZMA chunked GUIDed section.
+///
+typedef struct {
+  EXTRACT_GUIDED_SECTION_DECODE_HANDLER   DecodeHandler;
+  CHUNKED_SECTION_CHUNK                   *Chunks;
+  UINT32                                  ChunkCount;
+  UINT32                                  ChunkSize;
+  UINT32                                  DecompressedSize;
+  UINT8                                   *OutputBuffer;
+  UINT8                                   *ScratchBuffer;
+  UINTN                                   ScratchBufferSize;
+  UINT32                                  WorkerCount;
+  volatile UINT32                         NextWorker;
+  volatile UINT32                         NextChunk;
+} CHUNKED_SECTION_DECODE_CONTEXT;
+
 
 //
 // This PPI is installed to indicate the end of the PEI usage of memory
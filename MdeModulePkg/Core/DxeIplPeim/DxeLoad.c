@@ -3,7 +3,7 @@
   Responsibility of this module is to load the DXE Core from a Firmware Volume.
 
 Copyright (c) 2016 HP Development Company, L.P.
-Copyright (c) 2006 - 2019, Intel Corporation. All rights reserved.<BR>
+Copyright (c) 2006 - 2020, Intel Corporation. All rights reserved.<BR>
 SPDX-License-Identifier: BSD-2-Clause-Patent
 
 **/
@@ -511,6 +511,195 @@ DxeIplFindDxeCore (
 
 
 
+/**
+  Decode the chunks of a LZMA chunked GUIDed section on an AP or on the BSP.
+
+  Each processor takes a scratch buffer of its own, then decodes the chunks that
+  no other processor has taken yet.
+
+  @param  Buffer  Pointer to the CHUNKED_SECTION_DECODE_CONTEXT.
+
+**/
+VOID
+EFIAPI
+DecodeSectionChunks (
+  IN OUT VOID  *Buffer
+  )
+{
+  CHUNKED_SECTION_DECODE_CONTEXT  *Context;
+  CHUNKED_SECTION_CHUNK           *Chunk;
+  UINT32                          Worker;
+  UINT32                          Index;
+  UINT8                           *ScratchBuffer;
+  UINT8                           *ChunkBuffer;
+  VOID                            *ChunkOutput;
+
+  Context = (CHUNKED_SECTION_DECODE_CONTEXT *) Buffer;
+
+  Worker = InterlockedIncrement (&Context->NextWorker) - 1;
+  if (Worker >= Context->WorkerCount) {
+    return;
+  }
+  ScratchBuffer = Context->ScratchBuffer + Worker * Context->ScratchBufferSize;
+
+  while (TRUE) {
+    Index = InterlockedIncrement (&Context->NextChunk) - 1;
+    if (Index >= Context->ChunkCount) {
+      break;
+    }
+    Chunk       = &Context->Chunks[Index];
+    ChunkBuffer = Context->OutputBuffer + Index * Context->ChunkSize;
+    ChunkOutput = ChunkBuffer;
+    Chunk->Status = Context->DecodeHandler (
+                               Chunk->Section,
+                               &ChunkOutput,
+                               ScratchBuffer,
+                               &Chunk->AuthenticationStatus
+                               );
+    if (!RETURN_ERROR (Chunk->Status) && ChunkOutput != ChunkBuffer) {
+      CopyMem (
+        ChunkBuffer,
+        ChunkOutput,
+        MIN (Context->ChunkSize, Context->DecompressedSize - Index * Context->ChunkSize)
+        );
+    }
+  }
+}
+
+/**
+  Decode a LZMA chunked GUIDed section by decoding its chunks in parallel on the
+  APs, started through the PEI MP Services PPI.
+
+  The section must have been checked by the GetInfo handler registered for it,
+  which guarantees that every chunk is a LZMA GUIDed section that decodes to its
+  part of the output buffer.
+
+  @param InputSection           A pointer to the LZMA chunked GUIDed section.
+  @param OutputBuffer           The buffer to decode the section to.
+  @param ScratchBufferSize      The size of the scratch buffer required to decode one chunk.
+  @param AuthenticationStatus   The authentication status of the output buffer.
+
+  @retval EFI_SUCCESS           The section was decoded.
+  @retval EFI_UNSUPPORTED       The section can't be decoded in parallel. It must be
+                                decoded by the registered handler instead.
+  @retval Others                A chunk can't be decoded.
+
+**/
+EFI_STATUS
+DecodeChunkedSectionInParallel (
+  IN  CONST VOID  *InputSection,
+  IN  UINT8       *OutputBuffer,
+  IN  UINT32      ScratchBufferSize,
+  OUT UINT32      *AuthenticationStatus
+  )
+{
+  EFI_STATUS                          Status;
+  EFI_PEI_MP_SERVICES_PPI             *MpServices;
+  CONST EFI_PEI_SERVICES              **PeiServices;
+  UINTN                               NumberOfProcessors;
+  UINTN                               NumberOfEnabledProcessors;
+  CONST LZMA_CHUNKED_SECTION_HEADER   *Header;
+  CONST UINT8                         *Data;
+  UINT32                              DataSize;
+  UINT32                              Offset;
+  UINT32                              ChunkSectionSize;
+  UINT32                              Index;
+  CHUNKED_SECTION_DECODE_CONTEXT      Context;
+
+  PeiServices = GetPeiServicesTablePointer ();
+  Status = PeiServicesLocatePpi (&gEfiPeiMpServicesPpiGuid, 0, NULL, (VOID **) &MpServices);
+  if (EFI_ERROR (Status)) {
+    return EFI_UNSUPPORTED;
+  }
+  Status = MpServices->GetNumberOfProcessors (PeiServices, MpServices, &NumberOfProcessors, &NumberOfEnabledProcessors);
+  if (EFI_ERROR (Status) || NumberOfEnabledProcessors < 2) {
+    return EFI_UNSUPPORTED;
+  }
+
+  if (IS_SECTION2 (InputSection)) {
+    Data     = (UINT8 *) InputSection + ((EFI_GUID_DEFINED_SECTION2 *) InputSection)->DataOffset;
+    DataSize = SECTION2_SIZE (InputSection) - ((EFI_GUID_DEFINED_SECTION2 *) InputSection)->DataOffset;
+  } else {
+    Data     = (UINT8 *) InputSection + ((EFI_GUID_DEFINED_SECTION *) InputSection)->DataOffset;
+    DataSize = SECTION_SIZE (InputSection) - ((EFI_GUID_DEFINED_SECTION *) InputSection)->DataOffset;
+  }
+  Header = (CONST LZMA_CHUNKED_SECTION_HEADER *) Data;
+  if (Header->ChunkCount < 2) {
+    return EFI_UNSUPPORTED;
+  }
+
+  ZeroMem (&Context, sizeof (Context));
+  Status = ExtractGuidedSectionGetHandlers (&gLzmaCustomDecompressGuid, NULL, &Context.DecodeHandler);
+  if (EFI_ERROR (Status)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  Context.ChunkCount        = Header->ChunkCount;
+  Context.ChunkSize         = Header->ChunkSize;
+  Context.DecompressedSize  = Header->DecompressedSize;
+  Context.OutputBuffer      = OutputBuffer;
+  Context.WorkerCount       = (UINT32) MIN (NumberOfEnabledProcessors, Header->ChunkCount);
+  Context.ScratchBufferSize = EFI_PAGES_TO_SIZE (EFI_SIZE_TO_PAGES (ScratchBufferSize));
+  Context.Chunks            = AllocateZeroPool (Header->ChunkCount * sizeof (CHUNKED_SECTION_CHUNK));
+  if (Context.Chunks == NULL) {
+    return EFI_UNSUPPORTED;
+  }
+  if (ScratchBufferSize != 0) {
+    Context.ScratchBuffer = AllocatePages (EFI_SIZE_TO_PAGES (ScratchBufferSize) * Context.WorkerCount);
+    if (Context.ScratchBuffer == NULL) {
+      FreePool (Context.Chunks);
+      return EFI_UNSUPPORTED;
+    }
+  }
+
+  Offset = sizeof (LZMA_CHUNKED_SECTION_HEADER);
+  for (Index = 0; Index < Context.ChunkCount; Index++) {
+    Context.Chunks[Index].Section = Data + Offset;
+    Context.Chunks[Index].Status  = RETURN_NOT_STARTED;
+    if (IS_SECTION2 (Data + Offset)) {
+      ChunkSectionSize = SECTION2_SIZE (Data + Offset);
+    } else {
+      ChunkSectionSize = SECTION_SIZE (Data + Offset);
+    }
+    Offset = (UINT32) MIN (ALIGN_VALUE ((UINT64) Offset + ChunkSectionSize, 4), DataSize);
+  }
+
+  DEBUG ((DEBUG_INFO, "Decoding %d chunks of LZMA chunked section on %d processors\n", Context.ChunkCount, Context.WorkerCount));
+  Status = MpServices->StartupAllAPs (
+                         PeiServices,
+                         MpServices,
+                         DecodeSectionChunks,
+                         FALSE,
+                         0,
+                         &Context
+                         );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_WARN, "Failed to start APs to decode LZMA chunked section - %r\n", Status));
+  }
+
+  //
+  // Decode on the BSP the chunks no AP has taken, if the APs could not be started.
+  //
+  DecodeSectionChunks (&Context);
+
+  Status = EFI_SUCCESS;
+  *AuthenticationStatus = 0;
+  for (Index = 0; Index < Context.ChunkCount; Index++) {
+    if (RETURN_ERROR (Context.Chunks[Index].Status)) {
+      DEBUG ((DEBUG_ERROR, "Failed to decode chunk %d of LZMA chunked section - %r\n", Index, Context.Chunks[Index].Status));
+      Status = Context.Chunks[Index].Status;
+      break;
+    }
+    *AuthenticationStatus |= Context.Chunks[Index].AuthenticationStatus;
+  }
+
+  if (Context.ScratchBuffer != NULL) {
+    FreePages (Context.ScratchBuffer, EFI_SIZE_TO_PAGES (ScratchBufferSize) * Context.WorkerCount);
+  }
+  FreePool (Context.Chunks);
+  return Status;
+}
+
 /**
   The ExtractSection() function processes the input section and
   returns a pointer to the section contents. If the section being
@@ -580,6 +769,7 @@ CustomGuidedSectionExtract (
   UINT32          ScratchBufferSize;
   UINT32          OutputBufferSize;
   UINT16          SectionAttribute;
+  CONST EFI_GUID  *SectionDefinitionGuid;
 
   //
   // Init local variable
@@ -601,14 +791,10 @@ CustomGuidedSectionExtract (
     return Status;
   }
 
-  if (ScratchBufferSize != 0) {
-    //
-    // Allocate scratch buffer
-    //
-    ScratchBuffer = AllocatePages (EFI_SIZE_TO_PAGES (ScratchBufferSize));
-    if (ScratchBuffer == NULL) {
-      return EFI_OUT_OF_RESOURCES;
-    }
+  if (IS_SECTION2 (InputSection)) {
+    SectionDefinitionGuid = &(((EFI_GUID_DEFINED_SECTION2 *) InputSection)->SectionDefinitionGuid);
+  } else {
+    SectionDefinitionGuid = &(((EFI_GUID_DEFINED_SECTION *) InputSection)->SectionDefinitionGuid);
   }
 
   if (((SectionAttribute & EFI_GUIDED_SECTION_PROCESSING_REQUIRED) != 0) && OutputBufferSize > 0) {
@@ -620,6 +806,36 @@ CustomGuidedSectionExtract (
       return EFI_OUT_OF_RESOURCES;
     }
     DEBUG ((DEBUG_INFO, "Customized Guided section Memory Size required is 0x%x and address is 0x%p\n", OutputBufferSize, *OutputBuffer));
+
+    //
+    // The chunks of a LZMA chunked section are decoded in parallel when there are APs.
+    //
+    if (CompareGuid (SectionDefinitionGuid, &gLzmaChunkedCustomDecompressGuid)) {
+      Status = DecodeChunkedSectionInParallel (
+                 InputSection,
+                 *OutputBuffer,
+                 ScratchBufferSize,
+                 AuthenticationStatus
+                 );
+      if (Status != EFI_UNSUPPORTED) {
+        if (EFI_ERROR (Status)) {
+          DEBUG ((DEBUG_ERROR, "Extract guided section Failed - %r\n", Status));
+          return Status;
+        }
+        *OutputSize = (UINTN) OutputBufferSize;
+        return EFI_SUCCESS;
+      }
+    }
+  }
+
+  if (ScratchBufferSize != 0) {
+    //
+    // Allocate scratch buffer
+    //
+    ScratchBuffer = AllocatePages (EFI_SIZE_TO_PAGES (ScratchBufferSize));
+    if (ScratchBuffer == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
   }
 
   Status = ExtractGuidedSectionDecode (
@@ -238,6 +238,251 @@ GetPeCoffImageFixLoadingAssignedAddress(
    DEBUG ((EFI_D_INFO|EFI_D_LOAD, "LOADING MODULE FIXED INFO: Loading module at fixed address 0x%11p. Status= %r \n", (VOID *)(UINTN)FixLoadingAddress, Status));
    return Status;
 }
+
+/**
+  Get the PEIM relocation cache.
+
+  On normal boot the cache is allocated from reserved memory on first use and
+  its address is published in a GUID HOB, so that it can be saved for S3 resume.
+  On S3 resume the cache is only found through the GUID HOB that is produced
+  when the saved cache has been restored.
+
+  @param Private         Pointer to the private data passed in from caller.
+  @param Create          TRUE to allocate the cache if it does not exist yet.
+
+  @return Pointer to the PEIM relocation cache, or NULL if there is none.
+
+**/
+EDKII_PEIM_RELOCATION_CACHE *
+GetPeimRelocationCache (
+  IN PEI_CORE_INSTANCE  *Private,
+  IN BOOLEAN            Create
+  )
+{
+  EFI_STATUS                    Status;
+  EDKII_PEIM_RELOCATION_CACHE   *Cache;
+  EFI_PHYSICAL_ADDRESS          CacheAddress;
+  EFI_HOB_GUID_TYPE             *GuidHob;
+  UINTN                         Pages;
+
+  if (Private->PeimRelocationCache != NULL) {
+    return Private->PeimRelocationCache;
+  }
+
+  if (Create) {
+    //
+    // The first page holds the header and the entries, the images follow it.
+    //
+    Pages = EFI_SIZE_TO_PAGES ((UINTN) PcdGet32 (PcdPeiCoreRelocationCacheSize));
+    if (Pages < 2) {
+      return NULL;
+    }
+    Status = PeiServicesAllocatePages (EfiReservedMemoryType, Pages, &CacheAddress);
+    if (EFI_ERROR (Status)) {
+      return NULL;
+    }
+    Cache = (EDKII_PEIM_RELOCATION_CACHE *) (UINTN) CacheAddress;
+    Cache->Signature     = EDKII_PEIM_RELOCATION_CACHE_SIGNATURE;
+    Cache->EntryCount    = 0;
+    Cache->MaxEntryCount = (UINT32) ((EFI_PAGE_SIZE - sizeof (EDKII_PEIM_RELOCATION_CACHE)) /
+                                     sizeof (EDKII_PEIM_RELOCATION_CACHE_ENTRY));
+    Cache->Reserved      = 0;
+    Cache->Size          = EFI_PAGES_TO_SIZE (Pages);
+    Cache->UsedSize      = EFI_PAGE_SIZE;
+    BuildGuidDataHob (&gEdkiiPeimRelocationCacheGuid, &CacheAddress, sizeof (CacheAddress));
+  } else {
+    GuidHob = GetFirstGuidHob (&gEdkiiPeimRelocationCacheGuid);
+    if (GuidHob == NULL) {
+      return NULL;
+    }
+    Cache = (EDKII_PEIM_RELOCATION_CACHE *) (UINTN) (*(EFI_PHYSICAL_ADDRESS *) GET_GUID_HOB_DATA (GuidHob));
+    if (Cache->Signature != EDKII_PEIM_RELOCATION_CACHE_SIGNATURE ||
+        Cache->EntryCount > Cache->MaxEntryCount ||
+        Cache->UsedSize > Cache->Size) {
+      DEBUG ((DEBUG_ERROR, "PEIM relocation cache at 0x%lx is invalid\n", (UINT64) (UINTN) Cache));
+      return NULL;
+    }
+  }
+
+  Private->PeimRelocationCache = Cache;
+  return Cache;
+}
+
+/**
+  Find the relocation cache entry of a PEIM.
+
+  @param Cache           Pointer to the PEIM relocation cache.
+  @param FileName        The file name GUID of the PEIM.
+
+  @return Pointer to the cache entry, or NULL if the PEIM is not cached.
+
+**/
+EDKII_PEIM_RELOCATION_CACHE_ENTRY *
+FindPeimRelocationCacheEntry (
+  IN EDKII_PEIM_RELOCATION_CACHE  *Cache,
+  IN EFI_GUID                     *FileName
+  )
+{
+  EDKII_PEIM_RELOCATION_CACHE_ENTRY   *Entry;
+  UINT32                              Index;
+
+  Entry = (EDKII_PEIM_RELOCATION_CACHE_ENTRY *) (Cache + 1);
+  for (Index = 0; Index < Cache->EntryCount; Index++, Entry++) {
+    if (CompareGuid (&Entry->FileName, FileName)) {
+      return Entry;
+    }
+  }
+  return NULL;
+}
+
+/**
+  Copy a PEIM that has just been shadowed into the PEIM relocation cache.
+
+  The copy is taken before the PEIM runs and is rebased to its address in the
+  cache. It is never executed during this boot, so it can be run on S3 resume
+  without being loaded and relocated again. Copying the shadowed image saves
+  loading the sections of the PEIM from the firmware volume a second time.
+
+  @param Private         Pointer to the private data passed in from caller.
+  @param FileInfo        The file information of the PEIM.
+  @param ImageContext    The image context of the loaded and relocated PEIM.
+
+**/
+VOID
+CachePeimImage (
+  IN PEI_CORE_INSTANCE                      *Private,
+  IN EFI_FV_FILE_INFO                       *FileInfo,
+  IN CONST PE_COFF_LOADER_IMAGE_CONTEXT     *ImageContext
+  )
+{
+  EFI_STATUS                          Status;
+  EDKII_PEIM_RELOCATION_CACHE         *Cache;
+  EDKII_PEIM_RELOCATION_CACHE_ENTRY   *Entry;
+  PE_COFF_LOADER_IMAGE_CONTEXT        CacheContext;
+  UINT64                              AlignImageSize;
+  UINT32                              TeStrippedOffset;
+
+  Cache = GetPeimRelocationCache (Private, TRUE);
+  if (Cache == NULL || Cache->EntryCount >= Cache->MaxEntryCount) {
+    return;
+  }
+  if (FindPeimRelocationCacheEntry (Cache, &FileInfo->FileName) != NULL) {
+    return;
+  }
+
+  CopyMem (&CacheContext, ImageContext, sizeof (CacheContext));
+
+  TeStrippedOffset = 0;
+  if (CacheContext.IsTeImage) {
+    TeStrippedOffset = ((EFI_TE_IMAGE_HEADER *) (UINTN) ImageContext->ImageAddress)->StrippedSize -
+                       sizeof (EFI_TE_IMAGE_HEADER);
+  }
+  AlignImageSize = CacheContext.ImageSize + TeStrippedOffset;
+  if (CacheContext.SectionAlignment > EFI_PAGE_SIZE) {
+    AlignImageSize += CacheContext.SectionAlignment;
+  }
+  AlignImageSize = EFI_PAGES_TO_SIZE (EFI_SIZE_TO_PAGES ((UINTN) AlignImageSize));
+  if (AlignImageSize > Cache->Size - Cache->UsedSize) {
+    DEBUG ((DEBUG_INFO, "PEIM relocation cache is full, %g is not cached\n", &FileInfo->FileName));
+    return;
+  }
+
+  CacheContext.ImageAddress = (EFI_PHYSICAL_ADDRESS) (UINTN) Cache + Cache->UsedSize;
+  if (CacheContext.SectionAlignment > EFI_PAGE_SIZE) {
+    CacheContext.ImageAddress =
+        (CacheContext.ImageAddress + CacheContext.SectionAlignment - 1) &
+        ~((UINTN)CacheContext.SectionAlignment - 1);
+  }
+  CacheContext.ImageAddress += TeStrippedOffset;
+  CacheContext.EntryPoint    = CacheContext.ImageAddress + (ImageContext->EntryPoint - ImageContext->ImageAddress);
+
+  //
+  // The relocated image records the base it was relocated for in its header,
+  // so relocating the copy again applies the difference between the two bases.
+  //
+  CopyMem ((VOID *) (UINTN) CacheContext.ImageAddress, (VOID *) (UINTN) ImageContext->ImageAddress, (UINTN) CacheContext.ImageSize);
+  Status = PeCoffLoaderRelocateImage (&CacheContext);
+  if (EFI_ERROR (Status)) {
+    return;
+  }
+
+  Entry = (EDKII_PEIM_RELOCATION_CACHE_ENTRY *) (Cache + 1) + Cache->EntryCount;
+  CopyGuid (&Entry->FileName, &FileInfo->FileName);
+  Entry->FileDataCrc  = CalculateCrc32 (FileInfo->Buffer, FileInfo->BufferSize);
+  Entry->Reserved     = 0;
+  Entry->ImageAddress = CacheContext.ImageAddress;
+  Entry->ImageSize    = CacheContext.ImageSize;
+  Entry->EntryPoint   = CacheContext.EntryPoint;
+
+  Cache->EntryCount++;
+  Cache->UsedSize += AlignImageSize;
+}
+
+/**
+  Find a PEIM in the PEIM relocation cache restored on S3 resume.
+
+  The cached image is only used when the CRC32 of the file data still matches
+  the one recorded on normal boot.
+
+  @param Private         Pointer to the private data passed in from caller.
+  @param FileHandle      Pointer to the FFS file header of the image.
+  @param ImageAddress    The base address of the cached PE/COFF image.
+  @param ImageSize       The size of the cached PE/COFF image.
+  @param EntryPoint      The entry point of the cached PE/COFF image.
+
+  @retval EFI_SUCCESS    The PEIM was found in the cache.
+  @retval EFI_NOT_FOUND  The PEIM is not cached, or the cached image is stale.
+
+**/
+EFI_STATUS
+FindCachedPeimImage (
+  IN  PEI_CORE_INSTANCE                     *Private,
+  IN  EFI_PEI_FILE_HANDLE                   FileHandle,
+  OUT EFI_PHYSICAL_ADDRESS                  *ImageAddress,
+  OUT UINT64                                *ImageSize,
+  OUT EFI_PHYSICAL_ADDRESS                  *EntryPoint
+  )
+{
+  EFI_STATUS                          Status;
+  EDKII_PEIM_RELOCATION_CACHE         *Cache;
+  EDKII_PEIM_RELOCATION_CACHE_ENTRY   *Entry;
+  EFI_FV_FILE_INFO                    FileInfo;
+  EFI_PHYSICAL_ADDRESS                CacheStart;
+
+  Cache = GetPeimRelocationCache (Private, FALSE);
+  if (Cache == NULL) {
+    return EFI_NOT_FOUND;
+  }
+
+  Status = PeiServicesFfsGetFileInfo (FileHandle, &FileInfo);
+  if (EFI_ERROR (Status)) {
+    return EFI_NOT_FOUND;
+  }
+
+  Entry = FindPeimRelocationCacheEntry (Cache, &FileInfo.FileName);
+  if (Entry == NULL) {
+    return EFI_NOT_FOUND;
+  }
+
+  CacheStart = (EFI_PHYSICAL_ADDRESS) (UINTN) Cache;
+  if (Entry->ImageAddress < CacheStart + EFI_PAGE_SIZE ||
+      Entry->ImageSize > Cache->UsedSize ||
+      Entry->ImageAddress - CacheStart > Cache->UsedSize - Entry->ImageSize) {
+    return EFI_NOT_FOUND;
+  }
+
+  if (Entry->FileDataCrc != CalculateCrc32 (FileInfo.Buffer, FileInfo.BufferSize)) {
+    DEBUG ((DEBUG_INFO, "PEIM %g has changed since it was cached\n", &FileInfo.FileName));
+    return EFI_NOT_FOUND;
+  }
+
+  InvalidateInstructionCacheRange ((VOID *) (UINTN) Entry->ImageAddress, (UINTN) Entry->ImageSize);
+
+  *ImageAddress = Entry->ImageAddress;
+  *ImageSize    = Entry->ImageSize;
+  *EntryPoint   = Entry->EntryPoint;
+  return EFI_SUCCESS;
+}
 /**
 
   Loads and relocates a PE/COFF image into memory.
@@ -435,6 +680,16 @@ LoadAndRelocatePeCoffImage (
   //
   if (ImageContext.ImageAddress != (EFI_PHYSICAL_ADDRESS)(UINTN) Pe32Data) {
     InvalidateInstructionCacheRange ((VOID *)(UINTN)ImageContext.ImageAddress, (UINTN)ImageContext.ImageSize);
+
+    //
+    // On normal boot, keep a pristine copy of the shadowed PEIM for S3 resume
+    // when PEIMs are shadowed on S3 boot. A normal boot cannot use the cache
+    // itself: it starts with the cache empty, and shadows each PEIM only once.
+    //
+    if (!IsS3Boot && PcdGetBool (PcdShadowPeimOnS3Boot) && (PcdGet32 (PcdPeiCoreRelocationCacheSize) != 0) &&
+        (FileInfo.FileType == EFI_FV_FILETYPE_PEIM || FileInfo.FileType == EFI_FV_FILETYPE_COMBINED_PEIM_DRIVER)) {
+      CachePeimImage (Private, &FileInfo, &ImageContext);
+    }
   }
 
   *ImageAddress = ImageContext.ImageAddress;
@@ -482,6 +737,7 @@ PeiLoadImageLoadImage (
   UINT16                      Machine;
   EFI_SECTION_TYPE            SearchType1;
   EFI_SECTION_TYPE            SearchType2;
+  PEI_CORE_INSTANCE           *Private;
 
   *EntryPoint          = 0;
   ImageSize            = 0;
@@ -528,16 +784,29 @@ PeiLoadImageLoadImage (
 
   DEBUG ((DEBUG_INFO, "Loading PEIM %g\n", FileHandle));
 
+  //
+  // On S3 resume, use the copy relocated on normal boot if there is one.
+  //
+  Private = PEI_CORE_INSTANCE_FROM_PS_THIS (PeiServices);
+  Status  = EFI_NOT_FOUND;
+  if (Private->PeiMemoryInstalled &&
+      (Private->HobList.HandoffInformationTable->BootMode == BOOT_ON_S3_RESUME) &&
+      PcdGetBool (PcdShadowPeimOnS3Boot) && (PcdGet32 (PcdPeiCoreRelocationCacheSize) != 0)) {
+    Status = FindCachedPeimImage (Private, FileHandle, &ImageAddress, &ImageSize, &ImageEntryPoint);
+  }
+
   //
   // If memory is installed, perform the shadow operations
   //
-  Status = LoadAndRelocatePeCoffImage (
-    FileHandle,
-    Pe32Data,
-    &ImageAddress,
-    &ImageSize,
-    &ImageEntryPoint
-  );
+  if (EFI_ERROR (Status)) {
+    Status = LoadAndRelocatePeCoffImage (
+      FileHandle,
+      Pe32Data,
+      &ImageAddress,
+      &ImageSize,
+      &ImageEntryPoint
+    );
+  }
 
   ASSERT_EFI_ERROR (Status);
 
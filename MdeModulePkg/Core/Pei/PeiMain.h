@@ -44,6 +44,7 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include <Guid/FirmwareFileSystem2.h>
 #include <Guid/FirmwareFileSystem3.h>
 #include <Guid/AprioriFileName.h>
+#include <Guid/PeimRelocationCache.h>
 
 ///
 /// It is an FFS type extension used for PeiFindFileEx. It indicates current
@@ -67,6 +68,29 @@ typedef union {
 #define CALLBACK_NOTIFY_GROWTH_STEP 32
 #define DISPATCH_NOTIFY_GROWTH_STEP 8
 
+///
+/// End of a bucket of the PPI database GUID index
+///
+#define PPI_INDEX_END               MAX_UINT32
+
+///
+/// GUID index of one list of the PPI database. Each bucket holds the first list
+/// entry whose GUID hashes to it, and Next links every entry to the next entry of
+/// the same bucket, in list order. Entries are list indices, so the index does not
+/// change when the descriptors are migrated to permanent memory.
+///
+typedef struct {
+  ///
+  /// PEI_PPI_DATABASE.IndexBucketCount number of entries, NULL while the list
+  /// has not been indexed.
+  ///
+  UINT32                *Buckets;
+  ///
+  /// MaxCount number of entries.
+  ///
+  UINT32                *Next;
+} PEI_PPI_INDEX;
+
 typedef struct {
   UINTN                 CurrentCount;
   UINTN                 MaxCount;
@@ -75,6 +99,7 @@ typedef struct {
   /// MaxCount number of entries.
   ///
   PEI_PPI_LIST_POINTERS *PpiPtrs;
+  PEI_PPI_INDEX         GuidIndex;
 } PEI_PPI_LIST;
 
 typedef struct {
@@ -84,6 +109,7 @@ typedef struct {
   /// MaxCount number of entries.
   ///
   PEI_PPI_LIST_POINTERS *NotifyPtrs;
+  PEI_PPI_INDEX         GuidIndex;
 } PEI_CALLBACK_NOTIFY_LIST;
 
 typedef struct {
@@ -94,6 +120,7 @@ typedef struct {
   /// MaxCount number of entries.
   ///
   PEI_PPI_LIST_POINTERS *NotifyPtrs;
+  PEI_PPI_INDEX         GuidIndex;
 } PEI_DISPATCH_NOTIFY_LIST;
 
 ///
@@ -113,6 +140,10 @@ typedef struct {
   /// Notify List at callback level.
   ///
   PEI_DISPATCH_NOTIFY_LIST  DispatchNotifyList;
+  ///
+  /// Number of buckets of the GUID index of each list, a power of two.
+  ///
+  UINT32                    IndexBucketCount;
 } PEI_PPI_DATABASE;
 
 //
@@ -307,6 +338,12 @@ struct _PEI_CORE_INSTANCE {
   // Those Memory Range will be migrated into physical memory.
   //
   HOLE_MEMORY_DATA                  HoleData[HOLE_MAX_NUMBER];
+
+  //
+  // Cache of relocated PEIM images kept for S3 resume. It is created on
+  // normal boot and found through its GUID HOB on S3 resume.
+  //
+  EDKII_PEIM_RELOCATION_CACHE       *PeimRelocationCache;
 };
 
 ///
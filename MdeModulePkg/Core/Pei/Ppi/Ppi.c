@@ -196,6 +196,182 @@ ConvertPpiPointers (
       &PrivateData->PpiData.DispatchNotifyList.NotifyPtrs[Index]
       );
   }
+
+  //
+  // Convert the GUID indexes. They hold list indices, only the index buffers move.
+  //
+  ConvertPointerInRanges (SecCoreData, PrivateData, (VOID **) &PrivateData->PpiData.PpiList.GuidIndex.Buckets);
+  ConvertPointerInRanges (SecCoreData, PrivateData, (VOID **) &PrivateData->PpiData.PpiList.GuidIndex.Next);
+  ConvertPointerInRanges (SecCoreData, PrivateData, (VOID **) &PrivateData->PpiData.CallbackNotifyList.GuidIndex.Buckets);
+  ConvertPointerInRanges (SecCoreData, PrivateData, (VOID **) &PrivateData->PpiData.CallbackNotifyList.GuidIndex.Next);
+  ConvertPointerInRanges (SecCoreData, PrivateData, (VOID **) &PrivateData->PpiData.DispatchNotifyList.GuidIndex.Buckets);
+  ConvertPointerInRanges (SecCoreData, PrivateData, (VOID **) &PrivateData->PpiData.DispatchNotifyList.GuidIndex.Next);
+}
+
+/**
+
+  Get the bucket of the PPI database GUID index that a GUID hashes to.
+
+  @param PrivateData     Pointer to PeiCore's private data structure.
+  @param Guid            Pointer to the GUID.
+
+  @return The bucket number.
+
+**/
+UINT32
+GetPpiIndexBucket (
+  IN PEI_CORE_INSTANCE  *PrivateData,
+  IN CONST EFI_GUID     *Guid
+  )
+{
+  return (((UINT32 *) Guid)[0] ^ ((UINT32 *) Guid)[1] ^ ((UINT32 *) Guid)[2] ^ ((UINT32 *) Guid)[3]) &
+         (PrivateData->PpiData.IndexBucketCount - 1);
+}
+
+/**
+
+  Grow the GUID index of a PPI database list along with the list.
+
+  @param PrivateData     Pointer to PeiCore's private data structure.
+  @param GuidIndex       Pointer to the GUID index of the list.
+  @param MaxCount        Number of entries of the list before it grows.
+  @param NewMaxCount     Number of entries of the list after it grows.
+
+**/
+VOID
+GrowPpiIndex (
+  IN PEI_CORE_INSTANCE  *PrivateData,
+  IN PEI_PPI_INDEX      *GuidIndex,
+  IN UINTN              MaxCount,
+  IN UINTN              NewMaxCount
+  )
+{
+  VOID                  *TempPtr;
+
+  if (PcdGet32 (PcdPeiCoreMaxPpiSupported) == 0) {
+    return;
+  }
+
+  TempPtr = AllocatePool (sizeof (UINT32) * NewMaxCount);
+  ASSERT (TempPtr != NULL);
+  CopyMem (TempPtr, GuidIndex->Next, sizeof (UINT32) * MaxCount);
+  GuidIndex->Next = TempPtr;
+}
+
+/**
+
+  Add entries of a PPI database list to the GUID index of the list.
+  The entries must be added in list order.
+
+  @param PrivateData     Pointer to PeiCore's private data structure.
+  @param GuidIndex       Pointer to the GUID index of the list.
+  @param ListPtrs        Pointer to the entries of the list.
+  @param StartIndex      First list entry to add.
+  @param StopIndex       List entry after the last one to add.
+
+**/
+VOID
+AddPpiIndexEntries (
+  IN PEI_CORE_INSTANCE      *PrivateData,
+  IN PEI_PPI_INDEX          *GuidIndex,
+  IN PEI_PPI_LIST_POINTERS  *ListPtrs,
+  IN UINTN                  StartIndex,
+  IN UINTN                  StopIndex
+  )
+{
+  UINTN                     Index;
+  UINT32                    Bucket;
+  UINT32                    Entry;
+
+  if (PcdGet32 (PcdPeiCoreMaxPpiSupported) == 0) {
+    return;
+  }
+
+  if (GuidIndex->Buckets == NULL) {
+    if (PrivateData->PpiData.IndexBucketCount == 0) {
+      PrivateData->PpiData.IndexBucketCount = GetPowerOfTwo32 (PcdGet32 (PcdPeiCoreMaxPpiSupported));
+      if (PrivateData->PpiData.IndexBucketCount < PcdGet32 (PcdPeiCoreMaxPpiSupported)) {
+        PrivateData->PpiData.IndexBucketCount <<= 1;
+      }
+    }
+    GuidIndex->Buckets = AllocatePool (sizeof (UINT32) * PrivateData->PpiData.IndexBucketCount);
+    ASSERT (GuidIndex->Buckets != NULL);
+    SetMem (GuidIndex->Buckets, sizeof (UINT32) * PrivateData->PpiData.IndexBucketCount, 0xff);
+  }
+
+  for (Index = StartIndex; Index < StopIndex; Index++) {
+    GuidIndex->Next[Index] = PPI_INDEX_END;
+    Bucket = GetPpiIndexBucket (PrivateData, ListPtrs[Index].Ppi->Guid);
+    if (GuidIndex->Buckets[Bucket] == PPI_INDEX_END) {
+      GuidIndex->Buckets[Bucket] = (UINT32) Index;
+    } else {
+      for (Entry = GuidIndex->Buckets[Bucket]; GuidIndex->Next[Entry] != PPI_INDEX_END; Entry = GuidIndex->Next[Entry]) {
+      }
+      GuidIndex->Next[Entry] = (UINT32) Index;
+    }
+  }
+}
+
+/**
+
+  Get the first entry of a PPI database list, at or after a given one, that may
+  hold a GUID. If the list is not indexed, that is the given entry itself.
+
+  @param PrivateData     Pointer to PeiCore's private data structure.
+  @param GuidIndex       Pointer to the GUID index of the list.
+  @param Guid            Pointer to the GUID.
+  @param StartIndex      First list entry to consider.
+
+  @return The list entry, or MAX_UINTN if there is none.
+
+**/
+UINTN
+GetFirstPpiIndexEntry (
+  IN PEI_CORE_INSTANCE  *PrivateData,
+  IN PEI_PPI_INDEX      *GuidIndex,
+  IN CONST EFI_GUID     *Guid,
+  IN UINTN              StartIndex
+  )
+{
+  UINT32                Entry;
+
+  if (GuidIndex->Buckets == NULL) {
+    return StartIndex;
+  }
+
+  for (Entry = GuidIndex->Buckets[GetPpiIndexBucket (PrivateData, Guid)]; Entry != PPI_INDEX_END; Entry = GuidIndex->Next[Entry]) {
+    if (Entry >= StartIndex) {
+      return Entry;
+    }
+  }
+  return MAX_UINTN;
+}
+
+/**
+
+  Get the next entry of a PPI database list that may hold the GUID of a given entry.
+  If the list is not indexed, that is the entry following the given one.
+
+  @param GuidIndex       Pointer to the GUID index of the list.
+  @param Index           The list entry.
+
+  @return The list entry, or MAX_UINTN if there is none.
+
+**/
+UINTN
+GetNextPpiIndexEntry (
+  IN PEI_PPI_INDEX      *GuidIndex,
+  IN UINTN              Index
+  )
+{
+  if (GuidIndex->Buckets == NULL) {
+    return Index + 1;
+  }
+
+  if (GuidIndex->Next[Index] == PPI_INDEX_END) {
+    return MAX_UINTN;
+  }
+  return GuidIndex->Next[Index];
 }
 
 /**
@@ -271,6 +447,7 @@ InternalPeiInstallPpi (
         sizeof (PEI_PPI_LIST_POINTERS) * PpiListPointer->MaxCount
         );
       PpiListPointer->PpiPtrs = TempPtr;
+      GrowPpiIndex (PrivateData, &PpiListPointer->GuidIndex, PpiListPointer->MaxCount, PpiListPointer->MaxCount + PPI_GROWTH_STEP);
       PpiListPointer->MaxCount = PpiListPointer->MaxCount + PPI_GROWTH_STEP;
     }
 
@@ -297,6 +474,8 @@ InternalPeiInstallPpi (
     PpiList++;
   }
 
+  AddPpiIndexEntries (PrivateData, &PpiListPointer->GuidIndex, PpiListPointer->PpiPtrs, LastCount, PpiListPointer->CurrentCount);
+
   //
   // Process any callback level notifies for newly installed PPIs.
   //
@@ -380,12 +559,14 @@ PeiReInstallPpi (
   // Find the old PPI instance in the database.  If we can not find it,
   // return the EFI_NOT_FOUND error.
   //
-  for (Index = 0; Index < PrivateData->PpiData.PpiList.CurrentCount; Index++) {
+  for (Index = GetFirstPpiIndexEntry (PrivateData, &PrivateData->PpiData.PpiList.GuidIndex, OldPpi->Guid, 0);
+       Index < PrivateData->PpiData.PpiList.CurrentCount;
+       Index = GetNextPpiIndexEntry (&PrivateData->PpiData.PpiList.GuidIndex, Index)) {
     if (OldPpi == PrivateData->PpiData.PpiList.PpiPtrs[Index].Ppi) {
       break;
     }
   }
-  if (Index == PrivateData->PpiData.PpiList.CurrentCount) {
+  if (Index >= PrivateData->PpiData.PpiList.CurrentCount) {
     return EFI_NOT_FOUND;
   }
 
@@ -395,6 +576,21 @@ PeiReInstallPpi (
   DEBUG((EFI_D_INFO, "Reinstall PPI: %g\n", NewPpi->Guid));
   PrivateData->PpiData.PpiList.PpiPtrs[Index].Ppi = (EFI_PEI_PPI_DESCRIPTOR *) NewPpi;
 
+  //
+  // If the new PPI hashes to another bucket, index the PPI list again.
+  //
+  if ((PrivateData->PpiData.PpiList.GuidIndex.Buckets != NULL) &&
+      (GetPpiIndexBucket (PrivateData, OldPpi->Guid) != GetPpiIndexBucket (PrivateData, NewPpi->Guid))) {
+    SetMem (PrivateData->PpiData.PpiList.GuidIndex.Buckets, sizeof (UINT32) * PrivateData->PpiData.IndexBucketCount, 0xff);
+    AddPpiIndexEntries (
+      PrivateData,
+      &PrivateData->PpiData.PpiList.GuidIndex,
+      PrivateData->PpiData.PpiList.PpiPtrs,
+      0,
+      PrivateData->PpiData.PpiList.CurrentCount
+      );
+  }
+
   //
   // Process any callback level notifies for the newly installed PPI.
   //
@@ -447,7 +643,9 @@ PeiLocatePpi (
   //
   // Search the data base for the matching instance of the GUIDed PPI.
   //
-  for (Index = 0; Index < PrivateData->PpiData.PpiList.CurrentCount; Index++) {
+  for (Index = GetFirstPpiIndexEntry (PrivateData, &PrivateData->PpiData.PpiList.GuidIndex, Guid, 0);
+       Index < PrivateData->PpiData.PpiList.CurrentCount;
+       Index = GetNextPpiIndexEntry (&PrivateData->PpiData.PpiList.GuidIndex, Index)) {
     TempPtr = PrivateData->PpiData.PpiList.PpiPtrs[Index].Ppi;
     CheckGuid = TempPtr->Guid;
 
@@ -559,6 +757,12 @@ InternalPeiNotifyPpi (
           sizeof (PEI_PPI_LIST_POINTERS) * CallbackNotifyListPointer->MaxCount
           );
         CallbackNotifyListPointer->NotifyPtrs = TempPtr;
+        GrowPpiIndex (
+          PrivateData,
+          &CallbackNotifyListPointer->GuidIndex,
+          CallbackNotifyListPointer->MaxCount,
+          CallbackNotifyListPointer->MaxCount + CALLBACK_NOTIFY_GROWTH_STEP
+          );
         CallbackNotifyListPointer->MaxCount = CallbackNotifyListPointer->MaxCount + CALLBACK_NOTIFY_GROWTH_STEP;
       }
       CallbackNotifyListPointer->NotifyPtrs[CallbackNotifyIndex].Notify = (EFI_PEI_NOTIFY_DESCRIPTOR *) NotifyList;
@@ -579,6 +783,12 @@ InternalPeiNotifyPpi (
           sizeof (PEI_PPI_LIST_POINTERS) * DispatchNotifyListPointer->MaxCount
           );
         DispatchNotifyListPointer->NotifyPtrs = TempPtr;
+        GrowPpiIndex (
+          PrivateData,
+          &DispatchNotifyListPointer->GuidIndex,
+          DispatchNotifyListPointer->MaxCount,
+          DispatchNotifyListPointer->MaxCount + DISPATCH_NOTIFY_GROWTH_STEP
+          );
         DispatchNotifyListPointer->MaxCount = DispatchNotifyListPointer->MaxCount + DISPATCH_NOTIFY_GROWTH_STEP;
       }
       DispatchNotifyListPointer->NotifyPtrs[DispatchNotifyIndex].Notify = (EFI_PEI_NOTIFY_DESCRIPTOR *) NotifyList;
@@ -606,6 +816,21 @@ InternalPeiNotifyPpi (
     NotifyList++;
   }
 
+  AddPpiIndexEntries (
+    PrivateData,
+    &CallbackNotifyListPointer->GuidIndex,
+    CallbackNotifyListPointer->NotifyPtrs,
+    LastCallbackNotifyCount,
+    CallbackNotifyListPointer->CurrentCount
+    );
+  AddPpiIndexEntries (
+    PrivateData,
+    &DispatchNotifyListPointer->GuidIndex,
+    DispatchNotifyListPointer->NotifyPtrs,
+    LastDispatchNotifyCount,
+    DispatchNotifyListPointer->CurrentCount
+    );
+
   //
   // Process any callback level notifies for all previously installed PPIs.
   //
@@ -731,13 +956,38 @@ ProcessNotify (
   IN INTN                NotifyStopIndex
   )
 {
-  INTN                          Index1;
-  INTN                          Index2;
+  UINTN                         Index1;
+  UINTN                         Index2;
   EFI_GUID                      *SearchGuid;
   EFI_GUID                      *CheckGuid;
   EFI_PEI_NOTIFY_DESCRIPTOR     *NotifyDescriptor;
+  PEI_PPI_INDEX                 *NotifyIndex;
+  BOOLEAN                       SingleInstall;
+
+  if (NotifyType == EFI_PEI_PPI_DESCRIPTOR_NOTIFY_CALLBACK) {
+    NotifyIndex = &PrivateData->PpiData.CallbackNotifyList.GuidIndex;
+  } else {
+    NotifyIndex = &PrivateData->PpiData.DispatchNotifyList.GuidIndex;
+  }
+
+  //
+  // When a single PPI is installed, only the notifies indexed with its GUID are
+  // visited. Otherwise all notifies are visited, and only the PPIs indexed with
+  // the GUID of each. Both keep the notification order of the lists.
+  //
+  SingleInstall = (BOOLEAN) (InstallStopIndex - InstallStartIndex == 1);
+  if (SingleInstall) {
+    Index1 = GetFirstPpiIndexEntry (
+               PrivateData,
+               NotifyIndex,
+               PrivateData->PpiData.PpiList.PpiPtrs[InstallStartIndex].Ppi->Guid,
+               (UINTN) NotifyStartIndex
+               );
+  } else {
+    Index1 = (UINTN) NotifyStartIndex;
+  }
 
-  for (Index1 = NotifyStartIndex; Index1 < NotifyStopIndex; Index1++) {
+  for (; Index1 < (UINTN) NotifyStopIndex; Index1 = SingleInstall ? GetNextPpiIndexEntry (NotifyIndex, Index1) : Index1 + 1) {
     if (NotifyType == EFI_PEI_PPI_DESCRIPTOR_NOTIFY_CALLBACK) {
       NotifyDescriptor = PrivateData->PpiData.CallbackNotifyList.NotifyPtrs[Index1].Notify;
     } else {
@@ -746,7 +996,9 @@ ProcessNotify (
 
     CheckGuid = NotifyDescriptor->Guid;
 
-    for (Index2 = InstallStartIndex; Index2 < InstallStopIndex; Index2++) {
+    for (Index2 = GetFirstPpiIndexEntry (PrivateData, &PrivateData->PpiData.PpiList.GuidIndex, CheckGuid, (UINTN) InstallStartIndex);
+         Index2 < (UINTN) InstallStopIndex;
+         Index2 = GetNextPpiIndexEntry (&PrivateData->PpiData.PpiList.GuidIndex, Index2)) {
       SearchGuid = PrivateData->PpiData.PpiList.PpiPtrs[Index2].Ppi->Guid;
       //
       // Don't use CompareGuid function here for performance reasons.
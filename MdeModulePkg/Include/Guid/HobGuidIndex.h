@@ -0,0 +1,50 @@
+/** @file
+  Define the GUID and the format of the EDKII HOB GUID index table, which
+  indexes the GUID extension HOBs of the HOB list by their GUID.
+
+Copyright (c) 2020, Intel Corporation. All rights reserved.<BR>
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef _HOB_GUID_INDEX_H_
+#define _HOB_GUID_INDEX_H_
+
+#define EDKII_HOB_GUID_INDEX_TABLE_GUID {\
+  0x567d7ade, 0x9e74, 0x4aea, {0x9f, 0x0f, 0x5c, 0x80, 0x4d, 0xb6, 0x2f, 0xbe} \
+}
+
+//
+// The HOB GUID index table is built from the HOB list by the first module linked
+// with DxeHobIndexLib, and installed to the EFI System Table as a configuration
+// table so that the other modules share it.
+//
+// The table header is followed by BucketCount buckets, each a UINT32 holding the
+// first entry whose GUID hashes to the bucket or EDKII_HOB_GUID_INDEX_END, and by
+// EntryCount entries, one per GUID extension HOB in HOB list order. The bucket of
+// a GUID is the exclusive OR of its four UINT32 parts, modulo BucketCount which is
+// a power of two.
+//
+typedef struct {
+  UINT32                Version;
+  UINT32                BucketCount;
+  UINT32                EntryCount;
+  UINT32                Reserved;
+  EFI_PHYSICAL_ADDRESS  HobList;      // Address of the HOB list indexed.
+  UINT64                HobListSize;  // Size of the HOB list, up to the end of list HOB.
+//UINT32                             Bucket[BucketCount];
+//EDKII_HOB_GUID_INDEX_ENTRY         Entry[EntryCount];
+} EDKII_HOB_GUID_INDEX_TABLE;
+
+typedef struct {
+  UINT32                Offset;       // Offset of the GUID HOB from the start of the HOB list.
+  UINT32                Next;         // Next entry of the same bucket, or EDKII_HOB_GUID_INDEX_END.
+} EDKII_HOB_GUID_INDEX_ENTRY;
+
+#define EDKII_HOB_GUID_INDEX_TABLE_VERSION  0x00000001
+
+#define EDKII_HOB_GUID_INDEX_END            MAX_UINT32
+
+extern EFI_GUID gEdkiiHobGuidIndexTableGuid;
+
+#endif
@@ -1,7 +1,7 @@
 /** @file
   Lzma Custom decompress algorithm Guid definition.
 
-Copyright (c) 2009 - 2018, Intel Corporation. All rights reserved.<BR>
+Copyright (c) 2009 - 2020, Intel Corporation. All rights reserved.<BR>
 SPDX-License-Identifier: BSD-2-Clause-Patent
 
 **/
@@ -23,7 +23,32 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #define LZMAF86_CUSTOM_DECOMPRESS_GUID  \
   { 0xD42AE6BD, 0x1352, 0x4bfb, { 0x90, 0x9A, 0xCA, 0x72, 0xA6, 0xEA, 0xE8, 0x89 } }
 
+///
+/// The Global ID used to identify a section of an FFS file of type
+/// EFI_SECTION_GUID_DEFINED, whose contents have been split into chunks that are
+/// compressed independently using LZMA, so that they can be decompressed in parallel.
+///
+#define LZMA_CHUNKED_CUSTOM_DECOMPRESS_GUID  \
+  { 0xA2B32952, 0x98DF, 0x4B5E, { 0xAD, 0xEB, 0xFE, 0x04, 0x63, 0xC3, 0xB2, 0x21 } }
+
+#define LZMA_CHUNKED_SECTION_SIGNATURE  SIGNATURE_32 ('L', 'Z', 'C', 'H')
+
+///
+/// The data of a LZMA chunked GUIDed section starts with this header. It is
+/// followed by ChunkCount GUIDed sections compressed using LZMA, each aligned on
+/// a 4-byte boundary from the start of the data. Chunk N decompresses to the
+/// data at offset N * ChunkSize. All chunks but the last one decompress to
+/// ChunkSize bytes.
+///
+typedef struct {
+  UINT32  Signature;
+  UINT32  ChunkCount;
+  UINT32  ChunkSize;
+  UINT32  DecompressedSize;
+} LZMA_CHUNKED_SECTION_HEADER;
+
 extern GUID gLzmaCustomDecompressGuid;
 extern GUID gLzmaF86CustomDecompressGuid;
+extern GUID gLzmaChunkedCustomDecompressGuid;
 
 #endif
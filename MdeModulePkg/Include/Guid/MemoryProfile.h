@@ -179,6 +179,23 @@ typedef struct {
   //MEMORY_PROFILE_DESCRIPTOR     MemoryDescriptor[MemoryRangeCount];
 } MEMORY_PROFILE_MEMORY_RANGE;
 
+#define MEMORY_PROFILE_POOL_SLAB_INFO_SIGNATURE SIGNATURE_32 ('M','P','S','L')
+#define MEMORY_PROFILE_POOL_SLAB_INFO_REVISION 0x0001
+
+//
+// Statistics of the pool slab allocator of the DXE core, one record per
+// memory type and object size that slabs were used for.
+//
+typedef struct {
+  MEMORY_PROFILE_COMMON_HEADER  Header;
+  UINT32                        MemoryType;
+  UINT32                        ObjectSize;
+  UINT64                        AllocCount;
+  UINT64                        MagazineHitCount;
+  UINT64                        SlabPageAllocCount;
+  UINT64                        SlabPageFreeCount;
+} MEMORY_PROFILE_POOL_SLAB_INFO;
+
 //
 // UEFI memory profile layout:
 // +--------------------------------+
@@ -196,6 +213,10 @@ typedef struct {
 // +--------------------------------+
 // | ALLOC_INFO(n, mn)              |
 // +--------------------------------+
+// | POOL_SLAB_INFO(1)              |
+// +--------------------------------+
+// | POOL_SLAB_INFO(k)              |
+// +--------------------------------+
 //
 
 typedef struct _EDKII_MEMORY_PROFILE_PROTOCOL EDKII_MEMORY_PROFILE_PROTOCOL;
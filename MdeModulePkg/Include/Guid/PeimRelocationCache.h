@@ -0,0 +1,69 @@
+/** @file
+  Define the GUIDs and the format of the PEIM relocation cache.
+
+  On normal boot, the PEI Core relocates every PEIM it loads after memory is
+  installed a second time, into the cache in reserved memory, for the address
+  it has in the cache. The copies are never executed on normal boot. The
+  cache is saved to a LockBox at EndOfDxe, and restored on S3 resume so that
+  the PEI Core runs the PEIMs it shadows from their cached copies instead of
+  loading and relocating them again.
+
+Copyright (c) 2020, Intel Corporation. All rights reserved.<BR>
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef _PEIM_RELOCATION_CACHE_H_
+#define _PEIM_RELOCATION_CACHE_H_
+
+///
+/// GUID of the LockBox holding the PEIM relocation cache, and of the GUID HOB
+/// whose data is the EFI_PHYSICAL_ADDRESS of the cache. The HOB is built by the
+/// PEI Core on normal boot, and on S3 resume once the cache is restored.
+///
+#define EDKII_PEIM_RELOCATION_CACHE_GUID \
+  { \
+    0x09132572, 0xb2f0, 0x46c1, { 0x86, 0x6f, 0xe3, 0xde, 0x4d, 0x99, 0x85, 0x03 } \
+  }
+
+///
+/// GUID of the LockBox holding the EFI_PHYSICAL_ADDRESS of the PEIM relocation
+/// cache.
+///
+#define EDKII_PEIM_RELOCATION_CACHE_ADDRESS_GUID \
+  { \
+    0x1c047332, 0x0acf, 0x4eca, { 0xa5, 0xaa, 0x3a, 0x85, 0x71, 0xf8, 0xc5, 0x72 } \
+  }
+
+#define EDKII_PEIM_RELOCATION_CACHE_SIGNATURE  SIGNATURE_32 ('P', 'R', 'L', 'C')
+
+///
+/// One PEIM relocated for ImageAddress.
+///
+typedef struct {
+  EFI_GUID              FileName;       ///< Name of the FFS file of the PEIM.
+  UINT32                FileDataCrc;    ///< CRC32 of the data of the FFS file.
+  UINT32                Reserved;
+  EFI_PHYSICAL_ADDRESS  ImageAddress;
+  UINT64                ImageSize;
+  EFI_PHYSICAL_ADDRESS  EntryPoint;
+} EDKII_PEIM_RELOCATION_CACHE_ENTRY;
+
+///
+/// The cache starts with this header and MaxEntryCount entries within the first
+/// page, followed by the page aligned images.
+///
+typedef struct {
+  UINT32                Signature;
+  UINT32                EntryCount;
+  UINT32                MaxEntryCount;
+  UINT32                Reserved;
+  UINT64                Size;           ///< Size of the cache.
+  UINT64                UsedSize;       ///< Size of the cache used, from its start.
+//EDKII_PEIM_RELOCATION_CACHE_ENTRY  Entry[MaxEntryCount];
+} EDKII_PEIM_RELOCATION_CACHE;
+
+extern EFI_GUID gEdkiiPeimRelocationCacheGuid;
+extern EFI_GUID gEdkiiPeimRelocationCacheAddressGuid;
+
+#endif
@@ -9,6 +9,7 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #ifndef _SMM_VARIABLE_COMMON_H_
 #define _SMM_VARIABLE_COMMON_H_
 
+#include <Guid/VariableFormat.h>
 #include <Protocol/VarCheck.h>
 
 #define EFI_SMM_VARIABLE_WRITE_GUID \
@@ -66,6 +67,20 @@ typedef struct {
 #define SMM_VARIABLE_FUNCTION_VAR_CHECK_VARIABLE_PROPERTY_GET  10
 
 #define SMM_VARIABLE_FUNCTION_GET_PAYLOAD_SIZE        11
+//
+// The payload for this function is SMM_VARIABLE_COMMUNICATE_GET_RUNTIME_CACHE_INFO.
+//
+#define SMM_VARIABLE_FUNCTION_GET_RUNTIME_CACHE_INFO  12
+//
+// The payload for this function is SMM_VARIABLE_COMMUNICATE_RUNTIME_VARIABLE_CACHE_CONTEXT.
+// It is only accepted once, before the end of DXE.
+//
+#define SMM_VARIABLE_FUNCTION_INIT_RUNTIME_VARIABLE_CACHE_CONTEXT  13
+//
+// No extra payload for this function. The runtime variable caches are refreshed
+// from the SMM variable stores and the pending update flag is cleared.
+//
+#define SMM_VARIABLE_FUNCTION_SYNC_RUNTIME_CACHE      14
 
 ///
 /// Size of SMM communicate header, without including the payload.
@@ -120,4 +135,30 @@ typedef struct {
   UINTN                         VariablePayloadSize;
 } SMM_VARIABLE_COMMUNICATE_GET_PAYLOAD_SIZE;
 
+///
+/// This structure is used to communicate with SMI handler by GetRuntimeCacheInfo.
+/// A store size of zero means the store does not exist.
+///
+typedef struct {
+  UINTN                         TotalHobStorageSize;
+  UINTN                         TotalNvStorageSize;
+  UINTN                         TotalVolatileStorageSize;
+  BOOLEAN                       AuthenticatedVariableUsage;
+} SMM_VARIABLE_COMMUNICATE_GET_RUNTIME_CACHE_INFO;
+
+///
+/// This structure is used to communicate with SMI handler by InitRuntimeVariableCacheContext.
+/// All the buffers are owned by the variable wrapper driver and are outside of SMRAM.
+/// While ReadLock is TRUE the SMM variable driver does not touch the caches and sets
+/// PendingUpdate instead, the wrapper driver then requests SyncRuntimeCache before its
+/// next read.
+///
+typedef struct {
+  BOOLEAN                       *ReadLock;
+  BOOLEAN                       *PendingUpdate;
+  VARIABLE_STORE_HEADER         *RuntimeHobCache;
+  VARIABLE_STORE_HEADER         *RuntimeNvCache;
+  VARIABLE_STORE_HEADER         *RuntimeVolatileCache;
+} SMM_VARIABLE_COMMUNICATE_RUNTIME_VARIABLE_CACHE_CONTEXT;
+
 #endif // _SMM_VARIABLE_COMMON_H_
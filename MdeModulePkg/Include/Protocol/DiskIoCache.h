@@ -0,0 +1,97 @@
+/** @file
+  EDK II Disk I/O Cache Protocol.
+
+  The Disk I/O driver produces this protocol on every handle it installs the
+  Disk I/O protocol on. It reports how well the block cache that the driver
+  keeps for the device serves the reads, and lets a caller that wrote to the
+  device through another path discard the cached data.
+
+  Copyright (c) 2020, Intel Corporation. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#ifndef __EDKII_DISK_IO_CACHE_PROTOCOL_H__
+#define __EDKII_DISK_IO_CACHE_PROTOCOL_H__
+
+///
+/// EDK II Disk I/O Cache Protocol GUID value
+///
+#define EDKII_DISK_IO_CACHE_PROTOCOL_GUID \
+  { \
+    0x7f80ff80, 0x0ae8, 0x45ef, { 0xa3, 0xbf, 0xa3, 0xe7, 0x45, 0x66, 0x5f, 0xe5 } \
+  }
+
+#define EDKII_DISK_IO_CACHE_PROTOCOL_REVISION  0x00010000
+
+typedef struct _EDKII_DISK_IO_CACHE_PROTOCOL EDKII_DISK_IO_CACHE_PROTOCOL;
+
+///
+/// Statistics of the block cache of a device.
+///
+typedef struct {
+  ///
+  /// The size in bytes of the block cache, 0 if the device is not cached.
+  ///
+  UINT64  CacheSize;
+  ///
+  /// The number of cache lines that reads found in the cache.
+  ///
+  UINT64  ReadHits;
+  ///
+  /// The number of cache lines that reads had to read from the device.
+  ///
+  UINT64  ReadMisses;
+  ///
+  /// The number of blocks read ahead of sequential reads.
+  ///
+  UINT64  ReadAheadBlocks;
+} EDKII_DISK_IO_CACHE_STATISTICS;
+
+/**
+  Returns the statistics of the block cache of the device.
+
+  @param  This                  Indicates a pointer to the calling context.
+  @param  Statistics            Returns the statistics.
+
+  @retval EFI_SUCCESS           The statistics were returned.
+  @retval EFI_INVALID_PARAMETER Statistics is NULL.
+
+**/
+typedef
+EFI_STATUS
+(EFIAPI *EDKII_DISK_IO_CACHE_GET_STATISTICS)(
+  IN  EDKII_DISK_IO_CACHE_PROTOCOL    *This,
+  OUT EDKII_DISK_IO_CACHE_STATISTICS  *Statistics
+  );
+
+/**
+  Discards all the data in the block cache of the device, so that the following
+  reads get the data from the device.
+
+  @param  This                  Indicates a pointer to the calling context.
+
+  @retval EFI_SUCCESS           The block cache was discarded.
+
+**/
+typedef
+EFI_STATUS
+(EFIAPI *EDKII_DISK_IO_CACHE_INVALIDATE)(
+  IN EDKII_DISK_IO_CACHE_PROTOCOL     *This
+  );
+
+///
+/// EDK II Disk I/O Cache Protocol structure
+///
+struct _EDKII_DISK_IO_CACHE_PROTOCOL {
+  UINT64                              Revision;
+  EDKII_DISK_IO_CACHE_GET_STATISTICS  GetStatistics;
+  EDKII_DISK_IO_CACHE_INVALIDATE      Invalidate;
+};
+
+///
+/// EDK II Disk I/O Cache Protocol GUID variable.
+///
+extern EFI_GUID gEdkiiDiskIoCacheProtocolGuid;
+
+#endif
@@ -3,7 +3,7 @@
   It wraps Lzma decompress interfaces to GUIDed Section Extraction interfaces
   and registers them into GUIDed handler table.
 
-  Copyright (c) 2009 - 2018, Intel Corporation. All rights reserved.<BR>
+  Copyright (c) 2009 - 2020, Intel Corporation. All rights reserved.<BR>
   SPDX-License-Identifier: BSD-2-Clause-Patent
 
 **/
@@ -174,9 +174,216 @@ LzmaGuidedSectionExtraction (
   }
 }
 
+/**
+  Walk the chunks of a LZMA chunked GUIDed section, checking that each of them
+  decompresses to its part of the section data, and optionally decompress them.
+
+  @param[in]  InputSection       A pointer to a GUIDed section of an FFS formatted file.
+  @param[out] OutputBufferSize   The size, in bytes, of the decompressed section data.
+  @param[out] ScratchBufferSize  The size, in bytes, of the scratch buffer required to
+                                 decompress any of the chunks.
+  @param[out] SectionAttribute   The attributes of the GUIDed section.
+  @param[out] OutputBuffer       The buffer to decompress the chunks to, or NULL to only
+                                 check the chunks.
+  @param[in]  ScratchBuffer      The scratch buffer used to decompress the chunks.
+
+  @retval  RETURN_SUCCESS            The chunks were checked, and decompressed if requested.
+  @retval  RETURN_INVALID_PARAMETER  The section is not a valid LZMA chunked GUIDed section.
+
+**/
+RETURN_STATUS
+ProcessLzmaChunkedSection (
+  IN  CONST VOID  *InputSection,
+  OUT UINT32      *OutputBufferSize,
+  OUT UINT32      *ScratchBufferSize,
+  OUT UINT16      *SectionAttribute,
+  OUT UINT8       *OutputBuffer,   OPTIONAL
+  IN  VOID        *ScratchBuffer   OPTIONAL
+  )
+{
+  RETURN_STATUS                       Status;
+  CONST LZMA_CHUNKED_SECTION_HEADER   *Header;
+  CONST UINT8                         *Data;
+  UINT32                              DataSize;
+  UINT32                              Offset;
+  UINT32                              Index;
+  CONST EFI_GUID_DEFINED_SECTION      *Chunk;
+  UINT32                              ChunkSectionSize;
+  UINT32                              ChunkDataOffset;
+  UINT32                              ChunkOutputSize;
+  UINT32                              ChunkScratchSize;
+  UINT16                              ChunkAttribute;
+  UINT32                              AuthenticationStatus;
+  VOID                                *ChunkOutput;
+
+  if (IS_SECTION2 (InputSection)) {
+    if (!CompareGuid (
+        &gLzmaChunkedCustomDecompressGuid,
+        &(((EFI_GUID_DEFINED_SECTION2 *) InputSection)->SectionDefinitionGuid))) {
+      return RETURN_INVALID_PARAMETER;
+    }
+    *SectionAttribute = ((EFI_GUID_DEFINED_SECTION2 *) InputSection)->Attributes;
+    Data     = (UINT8 *) InputSection + ((EFI_GUID_DEFINED_SECTION2 *) InputSection)->DataOffset;
+    DataSize = SECTION2_SIZE (InputSection) - ((EFI_GUID_DEFINED_SECTION2 *) InputSection)->DataOffset;
+  } else {
+    if (!CompareGuid (
+        &gLzmaChunkedCustomDecompressGuid,
+        &(((EFI_GUID_DEFINED_SECTION *) InputSection)->SectionDefinitionGuid))) {
+      return RETURN_INVALID_PARAMETER;
+    }
+    *SectionAttribute = ((EFI_GUID_DEFINED_SECTION *) InputSection)->Attributes;
+    Data     = (UINT8 *) InputSection + ((EFI_GUID_DEFINED_SECTION *) InputSection)->DataOffset;
+    DataSize = SECTION_SIZE (InputSection) - ((EFI_GUID_DEFINED_SECTION *) InputSection)->DataOffset;
+  }
+
+  Header = (CONST LZMA_CHUNKED_SECTION_HEADER *) Data;
+  if (DataSize < sizeof (LZMA_CHUNKED_SECTION_HEADER) ||
+      Header->Signature != LZMA_CHUNKED_SECTION_SIGNATURE ||
+      Header->ChunkCount == 0 ||
+      Header->ChunkSize == 0 ||
+      Header->DecompressedSize <= MultU64x32 (Header->ChunkCount - 1, Header->ChunkSize) ||
+      Header->DecompressedSize > MultU64x32 (Header->ChunkCount, Header->ChunkSize)) {
+    return RETURN_INVALID_PARAMETER;
+  }
+
+  *OutputBufferSize  = Header->DecompressedSize;
+  *ScratchBufferSize = 0;
+
+  Offset = sizeof (LZMA_CHUNKED_SECTION_HEADER);
+  for (Index = 0; Index < Header->ChunkCount; Index++) {
+    //
+    // Each chunk is a LZMA GUIDed section that must fit in the section data.
+    //
+    if (DataSize - Offset < sizeof (EFI_GUID_DEFINED_SECTION)) {
+      return RETURN_INVALID_PARAMETER;
+    }
+    Chunk = (CONST EFI_GUID_DEFINED_SECTION *) (Data + Offset);
+    if (IS_SECTION2 (Chunk)) {
+      if (DataSize - Offset < sizeof (EFI_GUID_DEFINED_SECTION2)) {
+        return RETURN_INVALID_PARAMETER;
+      }
+      ChunkSectionSize = SECTION2_SIZE (Chunk);
+      ChunkDataOffset  = ((EFI_GUID_DEFINED_SECTION2 *) Chunk)->DataOffset;
+    } else {
+      ChunkSectionSize = SECTION_SIZE (Chunk);
+      ChunkDataOffset  = Chunk->DataOffset;
+    }
+    if (ChunkSectionSize > DataSize - Offset || ChunkDataOffset > ChunkSectionSize) {
+      return RETURN_INVALID_PARAMETER;
+    }
+
+    Status = LzmaGuidedSectionGetInfo (Chunk, &ChunkOutputSize, &ChunkScratchSize, &ChunkAttribute);
+    if (RETURN_ERROR (Status)) {
+      return Status;
+    }
+    if (ChunkOutputSize != MIN (Header->ChunkSize, Header->DecompressedSize - Index * Header->ChunkSize)) {
+      return RETURN_INVALID_PARAMETER;
+    }
+    *ScratchBufferSize = MAX (*ScratchBufferSize, ChunkScratchSize);
+
+    if (OutputBuffer != NULL) {
+      ChunkOutput = OutputBuffer + Index * Header->ChunkSize;
+      Status = LzmaGuidedSectionExtraction (Chunk, &ChunkOutput, ScratchBuffer, &AuthenticationStatus);
+      if (RETURN_ERROR (Status)) {
+        return Status;
+      }
+    }
+
+    Offset = (UINT32) MIN (ALIGN_VALUE ((UINT64) Offset + ChunkSectionSize, 4), DataSize);
+  }
+
+  return RETURN_SUCCESS;
+}
+
+/**
+  Examines a LZMA chunked GUIDed section and returns the size of the decoded buffer
+  and the size of an scratch buffer required to actually decode the data in it.
+
+  @param[in]  InputSection       A pointer to a GUIDed section of an FFS formatted file.
+  @param[out] OutputBufferSize   A pointer to the size, in bytes, of an output buffer required
+                                 if the buffer specified by InputSection were decoded.
+  @param[out] ScratchBufferSize  A pointer to the size, in bytes, required as scratch space
+                                 if the buffer specified by InputSection were decoded.
+  @param[out] SectionAttribute   A pointer to the attributes of the GUIDed section. See the Attributes
+                                 field of EFI_GUID_DEFINED_SECTION in the PI Specification.
+
+  @retval  RETURN_SUCCESS            The information about InputSection was returned.
+  @retval  RETURN_INVALID_PARAMETER  The information can not be retrieved from the section specified by InputSection.
+
+**/
+RETURN_STATUS
+EFIAPI
+LzmaChunkedGuidedSectionGetInfo (
+  IN  CONST VOID  *InputSection,
+  OUT UINT32      *OutputBufferSize,
+  OUT UINT32      *ScratchBufferSize,
+  OUT UINT16      *SectionAttribute
+  )
+{
+  ASSERT (InputSection != NULL);
+  ASSERT (OutputBufferSize != NULL);
+  ASSERT (ScratchBufferSize != NULL);
+  ASSERT (SectionAttribute != NULL);
+
+  return ProcessLzmaChunkedSection (
+           InputSection,
+           OutputBufferSize,
+           ScratchBufferSize,
+           SectionAttribute,
+           NULL,
+           NULL
+           );
+}
+
+/**
+  Decompress a LZMA chunked GUIDed section into a caller allocated output buffer,
+  one chunk after the other.
+
+  @param[in]  InputSection  A pointer to a GUIDed section of an FFS formatted file.
+  @param[out] OutputBuffer  A pointer to a buffer that contains the result of a decode operation.
+  @param[out] ScratchBuffer A caller allocated buffer that may be required by this function
+                            as a scratch buffer to perform the decode operation.
+  @param[out] AuthenticationStatus
+                            A pointer to the authentication status of the decoded output buffer.
+
+  @retval  RETURN_SUCCESS            The buffer specified by InputSection was decoded.
+  @retval  RETURN_INVALID_PARAMETER  The section specified by InputSection can not be decoded.
+
+**/
+RETURN_STATUS
+EFIAPI
+LzmaChunkedGuidedSectionExtraction (
+  IN CONST  VOID    *InputSection,
+  OUT       VOID    **OutputBuffer,
+  OUT       VOID    *ScratchBuffer,        OPTIONAL
+  OUT       UINT32  *AuthenticationStatus
+  )
+{
+  UINT32  OutputBufferSize;
+  UINT32  ScratchBufferSize;
+  UINT16  SectionAttribute;
+
+  ASSERT (OutputBuffer != NULL);
+  ASSERT (InputSection != NULL);
+
+  //
+  // Authentication is set to Zero, which may be ignored.
+  //
+  *AuthenticationStatus = 0;
+
+  return ProcessLzmaChunkedSection (
+           InputSection,
+           &OutputBufferSize,
+           &ScratchBufferSize,
+           &SectionAttribute,
+           *OutputBuffer,
+           ScratchBuffer
+           );
+}
 
 /**
-  Register LzmaDecompress and LzmaDecompressGetInfo handlers with LzmaCustomerDecompressGuid.
+  Register LzmaDecompress and LzmaDecompressGetInfo handlers with LzmaCustomerDecompressGuid,
+  and the handlers of LZMA chunked sections with LzmaChunkedCustomDecompressGuid.
 
   @retval  RETURN_SUCCESS            Register successfully.
   @retval  RETURN_OUT_OF_RESOURCES   No enough memory to store this handler.
@@ -187,10 +394,21 @@ LzmaDecompressLibConstructor (
   VOID
   )
 {
+  EFI_STATUS  Status;
+
+  Status = ExtractGuidedSectionRegisterHandlers (
+             &gLzmaCustomDecompressGuid,
+             LzmaGuidedSectionGetInfo,
+             LzmaGuidedSectionExtraction
+             );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
   return ExtractGuidedSectionRegisterHandlers (
-          &gLzmaCustomDecompressGuid,
-          LzmaGuidedSectionGetInfo,
-          LzmaGuidedSectionExtraction
-          );
+           &gLzmaChunkedCustomDecompressGuid,
+           LzmaChunkedGuidedSectionGetInfo,
+           LzmaChunkedGuidedSectionExtraction
+           );
 }
 
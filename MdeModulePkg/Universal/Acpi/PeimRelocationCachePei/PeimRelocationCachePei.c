@@ -0,0 +1,85 @@
+/** @file
+  This module restores the PEIM relocation cache saved by S3SaveStateDxe on
+  S3 resume, so that the PEI Core runs the PEIMs it shadows from the cache
+  instead of loading and relocating them again.
+
+  Copyright (c) 2020, Intel Corporation. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <PiPei.h>
+
+#include <Guid/PeimRelocationCache.h>
+
+#include <Library/PeiServicesLib.h>
+#include <Library/DebugLib.h>
+#include <Library/LockBoxLib.h>
+#include <Library/HobLib.h>
+
+/**
+  Main entry for the PEIM relocation cache restore module.
+
+  @param[in]  FileHandle    Handle of the file being invoked.
+  @param[in]  PeiServices   Pointer to PEI Services table.
+
+  @retval EFI_SUCCESS       The cache is restored, or there is nothing to restore.
+  @retval Others            The cache can't be restored.
+
+**/
+EFI_STATUS
+EFIAPI
+PeimRelocationCachePeiEntryPoint (
+  IN       EFI_PEI_FILE_HANDLE  FileHandle,
+  IN CONST EFI_PEI_SERVICES     **PeiServices
+  )
+{
+  EFI_STATUS                    Status;
+  EFI_BOOT_MODE                 BootMode;
+  EFI_PHYSICAL_ADDRESS          CacheAddress;
+  EDKII_PEIM_RELOCATION_CACHE   *Cache;
+  UINTN                         Size;
+
+  Status = PeiServicesGetBootMode (&BootMode);
+  ASSERT_EFI_ERROR (Status);
+  if (BootMode != BOOT_ON_S3_RESUME) {
+    return EFI_SUCCESS;
+  }
+
+  CacheAddress = 0;
+  Size = sizeof (CacheAddress);
+  Status = RestoreLockBox (&gEdkiiPeimRelocationCacheAddressGuid, &CacheAddress, &Size);
+  if (EFI_ERROR (Status)) {
+    //
+    // No PEIM was cached on normal boot.
+    //
+    return EFI_SUCCESS;
+  }
+
+  //
+  // Get the size of the saved cache, then restore it where it was on normal boot.
+  // The cache is in reserved memory, so it is not used by the OS.
+  //
+  Cache = (EDKII_PEIM_RELOCATION_CACHE *) (UINTN) CacheAddress;
+  Size  = 0;
+  Status = RestoreLockBox (&gEdkiiPeimRelocationCacheGuid, Cache, &Size);
+  if (Status == EFI_BUFFER_TOO_SMALL) {
+    Status = RestoreLockBox (&gEdkiiPeimRelocationCacheGuid, Cache, &Size);
+  }
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "PEIM relocation cache can't be restored - %r\n", Status));
+    return Status;
+  }
+
+  if (Size < sizeof (EDKII_PEIM_RELOCATION_CACHE) ||
+      Cache->Signature != EDKII_PEIM_RELOCATION_CACHE_SIGNATURE ||
+      Cache->UsedSize != Size) {
+    DEBUG ((DEBUG_ERROR, "PEIM relocation cache restored at 0x%lx is invalid\n", CacheAddress));
+    return EFI_VOLUME_CORRUPTED;
+  }
+
+  DEBUG ((DEBUG_INFO, "PEIM relocation cache restored at 0x%lx, %d PEIMs\n", CacheAddress, Cache->EntryCount));
+  BuildGuidDataHob (&gEdkiiPeimRelocationCacheGuid, &CacheAddress, sizeof (CacheAddress));
+
+  return EFI_SUCCESS;
+}
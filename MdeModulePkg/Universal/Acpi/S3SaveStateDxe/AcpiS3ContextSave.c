@@ -17,6 +17,7 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include <Library/DebugLib.h>
 #include <Library/UefiLib.h>
 #include <Guid/AcpiS3Context.h>
+#include <Guid/PeimRelocationCache.h>
 #include <IndustryStandard/Acpi.h>
 #include <Protocol/LockBox.h>
 
@@ -214,6 +215,53 @@ S3AllocatePageTablesBuffer (
   }
 }
 
+/**
+  Save the PEIM relocation cache built by the PEI core on normal boot to
+  LockBox, so that the relocated PEIMs can be restored on S3 resume.
+
+**/
+VOID
+SavePeimRelocationCache (
+  VOID
+  )
+{
+  EFI_STATUS                    Status;
+  EFI_HOB_GUID_TYPE             *GuidHob;
+  EFI_PHYSICAL_ADDRESS          CacheAddress;
+  EDKII_PEIM_RELOCATION_CACHE   *Cache;
+
+  GuidHob = GetFirstGuidHob (&gEdkiiPeimRelocationCacheGuid);
+  if (GuidHob == NULL) {
+    return;
+  }
+  CacheAddress = *(EFI_PHYSICAL_ADDRESS *) GET_GUID_HOB_DATA (GuidHob);
+  Cache        = (EDKII_PEIM_RELOCATION_CACHE *) (UINTN) CacheAddress;
+  if (Cache->Signature != EDKII_PEIM_RELOCATION_CACHE_SIGNATURE || Cache->EntryCount == 0) {
+    return;
+  }
+
+  DEBUG ((DEBUG_INFO, "PeimRelocationCache: 0x%lx, %d PEIMs, 0x%lx bytes\n", CacheAddress, Cache->EntryCount, Cache->UsedSize));
+
+  Status = SaveLockBox (
+             &gEdkiiPeimRelocationCacheAddressGuid,
+             &CacheAddress,
+             sizeof (CacheAddress)
+             );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_WARN, "PEIM relocation cache address can't be saved - %r\n", Status));
+    return;
+  }
+
+  Status = SaveLockBox (
+             &gEdkiiPeimRelocationCacheGuid,
+             Cache,
+             (UINTN) Cache->UsedSize
+             );
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_WARN, "PEIM relocation cache can't be saved - %r\n", Status));
+  }
+}
+
 /**
   Callback function executed when the EndOfDxe event group is signaled.
 
@@ -315,6 +363,8 @@ AcpiS3ContextSaveOnEndOfDxe (
   Status = SetLockBoxAttributes (&gEfiAcpiS3ContextGuid, LOCK_BOX_ATTRIBUTE_RESTORE_IN_PLACE);
   ASSERT_EFI_ERROR (Status);
 
+  SavePeimRelocationCache ();
+
 Done:
   //
   // Close the event, deregistering the callback and freeing resources.
@@ -9,7 +9,7 @@
     Aligned  - A read of N contiguous sectors.
     OverRun  - The last byte is not on a sector boundary.
 
-Copyright (c) 2006 - 2018, Intel Corporation. All rights reserved.<BR>
+Copyright (c) 2006 - 2020, Intel Corporation. All rights reserved.<BR>
 SPDX-License-Identifier: BSD-2-Clause-Patent
 
 **/
@@ -45,6 +45,11 @@ DISK_IO_PRIVATE_DATA        gDiskIoPrivateDataTemplate = {
     DiskIo2ReadDiskEx,
     DiskIo2WriteDiskEx,
     DiskIo2FlushDiskEx
+  },
+  {
+    EDKII_DISK_IO_CACHE_PROTOCOL_REVISION,
+    DiskIoCacheGetStatistics,
+    DiskIoCacheInvalidate
   }
 };
 
@@ -185,20 +190,24 @@ DiskIoDriverBindingStart (
     goto ErrorExit;
   }
 
+  DiskIoCacheInitialize (Instance);
+
   //
   // Install protocol interfaces for the Disk IO device.
   //
   if (Instance->BlockIo2 != NULL) {
     Status = gBS->InstallMultipleProtocolInterfaces (
                     &ControllerHandle,
-                    &gEfiDiskIoProtocolGuid,  &Instance->DiskIo,
-                    &gEfiDiskIo2ProtocolGuid, &Instance->DiskIo2,
+                    &gEfiDiskIoProtocolGuid,        &Instance->DiskIo,
+                    &gEfiDiskIo2ProtocolGuid,       &Instance->DiskIo2,
+                    &gEdkiiDiskIoCacheProtocolGuid, &Instance->DiskIoCache,
                     NULL
                     );
   } else {
     Status = gBS->InstallMultipleProtocolInterfaces (
                     &ControllerHandle,
-                    &gEfiDiskIoProtocolGuid,  &Instance->DiskIo,
+                    &gEfiDiskIoProtocolGuid,        &Instance->DiskIo,
+                    &gEdkiiDiskIoCacheProtocolGuid, &Instance->DiskIoCache,
                     NULL
                     );
   }
@@ -297,14 +306,16 @@ DiskIoDriverBindingStop (
     }
     Status = gBS->UninstallMultipleProtocolInterfaces (
                     ControllerHandle,
-                    &gEfiDiskIoProtocolGuid,  &Instance->DiskIo,
-                    &gEfiDiskIo2ProtocolGuid, &Instance->DiskIo2,
+                    &gEfiDiskIoProtocolGuid,        &Instance->DiskIo,
+                    &gEfiDiskIo2ProtocolGuid,       &Instance->DiskIo2,
+                    &gEdkiiDiskIoCacheProtocolGuid, &Instance->DiskIoCache,
                     NULL
                     );
   } else {
     Status = gBS->UninstallMultipleProtocolInterfaces (
                     ControllerHandle,
-                    &gEfiDiskIoProtocolGuid,  &Instance->DiskIo,
+                    &gEfiDiskIoProtocolGuid,        &Instance->DiskIo,
+                    &gEdkiiDiskIoCacheProtocolGuid, &Instance->DiskIoCache,
                     NULL
                     );
   }
@@ -320,6 +331,7 @@ DiskIoDriverBindingStop (
       Instance->SharedWorkingBuffer,
       EFI_SIZE_TO_PAGES (PcdGet32 (PcdDiskIoDataBufferBlockNum) * Instance->BlockIo->Media->BlockSize)
       );
+    DiskIoCacheFree (Instance);
 
     Status = gBS->CloseProtocol (
                     ControllerHandle,
@@ -833,6 +845,19 @@ DiskIo2ReadWriteDisk (
     //
     while (!DiskIo2RemoveCompletedTask (Instance));
 
+    //
+    // Small reads go through the block cache.
+    //
+    if (!Write) {
+      OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+      if (DiskIoCacheCanRead (Instance, MediaId, Offset, BufferSize)) {
+        Status = DiskIoCacheRead (Instance, MediaId, Offset, BufferSize, Buffer);
+        gBS->RestoreTPL (OldTpl);
+        return Status;
+      }
+      gBS->RestoreTPL (OldTpl);
+    }
+
     SubtasksPtr = &Subtasks;
   } else {
     DiskIo2RemoveCompletedTask (Instance);
@@ -863,6 +888,15 @@ DiskIo2ReadWriteDisk (
   ASSERT (!IsListEmpty (SubtasksPtr));
 
   OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+
+  //
+  // The data of a non-blocking write reaches the device later, discard the
+  // cached copy now. The blocking reads that fill the cache wait for it.
+  //
+  if (Write && !Blocking) {
+    DiskIoCacheWrite (Instance, Offset, BufferSize, NULL);
+  }
+
   for ( Link = GetFirstNode (SubtasksPtr), NextLink = GetNextNode (SubtasksPtr, Link)
       ; !IsNull (SubtasksPtr, Link)
       ; Link = NextLink, NextLink = GetNextNode (SubtasksPtr, NextLink)
@@ -978,6 +1012,10 @@ DiskIo2ReadWriteDisk (
     FreePool (Task);
   }
 
+  if (Write && Blocking) {
+    DiskIoCacheWrite (Instance, Offset, BufferSize, EFI_ERROR (Status) ? NULL : Buffer);
+  }
+
   gBS->RestoreTPL (OldTpl);
 
   return Status;
@@ -1114,6 +1152,12 @@ DiskIo2FlushDiskEx (
 
   Private = DISK_IO_PRIVATE_DATA_FROM_DISK_IO2 (This);
 
+  //
+  // The block cache is write-through, a flush only makes the following reads
+  // get the data from the device again.
+  //
+  DiskIoCacheInvalidate (&Private->DiskIoCache);
+
   if ((Token != NULL) && (Token->Event != NULL)) {
     Task = AllocatePool (sizeof (DISK_IO2_FLUSH_TASK));
     if (Task == NULL) {
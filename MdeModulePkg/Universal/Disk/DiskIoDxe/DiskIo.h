@@ -1,7 +1,7 @@
 /** @file
   Master header file for DiskIo driver. It includes the module private defininitions.
 
-Copyright (c) 2006 - 2018, Intel Corporation. All rights reserved.<BR>
+Copyright (c) 2006 - 2020, Intel Corporation. All rights reserved.<BR>
 SPDX-License-Identifier: BSD-2-Clause-Patent
 
 **/
@@ -16,6 +16,7 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include <Protocol/ComponentName.h>
 #include <Protocol/DriverBinding.h>
 #include <Protocol/DiskIo.h>
+#include <Protocol/DiskIoCache.h>
 #include <Library/DebugLib.h>
 #include <Library/UefiDriverEntryPoint.h>
 #include <Library/UefiLib.h>
@@ -23,6 +24,17 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include <Library/BaseMemoryLib.h>
 #include <Library/MemoryAllocationLib.h>
 #include <Library/UefiBootServicesTableLib.h>
+#include <Library/PcdLib.h>
+
+//
+// The size in bytes of a line of the block cache, rounded up to whole blocks.
+//
+#define DISK_IO_CACHE_LINE_SIZE         SIZE_4KB
+
+typedef struct {
+  UINT64                          Line;     /// < the line number, the byte offset divided by the line size
+  UINT64                          LastUsed; /// < the cache tick of the last access, 0 if the line is free
+} DISK_IO_CACHE_LINE;
 
 #define DISK_IO_PRIVATE_DATA_SIGNATURE  SIGNATURE_32 ('d', 's', 'k', 'I')
 typedef struct {
@@ -30,6 +42,7 @@ typedef struct {
 
   EFI_DISK_IO_PROTOCOL            DiskIo;
   EFI_DISK_IO2_PROTOCOL           DiskIo2;
+  EDKII_DISK_IO_CACHE_PROTOCOL    DiskIoCache;
   EFI_BLOCK_IO_PROTOCOL           *BlockIo;
   EFI_BLOCK_IO2_PROTOCOL          *BlockIo2;
 
@@ -37,9 +50,25 @@ typedef struct {
 
   EFI_LOCK                        TaskQueueLock;
   LIST_ENTRY                      TaskQueue;
+
+  //
+  // Block cache of the blocking reads. The lines and buffers are allocated
+  // by the first read that goes through the cache.
+  //
+  UINT32                          CacheLineCount;   /// < 0 if the device is not cached
+  UINT32                          CacheLineSize;
+  UINT32                          ReadAheadLines;   /// < lines read at once by sequential reads
+  DISK_IO_CACHE_LINE              *CacheLines;
+  UINT8                           *CacheBuffer;     /// < data of the lines
+  UINT8                           *CacheReadBuffer; /// < aligned buffer of ReadAheadLines lines
+  UINT64                          CacheTick;
+  UINT64                          LastReadLine;     /// < last line of the previous cached read
+  UINT32                          CacheMediaId;
+  EDKII_DISK_IO_CACHE_STATISTICS  CacheStatistics;
 } DISK_IO_PRIVATE_DATA;
-#define DISK_IO_PRIVATE_DATA_FROM_DISK_IO(a)  CR (a, DISK_IO_PRIVATE_DATA, DiskIo,  DISK_IO_PRIVATE_DATA_SIGNATURE)
-#define DISK_IO_PRIVATE_DATA_FROM_DISK_IO2(a) CR (a, DISK_IO_PRIVATE_DATA, DiskIo2, DISK_IO_PRIVATE_DATA_SIGNATURE)
+#define DISK_IO_PRIVATE_DATA_FROM_DISK_IO(a)       CR (a, DISK_IO_PRIVATE_DATA, DiskIo,  DISK_IO_PRIVATE_DATA_SIGNATURE)
+#define DISK_IO_PRIVATE_DATA_FROM_DISK_IO2(a)      CR (a, DISK_IO_PRIVATE_DATA, DiskIo2, DISK_IO_PRIVATE_DATA_SIGNATURE)
+#define DISK_IO_PRIVATE_DATA_FROM_DISK_IO_CACHE(a) CR (a, DISK_IO_PRIVATE_DATA, DiskIoCache, DISK_IO_PRIVATE_DATA_SIGNATURE)
 
 #define DISK_IO2_TASK_SIGNATURE   SIGNATURE_32 ('d', 'i', 'a', 't')
 typedef struct {
@@ -334,6 +363,126 @@ DiskIo2FlushDiskEx (
   IN OUT EFI_DISK_IO2_TOKEN       *Token
   );
 
+//
+// Block cache
+//
+/**
+  Initializes the block cache of the device. The cache is sized by
+  PcdDiskIoCacheSize and PcdDiskIoReadAheadSize, and left disabled if the PCD
+  disables it.
+
+  @param Instance    Pointer to the DISK_IO_PRIVATE_DATA.
+**/
+VOID
+DiskIoCacheInitialize (
+  IN DISK_IO_PRIVATE_DATA     *Instance
+  );
+
+/**
+  Frees the block cache of the device.
+
+  @param Instance    Pointer to the DISK_IO_PRIVATE_DATA.
+**/
+VOID
+DiskIoCacheFree (
+  IN DISK_IO_PRIVATE_DATA     *Instance
+  );
+
+/**
+  Checks whether a blocking read can go through the block cache. The first read
+  that can allocates the cache.
+
+  Reads that are larger than the read-ahead window, or that the device would
+  fail, go straight to the device.
+
+  @param Instance    Pointer to the DISK_IO_PRIVATE_DATA.
+  @param MediaId     ID of the medium to read.
+  @param Offset      The starting byte offset on the device to read from.
+  @param BufferSize  The number of bytes to read.
+
+  @retval TRUE       The read can go through the block cache.
+  @retval FALSE      The read has to go to the device.
+**/
+BOOLEAN
+DiskIoCacheCanRead (
+  IN DISK_IO_PRIVATE_DATA     *Instance,
+  IN UINT32                   MediaId,
+  IN UINT64                   Offset,
+  IN UINTN                    BufferSize
+  );
+
+/**
+  Reads through the block cache. The lines that are not cached are read from
+  the device, together with the lines that follow them if the reads are
+  sequential.
+
+  @param Instance    Pointer to the DISK_IO_PRIVATE_DATA.
+  @param MediaId     ID of the medium to read.
+  @param Offset      The starting byte offset on the device to read from.
+  @param BufferSize  The number of bytes to read.
+  @param Buffer      A pointer to the destination buffer for the data.
+
+  @retval EFI_SUCCESS The data was read.
+  @retval others      The device failed the read.
+**/
+EFI_STATUS
+DiskIoCacheRead (
+  IN DISK_IO_PRIVATE_DATA     *Instance,
+  IN UINT32                   MediaId,
+  IN UINT64                   Offset,
+  IN UINTN                    BufferSize,
+  OUT UINT8                   *Buffer
+  );
+
+/**
+  Updates the block cache for a write to the device. The cache is write-through,
+  so the cached lines get the written data, or are discarded if the data did
+  not make it to the device.
+
+  @param Instance    Pointer to the DISK_IO_PRIVATE_DATA.
+  @param Offset      The starting byte offset on the device written to.
+  @param BufferSize  The number of bytes written.
+  @param Buffer      The written data, or NULL to discard the cached lines.
+**/
+VOID
+DiskIoCacheWrite (
+  IN DISK_IO_PRIVATE_DATA     *Instance,
+  IN UINT64                   Offset,
+  IN UINTN                    BufferSize,
+  IN UINT8                    *Buffer     OPTIONAL
+  );
+
+/**
+  Returns the statistics of the block cache of the device.
+
+  @param  This                  Indicates a pointer to the calling context.
+  @param  Statistics            Returns the statistics.
+
+  @retval EFI_SUCCESS           The statistics were returned.
+  @retval EFI_INVALID_PARAMETER Statistics is NULL.
+
+**/
+EFI_STATUS
+EFIAPI
+DiskIoCacheGetStatistics (
+  IN  EDKII_DISK_IO_CACHE_PROTOCOL    *This,
+  OUT EDKII_DISK_IO_CACHE_STATISTICS  *Statistics
+  );
+
+/**
+  Discards all the data in the block cache of the device.
+
+  @param  This                  Indicates a pointer to the calling context.
+
+  @retval EFI_SUCCESS           The block cache was discarded.
+
+**/
+EFI_STATUS
+EFIAPI
+DiskIoCacheInvalidate (
+  IN EDKII_DISK_IO_CACHE_PROTOCOL     *This
+  );
+
 //
 // EFI Component Name Functions
 //
@@ -0,0 +1,448 @@
+/** @file
+  Block cache of the DiskIo driver.
+
+  File system drivers read their metadata through DiskIo in small pieces, each
+  of which would otherwise become a BlockIo request. The blocking reads that
+  are not larger than the read-ahead window go through a per-device cache of
+  DISK_IO_CACHE_LINE_SIZE lines, evicted least recently used first. A read
+  that misses the line that follows the previous read is taken as sequential,
+  and reads the whole read-ahead window with a single BlockIo request.
+
+  The cache is write-through: the writes through DiskIo go to the device as
+  before and update the cached lines, the flushes discard them. Devices with
+  removable media are not cached, since a media change is only noticed by the
+  BlockIo requests. Neither are partitions: their reads end up on the DiskIo
+  instance of the raw device, which caches them once.
+
+  The writes made through BlockIo directly are not seen, and leave stale lines
+  until the Invalidate() service of EDKII_DISK_IO_CACHE_PROTOCOL is called. The
+  cache is therefore disabled by default, PcdDiskIoCacheSize is 0, and only
+  platforms that can keep it coherent enable it.
+
+Copyright (c) 2020, Intel Corporation. All rights reserved.<BR>
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include "DiskIo.h"
+
+/**
+  Initializes the block cache of the device. The cache is sized by
+  PcdDiskIoCacheSize and PcdDiskIoReadAheadSize, and left disabled if the PCD
+  disables it.
+
+  @param Instance    Pointer to the DISK_IO_PRIVATE_DATA.
+**/
+VOID
+DiskIoCacheInitialize (
+  IN DISK_IO_PRIVATE_DATA     *Instance
+  )
+{
+  UINT32                      BlockSize;
+
+  BlockSize                 = Instance->BlockIo->Media->BlockSize;
+  Instance->CacheLineSize   = (DISK_IO_CACHE_LINE_SIZE + BlockSize - 1) / BlockSize * BlockSize;
+  Instance->CacheLineCount  = PcdGet32 (PcdDiskIoCacheSize) / Instance->CacheLineSize;
+  Instance->CacheLines      = NULL;
+  Instance->CacheBuffer     = NULL;
+  Instance->CacheReadBuffer = NULL;
+  Instance->CacheTick       = 0;
+  Instance->LastReadLine    = MAX_UINT64;
+  ZeroMem (&Instance->CacheStatistics, sizeof (Instance->CacheStatistics));
+
+  if ((Instance->CacheLineCount < 2) || Instance->BlockIo->Media->LogicalPartition) {
+    Instance->CacheLineCount = 0;
+    return;
+  }
+
+  //
+  // Keep a read-ahead from evicting more than half of the cache.
+  //
+  Instance->ReadAheadLines = PcdGet32 (PcdDiskIoReadAheadSize) / Instance->CacheLineSize;
+  Instance->ReadAheadLines = MIN (Instance->ReadAheadLines, Instance->CacheLineCount / 2);
+  Instance->ReadAheadLines = MAX (Instance->ReadAheadLines, 1);
+}
+
+/**
+  Frees the block cache of the device.
+
+  @param Instance    Pointer to the DISK_IO_PRIVATE_DATA.
+**/
+VOID
+DiskIoCacheFree (
+  IN DISK_IO_PRIVATE_DATA     *Instance
+  )
+{
+  if (Instance->CacheLines != NULL) {
+    FreePool (Instance->CacheLines);
+    Instance->CacheLines = NULL;
+  }
+  if (Instance->CacheBuffer != NULL) {
+    FreePool (Instance->CacheBuffer);
+    Instance->CacheBuffer = NULL;
+  }
+  if (Instance->CacheReadBuffer != NULL) {
+    FreeAlignedPages (
+      Instance->CacheReadBuffer,
+      EFI_SIZE_TO_PAGES (Instance->ReadAheadLines * Instance->CacheLineSize)
+      );
+    Instance->CacheReadBuffer = NULL;
+  }
+}
+
+/**
+  Discards all the cached lines.
+
+  @param Instance    Pointer to the DISK_IO_PRIVATE_DATA.
+**/
+VOID
+DiskIoCacheDiscard (
+  IN DISK_IO_PRIVATE_DATA     *Instance
+  )
+{
+  if (Instance->CacheLines != NULL) {
+    ZeroMem (Instance->CacheLines, Instance->CacheLineCount * sizeof (DISK_IO_CACHE_LINE));
+  }
+  Instance->LastReadLine = MAX_UINT64;
+}
+
+/**
+  Checks whether a blocking read can go through the block cache. The first read
+  that can allocates the cache.
+
+  Reads that are larger than the read-ahead window, or that the device would
+  fail, go straight to the device, and so do all the reads of a partition.
+
+  @param Instance    Pointer to the DISK_IO_PRIVATE_DATA.
+  @param MediaId     ID of the medium to read.
+  @param Offset      The starting byte offset on the device to read from.
+  @param BufferSize  The number of bytes to read.
+
+  @retval TRUE       The read can go through the block cache.
+  @retval FALSE      The read has to go to the device.
+**/
+BOOLEAN
+DiskIoCacheCanRead (
+  IN DISK_IO_PRIVATE_DATA     *Instance,
+  IN UINT32                   MediaId,
+  IN UINT64                   Offset,
+  IN UINTN                    BufferSize
+  )
+{
+  EFI_BLOCK_IO_MEDIA          *Media;
+  UINT64                      MediaSize;
+
+  Media = Instance->BlockIo->Media;
+
+  if ((Instance->CacheLineCount == 0) ||
+      (BufferSize == 0) || (BufferSize > Instance->ReadAheadLines * Instance->CacheLineSize) ||
+      Media->RemovableMedia || Media->LogicalPartition ||
+      !Media->MediaPresent || (MediaId != Media->MediaId)) {
+    return FALSE;
+  }
+
+  MediaSize = MultU64x32 (Media->LastBlock + 1, Media->BlockSize);
+  if ((Offset > MediaSize) || (BufferSize > MediaSize - Offset)) {
+    return FALSE;
+  }
+
+  if (Instance->CacheLines == NULL) {
+    Instance->CacheLines      = AllocateZeroPool (Instance->CacheLineCount * sizeof (DISK_IO_CACHE_LINE));
+    Instance->CacheBuffer     = AllocatePool (Instance->CacheLineCount * Instance->CacheLineSize);
+    Instance->CacheReadBuffer = AllocateAlignedPages (
+                                  EFI_SIZE_TO_PAGES (Instance->ReadAheadLines * Instance->CacheLineSize),
+                                  Media->IoAlign
+                                  );
+    if ((Instance->CacheLines == NULL) || (Instance->CacheBuffer == NULL) || (Instance->CacheReadBuffer == NULL)) {
+      DEBUG ((DEBUG_WARN, "DiskIo: No enough memory for the block cache, disable it\n"));
+      DiskIoCacheFree (Instance);
+      Instance->CacheLineCount = 0;
+      return FALSE;
+    }
+    Instance->CacheMediaId = Media->MediaId;
+  }
+
+  if (Instance->CacheMediaId != Media->MediaId) {
+    DiskIoCacheDiscard (Instance);
+    Instance->CacheMediaId = Media->MediaId;
+  }
+
+  return TRUE;
+}
+
+/**
+  Finds a line in the block cache.
+
+  @param Instance    Pointer to the DISK_IO_PRIVATE_DATA.
+  @param Line        The line number.
+
+  @return The cached line, or NULL if the line is not cached.
+**/
+DISK_IO_CACHE_LINE *
+DiskIoCacheLookup (
+  IN DISK_IO_PRIVATE_DATA     *Instance,
+  IN UINT64                   Line
+  )
+{
+  UINT32                      Index;
+
+  for (Index = 0; Index < Instance->CacheLineCount; Index++) {
+    if ((Instance->CacheLines[Index].LastUsed != 0) && (Instance->CacheLines[Index].Line == Line)) {
+      return &Instance->CacheLines[Index];
+    }
+  }
+
+  return NULL;
+}
+
+/**
+  Reads lines from the device into the block cache. The lines that are cached
+  already are refreshed, the others replace the least recently used lines.
+
+  @param Instance    Pointer to the DISK_IO_PRIVATE_DATA.
+  @param MediaId     ID of the medium to read.
+  @param Line        The first line number.
+  @param LineCount   The number of lines, at most ReadAheadLines.
+
+  @retval EFI_SUCCESS The lines were read.
+  @retval others      The device failed the read.
+**/
+EFI_STATUS
+DiskIoCacheFill (
+  IN DISK_IO_PRIVATE_DATA     *Instance,
+  IN UINT32                   MediaId,
+  IN UINT64                   Line,
+  IN UINT32                   LineCount
+  )
+{
+  EFI_STATUS                  Status;
+  EFI_BLOCK_IO_MEDIA          *Media;
+  UINT32                      LineBlocks;
+  UINT64                      Lba;
+  UINTN                       Blocks;
+  UINT32                      Index;
+  UINT32                      Victim;
+  DISK_IO_CACHE_LINE          *CacheLine;
+
+  ASSERT (LineCount <= Instance->ReadAheadLines);
+
+  Media      = Instance->BlockIo->Media;
+  LineBlocks = Instance->CacheLineSize / Media->BlockSize;
+  Lba        = MultU64x32 (Line, LineBlocks);
+  Blocks     = (UINTN) MIN ((UINT64) LineCount * LineBlocks, Media->LastBlock + 1 - Lba);
+
+  Status = Instance->BlockIo->ReadBlocks (
+                                Instance->BlockIo,
+                                MediaId,
+                                Lba,
+                                Blocks * Media->BlockSize,
+                                Instance->CacheReadBuffer
+                                );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (Blocks > LineBlocks) {
+    Instance->CacheStatistics.ReadAheadBlocks += Blocks - LineBlocks;
+  }
+
+  for (Index = 0; (UINTN) Index * LineBlocks < Blocks; Index++) {
+    CacheLine = DiskIoCacheLookup (Instance, Line + Index);
+    if (CacheLine == NULL) {
+      CacheLine = &Instance->CacheLines[0];
+      for (Victim = 1; Victim < Instance->CacheLineCount; Victim++) {
+        if (Instance->CacheLines[Victim].LastUsed < CacheLine->LastUsed) {
+          CacheLine = &Instance->CacheLines[Victim];
+        }
+      }
+      CacheLine->Line = Line + Index;
+    }
+    CacheLine->LastUsed = ++Instance->CacheTick;
+
+    //
+    // The last line of the device may be partial, its tail is never read.
+    //
+    CopyMem (
+      Instance->CacheBuffer + (CacheLine - Instance->CacheLines) * Instance->CacheLineSize,
+      Instance->CacheReadBuffer + Index * Instance->CacheLineSize,
+      MIN (Instance->CacheLineSize, (Blocks - Index * LineBlocks) * Media->BlockSize)
+      );
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Reads through the block cache. The lines that are not cached are read from
+  the device, together with the lines that follow them if the reads are
+  sequential.
+
+  @param Instance    Pointer to the DISK_IO_PRIVATE_DATA.
+  @param MediaId     ID of the medium to read.
+  @param Offset      The starting byte offset on the device to read from.
+  @param BufferSize  The number of bytes to read.
+  @param Buffer      A pointer to the destination buffer for the data.
+
+  @retval EFI_SUCCESS The data was read.
+  @retval others      The device failed the read.
+**/
+EFI_STATUS
+DiskIoCacheRead (
+  IN DISK_IO_PRIVATE_DATA     *Instance,
+  IN UINT32                   MediaId,
+  IN UINT64                   Offset,
+  IN UINTN                    BufferSize,
+  OUT UINT8                   *Buffer
+  )
+{
+  EFI_STATUS                  Status;
+  UINT64                      Line;
+  UINT32                      LineOffset;
+  UINTN                       Length;
+  DISK_IO_CACHE_LINE          *CacheLine;
+
+  Line = DivU64x32Remainder (Offset, Instance->CacheLineSize, &LineOffset);
+
+  while (BufferSize != 0) {
+    CacheLine = DiskIoCacheLookup (Instance, Line);
+    if (CacheLine != NULL) {
+      Instance->CacheStatistics.ReadHits++;
+      CacheLine->LastUsed = ++Instance->CacheTick;
+    } else {
+      Instance->CacheStatistics.ReadMisses++;
+      Status = DiskIoCacheFill (
+                 Instance,
+                 MediaId,
+                 Line,
+                 (Line == Instance->LastReadLine + 1) ? Instance->ReadAheadLines : 1
+                 );
+      if (EFI_ERROR (Status)) {
+        return Status;
+      }
+      CacheLine = DiskIoCacheLookup (Instance, Line);
+      ASSERT (CacheLine != NULL);
+    }
+
+    Length = MIN (BufferSize, Instance->CacheLineSize - LineOffset);
+    CopyMem (
+      Buffer,
+      Instance->CacheBuffer + (CacheLine - Instance->CacheLines) * Instance->CacheLineSize + LineOffset,
+      Length
+      );
+
+    Instance->LastReadLine = Line;
+    Buffer                += Length;
+    BufferSize            -= Length;
+    LineOffset             = 0;
+    Line++;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Updates the block cache for a write to the device. The cache is write-through,
+  so the cached lines get the written data, or are discarded if the data did
+  not make it to the device.
+
+  @param Instance    Pointer to the DISK_IO_PRIVATE_DATA.
+  @param Offset      The starting byte offset on the device written to.
+  @param BufferSize  The number of bytes written.
+  @param Buffer      The written data, or NULL to discard the cached lines.
+**/
+VOID
+DiskIoCacheWrite (
+  IN DISK_IO_PRIVATE_DATA     *Instance,
+  IN UINT64                   Offset,
+  IN UINTN                    BufferSize,
+  IN UINT8                    *Buffer     OPTIONAL
+  )
+{
+  UINT32                      Index;
+  DISK_IO_CACHE_LINE          *CacheLine;
+  UINT64                      Start;
+  UINT64                      End;
+
+  if ((Instance->CacheLines == NULL) || (BufferSize == 0)) {
+    return;
+  }
+
+  for (Index = 0; Index < Instance->CacheLineCount; Index++) {
+    CacheLine = &Instance->CacheLines[Index];
+    if (CacheLine->LastUsed == 0) {
+      continue;
+    }
+
+    Start = MultU64x32 (CacheLine->Line, Instance->CacheLineSize);
+    End   = Start + Instance->CacheLineSize;
+    if ((End <= Offset) || (Start >= Offset + BufferSize)) {
+      continue;
+    }
+
+    if (Buffer == NULL) {
+      CacheLine->LastUsed = 0;
+      continue;
+    }
+
+    Start = MAX (Start, Offset);
+    End   = MIN (End, Offset + BufferSize);
+    CopyMem (
+      Instance->CacheBuffer + Index * Instance->CacheLineSize + (UINTN) (Start - MultU64x32 (CacheLine->Line, Instance->CacheLineSize)),
+      Buffer + (UINTN) (Start - Offset),
+      (UINTN) (End - Start)
+      );
+  }
+}
+
+/**
+  Returns the statistics of the block cache of the device.
+
+  @param  This                  Indicates a pointer to the calling context.
+  @param  Statistics            Returns the statistics.
+
+  @retval EFI_SUCCESS           The statistics were returned.
+  @retval EFI_INVALID_PARAMETER Statistics is NULL.
+
+**/
+EFI_STATUS
+EFIAPI
+DiskIoCacheGetStatistics (
+  IN  EDKII_DISK_IO_CACHE_PROTOCOL    *This,
+  OUT EDKII_DISK_IO_CACHE_STATISTICS  *Statistics
+  )
+{
+  DISK_IO_PRIVATE_DATA                *Instance;
+
+  if (Statistics == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Instance = DISK_IO_PRIVATE_DATA_FROM_DISK_IO_CACHE (This);
+  CopyMem (Statistics, &Instance->CacheStatistics, sizeof (*Statistics));
+  Statistics->CacheSize = MultU64x32 (Instance->CacheLineCount, Instance->CacheLineSize);
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Discards all the data in the block cache of the device.
+
+  @param  This                  Indicates a pointer to the calling context.
+
+  @retval EFI_SUCCESS           The block cache was discarded.
+
+**/
+EFI_STATUS
+EFIAPI
+DiskIoCacheInvalidate (
+  IN EDKII_DISK_IO_CACHE_PROTOCOL     *This
+  )
+{
+  EFI_TPL                             OldTpl;
+
+  OldTpl = gBS->RaiseTPL (TPL_CALLBACK);
+  DiskIoCacheDiscard (DISK_IO_PRIVATE_DATA_FROM_DISK_IO_CACHE (This));
+  gBS->RestoreTPL (OldTpl);
+
+  return EFI_SUCCESS;
+}
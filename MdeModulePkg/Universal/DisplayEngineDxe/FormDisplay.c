@@ -1,7 +1,7 @@
 /** @file
 Entry and initialization module for the browser.
 
-Copyright (c) 2007 - 2018, Intel Corporation. All rights reserved.<BR>
+Copyright (c) 2007 - 2020, Intel Corporation. All rights reserved.<BR>
 Copyright (c) 2014, Hewlett-Packard Development Company, L.P.<BR>
 SPDX-License-Identifier: BSD-2-Clause-Patent
 
@@ -4046,6 +4046,12 @@ FormDisplay (
   gUserInput = UserInputData;
   gFormData  = FormData;
 
+  //
+  // Draw the form through the shadow console, so that only the cells which
+  // change are written to the console output.
+  //
+  ShadowConsoleEnable ();
+
   //
   // Process the status info first.
   //
@@ -4054,11 +4060,13 @@ FormDisplay (
     //
     // gFormData->BrowserStatus != BROWSER_SUCCESS, means only need to print the error info, return here.
     //
+    ShadowConsoleDisable ();
     return EFI_SUCCESS;
   }
 
   Status = DisplayPageFrame (FormData, &gStatementDimensions);
   if (EFI_ERROR (Status)) {
+    ShadowConsoleDisable ();
     return Status;
   }
 
@@ -4104,6 +4112,8 @@ FormDisplay (
   //
   FreeMenuOptionData(&gMenuOption);
 
+  ShadowConsoleDisable ();
+
   return Status;
 }
 
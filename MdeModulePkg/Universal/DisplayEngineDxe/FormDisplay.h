@@ -1,7 +1,7 @@
 /** @file
   FormDiplay protocol to show Form
 
-Copyright (c) 2013 - 2018, Intel Corporation. All rights reserved.<BR>
+Copyright (c) 2013 - 2020, Intel Corporation. All rights reserved.<BR>
 SPDX-License-Identifier: BSD-2-Clause-Patent
 
 **/
@@ -738,4 +738,24 @@ CreatePopup (
   OUT EFI_HII_POPUP_SELECTION *UserSelection OPTIONAL
   );
 
+/**
+  Replace the console input and output of the system table with the shadow
+  console, which stays in place until ShadowConsoleDisable() is called.
+
+**/
+VOID
+ShadowConsoleEnable (
+  VOID
+  );
+
+/**
+  Flush the shadow console to the screen, and put the console input and output
+  of the system table back.
+
+**/
+VOID
+ShadowConsoleDisable (
+  VOID
+  );
+
 #endif
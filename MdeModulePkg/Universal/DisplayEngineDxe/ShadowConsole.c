@@ -0,0 +1,804 @@
+/** @file
+Shadow buffer of the console output used while a form is displayed.
+
+The form display engine repaints whole lines, and often whole areas, of the
+screen for every key stroke, although only a few cells change. While a form is
+displayed, the console output of the system table is replaced by a shadow
+console which draws into a buffer of characters and attributes instead, and
+tracks the dirty columns of each row. The buffer is flushed to the real console
+output whenever a key stroke is read, which is when the screen must be up to
+date, and only the cells which differ from the ones on the screen are written.
+
+Output which the buffer cannot model, like scrolling or wide characters, is
+passed through to the real console output after a flush, and the cells on the
+screen are treated as unknown from then on.
+
+Copyright (c) 2020, Intel Corporation. All rights reserved.<BR>
+SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include "FormDisplay.h"
+
+//
+// Unchanged cells between two changed ones are written again rather than
+// moving the cursor over them, if there are no more of them than this.
+//
+#define SHADOW_CONSOLE_MAX_GAP    4
+
+typedef struct {
+  CHAR16                             Char;     // 0 if unknown
+  UINT16                             Attribute;
+} SHADOW_CONSOLE_CELL;
+
+typedef struct {
+  EFI_SIMPLE_TEXT_OUTPUT_PROTOCOL    TextOut;
+  EFI_SIMPLE_TEXT_INPUT_PROTOCOL     TextIn;
+  EFI_SIMPLE_TEXT_OUTPUT_MODE        Mode;
+  EFI_SIMPLE_TEXT_OUTPUT_PROTOCOL    *ConOut;
+  EFI_SIMPLE_TEXT_INPUT_PROTOCOL     *ConIn;
+  UINTN                              Columns;
+  UINTN                              Rows;
+  SHADOW_CONSOLE_CELL                *Back;       // cells as drawn by the display engine
+  SHADOW_CONSOLE_CELL                *Front;      // cells as on the screen
+  UINTN                              *DirtyLeft;  // first dirty column of each row
+  UINTN                              *DirtyRight; // last dirty column of each row
+  CHAR16                             *Line;
+  UINTN                              BytesWritten;
+} SHADOW_CONSOLE;
+
+SHADOW_CONSOLE  mShadowConsole;
+
+/**
+  Free the buffers of the shadow console, after which all output is passed
+  through to the real console output.
+
+**/
+VOID
+ShadowConsoleFreeBuffers (
+  VOID
+  )
+{
+  if (mShadowConsole.Back != NULL) {
+    FreePool (mShadowConsole.Back);
+  }
+  if (mShadowConsole.Front != NULL) {
+    FreePool (mShadowConsole.Front);
+  }
+  if (mShadowConsole.DirtyLeft != NULL) {
+    FreePool (mShadowConsole.DirtyLeft);
+  }
+  if (mShadowConsole.DirtyRight != NULL) {
+    FreePool (mShadowConsole.DirtyRight);
+  }
+  if (mShadowConsole.Line != NULL) {
+    FreePool (mShadowConsole.Line);
+  }
+  mShadowConsole.Back       = NULL;
+  mShadowConsole.Front      = NULL;
+  mShadowConsole.DirtyLeft  = NULL;
+  mShadowConsole.DirtyRight = NULL;
+  mShadowConsole.Line       = NULL;
+}
+
+/**
+  Mark all rows of the shadow console clean.
+
+**/
+VOID
+ShadowConsoleCleanRows (
+  VOID
+  )
+{
+  UINTN  Row;
+
+  for (Row = 0; Row < mShadowConsole.Rows; Row++) {
+    mShadowConsole.DirtyLeft[Row]  = mShadowConsole.Columns;
+    mShadowConsole.DirtyRight[Row] = 0;
+  }
+}
+
+/**
+  Allocate the buffers of the shadow console for the current mode of the real
+  console output. All cells start out unknown.
+
+**/
+VOID
+ShadowConsoleAllocateBuffers (
+  VOID
+  )
+{
+  EFI_STATUS  Status;
+  UINTN       Cells;
+
+  ShadowConsoleFreeBuffers ();
+
+  Status = mShadowConsole.ConOut->QueryMode (
+                                    mShadowConsole.ConOut,
+                                    mShadowConsole.ConOut->Mode->Mode,
+                                    &mShadowConsole.Columns,
+                                    &mShadowConsole.Rows
+                                    );
+  if (EFI_ERROR (Status) || mShadowConsole.Columns == 0 || mShadowConsole.Rows == 0) {
+    return;
+  }
+
+  Cells = mShadowConsole.Columns * mShadowConsole.Rows;
+  mShadowConsole.Back       = AllocateZeroPool (Cells * sizeof (SHADOW_CONSOLE_CELL));
+  mShadowConsole.Front      = AllocateZeroPool (Cells * sizeof (SHADOW_CONSOLE_CELL));
+  mShadowConsole.DirtyLeft  = AllocatePool (mShadowConsole.Rows * sizeof (UINTN));
+  mShadowConsole.DirtyRight = AllocatePool (mShadowConsole.Rows * sizeof (UINTN));
+  mShadowConsole.Line       = AllocatePool ((mShadowConsole.Columns + 1) * sizeof (CHAR16));
+  if (mShadowConsole.Back == NULL || mShadowConsole.Front == NULL || mShadowConsole.DirtyLeft == NULL ||
+      mShadowConsole.DirtyRight == NULL || mShadowConsole.Line == NULL) {
+    ShadowConsoleFreeBuffers ();
+    return;
+  }
+
+  ShadowConsoleCleanRows ();
+}
+
+/**
+  Copy the mode of the real console output to the shadow console.
+
+**/
+VOID
+ShadowConsoleSyncMode (
+  VOID
+  )
+{
+  CopyMem (&mShadowConsole.Mode, mShadowConsole.ConOut->Mode, sizeof (EFI_SIMPLE_TEXT_OUTPUT_MODE));
+}
+
+/**
+  Write the dirty cells which differ from the screen to the real console
+  output, and move the cursor of the real console output to the one of the
+  shadow console.
+
+**/
+VOID
+ShadowConsoleFlush (
+  VOID
+  )
+{
+  EFI_SIMPLE_TEXT_OUTPUT_PROTOCOL  *ConOut;
+  SHADOW_CONSOLE_CELL              *Back;
+  SHADOW_CONSOLE_CELL              *Front;
+  UINTN                            Row;
+  UINTN                            Column;
+  UINTN                            Start;
+  UINTN                            End;
+  UINTN                            Next;
+
+  ConOut = mShadowConsole.ConOut;
+
+  if (mShadowConsole.Back != NULL) {
+    for (Row = 0; Row < mShadowConsole.Rows; Row++) {
+      Back  = mShadowConsole.Back  + Row * mShadowConsole.Columns;
+      Front = mShadowConsole.Front + Row * mShadowConsole.Columns;
+      for (Column = mShadowConsole.DirtyLeft[Row]; Column <= mShadowConsole.DirtyRight[Row]; Column++) {
+        if (Back[Column].Char == Front[Column].Char && Back[Column].Attribute == Front[Column].Attribute) {
+          continue;
+        }
+
+        //
+        // Write the changed cells of one attribute in one go, together with the
+        // short runs of unchanged cells between them.
+        //
+        Start = Column;
+        End   = Column;
+        for (Next = Start + 1;
+             Next <= mShadowConsole.DirtyRight[Row] && Next - End <= SHADOW_CONSOLE_MAX_GAP &&
+             Back[Next].Char != 0 && Back[Next].Attribute == Back[Start].Attribute;
+             Next++) {
+          if (Back[Next].Char != Front[Next].Char || Back[Next].Attribute != Front[Next].Attribute) {
+            End = Next;
+          }
+        }
+
+        for (Next = Start; Next <= End; Next++) {
+          mShadowConsole.Line[Next - Start] = Back[Next].Char;
+          Front[Next] = Back[Next];
+        }
+        mShadowConsole.Line[End - Start + 1] = CHAR_NULL;
+
+        if (ConOut->Mode->CursorColumn != (INT32) Start || ConOut->Mode->CursorRow != (INT32) Row) {
+          ConOut->SetCursorPosition (ConOut, Start, Row);
+        }
+        if (ConOut->Mode->Attribute != (INT32) Back[Start].Attribute) {
+          ConOut->SetAttribute (ConOut, Back[Start].Attribute);
+        }
+        ConOut->OutputString (ConOut, mShadowConsole.Line);
+        mShadowConsole.BytesWritten += (End - Start + 1) * sizeof (CHAR16);
+
+        Column = End;
+      }
+    }
+    ShadowConsoleCleanRows ();
+  }
+
+  if (ConOut->Mode->Attribute != mShadowConsole.Mode.Attribute) {
+    ConOut->SetAttribute (ConOut, mShadowConsole.Mode.Attribute);
+  }
+  if (ConOut->Mode->CursorColumn != mShadowConsole.Mode.CursorColumn ||
+      ConOut->Mode->CursorRow != mShadowConsole.Mode.CursorRow) {
+    ConOut->SetCursorPosition (ConOut, mShadowConsole.Mode.CursorColumn, mShadowConsole.Mode.CursorRow);
+  }
+  if (ConOut->Mode->CursorVisible != mShadowConsole.Mode.CursorVisible) {
+    ConOut->EnableCursor (ConOut, mShadowConsole.Mode.CursorVisible);
+  }
+}
+
+/**
+  Forget the cells on the screen, after output which the shadow console does
+  not model was written to the real console output, and take over its mode.
+
+**/
+VOID
+ShadowConsoleInvalidate (
+  VOID
+  )
+{
+  if (mShadowConsole.Back != NULL) {
+    ZeroMem (mShadowConsole.Back, mShadowConsole.Columns * mShadowConsole.Rows * sizeof (SHADOW_CONSOLE_CELL));
+    ZeroMem (mShadowConsole.Front, mShadowConsole.Columns * mShadowConsole.Rows * sizeof (SHADOW_CONSOLE_CELL));
+  }
+  ShadowConsoleSyncMode ();
+}
+
+/**
+  Check whether the shadow console can draw a string at the cursor position.
+  It cannot if the string would scroll the screen, switches between narrow and
+  wide characters, or has control characters other than carriage return and
+  line feed.
+
+  @param  String                 The string to draw.
+
+  @retval TRUE                   The shadow console can draw the string.
+  @retval FALSE                  The string must be passed through.
+
+**/
+BOOLEAN
+ShadowConsoleCanDraw (
+  IN CHAR16                          *String
+  )
+{
+  UINTN  Column;
+  UINTN  Row;
+
+  if (mShadowConsole.Back == NULL || (mShadowConsole.Mode.Attribute & EFI_WIDE_ATTRIBUTE) != 0) {
+    return FALSE;
+  }
+
+  Column = (UINTN) mShadowConsole.Mode.CursorColumn;
+  Row    = (UINTN) mShadowConsole.Mode.CursorRow;
+  for (; *String != CHAR_NULL; String++) {
+    if (*String == CHAR_CARRIAGE_RETURN) {
+      Column = 0;
+    } else if (*String == CHAR_LINEFEED) {
+      if (Row + 1 >= mShadowConsole.Rows) {
+        return FALSE;
+      }
+      Row++;
+    } else if (*String < L' ' || *String == WIDE_CHAR || *String == NARROW_CHAR) {
+      return FALSE;
+    } else {
+      if (Column + 1 >= mShadowConsole.Columns && Row + 1 >= mShadowConsole.Rows) {
+        return FALSE;
+      }
+      Column++;
+      if (Column == mShadowConsole.Columns) {
+        Column = 0;
+        Row++;
+      }
+    }
+  }
+
+  return TRUE;
+}
+
+/**
+  Draw a string at the cursor position into the shadow console, which is
+  known to be able to draw it.
+
+  @param  String                 The string to draw.
+
+**/
+VOID
+ShadowConsoleDraw (
+  IN CHAR16                          *String
+  )
+{
+  SHADOW_CONSOLE_CELL  *Cell;
+  UINTN                Column;
+  UINTN                Row;
+
+  Column = (UINTN) mShadowConsole.Mode.CursorColumn;
+  Row    = (UINTN) mShadowConsole.Mode.CursorRow;
+  for (; *String != CHAR_NULL; String++) {
+    if (*String == CHAR_CARRIAGE_RETURN) {
+      Column = 0;
+    } else if (*String == CHAR_LINEFEED) {
+      Row++;
+    } else {
+      Cell = &mShadowConsole.Back[Row * mShadowConsole.Columns + Column];
+      Cell->Char      = *String;
+      Cell->Attribute = (UINT16) mShadowConsole.Mode.Attribute;
+      mShadowConsole.DirtyLeft[Row]  = MIN (mShadowConsole.DirtyLeft[Row], Column);
+      mShadowConsole.DirtyRight[Row] = MAX (mShadowConsole.DirtyRight[Row], Column);
+      Column++;
+      if (Column == mShadowConsole.Columns) {
+        Column = 0;
+        Row++;
+      }
+    }
+  }
+
+  mShadowConsole.Mode.CursorColumn = (INT32) Column;
+  mShadowConsole.Mode.CursorRow    = (INT32) Row;
+}
+
+/**
+  Reset the text output device hardware, through the real console output.
+
+  @param  This                   The protocol instance pointer.
+  @param  ExtendedVerification   Driver may perform more exhaustive verification
+                                 operation of the device during reset.
+
+  @retval EFI_SUCCESS            The text output device was reset.
+  @retval EFI_DEVICE_ERROR       The text output device is not functioning correctly and
+                                 could not be reset.
+
+**/
+EFI_STATUS
+EFIAPI
+ShadowConsoleReset (
+  IN EFI_SIMPLE_TEXT_OUTPUT_PROTOCOL *This,
+  IN BOOLEAN                         ExtendedVerification
+  )
+{
+  EFI_STATUS  Status;
+  EFI_TPL     OldTpl;
+
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+  ShadowConsoleFlush ();
+  Status = mShadowConsole.ConOut->Reset (mShadowConsole.ConOut, ExtendedVerification);
+  ShadowConsoleAllocateBuffers ();
+  ShadowConsoleInvalidate ();
+  gBS->RestoreTPL (OldTpl);
+
+  return Status;
+}
+
+/**
+  Write a string to the shadow console. Output from event notification
+  functions is flushed to the screen right away, since the display engine may
+  be waiting for an event rather than for a key stroke.
+
+  @param  This                   The protocol instance pointer.
+  @param  String                 The NULL-terminated string to be displayed on the output
+                                 device(s).
+
+  @retval EFI_SUCCESS            The string was output to the device.
+  @retval EFI_DEVICE_ERROR       The device reported an error while attempting to output
+                                 the text.
+  @retval EFI_UNSUPPORTED        The output device's mode is not currently in a
+                                 defined text mode.
+  @retval EFI_WARN_UNKNOWN_GLYPH This warning code indicates that some of the
+                                 characters in the string could not be
+                                 rendered and were skipped.
+
+**/
+EFI_STATUS
+EFIAPI
+ShadowConsoleOutputString (
+  IN EFI_SIMPLE_TEXT_OUTPUT_PROTOCOL *This,
+  IN CHAR16                          *String
+  )
+{
+  EFI_STATUS  Status;
+  EFI_TPL     OldTpl;
+
+  Status = EFI_SUCCESS;
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+  if (ShadowConsoleCanDraw (String)) {
+    ShadowConsoleDraw (String);
+    if (OldTpl != TPL_APPLICATION) {
+      ShadowConsoleFlush ();
+    }
+  } else {
+    ShadowConsoleFlush ();
+    Status = mShadowConsole.ConOut->OutputString (mShadowConsole.ConOut, String);
+    mShadowConsole.BytesWritten += StrLen (String) * sizeof (CHAR16);
+    ShadowConsoleInvalidate ();
+  }
+  gBS->RestoreTPL (OldTpl);
+
+  return Status;
+}
+
+/**
+  Verify that all characters in a string can be output to the target device,
+  through the real console output.
+
+  @param  This                   The protocol instance pointer.
+  @param  String                 The NULL-terminated string to be examined for the output
+                                 device(s).
+
+  @retval EFI_SUCCESS            The device(s) are capable of rendering the output string.
+  @retval EFI_UNSUPPORTED        Some of the characters in the string cannot be
+                                 rendered by one or more of the output devices mapped
+                                 by the EFI handle.
+
+**/
+EFI_STATUS
+EFIAPI
+ShadowConsoleTestString (
+  IN EFI_SIMPLE_TEXT_OUTPUT_PROTOCOL *This,
+  IN CHAR16                          *String
+  )
+{
+  return mShadowConsole.ConOut->TestString (mShadowConsole.ConOut, String);
+}
+
+/**
+  Return information for an available text mode, through the real console
+  output.
+
+  @param  This                   The protocol instance pointer.
+  @param  ModeNumber             The mode number to return information on.
+  @param  Columns                Returns the geometry of the text output device for the
+                                 requested ModeNumber.
+  @param  Rows                   Returns the geometry of the text output device for the
+                                 requested ModeNumber.
+
+  @retval EFI_SUCCESS            The requested mode information was returned.
+  @retval EFI_DEVICE_ERROR       The device had an error and could not complete the request.
+  @retval EFI_UNSUPPORTED        The mode number was not valid.
+
+**/
+EFI_STATUS
+EFIAPI
+ShadowConsoleQueryMode (
+  IN EFI_SIMPLE_TEXT_OUTPUT_PROTOCOL *This,
+  IN UINTN                           ModeNumber,
+  OUT UINTN                          *Columns,
+  OUT UINTN                          *Rows
+  )
+{
+  return mShadowConsole.ConOut->QueryMode (mShadowConsole.ConOut, ModeNumber, Columns, Rows);
+}
+
+/**
+  Set the output device(s) to a specified mode, through the real console
+  output.
+
+  @param  This                   The protocol instance pointer.
+  @param  ModeNumber             The mode number to set.
+
+  @retval EFI_SUCCESS            The requested text mode was set.
+  @retval EFI_DEVICE_ERROR       The device had an error and could not complete the request.
+  @retval EFI_UNSUPPORTED        The mode number was not valid.
+
+**/
+EFI_STATUS
+EFIAPI
+ShadowConsoleSetMode (
+  IN EFI_SIMPLE_TEXT_OUTPUT_PROTOCOL *This,
+  IN UINTN                           ModeNumber
+  )
+{
+  EFI_STATUS  Status;
+  EFI_TPL     OldTpl;
+
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+  ShadowConsoleFlush ();
+  Status = mShadowConsole.ConOut->SetMode (mShadowConsole.ConOut, ModeNumber);
+  ShadowConsoleAllocateBuffers ();
+  ShadowConsoleInvalidate ();
+  gBS->RestoreTPL (OldTpl);
+
+  return Status;
+}
+
+/**
+  Set the background and foreground colors for the OutputString() and
+  ClearScreen() functions of the shadow console.
+
+  @param  This                   The protocol instance pointer.
+  @param  Attribute              The attribute to set. Bits 0..3 are the foreground color, and
+                                 bits 4..6 are the background color. All other bits are undefined
+                                 and must be zero. The valid Attributes are defined in this file.
+
+  @retval EFI_SUCCESS            The attribute was set.
+  @retval EFI_DEVICE_ERROR       The device had an error and could not complete the request.
+  @retval EFI_UNSUPPORTED        The attribute requested is not defined.
+
+**/
+EFI_STATUS
+EFIAPI
+ShadowConsoleSetAttribute (
+  IN EFI_SIMPLE_TEXT_OUTPUT_PROTOCOL *This,
+  IN UINTN                           Attribute
+  )
+{
+  EFI_STATUS  Status;
+  EFI_TPL     OldTpl;
+
+  Status = EFI_SUCCESS;
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+  if ((Attribute | 0x7F) == 0x7F) {
+    mShadowConsole.Mode.Attribute = (INT32) Attribute;
+  } else {
+    ShadowConsoleFlush ();
+    Status = mShadowConsole.ConOut->SetAttribute (mShadowConsole.ConOut, Attribute);
+    ShadowConsoleSyncMode ();
+  }
+  gBS->RestoreTPL (OldTpl);
+
+  return Status;
+}
+
+/**
+  Clear the output device(s) display to the currently selected background
+  color. The screen is cleared right away, so that the cells on the screen are
+  known to be blank afterwards.
+
+  @param  This                   The protocol instance pointer.
+
+  @retval EFI_SUCCESS            The operation completed successfully.
+  @retval EFI_DEVICE_ERROR       The device had an error and could not complete the request.
+  @retval EFI_UNSUPPORTED        The output device is not in a valid text mode.
+
+**/
+EFI_STATUS
+EFIAPI
+ShadowConsoleClearScreen (
+  IN EFI_SIMPLE_TEXT_OUTPUT_PROTOCOL *This
+  )
+{
+  EFI_STATUS  Status;
+  EFI_TPL     OldTpl;
+  UINTN       Index;
+
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+  if (mShadowConsole.ConOut->Mode->Attribute != mShadowConsole.Mode.Attribute) {
+    mShadowConsole.ConOut->SetAttribute (mShadowConsole.ConOut, mShadowConsole.Mode.Attribute);
+  }
+  Status = mShadowConsole.ConOut->ClearScreen (mShadowConsole.ConOut);
+  if (!EFI_ERROR (Status) && mShadowConsole.Back != NULL) {
+    for (Index = 0; Index < mShadowConsole.Columns * mShadowConsole.Rows; Index++) {
+      mShadowConsole.Back[Index].Char      = L' ';
+      mShadowConsole.Back[Index].Attribute = (UINT16) mShadowConsole.Mode.Attribute;
+    }
+    CopyMem (mShadowConsole.Front, mShadowConsole.Back, mShadowConsole.Columns * mShadowConsole.Rows * sizeof (SHADOW_CONSOLE_CELL));
+    ShadowConsoleCleanRows ();
+    mShadowConsole.Mode.CursorColumn = 0;
+    mShadowConsole.Mode.CursorRow    = 0;
+  } else {
+    ShadowConsoleInvalidate ();
+  }
+  gBS->RestoreTPL (OldTpl);
+
+  return Status;
+}
+
+/**
+  Set the current coordinates of the cursor position of the shadow console.
+
+  @param  This                   The protocol instance pointer.
+  @param  Column                 The position to set the cursor to. Must be greater than or
+                                 equal to zero and less than the number of columns and rows
+                                 by QueryMode ().
+  @param  Row                    The position to set the cursor to. Must be greater than or
+                                 equal to zero and less than the number of columns and rows
+                                 by QueryMode ().
+
+  @retval EFI_SUCCESS            The operation completed successfully.
+  @retval EFI_DEVICE_ERROR       The device had an error and could not complete the request.
+  @retval EFI_UNSUPPORTED        The output device is not in a valid text mode, or the
+                                 cursor position is invalid for the current mode.
+
+**/
+EFI_STATUS
+EFIAPI
+ShadowConsoleSetCursorPosition (
+  IN EFI_SIMPLE_TEXT_OUTPUT_PROTOCOL *This,
+  IN UINTN                           Column,
+  IN UINTN                           Row
+  )
+{
+  EFI_STATUS  Status;
+  EFI_TPL     OldTpl;
+
+  Status = EFI_SUCCESS;
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+  if (mShadowConsole.Back == NULL) {
+    ShadowConsoleFlush ();
+    Status = mShadowConsole.ConOut->SetCursorPosition (mShadowConsole.ConOut, Column, Row);
+    ShadowConsoleSyncMode ();
+  } else if (Column >= mShadowConsole.Columns || Row >= mShadowConsole.Rows) {
+    Status = EFI_UNSUPPORTED;
+  } else {
+    mShadowConsole.Mode.CursorColumn = (INT32) Column;
+    mShadowConsole.Mode.CursorRow    = (INT32) Row;
+    if (OldTpl != TPL_APPLICATION) {
+      ShadowConsoleFlush ();
+    }
+  }
+  gBS->RestoreTPL (OldTpl);
+
+  return Status;
+}
+
+/**
+  Make the cursor of the shadow console visible or not.
+
+  @param  This                   The protocol instance pointer.
+  @param  Visible                If TRUE, the cursor is set to be visible. If FALSE, the cursor is
+                                 set to be invisible.
+
+  @retval EFI_SUCCESS            The operation completed successfully.
+  @retval EFI_DEVICE_ERROR       The device had an error and could not complete the
+                                 request, or the device does not support changing
+                                 the cursor mode.
+  @retval EFI_UNSUPPORTED        The output device is not in a valid text mode.
+
+**/
+EFI_STATUS
+EFIAPI
+ShadowConsoleEnableCursor (
+  IN EFI_SIMPLE_TEXT_OUTPUT_PROTOCOL *This,
+  IN BOOLEAN                         Visible
+  )
+{
+  EFI_TPL  OldTpl;
+
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+  mShadowConsole.Mode.CursorVisible = Visible;
+  if (OldTpl != TPL_APPLICATION) {
+    ShadowConsoleFlush ();
+  }
+  gBS->RestoreTPL (OldTpl);
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Reset the input device, through the real console input.
+
+  @param  This                 The EFI_SIMPLE_TEXT_INPUT_PROTOCOL instance.
+  @param  ExtendedVerification Indicates that the driver may perform a more exhaustive
+                               verification operation of the device during reset.
+
+  @retval EFI_SUCCESS          The device was reset.
+  @retval EFI_DEVICE_ERROR     The device is not functioning properly and could not be reset.
+
+**/
+EFI_STATUS
+EFIAPI
+ShadowConsoleInputReset (
+  IN EFI_SIMPLE_TEXT_INPUT_PROTOCOL  *This,
+  IN BOOLEAN                         ExtendedVerification
+  )
+{
+  return mShadowConsole.ConIn->Reset (mShadowConsole.ConIn, ExtendedVerification);
+}
+
+/**
+  Read the next keystroke from the real console input, after bringing the
+  screen up to date with the shadow console. The display engine always tries
+  to read a key before it waits for one.
+
+  @param  This  The EFI_SIMPLE_TEXT_INPUT_PROTOCOL instance.
+  @param  Key   A pointer to a buffer that is filled in with the keystroke
+                information for the key that was pressed.
+
+  @retval EFI_SUCCESS      The keystroke information was returned.
+  @retval EFI_NOT_READY    There was no keystroke data available.
+  @retval EFI_DEVICE_ERROR The keystroke information was not returned due to
+                           hardware errors.
+
+**/
+EFI_STATUS
+EFIAPI
+ShadowConsoleReadKeyStroke (
+  IN  EFI_SIMPLE_TEXT_INPUT_PROTOCOL  *This,
+  OUT EFI_INPUT_KEY                   *Key
+  )
+{
+  EFI_STATUS  Status;
+  EFI_TPL     OldTpl;
+
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+  ShadowConsoleFlush ();
+  gBS->RestoreTPL (OldTpl);
+
+  Status = mShadowConsole.ConIn->ReadKeyStroke (mShadowConsole.ConIn, Key);
+  if (!EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_VERBOSE, "DisplayEngine: %Lu bytes written to ConOut before key %x/%x\n",
+      (UINT64) mShadowConsole.BytesWritten, Key->ScanCode, Key->UnicodeChar));
+    mShadowConsole.BytesWritten = 0;
+  }
+
+  return Status;
+}
+
+/**
+  Replace the console input and output of the system table with the shadow
+  console, which stays in place until ShadowConsoleDisable() is called.
+
+**/
+VOID
+ShadowConsoleEnable (
+  VOID
+  )
+{
+  if (!FeaturePcdGet (PcdDisplayEngineShadowConsole) || mShadowConsole.ConOut != NULL) {
+    return;
+  }
+
+  mShadowConsole.ConOut = gST->ConOut;
+  mShadowConsole.ConIn  = gST->ConIn;
+
+  mShadowConsole.TextOut.Reset             = ShadowConsoleReset;
+  mShadowConsole.TextOut.OutputString      = ShadowConsoleOutputString;
+  mShadowConsole.TextOut.TestString        = ShadowConsoleTestString;
+  mShadowConsole.TextOut.QueryMode         = ShadowConsoleQueryMode;
+  mShadowConsole.TextOut.SetMode           = ShadowConsoleSetMode;
+  mShadowConsole.TextOut.SetAttribute      = ShadowConsoleSetAttribute;
+  mShadowConsole.TextOut.ClearScreen       = ShadowConsoleClearScreen;
+  mShadowConsole.TextOut.SetCursorPosition = ShadowConsoleSetCursorPosition;
+  mShadowConsole.TextOut.EnableCursor      = ShadowConsoleEnableCursor;
+  mShadowConsole.TextOut.Mode              = &mShadowConsole.Mode;
+  mShadowConsole.TextIn.Reset              = ShadowConsoleInputReset;
+  mShadowConsole.TextIn.ReadKeyStroke      = ShadowConsoleReadKeyStroke;
+  mShadowConsole.TextIn.WaitForKey         = mShadowConsole.ConIn->WaitForKey;
+
+  ShadowConsoleAllocateBuffers ();
+  ShadowConsoleSyncMode ();
+  mShadowConsole.BytesWritten = 0;
+
+  gST->ConOut = &mShadowConsole.TextOut;
+  gST->ConIn  = &mShadowConsole.TextIn;
+  gST->Hdr.CRC32 = 0;
+  gBS->CalculateCrc32 (
+        (UINT8 *) &gST->Hdr,
+        gST->Hdr.HeaderSize,
+        &gST->Hdr.CRC32
+        );
+}
+
+/**
+  Flush the shadow console to the screen, and put the console input and output
+  of the system table back.
+
+**/
+VOID
+ShadowConsoleDisable (
+  VOID
+  )
+{
+  EFI_TPL  OldTpl;
+
+  if (mShadowConsole.ConOut == NULL) {
+    return;
+  }
+
+  OldTpl = gBS->RaiseTPL (TPL_NOTIFY);
+  ShadowConsoleFlush ();
+  gBS->RestoreTPL (OldTpl);
+
+  gST->ConOut = mShadowConsole.ConOut;
+  gST->ConIn  = mShadowConsole.ConIn;
+  gST->Hdr.CRC32 = 0;
+  gBS->CalculateCrc32 (
+        (UINT8 *) &gST->Hdr,
+        gST->Hdr.HeaderSize,
+        &gST->Hdr.CRC32
+        );
+
+  ShadowConsoleFreeBuffers ();
+  mShadowConsole.ConOut = NULL;
+  mShadowConsole.ConIn  = NULL;
+}
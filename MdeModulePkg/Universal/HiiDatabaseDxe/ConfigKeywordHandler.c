@@ -1,7 +1,7 @@
 /** @file
 Implementation of interfaces function for EFI_CONFIG_KEYWORD_HANDLER_PROTOCOL.
 
-Copyright (c) 2015 - 2018, Intel Corporation. All rights reserved.<BR>
+Copyright (c) 2015 - 2020, Intel Corporation. All rights reserved.<BR>
 SPDX-License-Identifier: BSD-2-Clause-Patent
 
 **/
@@ -740,273 +740,279 @@ GetUnicodeStringTextAndSize (
 }
 
 /**
-  Find the string id for the input keyword.
+  Get the character at a position of a string text in the string blocks.
+
+  @param  StringTextPtr           The string text.
+  @param  Ascii                   TRUE for SCSU text, FALSE for UCS2 text.
+  @param  Index                   The position of the character.
+
+  @return The character.
+
+**/
+CHAR16
+GetKeywordIndexChar (
+  IN UINT8                            *StringTextPtr,
+  IN BOOLEAN                          Ascii,
+  IN UINTN                            Index
+  )
+{
+  if (Ascii) {
+    return (CHAR16) StringTextPtr[Index];
+  }
+  return ReadUnaligned16 ((UINT16 *) (StringTextPtr + Index * sizeof (CHAR16)));
+}
+
+/**
+  Get the keyword index of a string package, building it on first use.
+
+  The index records every string of the package in string ID order, and chains
+  the strings of each hash bucket in string ID order too, so a lookup finds the
+  same string ID a walk of the string blocks does. It is discarded together with
+  the string ID index whenever the string blocks change.
 
   @param  StringPackage           Hii string package instance.
-  @param  KeywordValue            Input keyword value.
-  @param  StringId                The string's id, which is unique within PackageList.
 
+  @return The keyword index, or NULL if it could not be allocated.
 
-  @retval EFI_SUCCESS             The string text and font is retrieved
-                                  successfully.
-  @retval EFI_NOT_FOUND           The specified text or font info can not be found
-                                  out.
-  @retval EFI_OUT_OF_RESOURCES    The system is out of resources to accomplish the
-                                  task.
 **/
-EFI_STATUS
-GetStringIdFromString (
-  IN HII_STRING_PACKAGE_INSTANCE      *StringPackage,
-  IN CHAR16                           *KeywordValue,
-  OUT EFI_STRING_ID                   *StringId
+HII_KEYWORD_INDEX *
+GetKeywordIndex (
+  IN HII_STRING_PACKAGE_INSTANCE      *StringPackage
   )
 {
+  HII_KEYWORD_INDEX                    *KeywordIndex;
+  HII_KEYWORD_INDEX                    *NewIndex;
+  HII_KEYWORD_INDEX_ENTRY              *Entry;
   UINT8                                *BlockHdr;
+  UINT8                                *StringTextPtr;
   EFI_STRING_ID                        CurrentStringId;
   UINTN                                BlockSize;
   UINTN                                Index;
-  UINT8                                *StringTextPtr;
-  UINTN                                Offset;
+  UINTN                                Length;
+  UINTN                                MaxCount;
+  UINT32                               Hash;
   UINT16                               StringCount;
   UINT16                               SkipCount;
   UINT8                                Length8;
   EFI_HII_SIBT_EXT2_BLOCK              Ext2;
   UINT32                               Length32;
-  UINTN                                StringSize;
-  CHAR16                               *String;
-  CHAR8                                *AsciiKeywordValue;
-  UINTN                                KeywordValueSize;
-  EFI_STATUS                           Status;
+  BOOLEAN                              Ascii;
 
-  ASSERT (StringPackage != NULL && KeywordValue != NULL && StringId != NULL);
+  ASSERT (StringPackage != NULL);
   ASSERT (StringPackage->Signature == HII_STRING_PACKAGE_SIGNATURE);
 
-  CurrentStringId = 1;
-  Status = EFI_SUCCESS;
-  String = NULL;
-  BlockHdr = StringPackage->StringBlock;
-  BlockSize = 0;
-  Offset = 0;
+  if (StringPackage->KeywordIndex != NULL) {
+    return StringPackage->KeywordIndex;
+  }
 
-  //
-  // Make a ascii keyword value for later use.
-  //
-  KeywordValueSize = StrLen (KeywordValue) + 1;
-  AsciiKeywordValue = AllocatePool (KeywordValueSize);
-  if (AsciiKeywordValue == NULL) {
-    return EFI_OUT_OF_RESOURCES;
+  MaxCount     = 64;
+  KeywordIndex = AllocateZeroPool (sizeof (HII_KEYWORD_INDEX) + (MaxCount - 1) * sizeof (HII_KEYWORD_INDEX_ENTRY));
+  if (KeywordIndex == NULL) {
+    return NULL;
   }
-  UnicodeStrToAsciiStrS (KeywordValue, AsciiKeywordValue, KeywordValueSize);
 
+  CurrentStringId = 1;
+  BlockHdr        = StringPackage->StringBlock;
   while (*BlockHdr != EFI_HII_SIBT_END) {
+    StringTextPtr = NULL;
+    StringCount   = 0;
+    BlockSize     = 0;
+    Ascii         = FALSE;
+
     switch (*BlockHdr) {
     case EFI_HII_SIBT_STRING_SCSU:
-      Offset = sizeof (EFI_HII_STRING_BLOCK);
-      StringTextPtr = BlockHdr + Offset;
-      BlockSize += Offset + AsciiStrSize ((CHAR8 *) StringTextPtr);
-      if (AsciiStrCmp(AsciiKeywordValue, (CHAR8 *) StringTextPtr) == 0) {
-        *StringId = CurrentStringId;
-        goto Done;
-      }
-      CurrentStringId++;
+      StringTextPtr = BlockHdr + sizeof (EFI_HII_STRING_BLOCK);
+      StringCount   = 1;
+      Ascii         = TRUE;
       break;
 
     case EFI_HII_SIBT_STRING_SCSU_FONT:
-      Offset = sizeof (EFI_HII_SIBT_STRING_SCSU_FONT_BLOCK) - sizeof (UINT8);
-      StringTextPtr = BlockHdr + Offset;
-      if (AsciiStrCmp(AsciiKeywordValue, (CHAR8 *) StringTextPtr) == 0) {
-        *StringId = CurrentStringId;
-        goto Done;
-      }
-      BlockSize += Offset + AsciiStrSize ((CHAR8 *) StringTextPtr);
-      CurrentStringId++;
+      StringTextPtr = BlockHdr + sizeof (EFI_HII_SIBT_STRING_SCSU_FONT_BLOCK) - sizeof (UINT8);
+      StringCount   = 1;
+      Ascii         = TRUE;
       break;
 
     case EFI_HII_SIBT_STRINGS_SCSU:
       CopyMem (&StringCount, BlockHdr + sizeof (EFI_HII_STRING_BLOCK), sizeof (UINT16));
-      StringTextPtr = (UINT8*)((UINTN)BlockHdr + sizeof (EFI_HII_SIBT_STRINGS_SCSU_BLOCK) - sizeof (UINT8));
-      BlockSize += StringTextPtr - BlockHdr;
-
-      for (Index = 0; Index < StringCount; Index++) {
-        BlockSize += AsciiStrSize ((CHAR8 *) StringTextPtr);
-        if (AsciiStrCmp(AsciiKeywordValue, (CHAR8 *) StringTextPtr) == 0) {
-          *StringId = CurrentStringId;
-          goto Done;
-        }
-        StringTextPtr = StringTextPtr + AsciiStrSize ((CHAR8 *) StringTextPtr);
-        CurrentStringId++;
-      }
+      StringTextPtr = BlockHdr + sizeof (EFI_HII_SIBT_STRINGS_SCSU_BLOCK) - sizeof (UINT8);
+      Ascii         = TRUE;
       break;
 
     case EFI_HII_SIBT_STRINGS_SCSU_FONT:
-      CopyMem (
-        &StringCount,
-        (UINT8*)((UINTN)BlockHdr + sizeof (EFI_HII_STRING_BLOCK) + sizeof (UINT8)),
-        sizeof (UINT16)
-        );
-      StringTextPtr = (UINT8*)((UINTN)BlockHdr + sizeof (EFI_HII_SIBT_STRINGS_SCSU_FONT_BLOCK) - sizeof (UINT8));
-      BlockSize += StringTextPtr - BlockHdr;
-
-      for (Index = 0; Index < StringCount; Index++) {
-        BlockSize += AsciiStrSize ((CHAR8 *) StringTextPtr);
-        if (AsciiStrCmp(AsciiKeywordValue, (CHAR8 *) StringTextPtr) == 0) {
-          *StringId = CurrentStringId;
-          goto Done;
-        }
-        StringTextPtr = StringTextPtr + AsciiStrSize ((CHAR8 *) StringTextPtr);
-        CurrentStringId++;
-      }
+      CopyMem (&StringCount, BlockHdr + sizeof (EFI_HII_STRING_BLOCK) + sizeof (UINT8), sizeof (UINT16));
+      StringTextPtr = BlockHdr + sizeof (EFI_HII_SIBT_STRINGS_SCSU_FONT_BLOCK) - sizeof (UINT8);
+      Ascii         = TRUE;
       break;
 
     case EFI_HII_SIBT_STRING_UCS2:
-      Offset        = sizeof (EFI_HII_STRING_BLOCK);
-      StringTextPtr = BlockHdr + Offset;
-      //
-      // Use StringSize to store the size of the specified string, including the NULL
-      // terminator.
-      //
-      Status = GetUnicodeStringTextAndSize (StringTextPtr, &StringSize, &String);
-      if (EFI_ERROR (Status)) {
-        goto Done;
-      }
-      ASSERT (String != NULL);
-      if (StrCmp(KeywordValue, String) == 0) {
-        *StringId = CurrentStringId;
-        goto Done;
-      }
-      BlockSize += Offset + StringSize;
-      CurrentStringId++;
+      StringTextPtr = BlockHdr + sizeof (EFI_HII_STRING_BLOCK);
+      StringCount   = 1;
       break;
 
     case EFI_HII_SIBT_STRING_UCS2_FONT:
-      Offset = sizeof (EFI_HII_SIBT_STRING_UCS2_FONT_BLOCK)  - sizeof (CHAR16);
-      StringTextPtr = BlockHdr + Offset;
-      //
-      // Use StringSize to store the size of the specified string, including the NULL
-      // terminator.
-      //
-      Status = GetUnicodeStringTextAndSize (StringTextPtr, &StringSize, &String);
-      if (EFI_ERROR (Status)) {
-        goto Done;
-      }
-      ASSERT (String != NULL);
-      if (StrCmp(KeywordValue, String) == 0) {
-        *StringId = CurrentStringId;
-        goto Done;
-      }
-      BlockSize += Offset + StringSize;
-      CurrentStringId++;
+      StringTextPtr = BlockHdr + sizeof (EFI_HII_SIBT_STRING_UCS2_FONT_BLOCK) - sizeof (CHAR16);
+      StringCount   = 1;
       break;
 
     case EFI_HII_SIBT_STRINGS_UCS2:
-      Offset = sizeof (EFI_HII_SIBT_STRINGS_UCS2_BLOCK) - sizeof (CHAR16);
-      StringTextPtr = BlockHdr + Offset;
-      BlockSize += Offset;
       CopyMem (&StringCount, BlockHdr + sizeof (EFI_HII_STRING_BLOCK), sizeof (UINT16));
-      for (Index = 0; Index < StringCount; Index++) {
-        Status = GetUnicodeStringTextAndSize (StringTextPtr, &StringSize, &String);
-        if (EFI_ERROR (Status)) {
-          goto Done;
-        }
-        ASSERT (String != NULL);
-        BlockSize += StringSize;
-        if (StrCmp(KeywordValue, String) == 0) {
-          *StringId = CurrentStringId;
-          goto Done;
-        }
-        StringTextPtr = StringTextPtr + StringSize;
-        CurrentStringId++;
-      }
+      StringTextPtr = BlockHdr + sizeof (EFI_HII_SIBT_STRINGS_UCS2_BLOCK) - sizeof (CHAR16);
       break;
 
     case EFI_HII_SIBT_STRINGS_UCS2_FONT:
-      Offset = sizeof (EFI_HII_SIBT_STRINGS_UCS2_FONT_BLOCK) - sizeof (CHAR16);
-      StringTextPtr = BlockHdr + Offset;
-      BlockSize += Offset;
-      CopyMem (
-        &StringCount,
-        (UINT8*)((UINTN)BlockHdr + sizeof (EFI_HII_STRING_BLOCK) + sizeof (UINT8)),
-        sizeof (UINT16)
-        );
-      for (Index = 0; Index < StringCount; Index++) {
-        Status = GetUnicodeStringTextAndSize (StringTextPtr, &StringSize, &String);
-        if (EFI_ERROR (Status)) {
-          goto Done;
-        }
-        ASSERT (String != NULL);
-        BlockSize += StringSize;
-        if (StrCmp(KeywordValue, String) == 0) {
-          *StringId = CurrentStringId;
-          goto Done;
-        }
-        StringTextPtr = StringTextPtr + StringSize;
-        CurrentStringId++;
-      }
+      CopyMem (&StringCount, BlockHdr + sizeof (EFI_HII_STRING_BLOCK) + sizeof (UINT8), sizeof (UINT16));
+      StringTextPtr = BlockHdr + sizeof (EFI_HII_SIBT_STRINGS_UCS2_FONT_BLOCK) - sizeof (CHAR16);
       break;
 
     case EFI_HII_SIBT_DUPLICATE:
-      BlockSize       += sizeof (EFI_HII_SIBT_DUPLICATE_BLOCK);
+      BlockSize = sizeof (EFI_HII_SIBT_DUPLICATE_BLOCK);
       CurrentStringId++;
       break;
 
     case EFI_HII_SIBT_SKIP1:
       SkipCount = (UINT16) (*(UINT8*)((UINTN)BlockHdr + sizeof (EFI_HII_STRING_BLOCK)));
       CurrentStringId = (UINT16) (CurrentStringId + SkipCount);
-      BlockSize       +=  sizeof (EFI_HII_SIBT_SKIP1_BLOCK);
+      BlockSize = sizeof (EFI_HII_SIBT_SKIP1_BLOCK);
       break;
 
     case EFI_HII_SIBT_SKIP2:
       CopyMem (&SkipCount, BlockHdr + sizeof (EFI_HII_STRING_BLOCK), sizeof (UINT16));
       CurrentStringId = (UINT16) (CurrentStringId + SkipCount);
-      BlockSize       +=  sizeof (EFI_HII_SIBT_SKIP2_BLOCK);
+      BlockSize = sizeof (EFI_HII_SIBT_SKIP2_BLOCK);
       break;
 
     case EFI_HII_SIBT_EXT1:
-      CopyMem (
-        &Length8,
-        (UINT8*)((UINTN)BlockHdr + sizeof (EFI_HII_STRING_BLOCK) + sizeof (UINT8)),
-        sizeof (UINT8)
-        );
-      BlockSize += Length8;
+      CopyMem (&Length8, BlockHdr + sizeof (EFI_HII_STRING_BLOCK) + sizeof (UINT8), sizeof (UINT8));
+      BlockSize = Length8;
       break;
 
     case EFI_HII_SIBT_EXT2:
       CopyMem (&Ext2, BlockHdr, sizeof (EFI_HII_SIBT_EXT2_BLOCK));
-      BlockSize += Ext2.Length;
+      BlockSize = Ext2.Length;
       break;
 
     case EFI_HII_SIBT_EXT4:
-      CopyMem (
-        &Length32,
-        (UINT8*)((UINTN)BlockHdr + sizeof (EFI_HII_STRING_BLOCK) + sizeof (UINT8)),
-        sizeof (UINT32)
-        );
-
-      BlockSize += Length32;
+      CopyMem (&Length32, BlockHdr + sizeof (EFI_HII_STRING_BLOCK) + sizeof (UINT8), sizeof (UINT32));
+      BlockSize = Length32;
       break;
 
     default:
       break;
     }
 
-    if (String != NULL) {
-      FreePool (String);
-      String = NULL;
+    if (StringTextPtr == NULL) {
+      BlockHdr += BlockSize;
+      continue;
     }
 
-    BlockHdr  = StringPackage->StringBlock + BlockSize;
+    for (Index = 0; Index < StringCount; Index++) {
+      if (KeywordIndex->Count == MaxCount) {
+        NewIndex = ReallocatePool (
+                     sizeof (HII_KEYWORD_INDEX) + (MaxCount - 1) * sizeof (HII_KEYWORD_INDEX_ENTRY),
+                     sizeof (HII_KEYWORD_INDEX) + (MaxCount * 2 - 1) * sizeof (HII_KEYWORD_INDEX_ENTRY),
+                     KeywordIndex
+                     );
+        if (NewIndex == NULL) {
+          FreePool (KeywordIndex);
+          return NULL;
+        }
+        KeywordIndex = NewIndex;
+        MaxCount    *= 2;
+      }
+
+      Entry             = &KeywordIndex->Entry[KeywordIndex->Count++];
+      Entry->TextOffset = (UINT32) (StringTextPtr - StringPackage->StringBlock);
+      Entry->StringId   = CurrentStringId++;
+      Entry->Ascii      = Ascii;
+      //
+      // String protocol uses this type for the string id which has value for other package.
+      // It allocates an empty string block for this string id, which is not a keyword.
+      //
+      Entry->Enumerated = (BOOLEAN) (*BlockHdr != EFI_HII_SIBT_STRING_UCS2 ||
+                                     GetKeywordIndexChar (StringTextPtr, FALSE, 0) != L'\0');
+
+      Length = 0;
+      while (GetKeywordIndexChar (StringTextPtr, Ascii, Length) != 0) {
+        Length++;
+      }
+      StringTextPtr += (Length + 1) * (Ascii ? sizeof (CHAR8) : sizeof (CHAR16));
+    }
+    BlockHdr = StringTextPtr;
   }
 
-  Status = EFI_NOT_FOUND;
+  //
+  // Chain the strings of each bucket, walking backwards so that the chains
+  // end up in string ID order.
+  //
+  for (Index = KeywordIndex->Count; Index > 0; Index--) {
+    Entry         = &KeywordIndex->Entry[Index - 1];
+    StringTextPtr = StringPackage->StringBlock + Entry->TextOffset;
+    Hash          = 0;
+    for (Length = 0; GetKeywordIndexChar (StringTextPtr, Entry->Ascii, Length) != 0; Length++) {
+      Hash = Hash * 31 + GetKeywordIndexChar (StringTextPtr, Entry->Ascii, Length);
+    }
+    Entry->Next = KeywordIndex->Bucket[Hash % HII_KEYWORD_INDEX_BUCKETS];
+    KeywordIndex->Bucket[Hash % HII_KEYWORD_INDEX_BUCKETS] = (UINT32) Index;
+  }
 
-Done:
-  if (AsciiKeywordValue != NULL) {
-    FreePool (AsciiKeywordValue);
+  StringPackage->KeywordIndex = KeywordIndex;
+  return KeywordIndex;
+}
+
+/**
+  Find the string id for the input keyword.
+
+  @param  StringPackage           Hii string package instance.
+  @param  KeywordValue            Input keyword value.
+  @param  StringId                The string's id, which is unique within PackageList.
+
+
+  @retval EFI_SUCCESS             The string text and font is retrieved
+                                  successfully.
+  @retval EFI_NOT_FOUND           The specified text or font info can not be found
+                                  out.
+  @retval EFI_OUT_OF_RESOURCES    The system is out of resources to accomplish the
+                                  task.
+**/
+EFI_STATUS
+GetStringIdFromString (
+  IN HII_STRING_PACKAGE_INSTANCE      *StringPackage,
+  IN CHAR16                           *KeywordValue,
+  OUT EFI_STRING_ID                   *StringId
+  )
+{
+  HII_KEYWORD_INDEX                    *KeywordIndex;
+  HII_KEYWORD_INDEX_ENTRY              *Entry;
+  UINT8                                *StringTextPtr;
+  UINT32                               Number;
+  UINT32                               Hash;
+  UINTN                                Index;
+
+  ASSERT (StringPackage != NULL && KeywordValue != NULL && StringId != NULL);
+  ASSERT (StringPackage->Signature == HII_STRING_PACKAGE_SIGNATURE);
+
+  KeywordIndex = GetKeywordIndex (StringPackage);
+  if (KeywordIndex == NULL) {
+    return EFI_OUT_OF_RESOURCES;
   }
-  if (String != NULL) {
-    FreePool (String);
+
+  Hash = 0;
+  for (Index = 0; KeywordValue[Index] != L'\0'; Index++) {
+    Hash = Hash * 31 + KeywordValue[Index];
   }
-  return Status;
+
+  for (Number = KeywordIndex->Bucket[Hash % HII_KEYWORD_INDEX_BUCKETS]; Number != 0; Number = Entry->Next) {
+    Entry         = &KeywordIndex->Entry[Number - 1];
+    StringTextPtr = StringPackage->StringBlock + Entry->TextOffset;
+    for (Index = 0; KeywordValue[Index] == GetKeywordIndexChar (StringTextPtr, Entry->Ascii, Index); Index++) {
+      if (KeywordValue[Index] == L'\0') {
+        *StringId = Entry->StringId;
+        return EFI_SUCCESS;
+      }
+    }
+  }
+
+  return EFI_NOT_FOUND;
 }
 
 /**
@@ -1028,267 +1034,57 @@ GetNextStringId (
   OUT EFI_STRING                       *KeywordValue
   )
 {
-  UINT8                                *BlockHdr;
-  EFI_STRING_ID                        CurrentStringId;
-  UINTN                                BlockSize;
-  UINTN                                Index;
+  HII_KEYWORD_INDEX                    *KeywordIndex;
+  HII_KEYWORD_INDEX_ENTRY              *Entry;
   UINT8                                *StringTextPtr;
-  UINTN                                Offset;
-  UINT16                               StringCount;
-  UINT16                               SkipCount;
-  UINT8                                Length8;
-  EFI_HII_SIBT_EXT2_BLOCK              Ext2;
-  UINT32                               Length32;
-  BOOLEAN                              FindString;
   UINTN                                StringSize;
-  CHAR16                               *String;
+  UINTN                                Low;
+  UINTN                                High;
+  UINTN                                Middle;
 
   ASSERT (StringPackage != NULL);
   ASSERT (StringPackage->Signature == HII_STRING_PACKAGE_SIGNATURE);
 
-  CurrentStringId = 1;
-  FindString = FALSE;
-  String = NULL;
+  KeywordIndex = GetKeywordIndex (StringPackage);
+  if (KeywordIndex == NULL) {
+    return 0;
+  }
 
   //
-  // Parse the string blocks to get the string text and font.
+  // Find the string of the current string id, the strings are in string id order.
   //
-  BlockHdr  = StringPackage->StringBlock;
-  BlockSize = 0;
-  Offset    = 0;
-  while (*BlockHdr != EFI_HII_SIBT_END) {
-    switch (*BlockHdr) {
-    case EFI_HII_SIBT_STRING_SCSU:
-      Offset = sizeof (EFI_HII_STRING_BLOCK);
-      StringTextPtr = BlockHdr + Offset;
-
-      if (FindString) {
-        StringSize = AsciiStrSize ((CHAR8 *) StringTextPtr);
-        *KeywordValue = AllocatePool (StringSize * sizeof (CHAR16));
-        if (*KeywordValue == NULL) {
-          return 0;
-        }
-        AsciiStrToUnicodeStrS ((CHAR8 *) StringTextPtr, *KeywordValue, StringSize);
-        return CurrentStringId;
-      } else if (CurrentStringId == StringId) {
-        FindString = TRUE;
-      }
-
-      BlockSize += Offset + AsciiStrSize ((CHAR8 *) StringTextPtr);
-      CurrentStringId++;
-      break;
-
-    case EFI_HII_SIBT_STRING_SCSU_FONT:
-      Offset = sizeof (EFI_HII_SIBT_STRING_SCSU_FONT_BLOCK) - sizeof (UINT8);
-      StringTextPtr = BlockHdr + Offset;
-
-      if (FindString) {
-        StringSize = AsciiStrSize ((CHAR8 *) StringTextPtr);
-        *KeywordValue = AllocatePool (StringSize * sizeof (CHAR16));
-        if (*KeywordValue == NULL) {
-          return 0;
-        }
-        AsciiStrToUnicodeStrS ((CHAR8 *) StringTextPtr, *KeywordValue, StringSize);
-        return CurrentStringId;
-      } else if (CurrentStringId == StringId) {
-        FindString = TRUE;
-      }
-
-      BlockSize += Offset + AsciiStrSize ((CHAR8 *) StringTextPtr);
-      CurrentStringId++;
-      break;
-
-    case EFI_HII_SIBT_STRINGS_SCSU:
-      CopyMem (&StringCount, BlockHdr + sizeof (EFI_HII_STRING_BLOCK), sizeof (UINT16));
-      StringTextPtr = (UINT8*)((UINTN)BlockHdr + sizeof (EFI_HII_SIBT_STRINGS_SCSU_BLOCK) - sizeof (UINT8));
-      BlockSize += StringTextPtr - BlockHdr;
-
-      for (Index = 0; Index < StringCount; Index++) {
-        if (FindString) {
-          StringSize = AsciiStrSize ((CHAR8 *) StringTextPtr);
-          *KeywordValue = AllocatePool (StringSize * sizeof (CHAR16));
-          if (*KeywordValue == NULL) {
-            return 0;
-          }
-          AsciiStrToUnicodeStrS ((CHAR8 *) StringTextPtr, *KeywordValue, StringSize);
-          return CurrentStringId;
-        } else if (CurrentStringId == StringId) {
-          FindString = TRUE;
-        }
-
-        BlockSize += AsciiStrSize ((CHAR8 *) StringTextPtr);
-        StringTextPtr = StringTextPtr + AsciiStrSize ((CHAR8 *) StringTextPtr);
-        CurrentStringId++;
-      }
-      break;
-
-    case EFI_HII_SIBT_STRINGS_SCSU_FONT:
-      CopyMem (
-        &StringCount,
-        (UINT8*)((UINTN)BlockHdr + sizeof (EFI_HII_STRING_BLOCK) + sizeof (UINT8)),
-        sizeof (UINT16)
-        );
-      StringTextPtr = (UINT8*)((UINTN)BlockHdr + sizeof (EFI_HII_SIBT_STRINGS_SCSU_FONT_BLOCK) - sizeof (UINT8));
-      BlockSize += StringTextPtr - BlockHdr;
-
-      for (Index = 0; Index < StringCount; Index++) {
-        if (FindString) {
-          StringSize = AsciiStrSize ((CHAR8 *) StringTextPtr);
-          *KeywordValue = AllocatePool (StringSize * sizeof (CHAR16));
-          if (*KeywordValue == NULL) {
-            return 0;
-          }
-          AsciiStrToUnicodeStrS ((CHAR8 *) StringTextPtr, *KeywordValue, StringSize);
-          return CurrentStringId;
-        } else if (CurrentStringId == StringId) {
-          FindString = TRUE;
-        }
-
-        BlockSize += AsciiStrSize ((CHAR8 *) StringTextPtr);
-        StringTextPtr = StringTextPtr + AsciiStrSize ((CHAR8 *) StringTextPtr);
-        CurrentStringId++;
-      }
-      break;
-
-    case EFI_HII_SIBT_STRING_UCS2:
-      Offset        = sizeof (EFI_HII_STRING_BLOCK);
-      StringTextPtr = BlockHdr + Offset;
-      //
-      // Use StringSize to store the size of the specified string, including the NULL
-      // terminator.
-      //
-      GetUnicodeStringTextAndSize (StringTextPtr, &StringSize, &String);
-      if (FindString && (String != NULL) && (*String != L'\0')) {
-        //
-        // String protocol use this type for the string id which has value for other package.
-        // It will allocate an empty string block for this string id. so here we also check
-        // *String != L'\0' to prohibit this case.
-        //
-        *KeywordValue = String;
-        return CurrentStringId;
-      } else if (CurrentStringId == StringId) {
-        FindString = TRUE;
-      }
-
-      BlockSize += Offset + StringSize;
-      CurrentStringId++;
-      break;
-
-    case EFI_HII_SIBT_STRING_UCS2_FONT:
-      Offset = sizeof (EFI_HII_SIBT_STRING_UCS2_FONT_BLOCK)  - sizeof (CHAR16);
-      StringTextPtr = BlockHdr + Offset;
-      //
-      // Use StringSize to store the size of the specified string, including the NULL
-      // terminator.
-      //
-      GetUnicodeStringTextAndSize (StringTextPtr, &StringSize, &String);
-      if (FindString) {
-        *KeywordValue = String;
-        return CurrentStringId;
-      } else if (CurrentStringId == StringId) {
-        FindString = TRUE;
-      }
-
-      BlockSize += Offset + StringSize;
-      CurrentStringId++;
-      break;
-
-    case EFI_HII_SIBT_STRINGS_UCS2:
-      Offset = sizeof (EFI_HII_SIBT_STRINGS_UCS2_BLOCK) - sizeof (CHAR16);
-      StringTextPtr = BlockHdr + Offset;
-      BlockSize += Offset;
-      CopyMem (&StringCount, BlockHdr + sizeof (EFI_HII_STRING_BLOCK), sizeof (UINT16));
-      for (Index = 0; Index < StringCount; Index++) {
-        GetUnicodeStringTextAndSize (StringTextPtr, &StringSize, &String);
-
-        if (FindString) {
-          *KeywordValue = String;
-          return CurrentStringId;
-        } else if (CurrentStringId == StringId) {
-          FindString = TRUE;
-        }
-
-        BlockSize += StringSize;
-        StringTextPtr = StringTextPtr + StringSize;
-        CurrentStringId++;
-      }
-      break;
-
-    case EFI_HII_SIBT_STRINGS_UCS2_FONT:
-      Offset = sizeof (EFI_HII_SIBT_STRINGS_UCS2_FONT_BLOCK) - sizeof (CHAR16);
-      StringTextPtr = BlockHdr + Offset;
-      BlockSize += Offset;
-      CopyMem (
-        &StringCount,
-        (UINT8*)((UINTN)BlockHdr + sizeof (EFI_HII_STRING_BLOCK) + sizeof (UINT8)),
-        sizeof (UINT16)
-        );
-      for (Index = 0; Index < StringCount; Index++) {
-        GetUnicodeStringTextAndSize (StringTextPtr, &StringSize, &String);
-        if (FindString) {
-          *KeywordValue = String;
-          return CurrentStringId;
-        } else if (CurrentStringId == StringId) {
-          FindString = TRUE;
-        }
-
-        BlockSize += StringSize;
-        StringTextPtr = StringTextPtr + StringSize;
-        CurrentStringId++;
-      }
-      break;
-
-    case EFI_HII_SIBT_DUPLICATE:
-      BlockSize       += sizeof (EFI_HII_SIBT_DUPLICATE_BLOCK);
-      CurrentStringId++;
-      break;
-
-    case EFI_HII_SIBT_SKIP1:
-      SkipCount = (UINT16) (*(UINT8*)((UINTN)BlockHdr + sizeof (EFI_HII_STRING_BLOCK)));
-      CurrentStringId = (UINT16) (CurrentStringId + SkipCount);
-      BlockSize       +=  sizeof (EFI_HII_SIBT_SKIP1_BLOCK);
-      break;
-
-    case EFI_HII_SIBT_SKIP2:
-      CopyMem (&SkipCount, BlockHdr + sizeof (EFI_HII_STRING_BLOCK), sizeof (UINT16));
-      CurrentStringId = (UINT16) (CurrentStringId + SkipCount);
-      BlockSize       +=  sizeof (EFI_HII_SIBT_SKIP2_BLOCK);
-      break;
-
-    case EFI_HII_SIBT_EXT1:
-      CopyMem (
-        &Length8,
-        (UINT8*)((UINTN)BlockHdr + sizeof (EFI_HII_STRING_BLOCK) + sizeof (UINT8)),
-        sizeof (UINT8)
-        );
-      BlockSize += Length8;
-      break;
-
-    case EFI_HII_SIBT_EXT2:
-      CopyMem (&Ext2, BlockHdr, sizeof (EFI_HII_SIBT_EXT2_BLOCK));
-      BlockSize += Ext2.Length;
-      break;
-
-    case EFI_HII_SIBT_EXT4:
-      CopyMem (
-        &Length32,
-        (UINT8*)((UINTN)BlockHdr + sizeof (EFI_HII_STRING_BLOCK) + sizeof (UINT8)),
-        sizeof (UINT32)
-        );
-
-      BlockSize += Length32;
-      break;
-
-    default:
-      break;
+  Low  = 0;
+  High = KeywordIndex->Count;
+  while (Low < High) {
+    Middle = (Low + High) / 2;
+    if (KeywordIndex->Entry[Middle].StringId < StringId) {
+      Low = Middle + 1;
+    } else {
+      High = Middle;
     }
+  }
+  if (Low == KeywordIndex->Count || KeywordIndex->Entry[Low].StringId != StringId) {
+    return 0;
+  }
 
-    if (String != NULL) {
-      FreePool (String);
-      String = NULL;
+  for (Low++; Low < KeywordIndex->Count; Low++) {
+    Entry = &KeywordIndex->Entry[Low];
+    if (!Entry->Enumerated) {
+      continue;
     }
 
-    BlockHdr  = StringPackage->StringBlock + BlockSize;
+    StringTextPtr = StringPackage->StringBlock + Entry->TextOffset;
+    if (Entry->Ascii) {
+      StringSize = AsciiStrSize ((CHAR8 *) StringTextPtr);
+      *KeywordValue = AllocatePool (StringSize * sizeof (CHAR16));
+      if (*KeywordValue == NULL) {
+        return 0;
+      }
+      AsciiStrToUnicodeStrS ((CHAR8 *) StringTextPtr, *KeywordValue, StringSize);
+    } else if (EFI_ERROR (GetUnicodeStringTextAndSize (StringTextPtr, &StringSize, KeywordValue))) {
+      return 0;
+    }
+    return Entry->StringId;
   }
 
   return 0;
@@ -1415,6 +1211,74 @@ IsStorageOpCode (
   return FALSE;
 }
 
+/**
+  Build the question index of a form package, which records the first
+  statement using each prompt string id.
+
+  The IFR data of a form package does not change once the package is in the
+  database, so the index lives as long as the package.
+
+  @param  FormPackage            The input form package.
+
+  @retval EFI_SUCCESS            The question index is built.
+  @retval EFI_OUT_OF_RESOURCES   No enough memory to build the index.
+
+**/
+EFI_STATUS
+BuildQuestionIndex (
+  IN HII_IFR_PACKAGE_INSTANCE      *FormPackage
+  )
+{
+  HII_QUESTION_INDEX_ENTRY     *QuestionIndex;
+  HII_QUESTION_INDEX_ENTRY     Question;
+  EFI_IFR_OP_HEADER            *OpCodeHeader;
+  UINT32                       Offset;
+  UINT32                       FormDataLen;
+  UINTN                        Count;
+  UINTN                        Index;
+
+  FormDataLen = FormPackage->FormPkgHdr.Length - sizeof (EFI_HII_PACKAGE_HEADER);
+  Count  = 0;
+  Offset = 0;
+  while (Offset < FormDataLen) {
+    OpCodeHeader = (EFI_IFR_OP_HEADER *) (FormPackage->IfrData + Offset);
+    if (IsStatementOpCode(OpCodeHeader->OpCode)) {
+      Count++;
+    }
+    Offset += OpCodeHeader->Length;
+  }
+
+  QuestionIndex = AllocatePool (MAX (Count, 1) * sizeof (HII_QUESTION_INDEX_ENTRY));
+  if (QuestionIndex == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  //
+  // Insert the statements in IFR order, the prompts mostly come in ascending
+  // order already. The sort is stable, so the first statement of a prompt is
+  // ahead of the others.
+  //
+  Count  = 0;
+  Offset = 0;
+  while (Offset < FormDataLen) {
+    OpCodeHeader = (EFI_IFR_OP_HEADER *) (FormPackage->IfrData + Offset);
+    if (IsStatementOpCode(OpCodeHeader->OpCode)) {
+      Question.Prompt = ((EFI_IFR_STATEMENT_HEADER *) (OpCodeHeader + 1))->Prompt;
+      Question.Offset = Offset;
+      for (Index = Count; Index > 0 && QuestionIndex[Index - 1].Prompt > Question.Prompt; Index--) {
+        QuestionIndex[Index] = QuestionIndex[Index - 1];
+      }
+      QuestionIndex[Index] = Question;
+      Count++;
+    }
+    Offset += OpCodeHeader->Length;
+  }
+
+  FormPackage->QuestionIndex = QuestionIndex;
+  FormPackage->QuestionCount = Count;
+  return EFI_SUCCESS;
+}
+
 /**
   Base on the prompt string id to find the question.
 
@@ -1435,9 +1299,29 @@ FindQuestionFromStringId (
   EFI_IFR_STATEMENT_HEADER     *StatementHeader;
   EFI_IFR_OP_HEADER            *OpCodeHeader;
   UINT32                       FormDataLen;
+  UINTN                        Low;
+  UINTN                        High;
+  UINTN                        Middle;
 
   ASSERT (FormPackage != NULL);
 
+  if (FormPackage->QuestionIndex != NULL || !EFI_ERROR (BuildQuestionIndex (FormPackage))) {
+    Low  = 0;
+    High = FormPackage->QuestionCount;
+    while (Low < High) {
+      Middle = (Low + High) / 2;
+      if (FormPackage->QuestionIndex[Middle].Prompt < KeywordStrId) {
+        Low = Middle + 1;
+      } else {
+        High = Middle;
+      }
+    }
+    if (Low < FormPackage->QuestionCount && FormPackage->QuestionIndex[Low].Prompt == KeywordStrId) {
+      return FormPackage->IfrData + FormPackage->QuestionIndex[Low].Offset;
+    }
+    return NULL;
+  }
+
   FormDataLen = FormPackage->FormPkgHdr.Length - sizeof (EFI_HII_PACKAGE_HEADER);
   Offset = 0;
   while (Offset < FormDataLen) {
@@ -1460,6 +1344,11 @@ FindQuestionFromStringId (
 /**
   Base on the varstore id to find the storage info.
 
+  The storage is looked up in the varstore index of the package list, which
+  ExtractConfig and ExportConfig use as well. The form package is only walked
+  if the index can't be built.
+
+  @param  DatabaseRecord         The database record of the package list.
   @param  FormPackage            The input form package.
   @param  VarStoreId             The input storage id.
 
@@ -1468,6 +1357,7 @@ FindQuestionFromStringId (
 **/
 UINT8 *
 FindStorageFromVarId (
+  IN HII_DATABASE_RECORD           *DatabaseRecord,
   IN HII_IFR_PACKAGE_INSTANCE      *FormPackage,
   IN EFI_VARSTORE_ID               VarStoreId
   )
@@ -1476,8 +1366,21 @@ FindStorageFromVarId (
   UINT32                       Offset;
   EFI_IFR_OP_HEADER            *OpCodeHeader;
   UINT32                       FormDataLen;
+  LIST_ENTRY                   *VarStoreIndex;
+  LIST_ENTRY                   *Link;
+  HII_VARSTORE_INDEX_ENTRY     *IndexEntry;
 
-  ASSERT (FormPackage != NULL);
+  ASSERT (DatabaseRecord != NULL && FormPackage != NULL);
+
+  if (!EFI_ERROR (GetVarStoreIndex (DatabaseRecord, &VarStoreIndex))) {
+    for (Link = VarStoreIndex->ForwardLink; Link != VarStoreIndex; Link = Link->ForwardLink) {
+      IndexEntry = CR (Link, HII_VARSTORE_INDEX_ENTRY, Entry, HII_VARSTORE_INDEX_SIGNATURE);
+      if (IndexEntry->FormPackage == FormPackage && IndexEntry->VarStoreId == VarStoreId) {
+        return (UINT8 *) IndexEntry->VarStore;
+      }
+    }
+    return NULL;
+  }
 
   FormDataLen = FormPackage->FormPkgHdr.Length - sizeof (EFI_HII_PACKAGE_HEADER);
   Offset = 0;
@@ -2048,7 +1951,7 @@ ExtractConfigRequest (
       ASSERT (Header->VarStoreId != 0);
       DEBUG ((EFI_D_INFO, "Varstore Id: 0x%x\n", Header->VarStoreId));
 
-      Storage = FindStorageFromVarId (FormPackage, Header->VarStoreId);
+      Storage = FindStorageFromVarId (DatabaseRecord, FormPackage, Header->VarStoreId);
       ASSERT (Storage != NULL);
 
       if (((EFI_IFR_OP_HEADER *) Storage)->OpCode == EFI_IFR_VARSTORE_NAME_VALUE_OP) {
@@ -2151,7 +2054,7 @@ ExtractConfigResp (
       ASSERT (Header->VarStoreId != 0);
       DEBUG ((EFI_D_INFO, "Varstore Id: 0x%x\n", Header->VarStoreId));
 
-      Storage = FindStorageFromVarId (FormPackage, Header->VarStoreId);
+      Storage = FindStorageFromVarId (DatabaseRecord, FormPackage, Header->VarStoreId);
       ASSERT (Storage != NULL);
 
       if (((EFI_IFR_OP_HEADER *) Storage)->OpCode == EFI_IFR_VARSTORE_NAME_VALUE_OP) {
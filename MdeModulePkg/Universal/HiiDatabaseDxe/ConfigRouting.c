@@ -1,7 +1,7 @@
 /** @file
 Implementation of interfaces function for EFI_HII_CONFIG_ROUTING_PROTOCOL.
 
-Copyright (c) 2007 - 2018, Intel Corporation. All rights reserved.<BR>
+Copyright (c) 2007 - 2020, Intel Corporation. All rights reserved.<BR>
 SPDX-License-Identifier: BSD-2-Clause-Patent
 
 **/
@@ -1599,7 +1599,198 @@ GetFormPackageData (
 
 
 /**
-  This function parses Form Package to get the efi varstore info according to the request ConfigHdr.
+  Free a VarStorageData with its block array and the default values of the blocks.
+
+  @param  VarStorageData         The VarStorageData to free.
+
+**/
+VOID
+FreeVarStorageData (
+  IN IFR_VARSTORAGE_DATA       *VarStorageData
+  )
+{
+  IFR_BLOCK_DATA               *BlockData;
+  IFR_DEFAULT_DATA             *DefaultValueData;
+
+  while (!IsListEmpty (&VarStorageData->BlockEntry)) {
+    BlockData = BASE_CR (VarStorageData->BlockEntry.ForwardLink, IFR_BLOCK_DATA, Entry);
+    RemoveEntryList (&BlockData->Entry);
+    if (BlockData->Name != NULL) {
+      FreePool (BlockData->Name);
+    }
+    //
+    // Free default value link array
+    //
+    while (!IsListEmpty (&BlockData->DefaultValueEntry)) {
+      DefaultValueData = BASE_CR (BlockData->DefaultValueEntry.ForwardLink, IFR_DEFAULT_DATA, Entry);
+      RemoveEntryList (&DefaultValueData->Entry);
+      FreePool (DefaultValueData);
+    }
+    FreePool (BlockData);
+  }
+  if (VarStorageData->Name != NULL) {
+    FreePool (VarStorageData->Name);
+  }
+  FreePool (VarStorageData);
+}
+
+/**
+  Free a DefaultId array.
+
+  @param  DefaultIdArray         The DefaultId array to free.
+
+**/
+VOID
+FreeDefaultIdArray (
+  IN IFR_DEFAULT_DATA          *DefaultIdArray
+  )
+{
+  IFR_DEFAULT_DATA             *DefaultId;
+
+  while (!IsListEmpty (&DefaultIdArray->Entry)) {
+    DefaultId = BASE_CR (DefaultIdArray->Entry.ForwardLink, IFR_DEFAULT_DATA, Entry);
+    RemoveEntryList (&DefaultId->Entry);
+    FreePool (DefaultId);
+  }
+  FreePool (DefaultIdArray);
+}
+
+/**
+  Free the varstore index of a package list. It must be called whenever a form
+  package is added to or removed from the package list.
+
+  @param  PackageList            The package list.
+
+**/
+VOID
+InvalidateVarStoreIndex (
+  IN HII_DATABASE_PACKAGE_LIST_INSTANCE  *PackageList
+  )
+{
+  HII_VARSTORE_INDEX_ENTRY     *IndexEntry;
+
+  while (!IsListEmpty (&PackageList->VarStoreIndex)) {
+    IndexEntry = CR (PackageList->VarStoreIndex.ForwardLink, HII_VARSTORE_INDEX_ENTRY, Entry, HII_VARSTORE_INDEX_SIGNATURE);
+    RemoveEntryList (&IndexEntry->Entry);
+    if (IndexEntry->Questions != NULL) {
+      FreeVarStorageData (IndexEntry->Questions);
+      FreeDefaultIdArray (IndexEntry->DefaultIds);
+    }
+    FreePool (IndexEntry->VarStore);
+    FreePool (IndexEntry->ConfigHdr);
+    FreePool (IndexEntry);
+  }
+  PackageList->VarStoreIndexValid = FALSE;
+}
+
+/**
+  Add a varstore opcode to the varstore index of a package list.
+
+  @param  PackageList            The package list.
+  @param  FormPackage            The form package declaring the varstore.
+  @param  IfrOpHdr               The varstore opcode.
+  @param  BeforeForm             Whether the varstore is declared before the first form.
+
+  @retval EFI_SUCCESS            The varstore is added.
+  @retval EFI_OUT_OF_RESOURCES   No enough memory.
+
+**/
+EFI_STATUS
+AddVarStoreIndexEntry (
+  IN HII_DATABASE_PACKAGE_LIST_INSTANCE  *PackageList,
+  IN HII_IFR_PACKAGE_INSTANCE            *FormPackage,
+  IN EFI_IFR_OP_HEADER                   *IfrOpHdr,
+  IN BOOLEAN                             BeforeForm
+  )
+{
+  HII_VARSTORE_INDEX_ENTRY     *IndexEntry;
+  EFI_GUID                     *Guid;
+  EFI_VARSTORE_ID              VarStoreId;
+  CHAR8                        *AsciiName;
+  CHAR16                       *VarStoreName;
+  UINTN                        NameSize;
+  EFI_STRING                   GuidStr;
+  EFI_STRING                   NameStr;
+  UINTN                        LengthString;
+
+  switch (IfrOpHdr->OpCode) {
+  case EFI_IFR_VARSTORE_OP:
+    Guid       = &((EFI_IFR_VARSTORE *) IfrOpHdr)->Guid;
+    VarStoreId = ((EFI_IFR_VARSTORE *) IfrOpHdr)->VarStoreId;
+    AsciiName  = (CHAR8 *) ((EFI_IFR_VARSTORE *) IfrOpHdr)->Name;
+    break;
+
+  case EFI_IFR_VARSTORE_EFI_OP:
+    Guid       = &((EFI_IFR_VARSTORE_EFI *) IfrOpHdr)->Guid;
+    VarStoreId = ((EFI_IFR_VARSTORE_EFI *) IfrOpHdr)->VarStoreId;
+    AsciiName  = (CHAR8 *) ((EFI_IFR_VARSTORE_EFI *) IfrOpHdr)->Name;
+    break;
+
+  default:
+    Guid       = &((EFI_IFR_VARSTORE_NAME_VALUE *) IfrOpHdr)->Guid;
+    VarStoreId = ((EFI_IFR_VARSTORE_NAME_VALUE *) IfrOpHdr)->VarStoreId;
+    AsciiName  = NULL;
+    break;
+  }
+
+  IndexEntry = AllocateZeroPool (sizeof (HII_VARSTORE_INDEX_ENTRY));
+  if (IndexEntry == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  IndexEntry->Signature   = HII_VARSTORE_INDEX_SIGNATURE;
+  IndexEntry->VarStoreId  = VarStoreId;
+  IndexEntry->FormPackage = FormPackage;
+  IndexEntry->BeforeForm  = BeforeForm;
+  IndexEntry->VarStore   = AllocateCopyPool (IfrOpHdr->Length, IfrOpHdr);
+  if (IndexEntry->VarStore == NULL) {
+    FreePool (IndexEntry);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  //
+  // Generate the GUID=...&NAME=... that a ConfigHdr of this varstore starts with.
+  //
+  VarStoreName = NULL;
+  GuidStr      = NULL;
+  NameStr      = NULL;
+  GenerateSubStr (L"GUID=", sizeof (EFI_GUID), (VOID *) Guid, 1, &GuidStr);
+  if (AsciiName != NULL) {
+    NameSize = AsciiStrSize (AsciiName);
+    VarStoreName = AllocateZeroPool (NameSize * sizeof (CHAR16));
+    if (VarStoreName != NULL) {
+      AsciiStrToUnicodeStrS (AsciiName, VarStoreName, NameSize);
+      GenerateSubStr (L"NAME=", StrLen (VarStoreName) * sizeof (CHAR16), (VOID *) VarStoreName, 2, &NameStr);
+      FreePool (VarStoreName);
+    }
+  } else {
+    GenerateSubStr (L"NAME=", 0, NULL, 2, &NameStr);
+  }
+  if (GuidStr != NULL && NameStr != NULL) {
+    LengthString = StrLen (GuidStr) + StrLen (NameStr) + 1;
+    IndexEntry->ConfigHdr = AllocateZeroPool (LengthString * sizeof (CHAR16));
+    if (IndexEntry->ConfigHdr != NULL) {
+      StrCpyS (IndexEntry->ConfigHdr, LengthString, GuidStr);
+      StrCatS (IndexEntry->ConfigHdr, LengthString, NameStr);
+    }
+  }
+  if (GuidStr != NULL) {
+    FreePool (GuidStr);
+  }
+  if (NameStr != NULL) {
+    FreePool (NameStr);
+  }
+  if (IndexEntry->ConfigHdr == NULL) {
+    FreePool (IndexEntry->VarStore);
+    FreePool (IndexEntry);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  InsertTailList (&PackageList->VarStoreIndex, &IndexEntry->Entry);
+  return EFI_SUCCESS;
+}
+
+/**
+  This function looks the efi varstore info up in the varstore index according to the request ConfigHdr.
 
   @param  DataBaseRecord        The DataBaseRecord instance contains the found Hii handle and package.
   @param  ConfigHdr             Request string ConfigHdr. If it is NULL,
@@ -1616,123 +1807,42 @@ GetVarStoreType (
   )
 {
   EFI_STATUS               Status;
-  UINTN                    IfrOffset;
-  UINTN                    PackageOffset;
-  EFI_IFR_OP_HEADER        *IfrOpHdr;
-  CHAR16                   *VarStoreName;
-  UINTN                    NameSize;
-  EFI_STRING               GuidStr;
-  EFI_STRING               NameStr;
-  EFI_STRING               TempStr;
-  UINTN                    LengthString;
-  UINT8                    *HiiFormPackage;
-  UINTN                    PackageSize;
-  EFI_IFR_VARSTORE_EFI     *IfrEfiVarStore;
-  EFI_HII_PACKAGE_HEADER   *PackageHeader;
+  LIST_ENTRY               *VarStoreIndex;
+  LIST_ENTRY               *Link;
+  HII_VARSTORE_INDEX_ENTRY *IndexEntry;
 
-  HiiFormPackage = NULL;
-  LengthString     = 0;
-  Status           = EFI_SUCCESS;
-  GuidStr          = NULL;
-  NameStr          = NULL;
-  TempStr          = NULL;
   *IsEfiVarstore   = FALSE;
 
-  Status = GetFormPackageData(DataBaseRecord, &HiiFormPackage, &PackageSize);
+  Status = GetVarStoreIndex (DataBaseRecord, &VarStoreIndex);
   if (EFI_ERROR (Status)) {
     return Status;
   }
 
-  IfrOffset     = sizeof (EFI_HII_PACKAGE_HEADER);
-  PackageOffset = IfrOffset;
-  PackageHeader = (EFI_HII_PACKAGE_HEADER *) HiiFormPackage;
-
-  while (IfrOffset < PackageSize) {
+  for (Link = VarStoreIndex->ForwardLink; Link != VarStoreIndex; Link = Link->ForwardLink) {
+    IndexEntry = CR (Link, HII_VARSTORE_INDEX_ENTRY, Entry, HII_VARSTORE_INDEX_SIGNATURE);
+    if (IndexEntry->VarStore->OpCode != EFI_IFR_VARSTORE_EFI_OP) {
+      continue;
+    }
     //
-    // More than one form packages exist.
+    // If the length is small than the structure, this is from old efi
+    // varstore definition. Old efi varstore get config directly from
+    // GetVariable function.
     //
-    if (PackageOffset >= PackageHeader->Length) {
-        //
-        // Process the new form package.
-        //
-        PackageOffset = sizeof (EFI_HII_PACKAGE_HEADER);
-        IfrOffset    += PackageOffset;
-        PackageHeader = (EFI_HII_PACKAGE_HEADER *) (HiiFormPackage + IfrOffset);
+    if (IndexEntry->VarStore->Length < sizeof (EFI_IFR_VARSTORE_EFI)) {
+      continue;
     }
 
-    IfrOpHdr  = (EFI_IFR_OP_HEADER *) (HiiFormPackage + IfrOffset);
-    IfrOffset += IfrOpHdr->Length;
-    PackageOffset += IfrOpHdr->Length;
-
-    if (IfrOpHdr->OpCode == EFI_IFR_VARSTORE_EFI_OP ) {
-      IfrEfiVarStore = (EFI_IFR_VARSTORE_EFI *) IfrOpHdr;
-      //
-      // If the length is small than the structure, this is from old efi
-      // varstore definition. Old efi varstore get config directly from
-      // GetVariable function.
-      //
-      if (IfrOpHdr->Length < sizeof (EFI_IFR_VARSTORE_EFI)) {
-        continue;
-      }
-
-      NameSize = AsciiStrSize ((CHAR8 *)IfrEfiVarStore->Name);
-      VarStoreName = AllocateZeroPool (NameSize * sizeof (CHAR16));
-      if (VarStoreName == NULL) {
-        Status = EFI_OUT_OF_RESOURCES;
-        goto Done;
-      }
-      AsciiStrToUnicodeStrS ((CHAR8 *) IfrEfiVarStore->Name, VarStoreName, NameSize);
-
-      GenerateSubStr (L"GUID=", sizeof (EFI_GUID), (VOID *) &IfrEfiVarStore->Guid, 1, &GuidStr);
-      GenerateSubStr (L"NAME=", StrLen (VarStoreName) * sizeof (CHAR16), (VOID *) VarStoreName, 2, &NameStr);
-      LengthString = StrLen (GuidStr);
-      LengthString = LengthString + StrLen (NameStr) + 1;
-      TempStr = AllocateZeroPool (LengthString * sizeof (CHAR16));
-      if (TempStr == NULL) {
-        FreePool (GuidStr);
-        FreePool (NameStr);
-        FreePool (VarStoreName);
-        Status = EFI_OUT_OF_RESOURCES;
-        goto Done;
-      }
-      StrCpyS (TempStr, LengthString, GuidStr);
-      StrCatS (TempStr, LengthString, NameStr);
-      if (ConfigHdr == NULL || StrnCmp (ConfigHdr, TempStr, StrLen (TempStr)) == 0) {
-        *EfiVarStore = (EFI_IFR_VARSTORE_EFI *) AllocateZeroPool (IfrOpHdr->Length);
-        if (*EfiVarStore == NULL) {
-          FreePool (VarStoreName);
-          FreePool (GuidStr);
-          FreePool (NameStr);
-          FreePool (TempStr);
-          Status = EFI_OUT_OF_RESOURCES;
-          goto Done;
-        }
-        *IsEfiVarstore = TRUE;
-        CopyMem (*EfiVarStore, IfrEfiVarStore, IfrOpHdr->Length);
-      }
-
-      //
-      // Free allocated temp string.
-      //
-      FreePool (VarStoreName);
-      FreePool (GuidStr);
-      FreePool (NameStr);
-      FreePool (TempStr);
-
-      //
-      // Already found the varstore, break;
-      //
-      if (*IsEfiVarstore) {
-        break;
+    if (ConfigHdr == NULL || StrnCmp (ConfigHdr, IndexEntry->ConfigHdr, StrLen (IndexEntry->ConfigHdr)) == 0) {
+      *EfiVarStore = (EFI_IFR_VARSTORE_EFI *) AllocateCopyPool (IndexEntry->VarStore->Length, IndexEntry->VarStore);
+      if (*EfiVarStore == NULL) {
+        return EFI_OUT_OF_RESOURCES;
       }
+      *IsEfiVarstore = TRUE;
+      break;
     }
   }
-Done:
-  if (HiiFormPackage != NULL) {
-    FreePool (HiiFormPackage);
-  }
 
-  return Status;
+  return EFI_SUCCESS;
 }
 
 /**
@@ -1835,7 +1945,7 @@ Done:
 }
 
 /**
-  This function parses Form Package to get the efi varstore info according to the request ConfigHdr.
+  This function looks the request ConfigHdr up in the varstore index of a package list.
 
   @param  DataBaseRecord        The DataBaseRecord instance contains the found Hii handle and package.
   @param  ConfigHdr             Request string ConfigHdr. If it is NULL,
@@ -1850,119 +1960,36 @@ IsThisPackageList (
   )
 {
   EFI_STATUS               Status;
-  UINTN                    IfrOffset;
-  UINTN                    PackageOffset;
-  EFI_IFR_OP_HEADER        *IfrOpHdr;
-  CHAR16                   *VarStoreName;
-  UINTN                    NameSize;
-  UINT8                    *HiiFormPackage;
-  UINTN                    PackageSize;
-  EFI_IFR_VARSTORE_EFI     *IfrEfiVarStore;
-  EFI_HII_PACKAGE_HEADER   *PackageHeader;
-  EFI_IFR_VARSTORE         *IfrVarStore;
-  EFI_IFR_VARSTORE_NAME_VALUE *IfrNameValueVarStore;
-  BOOLEAN                  FindVarstore;
-
-  HiiFormPackage   = NULL;
-  VarStoreName     = NULL;
-  Status           = EFI_SUCCESS;
-  FindVarstore     = FALSE;
+  LIST_ENTRY               *VarStoreIndex;
+  LIST_ENTRY               *Link;
+  HII_VARSTORE_INDEX_ENTRY *IndexEntry;
 
-  Status = GetFormPackageData(DataBaseRecord, &HiiFormPackage, &PackageSize);
+  Status = GetVarStoreIndex (DataBaseRecord, &VarStoreIndex);
   if (EFI_ERROR (Status)) {
     return FALSE;
   }
 
-  IfrOffset     = sizeof (EFI_HII_PACKAGE_HEADER);
-  PackageOffset = IfrOffset;
-  PackageHeader = (EFI_HII_PACKAGE_HEADER *) HiiFormPackage;
-
-  while (IfrOffset < PackageSize) {
+  //
+  // Only the varstores declared before the first form are checked.
+  //
+  for (Link = VarStoreIndex->ForwardLink; Link != VarStoreIndex; Link = Link->ForwardLink) {
+    IndexEntry = CR (Link, HII_VARSTORE_INDEX_ENTRY, Entry, HII_VARSTORE_INDEX_SIGNATURE);
+    if (!IndexEntry->BeforeForm) {
+      break;
+    }
     //
-    // More than one form packages exist.
+    // If ConfigHdr has name field and varstore not has name, it does not match.
     //
-    if (PackageOffset >= PackageHeader->Length) {
-        //
-        // Process the new form package.
-        //
-        PackageOffset = sizeof (EFI_HII_PACKAGE_HEADER);
-        IfrOffset    += PackageOffset;
-        PackageHeader = (EFI_HII_PACKAGE_HEADER *) (HiiFormPackage + IfrOffset);
+    if (IndexEntry->VarStore->OpCode == EFI_IFR_VARSTORE_NAME_VALUE_OP &&
+        ConfigHdr != NULL && StrStr (ConfigHdr, L"NAME=&") == NULL) {
+      continue;
     }
-
-    IfrOpHdr  = (EFI_IFR_OP_HEADER *) (HiiFormPackage + IfrOffset);
-    IfrOffset += IfrOpHdr->Length;
-    PackageOffset += IfrOpHdr->Length;
-
-    switch (IfrOpHdr->OpCode) {
-
-    case EFI_IFR_VARSTORE_OP:
-      IfrVarStore = (EFI_IFR_VARSTORE *) IfrOpHdr;
-
-      NameSize = AsciiStrSize ((CHAR8 *)IfrVarStore->Name);
-      VarStoreName = AllocateZeroPool (NameSize * sizeof (CHAR16));
-      if (VarStoreName == NULL) {
-        goto Done;
-      }
-      AsciiStrToUnicodeStrS ((CHAR8 *)IfrVarStore->Name, VarStoreName, NameSize);
-
-      if (IsThisVarstore((VOID *)&IfrVarStore->Guid, VarStoreName, ConfigHdr)) {
-        FindVarstore = TRUE;
-        goto Done;
-      } else {
-        FreePool (VarStoreName);
-        VarStoreName = NULL;
-      }
-      break;
-
-    case EFI_IFR_VARSTORE_EFI_OP:
-      IfrEfiVarStore = (EFI_IFR_VARSTORE_EFI *) IfrOpHdr;
-      NameSize = AsciiStrSize ((CHAR8 *)IfrEfiVarStore->Name);
-      VarStoreName = AllocateZeroPool (NameSize * sizeof (CHAR16));
-      if (VarStoreName == NULL) {
-        goto Done;
-      }
-      AsciiStrToUnicodeStrS ((CHAR8 *)IfrEfiVarStore->Name, VarStoreName, NameSize);
-
-      if (IsThisVarstore (&IfrEfiVarStore->Guid, VarStoreName, ConfigHdr)) {
-        FindVarstore = TRUE;
-        goto Done;
-      } else {
-        FreePool (VarStoreName);
-        VarStoreName = NULL;
-      }
-      break;
-
-    case EFI_IFR_VARSTORE_NAME_VALUE_OP:
-      IfrNameValueVarStore = (EFI_IFR_VARSTORE_NAME_VALUE *) IfrOpHdr;
-
-      if (IsThisVarstore (&IfrNameValueVarStore->Guid, NULL, ConfigHdr)) {
-        FindVarstore = TRUE;
-        goto Done;
-      }
-      break;
-
-    case EFI_IFR_FORM_OP:
-    case EFI_IFR_FORM_MAP_OP:
-      //
-      // No matched varstore is found and directly return.
-      //
-      goto Done;
-
-    default:
-      break;
+    if (ConfigHdr == NULL || StrnCmp (ConfigHdr, IndexEntry->ConfigHdr, StrLen (IndexEntry->ConfigHdr)) == 0) {
+      return TRUE;
     }
   }
-Done:
-  if (HiiFormPackage != NULL) {
-    FreePool (HiiFormPackage);
-  }
 
-  if (VarStoreName != NULL) {
-    FreePool (VarStoreName);
-  }
-
-  return FindVarstore;
+  return FALSE;
 }
 
 /**
@@ -2066,6 +2093,7 @@ IsThisOpcodeRequired (
     BlockData->Offset = VarOffset;
   }
 
+  BlockData->NameId     = NameId;
   BlockData->Width      = VarWidth;
   BlockData->QuestionId = IfrQuestionHdr->QuestionId;
   BlockData->OpCode     = IfrOpHdr->OpCode;
@@ -2327,11 +2355,12 @@ ParseIfrData (
       VarWidth  = (UINT16) (sizeof (EFI_HII_REF));
 
       //
-      // The BlockData may allocate by other opcode,need to clean.
+      // The BlockData may allocate by other opcode,need to clean. The defaults of
+      // the previous question don't apply to this one either.
       //
-      if (BlockData != NULL){
-        BlockData = NULL;
-      }
+      BlockData              = NULL;
+      SmallestDefaultId      = 0xFFFF;
+      FromOtherDefaultOpcode = FALSE;
 
       Status = IsThisOpcodeRequired(RequestBlockArray, HiiHandle, VarStorageData, IfrOpHdr, VarWidth, &BlockData, FALSE);
       if (EFI_ERROR (Status)) {
@@ -2373,11 +2402,12 @@ ParseIfrData (
       }
 
       //
-      // The BlockData may allocate by other opcode,need to clean.
+      // The BlockData may allocate by other opcode,need to clean. The defaults of
+      // the previous question don't apply to this one either.
       //
-      if (BlockData != NULL){
-        BlockData = NULL;
-      }
+      BlockData              = NULL;
+      SmallestDefaultId      = 0xFFFF;
+      FromOtherDefaultOpcode = FALSE;
 
       Status = IsThisOpcodeRequired(RequestBlockArray, HiiHandle, VarStorageData, IfrOpHdr, VarWidth, &BlockData, QuestionReferBitField);
       if (EFI_ERROR (Status)) {
@@ -2469,11 +2499,12 @@ ParseIfrData (
       VarWidth  = IfrOrderedList->MaxContainers;
 
       //
-      // The BlockData may allocate by other opcode,need to clean.
+      // The BlockData may allocate by other opcode,need to clean. The defaults of
+      // the previous question don't apply to this one either.
       //
-      if (BlockData != NULL){
-        BlockData = NULL;
-      }
+      BlockData              = NULL;
+      SmallestDefaultId      = 0xFFFF;
+      FromOtherDefaultOpcode = FALSE;
 
       Status = IsThisOpcodeRequired(RequestBlockArray, HiiHandle, VarStorageData, IfrOpHdr, VarWidth, &BlockData, FALSE);
       if (EFI_ERROR (Status)) {
@@ -2514,11 +2545,12 @@ ParseIfrData (
       VarWidth  = (UINT16) sizeof (BOOLEAN);
 
       //
-      // The BlockData may allocate by other opcode,need to clean.
+      // The BlockData may allocate by other opcode,need to clean. The defaults of
+      // the previous question don't apply to this one either.
       //
-      if (BlockData != NULL){
-        BlockData = NULL;
-      }
+      BlockData              = NULL;
+      SmallestDefaultId      = 0xFFFF;
+      FromOtherDefaultOpcode = FALSE;
 
       if (QuestionReferBitField) {
         VarWidth = 1;
@@ -2660,11 +2692,12 @@ ParseIfrData (
       }
 
       //
-      // The BlockData may allocate by other opcode,need to clean.
+      // The BlockData may allocate by other opcode,need to clean. The defaults of
+      // the previous question don't apply to this one either.
       //
-      if (BlockData != NULL){
-        BlockData = NULL;
-      }
+      BlockData              = NULL;
+      SmallestDefaultId      = 0xFFFF;
+      FromOtherDefaultOpcode = FALSE;
 
       VarWidth  = (UINT16) sizeof (EFI_HII_DATE);
       Status = IsThisOpcodeRequired(RequestBlockArray, HiiHandle, VarStorageData, IfrOpHdr, VarWidth, &BlockData, FALSE);
@@ -2702,11 +2735,12 @@ ParseIfrData (
       }
 
       //
-      // The BlockData may allocate by other opcode,need to clean.
+      // The BlockData may allocate by other opcode,need to clean. The defaults of
+      // the previous question don't apply to this one either.
       //
-      if (BlockData != NULL){
-        BlockData = NULL;
-      }
+      BlockData              = NULL;
+      SmallestDefaultId      = 0xFFFF;
+      FromOtherDefaultOpcode = FALSE;
 
       VarWidth  = (UINT16) sizeof (EFI_HII_TIME);
       Status = IsThisOpcodeRequired(RequestBlockArray, HiiHandle, VarStorageData, IfrOpHdr, VarWidth, &BlockData, FALSE);
@@ -2744,11 +2778,12 @@ ParseIfrData (
       }
 
       //
-      // The BlockData may allocate by other opcode,need to clean.
+      // The BlockData may allocate by other opcode,need to clean. The defaults of
+      // the previous question don't apply to this one either.
       //
-      if (BlockData != NULL){
-        BlockData = NULL;
-      }
+      BlockData              = NULL;
+      SmallestDefaultId      = 0xFFFF;
+      FromOtherDefaultOpcode = FALSE;
 
       VarWidth  = (UINT16) (IfrString->MaxSize * sizeof (UINT16));
       Status = IsThisOpcodeRequired(RequestBlockArray, HiiHandle, VarStorageData, IfrOpHdr, VarWidth, &BlockData, FALSE);
@@ -2786,11 +2821,12 @@ ParseIfrData (
       }
 
       //
-      // The BlockData may allocate by other opcode,need to clean.
+      // The BlockData may allocate by other opcode,need to clean. The defaults of
+      // the previous question don't apply to this one either.
       //
-      if (BlockData != NULL){
-        BlockData = NULL;
-      }
+      BlockData              = NULL;
+      SmallestDefaultId      = 0xFFFF;
+      FromOtherDefaultOpcode = FALSE;
 
       VarWidth  = (UINT16) (IfrPassword->MaxSize * sizeof (UINT16));
       Status = IsThisOpcodeRequired(RequestBlockArray, HiiHandle, VarStorageData, IfrOpHdr, VarWidth, &BlockData, FALSE);
@@ -3095,6 +3131,350 @@ Done:
   return Status;
 }
 
+/**
+  Parse the questions and the default values of a varstore index entry, as
+  ParseIfrData() gets them for a request with the ConfigHdr of the entry and
+  no request element. If the IFR data can't be parsed, the entry gets none.
+
+  @param  HiiHandle             Hii Handle for this hii package.
+  @param  Package               Pointer to the form package data.
+  @param  PackageLength         Length of the package.
+  @param  IndexEntry            The varstore index entry.
+
+**/
+VOID
+ParseVarStoreQuestions (
+  IN     EFI_HII_HANDLE            HiiHandle,
+  IN     UINT8                     *Package,
+  IN     UINT32                    PackageLength,
+  IN OUT HII_VARSTORE_INDEX_ENTRY  *IndexEntry
+  )
+{
+  EFI_STATUS               Status;
+  EFI_STRING               ConfigHdr;
+  UINTN                    LengthString;
+  IFR_VARSTORAGE_DATA      *VarStorageData;
+  IFR_DEFAULT_DATA         *DefaultIdArray;
+
+  VarStorageData = (IFR_VARSTORAGE_DATA *) AllocateZeroPool (sizeof (IFR_VARSTORAGE_DATA));
+  if (VarStorageData == NULL) {
+    return;
+  }
+  InitializeListHead (&VarStorageData->Entry);
+  InitializeListHead (&VarStorageData->BlockEntry);
+
+  DefaultIdArray = (IFR_DEFAULT_DATA *) AllocateZeroPool (sizeof (IFR_DEFAULT_DATA));
+  if (DefaultIdArray == NULL) {
+    FreeVarStorageData (VarStorageData);
+    return;
+  }
+  InitializeListHead (&DefaultIdArray->Entry);
+
+  //
+  // The ConfigHdr of a request is followed by "&PATH=".
+  //
+  LengthString = StrLen (IndexEntry->ConfigHdr) + 2;
+  ConfigHdr    = AllocateZeroPool (LengthString * sizeof (CHAR16));
+  if (ConfigHdr == NULL) {
+    Status = EFI_OUT_OF_RESOURCES;
+  } else {
+    StrCpyS (ConfigHdr, LengthString, IndexEntry->ConfigHdr);
+    StrCatS (ConfigHdr, LengthString, L"&");
+    Status = ParseIfrData (HiiHandle, Package, PackageLength, ConfigHdr, NULL, VarStorageData, DefaultIdArray);
+    FreePool (ConfigHdr);
+  }
+
+  if (EFI_ERROR (Status)) {
+    FreeVarStorageData (VarStorageData);
+    FreeDefaultIdArray (DefaultIdArray);
+    return;
+  }
+
+  IndexEntry->Questions  = VarStorageData;
+  IndexEntry->DefaultIds = DefaultIdArray;
+}
+
+/**
+  Build the varstore index of a package list, with the questions and default
+  values of each varstore, if it is not built yet.
+
+  @param  DataBaseRecord        The DataBaseRecord instance contains the found Hii handle and package.
+
+  @retval EFI_SUCCESS           The varstore index is built.
+  @retval EFI_OUT_OF_RESOURCES  No enough memory.
+
+**/
+EFI_STATUS
+BuildVarStoreIndex (
+  IN HII_DATABASE_RECORD                 *DataBaseRecord
+  )
+{
+  EFI_STATUS                         Status;
+  HII_DATABASE_PACKAGE_LIST_INSTANCE *PackageList;
+  LIST_ENTRY                         *Link;
+  LIST_ENTRY                         *SameLink;
+  HII_IFR_PACKAGE_INSTANCE           *FormPackage;
+  HII_VARSTORE_INDEX_ENTRY           *IndexEntry;
+  HII_VARSTORE_INDEX_ENTRY           *SameEntry;
+  EFI_IFR_OP_HEADER                  *IfrOpHdr;
+  UINTN                              IfrOffset;
+  UINTN                              PackageLength;
+  BOOLEAN                            BeforeForm;
+  UINT8                              *HiiFormPackage;
+  UINTN                              PackageSize;
+
+  PackageList = DataBaseRecord->PackageList;
+  if (PackageList->VarStoreIndexValid) {
+    return EFI_SUCCESS;
+  }
+
+  BeforeForm = TRUE;
+  for (Link = PackageList->FormPkgHdr.ForwardLink; Link != &PackageList->FormPkgHdr; Link = Link->ForwardLink) {
+    FormPackage   = CR (Link, HII_IFR_PACKAGE_INSTANCE, IfrEntry, HII_IFR_PACKAGE_SIGNATURE);
+    PackageLength = FormPackage->FormPkgHdr.Length - sizeof (EFI_HII_PACKAGE_HEADER);
+    for (IfrOffset = 0; IfrOffset < PackageLength; IfrOffset += IfrOpHdr->Length) {
+      IfrOpHdr = (EFI_IFR_OP_HEADER *) (FormPackage->IfrData + IfrOffset);
+      switch (IfrOpHdr->OpCode) {
+      case EFI_IFR_VARSTORE_OP:
+      case EFI_IFR_VARSTORE_EFI_OP:
+      case EFI_IFR_VARSTORE_NAME_VALUE_OP:
+        Status = AddVarStoreIndexEntry (PackageList, FormPackage, IfrOpHdr, BeforeForm);
+        if (EFI_ERROR (Status)) {
+          InvalidateVarStoreIndex (PackageList);
+          return Status;
+        }
+        break;
+
+      case EFI_IFR_FORM_OP:
+      case EFI_IFR_FORM_MAP_OP:
+        BeforeForm = FALSE;
+        break;
+
+      default:
+        break;
+      }
+      if (IfrOpHdr->Length == 0) {
+        break;
+      }
+    }
+  }
+
+  //
+  // Parse the questions of each ConfigHdr once, so that a request is served by
+  // filtering them with its request elements.
+  //
+  if (!IsListEmpty (&PackageList->VarStoreIndex)) {
+    Status = GetFormPackageData (DataBaseRecord, &HiiFormPackage, &PackageSize);
+    if (!EFI_ERROR (Status)) {
+      for (Link = PackageList->VarStoreIndex.ForwardLink; Link != &PackageList->VarStoreIndex; Link = Link->ForwardLink) {
+        IndexEntry = CR (Link, HII_VARSTORE_INDEX_ENTRY, Entry, HII_VARSTORE_INDEX_SIGNATURE);
+        for (SameLink = PackageList->VarStoreIndex.ForwardLink; SameLink != Link; SameLink = SameLink->ForwardLink) {
+          SameEntry = CR (SameLink, HII_VARSTORE_INDEX_ENTRY, Entry, HII_VARSTORE_INDEX_SIGNATURE);
+          if (StrCmp (SameEntry->ConfigHdr, IndexEntry->ConfigHdr) == 0) {
+            break;
+          }
+        }
+        if (SameLink == Link) {
+          ParseVarStoreQuestions (DataBaseRecord->Handle, HiiFormPackage, (UINT32) PackageSize, IndexEntry);
+        }
+      }
+      FreePool (HiiFormPackage);
+    }
+  }
+
+  PackageList->VarStoreIndexValid = TRUE;
+  return EFI_SUCCESS;
+}
+
+/**
+  Get the varstore index of a package list, which lists the varstores of its
+  form packages in IFR order. The index is built when the package list is
+  installed or updated, or else on first use, and kept until a form package is
+  added or removed.
+
+  @param  DataBaseRecord        The DataBaseRecord instance contains the found Hii handle and package.
+  @param  VarStoreIndex         Return the list of HII_VARSTORE_INDEX_ENTRY.
+
+  @retval EFI_SUCCESS           The varstore index is returned.
+  @retval EFI_OUT_OF_RESOURCES  No enough memory.
+
+**/
+EFI_STATUS
+GetVarStoreIndex (
+  IN     HII_DATABASE_RECORD        *DataBaseRecord,
+  OUT    LIST_ENTRY                 **VarStoreIndex
+  )
+{
+  EFI_STATUS                         Status;
+
+  Status = BuildVarStoreIndex (DataBaseRecord);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  *VarStoreIndex = &DataBaseRecord->PackageList->VarStoreIndex;
+  return EFI_SUCCESS;
+}
+
+/**
+  Get the block array and the default value array of a request by filtering
+  the questions in the varstore index with the request elements, instead of
+  parsing the form packages.
+
+  @param  DataBaseRecord        The DataBaseRecord instance contains the found Hii handle and package.
+  @param  Request               The request string. If it is NULL, the first
+                                found varstore will be as ConfigHdr.
+  @param  RequestBlockArray     The block array is retrieved from the request string.
+  @param  VarStorageData        VarStorage structure contains the got block and default value.
+  @param  DefaultIdArray        Point to the got default id and default name array.
+
+  @retval EFI_SUCCESS           The block array and the default value array are got.
+  @retval EFI_NOT_FOUND         The questions of the request are not in the index,
+                                the form packages have to be parsed.
+  @retval EFI_OUT_OF_RESOURCES  No enough memory.
+**/
+EFI_STATUS
+GetVarStoreQuestions (
+  IN     HII_DATABASE_RECORD *DataBaseRecord,
+  IN     EFI_STRING          Request,
+  IN     IFR_BLOCK_DATA      *RequestBlockArray,
+  IN OUT IFR_VARSTORAGE_DATA *VarStorageData,
+  IN OUT IFR_DEFAULT_DATA    *DefaultIdArray
+  )
+{
+  EFI_STATUS                         Status;
+  HII_DATABASE_PACKAGE_LIST_INSTANCE *PackageList;
+  LIST_ENTRY                         *VarStoreIndex;
+  LIST_ENTRY                         *Link;
+  LIST_ENTRY                         *LinkDefault;
+  HII_VARSTORE_INDEX_ENTRY           *IndexEntry;
+  IFR_VARSTORAGE_DATA                *Questions;
+  IFR_BLOCK_DATA                     *Question;
+  IFR_BLOCK_DATA                     *BlockData;
+  IFR_DEFAULT_DATA                   *DefaultData;
+  IFR_DEFAULT_DATA                   *DefaultDataPtr;
+  EFI_STRING                         ConfigHdr;
+  EFI_STRING                         StringPtr;
+  UINTN                              HdrLength;
+  BOOLEAN                            IsNameValue;
+
+  Status = GetVarStoreIndex (DataBaseRecord, &VarStoreIndex);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  ConfigHdr = NULL;
+  HdrLength = 0;
+  if (Request != NULL) {
+    StringPtr = StrStr (Request, L"&PATH=");
+    if (StringPtr == NULL) {
+      return EFI_NOT_FOUND;
+    }
+    ConfigHdr = Request;
+    HdrLength = (UINTN) (StringPtr - Request);
+  } else {
+    //
+    // Without ConfigHdr, ParseIfrData() takes the first varstore of each form
+    // package, the index has its questions only for a single form package.
+    //
+    PackageList = DataBaseRecord->PackageList;
+    if (PackageList->FormPkgHdr.ForwardLink->ForwardLink != &PackageList->FormPkgHdr) {
+      return EFI_NOT_FOUND;
+    }
+    for (Link = VarStoreIndex->ForwardLink; Link != VarStoreIndex; Link = Link->ForwardLink) {
+      IndexEntry = CR (Link, HII_VARSTORE_INDEX_ENTRY, Entry, HII_VARSTORE_INDEX_SIGNATURE);
+      //
+      // The old efi varstore definition is skipped as ParseIfrData() does.
+      //
+      if (IndexEntry->VarStore->OpCode != EFI_IFR_VARSTORE_EFI_OP ||
+          IndexEntry->VarStore->Length >= sizeof (EFI_IFR_VARSTORE_EFI)) {
+        ConfigHdr = IndexEntry->ConfigHdr;
+        HdrLength = StrLen (ConfigHdr);
+        break;
+      }
+    }
+    if (ConfigHdr == NULL) {
+      return EFI_NOT_FOUND;
+    }
+  }
+
+  //
+  // The questions are kept by the first entry of a ConfigHdr.
+  //
+  Questions = NULL;
+  for (Link = VarStoreIndex->ForwardLink; Link != VarStoreIndex; Link = Link->ForwardLink) {
+    IndexEntry = CR (Link, HII_VARSTORE_INDEX_ENTRY, Entry, HII_VARSTORE_INDEX_SIGNATURE);
+    if (StrLen (IndexEntry->ConfigHdr) == HdrLength && StrnCmp (IndexEntry->ConfigHdr, ConfigHdr, HdrLength) == 0) {
+      Questions = IndexEntry->Questions;
+      break;
+    }
+  }
+  if (Questions == NULL) {
+    return EFI_NOT_FOUND;
+  }
+
+  CopyGuid (&VarStorageData->Guid, &Questions->Guid);
+  VarStorageData->Size = Questions->Size;
+  VarStorageData->Type = Questions->Type;
+  if (Questions->Name != NULL) {
+    VarStorageData->Name = AllocateCopyPool (StrSize (Questions->Name), Questions->Name);
+    if (VarStorageData->Name == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+  }
+
+  IsNameValue = (BOOLEAN) (Questions->Type == EFI_HII_VARSTORE_NAME_VALUE);
+  for (Link = Questions->BlockEntry.ForwardLink; Link != &Questions->BlockEntry; Link = Link->ForwardLink) {
+    Question = BASE_CR (Link, IFR_BLOCK_DATA, Entry);
+    //
+    // Check whether this question is in requested block array.
+    //
+    if (IsNameValue) {
+      if (!BlockArrayCheck (RequestBlockArray, Question->NameId, 0, TRUE, DataBaseRecord->Handle)) {
+        continue;
+      }
+    } else {
+      if (!BlockArrayCheck (RequestBlockArray, Question->Offset, Question->Width, FALSE, DataBaseRecord->Handle)) {
+        continue;
+      }
+    }
+
+    BlockData = (IFR_BLOCK_DATA *) AllocateCopyPool (sizeof (IFR_BLOCK_DATA), Question);
+    if (BlockData == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+    InitializeListHead (&BlockData->DefaultValueEntry);
+    InsertTailList (&VarStorageData->BlockEntry, &BlockData->Entry);
+    //
+    // Get the name in the current language.
+    //
+    BlockData->Name = NULL;
+    if (IsNameValue) {
+      BlockData->Name = InternalGetString (DataBaseRecord->Handle, Question->NameId);
+    }
+
+    for (LinkDefault = Question->DefaultValueEntry.ForwardLink; LinkDefault != &Question->DefaultValueEntry; LinkDefault = LinkDefault->ForwardLink) {
+      DefaultDataPtr = BASE_CR (LinkDefault, IFR_DEFAULT_DATA, Entry);
+      DefaultData    = (IFR_DEFAULT_DATA *) AllocateCopyPool (sizeof (IFR_DEFAULT_DATA), DefaultDataPtr);
+      if (DefaultData == NULL) {
+        return EFI_OUT_OF_RESOURCES;
+      }
+      InsertTailList (&BlockData->DefaultValueEntry, &DefaultData->Entry);
+    }
+  }
+
+  for (Link = IndexEntry->DefaultIds->Entry.ForwardLink; Link != &IndexEntry->DefaultIds->Entry; Link = Link->ForwardLink) {
+    DefaultDataPtr = BASE_CR (Link, IFR_DEFAULT_DATA, Entry);
+    DefaultData    = (IFR_DEFAULT_DATA *) AllocateCopyPool (sizeof (IFR_DEFAULT_DATA), DefaultDataPtr);
+    if (DefaultData == NULL) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+    InsertTailList (&DefaultIdArray->Entry, &DefaultData->Entry);
+  }
+
+  return EFI_SUCCESS;
+}
+
 /**
   parse the configrequest string, get the elements.
 
@@ -4042,8 +4422,6 @@ GetFullStringFromHiiFormPackages (
   UINTN                        PackageSize;
   IFR_BLOCK_DATA               *RequestBlockArray;
   IFR_BLOCK_DATA               *BlockData;
-  IFR_DEFAULT_DATA             *DefaultValueData;
-  IFR_DEFAULT_DATA             *DefaultId;
   IFR_DEFAULT_DATA             *DefaultIdArray;
   IFR_VARSTORAGE_DATA          *VarStorageData;
   EFI_STRING                   DefaultAltCfgResp;
@@ -4067,11 +4445,6 @@ GetFullStringFromHiiFormPackages (
   PackageSize       = 0;
   Progress          = *Request;
 
-  Status = GetFormPackageData (DataBaseRecord, &HiiFormPackage, &PackageSize);
-  if (EFI_ERROR (Status)) {
-    goto Done;
-  }
-
   //
   // 1. Get the request block array by Request String when Request string contains the block array.
   //
@@ -4152,19 +4525,27 @@ GetFullStringFromHiiFormPackages (
   InitializeListHead (&VarStorageData->BlockEntry);
 
   //
-  // 2. Parse FormPackage to get BlockArray and DefaultId Array for the request BlockArray.
+  // 2. Get BlockArray and DefaultId Array for the request BlockArray from the questions
+  //    in the varstore index, or parse FormPackage if they are not indexed.
   //
+  Status = GetVarStoreQuestions (DataBaseRecord, *Request, RequestBlockArray, VarStorageData, DefaultIdArray);
+  if (Status == EFI_NOT_FOUND) {
+    Status = GetFormPackageData (DataBaseRecord, &HiiFormPackage, &PackageSize);
+    if (EFI_ERROR (Status)) {
+      goto Done;
+    }
 
-  //
-  // Parse the opcode in form package to get the default setting.
-  //
-  Status = ParseIfrData (DataBaseRecord->Handle,
-                         HiiFormPackage,
-                         (UINT32) PackageSize,
-                         *Request,
-                         RequestBlockArray,
-                         VarStorageData,
-                         DefaultIdArray);
+    //
+    // Parse the opcode in form package to get the default setting.
+    //
+    Status = ParseIfrData (DataBaseRecord->Handle,
+                           HiiFormPackage,
+                           (UINT32) PackageSize,
+                           *Request,
+                           RequestBlockArray,
+                           VarStorageData,
+                           DefaultIdArray);
+  }
   if (EFI_ERROR (Status)) {
     goto Done;
   }
@@ -4232,39 +4613,14 @@ Done:
     //
     // Free link array VarStorageData
     //
-    while (!IsListEmpty (&VarStorageData->BlockEntry)) {
-      BlockData = BASE_CR (VarStorageData->BlockEntry.ForwardLink, IFR_BLOCK_DATA, Entry);
-      RemoveEntryList (&BlockData->Entry);
-      if (BlockData->Name != NULL) {
-        FreePool (BlockData->Name);
-      }
-      //
-      // Free default value link array
-      //
-      while (!IsListEmpty (&BlockData->DefaultValueEntry)) {
-        DefaultValueData = BASE_CR (BlockData->DefaultValueEntry.ForwardLink, IFR_DEFAULT_DATA, Entry);
-        RemoveEntryList (&DefaultValueData->Entry);
-        FreePool (DefaultValueData);
-      }
-      FreePool (BlockData);
-    }
-    if (VarStorageData ->Name != NULL) {
-      FreePool (VarStorageData ->Name);
-      VarStorageData ->Name = NULL;
-    }
-    FreePool (VarStorageData);
+    FreeVarStorageData (VarStorageData);
   }
 
   if (DefaultIdArray != NULL) {
     //
     // Free DefaultId Array
     //
-    while (!IsListEmpty (&DefaultIdArray->Entry)) {
-      DefaultId = BASE_CR (DefaultIdArray->Entry.ForwardLink, IFR_DEFAULT_DATA, Entry);
-      RemoveEntryList (&DefaultId->Entry);
-      FreePool (DefaultId);
-    }
-    FreePool (DefaultIdArray);
+    FreeDefaultIdArray (DefaultIdArray);
   }
 
   //
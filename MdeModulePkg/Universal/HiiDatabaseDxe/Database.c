@@ -1,7 +1,7 @@
 /** @file
 Implementation for EFI_HII_DATABASE_PROTOCOL.
 
-Copyright (c) 2007 - 2019, Intel Corporation. All rights reserved.<BR>
+Copyright (c) 2007 - 2020, Intel Corporation. All rights reserved.<BR>
 SPDX-License-Identifier: BSD-2-Clause-Patent
 
 **/
@@ -73,6 +73,7 @@ GenerateHiiDatabaseRecord (
   InitializeListHead (&PackageList->StringPkgHdr);
   InitializeListHead (&PackageList->FontPkgHdr);
   InitializeListHead (&PackageList->SimpleFontPkgHdr);
+  InitializeListHead (&PackageList->VarStoreIndex);
   PackageList->ImagePkg      = NULL;
   PackageList->DevicePathPkg = NULL;
 
@@ -1125,6 +1126,7 @@ InsertFormPackage (
     );
 
   InsertTailList (&PackageList->FormPkgHdr, &FormPackage->IfrEntry);
+  InvalidateVarStoreIndex (PackageList);
   *Package = FormPackage;
 
   //
@@ -1268,7 +1270,11 @@ RemoveFormPackages (
     }
 
     RemoveEntryList (&Package->IfrEntry);
+    InvalidateVarStoreIndex (PackageList);
     PackageList->PackageListHdr.PackageLength -= Package->FormPkgHdr.Length;
+    if (Package->QuestionIndex != NULL) {
+      FreePool (Package->QuestionIndex);
+    }
     FreePool (Package->IfrData);
     FreePool (Package);
     //
@@ -1497,6 +1503,7 @@ AdjustStringPackage (
       *BlockPtr = EFI_HII_SIBT_END;
       FreePool (StringPackage->StringBlock);
       StringPackage->StringBlock = StringBlock;
+      InvalidateStringBlockIndex (StringPackage);
       StringPackage->StringPkgHdr->Header.Length += Skip2BlockSize;
       PackageList->PackageListHdr.PackageLength += Skip2BlockSize;
       StringPackage->MaxStringId = MaxStringId;
@@ -1636,6 +1643,7 @@ RemoveStringPackages (
 
     RemoveEntryList (&Package->StringEntry);
     PackageList->PackageListHdr.PackageLength -= Package->StringPkgHdr->Header.Length;
+    InvalidateStringBlockIndex (Package);
     FreePool (Package->StringBlock);
     FreePool (Package->StringPkgHdr);
     //
@@ -1776,6 +1784,7 @@ InsertFontPackage (
   GlobalFont->FontInfoSize = FontInfoSize;
   GlobalFont->FontInfo     = FontInfo;
   InsertTailList (&Private->FontInfoList, &GlobalFont->Entry);
+  FlushGlyphCache (Private);
 
   //
   // Insert this font package to Font package array
@@ -1967,6 +1976,7 @@ RemoveFontPackages (
     //
     // Remove corresponding global font info
     //
+    FlushGlyphCache (Private);
     for (Link = Private->FontInfoList.ForwardLink; Link != &Private->FontInfoList; Link = Link->ForwardLink) {
       GlobalFont = CR (Link, HII_GLOBAL_FONT_INFO, Entry, HII_GLOBAL_FONT_INFO_SIGNATURE);
       if (GlobalFont->FontPackage == Package) {
@@ -2458,6 +2468,7 @@ RemoveSimpleFontPackages (
 
     RemoveEntryList (&Package->SimpleFontEntry);
     PackageList->PackageListHdr.PackageLength -= Package->SimpleFontPkgHdr->Header.Length;
+    FlushGlyphCache (Private);
     FreePool (Package->SimpleFontPkgHdr);
     FreePool (Package);
   }
@@ -3124,6 +3135,7 @@ AddPackages (
       if (EFI_ERROR (Status)) {
         return Status;
       }
+      FlushGlyphCache (Private);
       Status = InvokeRegisteredFunction (
                  Private,
                  NotifyType,
@@ -3538,6 +3550,13 @@ HiiNewPackageList (
     ASSERT_EFI_ERROR (Status);
   }
 
+  //
+  // Index the varstores and the questions of the form packages now, rather than
+  // in the first ExtractConfig or ExportConfig. If there is not enough memory,
+  // the index is built on first use.
+  //
+  BuildVarStoreIndex (DatabaseRecord);
+
   *Handle = DatabaseRecord->Handle;
 
   //
@@ -3817,6 +3836,13 @@ HiiUpdatePackageList (
       //
       Status = AddPackages (Private, EFI_HII_DATABASE_NOTIFY_ADD_PACK, PackageList, Node);
 
+      //
+      // Index the new form packages, if any.
+      //
+      if (Status == EFI_SUCCESS) {
+        BuildVarStoreIndex (Node);
+      }
+
       //
       // Check whether need to get the Database info.
       // Only after ReadyToBoot, need to do the export.
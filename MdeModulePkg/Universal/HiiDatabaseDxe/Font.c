@@ -2,7 +2,7 @@
 Implementation for EFI_HII_FONT_PROTOCOL.
 
 
-Copyright (c) 2007 - 2018, Intel Corporation. All rights reserved.<BR>
+Copyright (c) 2007 - 2020, Intel Corporation. All rights reserved.<BR>
 SPDX-License-Identifier: BSD-2-Clause-Patent
 
 **/
@@ -576,6 +576,303 @@ GlyphToImage (
 }
 
 
+/**
+  Free all the glyphs of the rendered glyph cache. It must be called whenever
+  a font or simple font package is added or removed.
+
+  @param  Private                 Hii database private structure.
+
+**/
+VOID
+FlushGlyphCache (
+  IN HII_DATABASE_PRIVATE_DATA       *Private
+  )
+{
+  UINTN                                Index;
+  HII_GLYPH_CACHE_ENTRY                *CacheEntry;
+
+  for (Index = 0; Index < HII_GLYPH_CACHE_BUCKETS; Index++) {
+    while (!IsListEmpty (&Private->GlyphCache[Index])) {
+      CacheEntry = CR (Private->GlyphCache[Index].ForwardLink, HII_GLYPH_CACHE_ENTRY, Entry, HII_GLYPH_CACHE_SIGNATURE);
+      RemoveEntryList (&CacheEntry->Entry);
+      FreePool (CacheEntry);
+    }
+  }
+  Private->GlyphCacheCount = 0;
+}
+
+
+/**
+  Get the rendered glyph cache bucket of a character drawn in a font and colors.
+
+  This is a internal function.
+
+  @param  GlobalFont              The font, or NULL for the system font.
+  @param  CharValue               Unicode character value.
+  @param  Foreground              The color of the "on" pixels in the glyph.
+  @param  Background              The color of the "off" pixels in the glyph.
+
+  @return The index of the bucket.
+
+**/
+UINTN
+GetGlyphCacheBucket (
+  IN HII_GLOBAL_FONT_INFO            *GlobalFont,
+  IN CHAR16                          CharValue,
+  IN EFI_GRAPHICS_OUTPUT_BLT_PIXEL   Foreground,
+  IN EFI_GRAPHICS_OUTPUT_BLT_PIXEL   Background
+  )
+{
+  UINTN                                Hash;
+
+  Hash  = CharValue ^ ((UINTN) GlobalFont >> 4);
+  Hash ^= Foreground.Blue ^ Foreground.Green << 2 ^ Foreground.Red << 4;
+  Hash ^= Background.Blue << 1 ^ Background.Green << 3 ^ Background.Red << 5;
+  return Hash % HII_GLYPH_CACHE_BUCKETS;
+}
+
+
+/**
+  Find a character drawn in a font and colors in the rendered glyph cache.
+
+  This is a internal function.
+
+  @param  Private                 HII database driver private data.
+  @param  GlobalFont              The font, or NULL for the system font.
+  @param  CharValue               Unicode character value.
+  @param  Foreground              The color of the "on" pixels in the glyph.
+  @param  Background              The color of the "off" pixels in the glyph.
+
+  @return The cached glyph, or NULL if the character is not cached.
+
+**/
+HII_GLYPH_CACHE_ENTRY *
+FindCachedGlyph (
+  IN HII_DATABASE_PRIVATE_DATA       *Private,
+  IN HII_GLOBAL_FONT_INFO            *GlobalFont,
+  IN CHAR16                          CharValue,
+  IN EFI_GRAPHICS_OUTPUT_BLT_PIXEL   Foreground,
+  IN EFI_GRAPHICS_OUTPUT_BLT_PIXEL   Background
+  )
+{
+  LIST_ENTRY                           *ListHead;
+  LIST_ENTRY                           *Link;
+  HII_GLYPH_CACHE_ENTRY                *CacheEntry;
+
+  ListHead = &Private->GlyphCache[GetGlyphCacheBucket (GlobalFont, CharValue, Foreground, Background)];
+  for (Link = ListHead->ForwardLink; Link != ListHead; Link = Link->ForwardLink) {
+    CacheEntry = CR (Link, HII_GLYPH_CACHE_ENTRY, Entry, HII_GLYPH_CACHE_SIGNATURE);
+    if (CacheEntry->CharValue == CharValue &&
+        CacheEntry->GlobalFont == GlobalFont &&
+        CompareMem (&CacheEntry->Foreground, &Foreground, sizeof (EFI_GRAPHICS_OUTPUT_BLT_PIXEL)) == 0 &&
+        CompareMem (&CacheEntry->Background, &Background, sizeof (EFI_GRAPHICS_OUTPUT_BLT_PIXEL)) == 0) {
+      return CacheEntry;
+    }
+  }
+
+  return NULL;
+}
+
+
+/**
+  Add a character drawn in a font and colors to the rendered glyph cache.
+
+  The glyph is drawn once into the rows of pixels GlyphToImage() would write
+  when the background is not transparent, so that drawing it again is a copy
+  of each row. Non-spacing glyphs are OR'd with the previous glyph and are
+  only cached with their bitmap data.
+
+  This is a internal function.
+
+  @param  Private                 HII database driver private data.
+  @param  GlobalFont              The font, or NULL for the system font.
+  @param  CharValue               Unicode character value.
+  @param  Foreground              The color of the "on" pixels in the glyph.
+  @param  Background              The color of the "off" pixels in the glyph.
+  @param  GlyphBuffer             Bitmap data of the glyph.
+  @param  Cell                    Points to EFI_HII_GLYPH_INFO structure.
+  @param  Attributes              The attribute of the glyph.
+
+  @return The cached glyph, or NULL if the cache is full or out of resources.
+
+**/
+HII_GLYPH_CACHE_ENTRY *
+CacheGlyph (
+  IN HII_DATABASE_PRIVATE_DATA       *Private,
+  IN HII_GLOBAL_FONT_INFO            *GlobalFont,
+  IN CHAR16                          CharValue,
+  IN EFI_GRAPHICS_OUTPUT_BLT_PIXEL   Foreground,
+  IN EFI_GRAPHICS_OUTPUT_BLT_PIXEL   Background,
+  IN UINT8                           *GlyphBuffer,
+  IN CONST EFI_HII_GLYPH_INFO        *Cell,
+  IN UINT8                           Attributes
+  )
+{
+  HII_GLYPH_CACHE_ENTRY                *CacheEntry;
+  UINTN                                GlyphBufferLen;
+  UINTN                                BitmapWidth;
+  UINTN                                BitmapHeight;
+  UINTN                                Xpos;
+  UINTN                                Ypos;
+  UINT8                                Data;
+
+  if (Private->GlyphCacheCount >= HII_GLYPH_CACHE_MAX_ENTRIES) {
+    return NULL;
+  }
+
+  //
+  // Size the bitmap data and pixels of the glyph the same way GlyphToImage()
+  // draws it.
+  //
+  BitmapWidth  = 0;
+  BitmapHeight = 0;
+  if ((Attributes & EFI_GLYPH_NON_SPACING) == EFI_GLYPH_NON_SPACING) {
+    GlyphBufferLen = BITMAP_LEN_1_BIT (Cell->Width, Cell->Height);
+  } else if ((Attributes & EFI_GLYPH_WIDE) == EFI_GLYPH_WIDE) {
+    if (Cell->Width != EFI_GLYPH_WIDTH * 2) {
+      return NULL;
+    }
+    GlyphBufferLen = EFI_GLYPH_HEIGHT * 2;
+    BitmapWidth    = EFI_GLYPH_WIDTH * 2;
+    BitmapHeight   = EFI_GLYPH_HEIGHT;
+  } else if ((Attributes & NARROW_GLYPH) == NARROW_GLYPH) {
+    GlyphBufferLen = EFI_GLYPH_HEIGHT;
+    BitmapWidth    = EFI_GLYPH_WIDTH;
+    BitmapHeight   = EFI_GLYPH_HEIGHT;
+  } else if ((Attributes & PROPORTIONAL_GLYPH) == PROPORTIONAL_GLYPH) {
+    GlyphBufferLen = BITMAP_LEN_1_BIT (Cell->Width, Cell->Height);
+    BitmapWidth    = Cell->Width;
+    BitmapHeight   = Cell->Height;
+  } else {
+    return NULL;
+  }
+
+  CacheEntry = AllocatePool (
+                 sizeof (HII_GLYPH_CACHE_ENTRY) +
+                 BitmapWidth * BitmapHeight * sizeof (EFI_GRAPHICS_OUTPUT_BLT_PIXEL) +
+                 GlyphBufferLen
+                 );
+  if (CacheEntry == NULL) {
+    return NULL;
+  }
+
+  CacheEntry->Signature   = HII_GLYPH_CACHE_SIGNATURE;
+  CacheEntry->GlobalFont  = GlobalFont;
+  CacheEntry->CharValue   = CharValue;
+  CacheEntry->Foreground  = Foreground;
+  CacheEntry->Background  = Background;
+  CacheEntry->Attributes  = Attributes;
+  CopyMem (&CacheEntry->Cell, Cell, sizeof (EFI_HII_GLYPH_INFO));
+  CacheEntry->Bitmap      = NULL;
+  if (BitmapWidth != 0 && BitmapHeight != 0) {
+    CacheEntry->Bitmap    = (EFI_GRAPHICS_OUTPUT_BLT_PIXEL *) (CacheEntry + 1);
+  }
+  CacheEntry->GlyphBuffer = (UINT8 *) (CacheEntry + 1) + BitmapWidth * BitmapHeight * sizeof (EFI_GRAPHICS_OUTPUT_BLT_PIXEL);
+  CopyMem (CacheEntry->GlyphBuffer, GlyphBuffer, GlyphBufferLen);
+
+  for (Ypos = 0; Ypos < BitmapHeight; Ypos++) {
+    for (Xpos = 0; Xpos < BitmapWidth; Xpos++) {
+      if ((Attributes & PROPORTIONAL_GLYPH) == PROPORTIONAL_GLYPH) {
+        //
+        // The glyph's upper left hand corner pixel is the most significant bit
+        // of the first bitmap byte.
+        //
+        Data = GlyphBuffer[BITMAP_LEN_1_BIT (Cell->Width, Ypos) + Xpos / 8];
+      } else {
+        //
+        // A wide glyph is stored as two narrow glyphs.
+        //
+        Data = GlyphBuffer[(Xpos / EFI_GLYPH_WIDTH) * EFI_GLYPH_HEIGHT + Ypos];
+      }
+      if ((Data & (1 << (8 - (Xpos % 8) - 1))) != 0) {
+        CacheEntry->Bitmap[Ypos * BitmapWidth + Xpos] = Foreground;
+      } else {
+        CacheEntry->Bitmap[Ypos * BitmapWidth + Xpos] = Background;
+      }
+    }
+  }
+
+  InsertHeadList (
+    &Private->GlyphCache[GetGlyphCacheBucket (GlobalFont, CharValue, Foreground, Background)],
+    &CacheEntry->Entry
+    );
+  Private->GlyphCacheCount++;
+
+  return CacheEntry;
+}
+
+
+/**
+  Copy the pixels of a cached glyph to blt structure. This draws what
+  GlyphToImage() draws for the glyph when the background is not transparent.
+
+  This is a internal function.
+
+  @param  CacheEntry              The cached glyph, which has pixels.
+  @param  ImageWidth              Width of the whole image in pixels.
+  @param  BaseLine                BaseLine in the line.
+  @param  RowWidth                The width of the text on the line, in pixels.
+  @param  RowHeight               The height of the line, in pixels.
+  @param  Origin                  On input, points to the origin of the to be
+                                  displayed character, on output, points to the
+                                  next glyph's origin.
+
+**/
+VOID
+CachedGlyphToImage (
+  IN     HII_GLYPH_CACHE_ENTRY         *CacheEntry,
+  IN     UINT16                        ImageWidth,
+  IN     UINT16                        BaseLine,
+  IN     UINTN                         RowWidth,
+  IN     UINTN                         RowHeight,
+  IN OUT EFI_GRAPHICS_OUTPUT_BLT_PIXEL **Origin
+  )
+{
+  EFI_HII_GLYPH_INFO                   *Cell;
+  EFI_GRAPHICS_OUTPUT_BLT_PIXEL        *Buffer;
+  UINT16                               YposOffset;
+  UINTN                                Width;
+  UINTN                                Ypos;
+  UINTN                                Half;
+
+  ASSERT (CacheEntry != NULL && CacheEntry->Bitmap != NULL && Origin != NULL && *Origin != NULL);
+
+  Cell = &CacheEntry->Cell;
+
+  if ((CacheEntry->Attributes & (EFI_GLYPH_WIDE | NARROW_GLYPH)) != 0) {
+    //
+    // Each 8 pixels wide half is clipped on its own, as NarrowGlyphToBlt() does.
+    //
+    Buffer = *Origin - EFI_GLYPH_HEIGHT * ImageWidth;
+    Width  = MIN (EFI_GLYPH_WIDTH, RowWidth);
+    for (Half = 0; Half < Cell->Width / EFI_GLYPH_WIDTH; Half++) {
+      for (Ypos = 0; Ypos < EFI_GLYPH_HEIGHT && Ypos < RowHeight; Ypos++) {
+        CopyMem (
+          Buffer + Ypos * ImageWidth + Half * EFI_GLYPH_WIDTH,
+          CacheEntry->Bitmap + Ypos * Cell->Width + Half * EFI_GLYPH_WIDTH,
+          Width * sizeof (EFI_GRAPHICS_OUTPUT_BLT_PIXEL)
+          );
+      }
+    }
+    *Origin = *Origin + Cell->Width;
+    return;
+  }
+
+  Buffer     = *Origin + Cell->OffsetX - (Cell->OffsetY + Cell->Height) * ImageWidth;
+  YposOffset = (UINT16) (BaseLine - (Cell->OffsetY + Cell->Height));
+  for (Width = 0; Width < Cell->Width && (((UINT32) Width + Cell->OffsetX) < RowWidth); Width++);
+  for (Ypos = 0; Ypos < Cell->Height && (((UINT32) Ypos + YposOffset) < RowHeight); Ypos++) {
+    CopyMem (
+      Buffer + Ypos * ImageWidth,
+      CacheEntry->Bitmap + Ypos * Cell->Width,
+      Width * sizeof (EFI_GRAPHICS_OUTPUT_BLT_PIXEL)
+      );
+  }
+
+  *Origin = *Origin + Cell->AdvanceX;
+}
+
+
 /**
   Write the output parameters of FindGlyphBlock().
 
@@ -1620,6 +1917,8 @@ HiiStringToImage (
   EFI_GRAPHICS_OUTPUT_BLT_PIXEL       *RowBufferPtr;
   HII_GLOBAL_FONT_INFO                *GlobalFont;
   UINT32                              PreInitBkgnd;
+  HII_GLYPH_CACHE_ENTRY               **CachedGlyph;
+  BOOLEAN                             GlyphReplaced;
 
   //
   // Check incoming parameters.
@@ -1685,6 +1984,8 @@ HiiStringToImage (
   ASSERT (Cell != NULL);
   Attributes = (UINT8 *) AllocateZeroPool (StrLength * sizeof (UINT8));
   ASSERT (Attributes != NULL);
+  CachedGlyph = (HII_GLYPH_CACHE_ENTRY **) AllocateZeroPool (StrLength * sizeof (HII_GLYPH_CACHE_ENTRY *));
+  ASSERT (CachedGlyph != NULL);
 
   RowInfo       = NULL;
   Status        = EFI_SUCCESS;
@@ -1699,6 +2000,7 @@ HiiStringToImage (
   //
   StringInfoOut = NULL;
   FontHandle    = NULL;
+  GlobalFont    = NULL;
   Private       = HII_FONT_DATABASE_PRIVATE_DATA_FROM_THIS (This);
   SysFontFlag   = IsSystemFontInfo (Private, (EFI_FONT_DISPLAY_INFO *) StringInfo, &SystemDefault, NULL);
 
@@ -1779,6 +2081,14 @@ HiiStringToImage (
   // If EFI_HII_IGNORE_IF_NO_GLYPH is set, then characters which have no glyphs
   // are not drawn. Otherwise they are replaced with Unicode character 0xFFFD.
   //
+  // Glyphs are taken from the rendered glyph cache when they were drawn in the
+  // same font and colors before, which saves searching the font packages and
+  // converting the bitmap data to pixels again. The cache is emptied once it is
+  // full, before any of its glyphs are in use.
+  //
+  if (Private->GlyphCacheCount >= HII_GLYPH_CACHE_MAX_ENTRIES) {
+    FlushGlyphCache (Private);
+  }
   StringIn2  = AllocateZeroPool (StrSize (StringPtr));
   if (StringIn2 == NULL) {
     Status = EFI_OUT_OF_RESOURCES;
@@ -1794,8 +2104,20 @@ HiiStringToImage (
       continue;
     }
 
+    CachedGlyph[Index] = FindCachedGlyph (Private, GlobalFont, *StringPtr, Foreground, Background);
+    if (CachedGlyph[Index] != NULL) {
+      GlyphBuf[Index]   = CachedGlyph[Index]->GlyphBuffer;
+      Attributes[Index] = CachedGlyph[Index]->Attributes;
+      CopyMem (&Cell[Index], &CachedGlyph[Index]->Cell, sizeof (EFI_HII_GLYPH_INFO));
+      *StringTmp++ = *StringPtr++;
+      Index++;
+      continue;
+    }
+
+    GlyphReplaced = FALSE;
     Status = GetGlyphBuffer (Private, *StringPtr, FontInfo, &GlyphBuf[Index], &Cell[Index], &Attributes[Index]);
     if (Status == EFI_NOT_FOUND) {
+      GlyphReplaced = TRUE;
       if ((Flags & EFI_HII_IGNORE_IF_NO_GLYPH) == EFI_HII_IGNORE_IF_NO_GLYPH) {
         GlyphBuf[Index] = NULL;
         ZeroMem (&Cell[Index], sizeof (Cell[Index]));
@@ -1822,6 +2144,26 @@ HiiStringToImage (
       goto Exit;
     }
 
+    //
+    // Only cache the glyph of the character itself, the replacement depends on Flags.
+    //
+    if (!GlyphReplaced && GlyphBuf[Index] != NULL) {
+      CachedGlyph[Index] = CacheGlyph (
+                             Private,
+                             GlobalFont,
+                             *StringPtr,
+                             Foreground,
+                             Background,
+                             GlyphBuf[Index],
+                             &Cell[Index],
+                             Attributes[Index]
+                             );
+      if (CachedGlyph[Index] != NULL) {
+        FreePool (GlyphBuf[Index]);
+        GlyphBuf[Index] = CachedGlyph[Index]->GlyphBuffer;
+      }
+    }
+
     *StringTmp++ = *StringPtr++;
     Index++;
   }
@@ -2070,19 +2412,30 @@ HiiStringToImage (
           //
           // Only BLT these character which have corresponding glyph in font database.
           //
-          GlyphToImage (
-            GlyphBuf[Index1],
-            Foreground,
-            Background,
-            (UINT16) RowInfo[RowIndex].LineWidth,
-            BaseLine,
-            RowInfo[RowIndex].LineWidth - LineOffset,
-            RowInfo[RowIndex].LineHeight,
-            Transparent,
-            &Cell[Index1],
-            Attributes[Index1],
-            &BufferPtr
-          );
+          if (!Transparent && CachedGlyph[Index1] != NULL && CachedGlyph[Index1]->Bitmap != NULL) {
+            CachedGlyphToImage (
+              CachedGlyph[Index1],
+              (UINT16) RowInfo[RowIndex].LineWidth,
+              BaseLine,
+              RowInfo[RowIndex].LineWidth - LineOffset,
+              RowInfo[RowIndex].LineHeight,
+              &BufferPtr
+              );
+          } else {
+            GlyphToImage (
+              GlyphBuf[Index1],
+              Foreground,
+              Background,
+              (UINT16) RowInfo[RowIndex].LineWidth,
+              BaseLine,
+              RowInfo[RowIndex].LineWidth - LineOffset,
+              RowInfo[RowIndex].LineHeight,
+              Transparent,
+              &Cell[Index1],
+              Attributes[Index1],
+              &BufferPtr
+            );
+          }
         }
         if (ColumnInfoArray != NULL) {
           if ((GlyphBuf[Index1] == NULL && Cell[Index1].AdvanceX == 0)
@@ -2130,19 +2483,30 @@ HiiStringToImage (
           //
           // Only BLT these character which have corresponding glyph in font database.
           //
-          GlyphToImage (
-            GlyphBuf[Index1],
-            Foreground,
-            Background,
-            Image->Width,
-            BaseLine,
-            RowInfo[RowIndex].LineWidth - LineOffset,
-            RowInfo[RowIndex].LineHeight,
-            Transparent,
-            &Cell[Index1],
-            Attributes[Index1],
-            &BufferPtr
-          );
+          if (!Transparent && CachedGlyph[Index1] != NULL && CachedGlyph[Index1]->Bitmap != NULL) {
+            CachedGlyphToImage (
+              CachedGlyph[Index1],
+              Image->Width,
+              BaseLine,
+              RowInfo[RowIndex].LineWidth - LineOffset,
+              RowInfo[RowIndex].LineHeight,
+              &BufferPtr
+              );
+          } else {
+            GlyphToImage (
+              GlyphBuf[Index1],
+              Foreground,
+              Background,
+              Image->Width,
+              BaseLine,
+              RowInfo[RowIndex].LineWidth - LineOffset,
+              RowInfo[RowIndex].LineHeight,
+              Transparent,
+              &Cell[Index1],
+              Attributes[Index1],
+              &BufferPtr
+            );
+          }
         }
         if (ColumnInfoArray != NULL) {
           if ((GlyphBuf[Index1] == NULL && Cell[Index1].AdvanceX == 0)
@@ -2208,7 +2572,7 @@ NextLine:
 Exit:
 
   for (Index = 0; Index < StrLength; Index++) {
-    if (GlyphBuf[Index] != NULL) {
+    if (GlyphBuf[Index] != NULL && CachedGlyph[Index] == NULL) {
       FreePool (GlyphBuf[Index]);
     }
   }
@@ -2236,6 +2600,9 @@ Exit:
   if (Attributes != NULL) {
     FreePool (Attributes);
   }
+  if (CachedGlyph != NULL) {
+    FreePool (CachedGlyph);
+  }
 
   return Status;
 }
@@ -1,7 +1,7 @@
 /** @file
 Private structures definitions in HiiDatabase.
 
-Copyright (c) 2007 - 2018, Intel Corporation. All rights reserved.<BR>
+Copyright (c) 2007 - 2020, Intel Corporation. All rights reserved.<BR>
 SPDX-License-Identifier: BSD-2-Clause-Patent
 
 **/
@@ -88,6 +88,7 @@ typedef struct {
   UINT8               Scope;
   LIST_ENTRY          DefaultValueEntry; // Link to its default value array
   CHAR16              *Name;
+  EFI_STRING_ID       NameId;            // String ID of Name for name/value varstores
   BOOLEAN             IsBitVar;
 } IFR_BLOCK_DATA;
 
@@ -152,6 +153,35 @@ typedef struct {
 // String Package definitions
 //
 #define HII_STRING_PACKAGE_SIGNATURE    SIGNATURE_32 ('h','i','s','p')
+
+//
+// The string block a string ID lives in, and the first string ID of that block.
+//
+typedef struct {
+  UINT32                                BlockOffset;
+  EFI_STRING_ID                         StartStringId;
+} HII_STRING_BLOCK_INDEX_ENTRY;
+
+//
+// The strings of a keyword string package in string ID order, with the strings
+// of each bucket chained in string ID order as well.
+//
+#define HII_KEYWORD_INDEX_BUCKETS       64
+
+typedef struct {
+  UINT32                                TextOffset;    // offset of the string text in the string blocks
+  EFI_STRING_ID                         StringId;
+  BOOLEAN                               Ascii;         // SCSU text rather than UCS2 text
+  BOOLEAN                               Enumerated;    // returned by GetNextStringId()
+  UINT32                                Next;          // next entry of the bucket + 1, 0 for none
+} HII_KEYWORD_INDEX_ENTRY;
+
+typedef struct {
+  UINT32                                Count;
+  UINT32                                Bucket[HII_KEYWORD_INDEX_BUCKETS];  // first entry + 1, 0 for none
+  HII_KEYWORD_INDEX_ENTRY               Entry[1];
+} HII_KEYWORD_INDEX;
+
 typedef struct _HII_STRING_PACKAGE_INSTANCE {
   UINTN                                 Signature;
   EFI_HII_STRING_PACKAGE_HDR            *StringPkgHdr;
@@ -160,19 +190,55 @@ typedef struct _HII_STRING_PACKAGE_INSTANCE {
   LIST_ENTRY                            FontInfoList;  // local font info list
   UINT8                                 FontId;
   EFI_STRING_ID                         MaxStringId;   // record StringId
+  HII_STRING_BLOCK_INDEX_ENTRY          *StringBlockIndex;  // indexed by StringId, built lazily
+  EFI_STRING_ID                         IndexedStringId;    // first StringId not indexed yet
+  UINT32                                IndexedBlockSize;   // offset of the block of IndexedStringId
+  HII_KEYWORD_INDEX                     *KeywordIndex;      // built lazily by the keyword handler
 } HII_STRING_PACKAGE_INSTANCE;
 
 //
 // Form Package definitions
 //
 #define HII_IFR_PACKAGE_SIGNATURE       SIGNATURE_32 ('h','f','r','p')
+
+//
+// The first statement of a form package using a prompt string ID.
+//
+typedef struct {
+  EFI_STRING_ID                         Prompt;
+  UINT32                                Offset;        // offset of the statement in the IFR data
+} HII_QUESTION_INDEX_ENTRY;
+
 typedef struct _HII_IFR_PACKAGE_INSTANCE {
   UINTN                                 Signature;
   EFI_HII_PACKAGE_HEADER                FormPkgHdr;
   UINT8                                 *IfrData;
   LIST_ENTRY                            IfrEntry;
+  HII_QUESTION_INDEX_ENTRY              *QuestionIndex;  // sorted by Prompt, built lazily
+  UINTN                                 QuestionCount;
 } HII_IFR_PACKAGE_INSTANCE;
 
+//
+// Varstore index definitions
+//
+#define HII_VARSTORE_INDEX_SIGNATURE    SIGNATURE_32 ('h','v','s','i')
+typedef struct _HII_VARSTORE_INDEX_ENTRY {
+  UINTN                                 Signature;
+  LIST_ENTRY                            Entry;
+  EFI_IFR_OP_HEADER                     *VarStore;     // copy of the varstore opcode
+  EFI_VARSTORE_ID                       VarStoreId;
+  HII_IFR_PACKAGE_INSTANCE              *FormPackage;  // form package declaring the varstore
+  EFI_STRING                            ConfigHdr;     // GUID=...&NAME=... of the varstore
+  BOOLEAN                               BeforeForm;    // declared before the first form
+  //
+  // The questions and the default stores that ParseIfrData() returns for a
+  // request with this ConfigHdr and no request element. Only the first entry
+  // of a ConfigHdr has them, NULL if the IFR could not be parsed.
+  //
+  IFR_VARSTORAGE_DATA                   *Questions;
+  IFR_DEFAULT_DATA                      *DefaultIds;
+} HII_VARSTORE_INDEX_ENTRY;
+
 //
 // Simple Font Package definitions
 //
@@ -222,6 +288,26 @@ typedef struct _HII_GLOBAL_FONT_INFO {
   EFI_FONT_INFO                         *FontInfo;
 } HII_GLOBAL_FONT_INFO;
 
+//
+// Rendered glyph cache definitions
+//
+#define HII_GLYPH_CACHE_SIGNATURE       SIGNATURE_32 ('h','g','c','e')
+#define HII_GLYPH_CACHE_BUCKETS         64
+#define HII_GLYPH_CACHE_MAX_ENTRIES     512
+
+typedef struct _HII_GLYPH_CACHE_ENTRY {
+  UINTN                                 Signature;
+  LIST_ENTRY                            Entry;
+  HII_GLOBAL_FONT_INFO                  *GlobalFont;   // NULL for the system font
+  CHAR16                                CharValue;
+  EFI_GRAPHICS_OUTPUT_BLT_PIXEL         Foreground;
+  EFI_GRAPHICS_OUTPUT_BLT_PIXEL         Background;
+  EFI_HII_GLYPH_INFO                    Cell;
+  UINT8                                 Attributes;
+  UINT8                                 *GlyphBuffer;  // bitmap data of the glyph
+  EFI_GRAPHICS_OUTPUT_BLT_PIXEL         *Bitmap;       // glyph drawn in Foreground and Background, row by row
+} HII_GLYPH_CACHE_ENTRY;
+
 //
 // Image Package definitions
 //
@@ -270,6 +356,8 @@ typedef struct _HII_DATABASE_PACKAGE_LIST_INSTANCE {
   HII_IMAGE_PACKAGE_INSTANCE            *ImagePkg;
   LIST_ENTRY                            SimpleFontPkgHdr;
   UINT8                                 *DevicePathPkg;
+  LIST_ENTRY                            VarStoreIndex;       // varstores of the form packages
+  BOOLEAN                               VarStoreIndexValid;
 } HII_DATABASE_PACKAGE_LIST_INSTANCE;
 
 #define HII_HANDLE_SIGNATURE            SIGNATURE_32 ('h','i','h','l')
@@ -321,6 +409,8 @@ typedef struct _HII_DATABASE_PRIVATE_DATA {
   UINTN                                 Attribute;     // default system color
   EFI_GUID                              CurrentLayoutGuid;
   EFI_HII_KEYBOARD_LAYOUT               *CurrentLayout;
+  LIST_ENTRY                            GlyphCache[HII_GLYPH_CACHE_BUCKETS];  // rendered glyphs
+  UINTN                                 GlyphCacheCount;
 } HII_DATABASE_PRIVATE_DATA;
 
 #define HII_FONT_DATABASE_PRIVATE_DATA_FROM_THIS(a) \
@@ -453,6 +543,18 @@ IsFontInfoExisted (
   OUT HII_GLOBAL_FONT_INFO      **GlobalFontInfo OPTIONAL
   );
 
+/**
+  Free all the glyphs of the rendered glyph cache. It must be called whenever
+  a font or simple font package is added or removed.
+
+  @param  Private                 Hii database private structure.
+
+**/
+VOID
+FlushGlyphCache (
+  IN HII_DATABASE_PRIVATE_DATA       *Private
+  );
+
 /**
 
    This function invokes the matching registered function.
@@ -501,8 +603,23 @@ GetSystemFont (
   );
 
 
+/**
+  Discard the string ID index and the keyword index of a string package. It
+  must be called whenever the string blocks of the package are changed or freed.
+
+  @param  StringPackage           Hii string package instance.
+
+**/
+VOID
+InvalidateStringBlockIndex (
+  IN HII_STRING_PACKAGE_INSTANCE      *StringPackage
+  );
+
+
 /**
   Parse all string blocks to find a String block specified by StringId.
+  Blocks already parsed for a StringId are indexed so that later lookups
+  start at the block holding the string ID.
   If StringId = (EFI_STRING_ID) (-1), find out all EFI_HII_SIBT_FONT blocks
   within this string package and backup its information. If LastStringId is
   specified, the string id of last string block will also be output.
@@ -1851,6 +1968,50 @@ HiiGetPackageListHandle (
 //
 
 
+/**
+  Free the varstore index of a package list. It must be called whenever a form
+  package is added to or removed from the package list.
+
+  @param  PackageList            The package list.
+
+**/
+VOID
+InvalidateVarStoreIndex (
+  IN HII_DATABASE_PACKAGE_LIST_INSTANCE  *PackageList
+  );
+
+/**
+  Build the varstore index of a package list, with the questions and default
+  values of each varstore, if it is not built yet.
+
+  @param  DataBaseRecord        The DataBaseRecord instance contains the found Hii handle and package.
+
+  @retval EFI_SUCCESS           The varstore index is built.
+  @retval EFI_OUT_OF_RESOURCES  No enough memory.
+
+**/
+EFI_STATUS
+BuildVarStoreIndex (
+  IN HII_DATABASE_RECORD                 *DataBaseRecord
+  );
+
+/**
+  Get the varstore index of a package list, which lists the varstores of its
+  form packages in IFR order.
+
+  @param  DataBaseRecord        The DataBaseRecord instance contains the found Hii handle and package.
+  @param  VarStoreIndex         Return the list of HII_VARSTORE_INDEX_ENTRY.
+
+  @retval EFI_SUCCESS           The varstore index is returned.
+  @retval EFI_OUT_OF_RESOURCES  No enough memory.
+
+**/
+EFI_STATUS
+GetVarStoreIndex (
+  IN     HII_DATABASE_RECORD        *DataBaseRecord,
+  OUT    LIST_ENTRY                 **VarStoreIndex
+  );
+
 /**
   This function allows a caller to extract the current configuration
   for one or more named elements from one or more drivers.
@@ -2,7 +2,7 @@
 This file contains the entry code to the HII database, which is defined by
 UEFI 2.1 specification.
 
-Copyright (c) 2007 - 2018, Intel Corporation. All rights reserved.<BR>
+Copyright (c) 2007 - 2020, Intel Corporation. All rights reserved.<BR>
 SPDX-License-Identifier: BSD-2-Clause-Patent
 
 **/
@@ -171,6 +171,7 @@ InitializeHiiDatabase (
   EFI_STATUS                             Status;
   EFI_HANDLE                             Handle;
   EFI_EVENT                              ReadyToBootEvent;
+  UINTN                                  Index;
 
   //
   // There will be only one HII Database in the system
@@ -188,6 +189,9 @@ InitializeHiiDatabase (
   InitializeListHead (&mPrivate.DatabaseNotifyList);
   InitializeListHead (&mPrivate.HiiHandleList);
   InitializeListHead (&mPrivate.FontInfoList);
+  for (Index = 0; Index < HII_GLYPH_CACHE_BUCKETS; Index++) {
+    InitializeListHead (&mPrivate.GlyphCache[Index]);
+  }
 
   //
   // Create a event with EFI_HII_SET_KEYBOARD_LAYOUT_EVENT_GUID group type.
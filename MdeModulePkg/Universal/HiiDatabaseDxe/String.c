@@ -2,7 +2,7 @@
 Implementation for EFI_HII_STRING_PROTOCOL.
 
 
-Copyright (c) 2007 - 2018, Intel Corporation. All rights reserved.<BR>
+Copyright (c) 2007 - 2020, Intel Corporation. All rights reserved.<BR>
 (C) Copyright 2016 Hewlett Packard Enterprise Development LP<BR>
 SPDX-License-Identifier: BSD-2-Clause-Patent
 
@@ -227,8 +227,77 @@ GetStringFontInfo (
 }
 
 
+/**
+  Discard the string ID index and the keyword index of a string package. It
+  must be called whenever the string blocks of the package are changed or freed.
+
+  @param  StringPackage           Hii string package instance.
+
+**/
+VOID
+InvalidateStringBlockIndex (
+  IN HII_STRING_PACKAGE_INSTANCE      *StringPackage
+  )
+{
+  if (StringPackage->StringBlockIndex != NULL) {
+    FreePool (StringPackage->StringBlockIndex);
+    StringPackage->StringBlockIndex = NULL;
+  }
+  if (StringPackage->KeywordIndex != NULL) {
+    FreePool (StringPackage->KeywordIndex);
+    StringPackage->KeywordIndex = NULL;
+  }
+  StringPackage->IndexedStringId  = 1;
+  StringPackage->IndexedBlockSize = 0;
+}
+
+/**
+  Find the string block to start parsing from to reach a string ID. This is
+  the block holding the string ID if it is indexed already, otherwise the
+  first block which is not indexed yet.
+
+  The index is allocated on the first lookup, so string packages which are
+  only parsed once never pay for it.
+
+  @param  StringPackage           Hii string package instance.
+  @param  StringId                The string's id, which is unique within
+                                  PackageList.
+  @param  BlockSize               Output the offset of the block to start from.
+  @param  CurrentStringId         Output the first string id of that block.
+
+**/
+VOID
+SeekStringBlock (
+  IN  HII_STRING_PACKAGE_INSTANCE     *StringPackage,
+  IN  EFI_STRING_ID                   StringId,
+  OUT UINTN                           *BlockSize,
+  OUT EFI_STRING_ID                   *CurrentStringId
+  )
+{
+  if (StringPackage->StringBlockIndex == NULL) {
+    StringPackage->StringBlockIndex = AllocatePool (
+                                        ((UINTN) StringPackage->MaxStringId + 1) * sizeof (HII_STRING_BLOCK_INDEX_ENTRY)
+                                        );
+    StringPackage->IndexedStringId  = 1;
+    StringPackage->IndexedBlockSize = 0;
+  }
+
+  if (StringPackage->StringBlockIndex != NULL && StringId < StringPackage->IndexedStringId) {
+    *BlockSize       = StringPackage->StringBlockIndex[StringId].BlockOffset;
+    *CurrentStringId = StringPackage->StringBlockIndex[StringId].StartStringId;
+  } else if (StringPackage->StringBlockIndex != NULL) {
+    *BlockSize       = StringPackage->IndexedBlockSize;
+    *CurrentStringId = StringPackage->IndexedStringId;
+  } else {
+    *BlockSize       = 0;
+    *CurrentStringId = 1;
+  }
+}
+
 /**
   Parse all string blocks to find a String block specified by StringId.
+  Blocks already parsed for a StringId are indexed so that later lookups
+  start at the block holding the string ID.
   If StringId = (EFI_STRING_ID) (-1), find out all EFI_HII_SIBT_FONT blocks
   within this string package and backup its information. If LastStringId is
   specified, the string id of last string block will also be output.
@@ -285,6 +354,9 @@ FindStringBlock (
   UINT32                               Length32;
   UINTN                                StringSize;
   CHAR16                               Zero;
+  UINTN                                BlockStart;
+  EFI_STRING_ID                        BlockStartStringId;
+  EFI_STRING_ID                        IndexedStringId;
 
   ASSERT (StringPackage != NULL);
   ASSERT (StringPackage->Signature == HII_STRING_PACKAGE_SIGNATURE);
@@ -308,12 +380,21 @@ FindStringBlock (
   ZeroMem (&Zero, sizeof (CHAR16));
 
   //
-  // Parse the string blocks to get the string text and font.
+  // Parse the string blocks to get the string text and font. A single string
+  // is looked up from the block the index says holds it.
   //
-  BlockHdr  = StringPackage->StringBlock;
   BlockSize = 0;
   Offset    = 0;
+  if (StringId != (EFI_STRING_ID) (-1) && StringId != 0) {
+    SeekStringBlock (StringPackage, StringId, &BlockSize, &CurrentStringId);
+    if (BlockSize != 0 && StartStringId != NULL) {
+      *StartStringId = CurrentStringId;
+    }
+  }
+  BlockHdr  = StringPackage->StringBlock + BlockSize;
   while (*BlockHdr != EFI_HII_SIBT_END) {
+    BlockStart         = BlockSize;
+    BlockStartStringId = CurrentStringId;
     switch (*BlockHdr) {
     case EFI_HII_SIBT_STRING_SCSU:
       Offset = sizeof (EFI_HII_STRING_BLOCK);
@@ -452,8 +533,7 @@ FindStringBlock (
           sizeof (EFI_STRING_ID)
           );
         ASSERT (StringId != CurrentStringId);
-        CurrentStringId = 1;
-        BlockSize       = 0;
+        SeekStringBlock (StringPackage, StringId, &BlockSize, &CurrentStringId);
       } else {
         BlockSize       += sizeof (EFI_HII_SIBT_DUPLICATE_BLOCK);
         CurrentStringId++;
@@ -542,6 +622,23 @@ FindStringBlock (
       break;
     }
 
+    //
+    // Extend the index by this block if it is the first block not indexed yet.
+    //
+    if (StringPackage->StringBlockIndex != NULL &&
+        BlockStart == StringPackage->IndexedBlockSize &&
+        BlockStartStringId == StringPackage->IndexedStringId &&
+        BlockSize > BlockStart) {
+      for (IndexedStringId = BlockStartStringId;
+           IndexedStringId < CurrentStringId && IndexedStringId <= StringPackage->MaxStringId;
+           IndexedStringId++) {
+        StringPackage->StringBlockIndex[IndexedStringId].BlockOffset   = (UINT32) BlockStart;
+        StringPackage->StringBlockIndex[IndexedStringId].StartStringId = BlockStartStringId;
+      }
+      StringPackage->IndexedStringId  = IndexedStringId;
+      StringPackage->IndexedBlockSize = (UINT32) BlockSize;
+    }
+
     if (StringId > 0 && StringId != (EFI_STRING_ID)(-1)) {
       ASSERT (BlockType != NULL && StringBlockAddr != NULL && StringTextOffset != NULL);
       *BlockType        = *BlockHdr;
@@ -841,6 +938,7 @@ InsertLackStringBlock (
   }
   FreePool (StringPackage->StringBlock);
   StringPackage->StringBlock = StringBlock;
+  InvalidateStringBlockIndex (StringPackage);
   StringPackage->StringPkgHdr->Header.Length += NewBlockSize - OldBlockSize;
 
   return EFI_SUCCESS;
@@ -1008,6 +1106,7 @@ SetStringWorker (
 
     FreePool (StringPackage->StringBlock);
     StringPackage->StringBlock = Block;
+    InvalidateStringBlockIndex (StringPackage);
     StringPackage->StringPkgHdr->Header.Length += (UINT32) (BlockSize - OldBlockSize);
     break;
 
@@ -1041,6 +1140,7 @@ SetStringWorker (
 
     FreePool (StringPackage->StringBlock);
     StringPackage->StringBlock = Block;
+    InvalidateStringBlockIndex (StringPackage);
     StringPackage->StringPkgHdr->Header.Length += (UINT32) (BlockSize - OldBlockSize);
     break;
 
@@ -1092,6 +1192,7 @@ SetStringWorker (
 
   FreePool (StringPackage->StringBlock);
   StringPackage->StringBlock = Block;
+  InvalidateStringBlockIndex (StringPackage);
   StringPackage->StringPkgHdr->Header.Length += Ext2.Length;
 
   return EFI_SUCCESS;
@@ -1277,6 +1378,7 @@ HiiNewString (
       *BlockPtr = EFI_HII_SIBT_END;
       FreePool (StringPackage->StringBlock);
       StringPackage->StringBlock = StringBlock;
+      InvalidateStringBlockIndex (StringPackage);
       StringPackage->StringPkgHdr->Header.Length += Ucs2BlockSize;
       PackageListNode->PackageListHdr.PackageLength += Ucs2BlockSize;
     }
@@ -1408,6 +1510,7 @@ HiiNewString (
     *BlockPtr = EFI_HII_SIBT_END;
     FreePool (StringPackage->StringBlock);
     StringPackage->StringBlock = StringBlock;
+    InvalidateStringBlockIndex (StringPackage);
     StringPackage->StringPkgHdr->Header.Length += Ucs2BlockSize;
     PackageListNode->PackageListHdr.PackageLength += Ucs2BlockSize;
 
@@ -1450,6 +1553,7 @@ HiiNewString (
       *BlockPtr = EFI_HII_SIBT_END;
       FreePool (StringPackage->StringBlock);
       StringPackage->StringBlock = StringBlock;
+      InvalidateStringBlockIndex (StringPackage);
       StringPackage->StringPkgHdr->Header.Length += Ucs2FontBlockSize;
       PackageListNode->PackageListHdr.PackageLength += Ucs2FontBlockSize;
 
@@ -1511,6 +1615,7 @@ HiiNewString (
       *BlockPtr = EFI_HII_SIBT_END;
       FreePool (StringPackage->StringBlock);
       StringPackage->StringBlock = StringBlock;
+      InvalidateStringBlockIndex (StringPackage);
       StringPackage->StringPkgHdr->Header.Length += FontBlockSize + Ucs2FontBlockSize;
       PackageListNode->PackageListHdr.PackageLength += FontBlockSize + Ucs2FontBlockSize;
 
@@ -1552,6 +1657,7 @@ Done:
     // Free the allocated new string Package when new string can't be added.
     //
     RemoveEntryList (&StringPackage->StringEntry);
+    InvalidateStringBlockIndex (StringPackage);
     FreePool (StringPackage->StringBlock);
     FreePool (StringPackage->StringPkgHdr);
     FreePool (StringPackage);
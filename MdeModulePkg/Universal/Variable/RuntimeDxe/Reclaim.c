@@ -92,6 +92,13 @@ GetLbaAndOffsetByAddress (
   volume block device. The destination is specified by parameter
   VariableBase. Fault Tolerant Write protocol is used for writing.
 
+  Only the range from the first to the last byte that differs from the
+  current variable store is written, in a single FTW write record, so the
+  flash blocks outside of this range are neither erased nor programmed and
+  the write stays fault tolerant. After a reclaim, the leading variables
+  that were not deleted or updated are identical, and so is the erased
+  space at the end of the store.
+
   @param  VariableBase   Base address of variable to write
   @param  VariableBuffer Point to the variable data buffer.
 
@@ -112,6 +119,10 @@ FtwVariableSpace (
   UINTN                              VarOffset;
   UINTN                              FtwBufferSize;
   EFI_FAULT_TOLERANT_WRITE_PROTOCOL  *FtwProtocol;
+  UINT8                              *CurrentStore;
+  UINT8                              *NewStore;
+  UINTN                              FirstDifference;
+  UINTN                              EndDifference;
 
   //
   // Locate fault tolerant write protocol.
@@ -127,28 +138,54 @@ FtwVariableSpace (
   if (EFI_ERROR (Status)) {
     return Status;
   }
+
+  FtwBufferSize = ((VARIABLE_STORE_HEADER *) ((UINTN) VariableBase))->Size;
+  ASSERT (FtwBufferSize == VariableBuffer->Size);
+
+  //
+  // Find the range that differs from the current variable store.
+  //
+  CurrentStore    = (UINT8 *) (UINTN) VariableBase;
+  NewStore        = (UINT8 *) VariableBuffer;
+  FirstDifference = 0;
+  while ((FirstDifference < FtwBufferSize) && (CurrentStore[FirstDifference] == NewStore[FirstDifference])) {
+    FirstDifference++;
+  }
+  if (FirstDifference == FtwBufferSize) {
+    return EFI_SUCCESS;
+  }
+  EndDifference = FtwBufferSize;
+  while (CurrentStore[EndDifference - 1] == NewStore[EndDifference - 1]) {
+    EndDifference--;
+  }
+
   //
   // Get LBA and Offset by address.
   //
-  Status = GetLbaAndOffsetByAddress (VariableBase, &VarLba, &VarOffset);
+  Status = GetLbaAndOffsetByAddress (VariableBase + FirstDifference, &VarLba, &VarOffset);
   if (EFI_ERROR (Status)) {
     return EFI_ABORTED;
   }
 
-  FtwBufferSize = ((VARIABLE_STORE_HEADER *) ((UINTN) VariableBase))->Size;
-  ASSERT (FtwBufferSize == VariableBuffer->Size);
+  DEBUG ((
+    DEBUG_VERBOSE,
+    "Variable: FTW write 0x%x of 0x%x bytes at offset 0x%x\n",
+    EndDifference - FirstDifference,
+    FtwBufferSize,
+    FirstDifference
+    ));
 
   //
   // FTW write record.
   //
   Status = FtwProtocol->Write (
                           FtwProtocol,
-                          VarLba,         // LBA
-                          VarOffset,      // Offset
-                          FtwBufferSize,  // NumBytes
-                          NULL,           // PrivateData NULL
-                          FvbHandle,      // Fvb Handle
-                          (VOID *) VariableBuffer // write buffer
+                          VarLba,                             // LBA
+                          VarOffset,                          // Offset
+                          EndDifference - FirstDifference,    // NumBytes
+                          NULL,                               // PrivateData NULL
+                          FvbHandle,                          // Fvb Handle
+                          (VOID *) (NewStore + FirstDifference) // write buffer
                           );
 
   return Status;
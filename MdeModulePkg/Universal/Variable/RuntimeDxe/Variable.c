@@ -265,6 +265,11 @@ UpdateVariableStore (
   FvVolHdr    = 0;
   DataPtr     = DataPtrIndex;
 
+  //
+  // Any variable written may change what GetNextVariableName() returns next.
+  //
+  mVariableModuleGlobal->StoreGeneration++;
+
   //
   // Check if the Data is Volatile.
   //
@@ -935,6 +940,333 @@ InitializeVariableQuota (
   CalculateCommonUserVariableTotalSize ();
 }
 
+/**
+  Get the variable store covered by the hash index of the given type.
+
+  @param[in]  Type                The variable store type.
+  @param[out] LastVariableOffset  Offset of the end of the last variable in the store.
+
+  @return The variable store header, or NULL if the store does not exist.
+
+**/
+VARIABLE_STORE_HEADER *
+GetVariableIndexStore (
+  IN  VARIABLE_STORE_TYPE     Type,
+  OUT UINTN                   *LastVariableOffset
+  )
+{
+  VARIABLE_STORE_HEADER       *VariableStoreHeader;
+
+  switch (Type) {
+    case VariableStoreTypeVolatile:
+      VariableStoreHeader = (VARIABLE_STORE_HEADER *) (UINTN) mVariableModuleGlobal->VariableGlobal.VolatileVariableBase;
+      *LastVariableOffset = mVariableModuleGlobal->VolatileLastVariableOffset;
+      break;
+
+    case VariableStoreTypeHob:
+      VariableStoreHeader = (VARIABLE_STORE_HEADER *) (UINTN) mVariableModuleGlobal->VariableGlobal.HobVariableBase;
+      *LastVariableOffset = (VariableStoreHeader == NULL) ? 0 : VariableStoreHeader->Size;
+      break;
+
+    default:
+      VariableStoreHeader = mNvVariableCache;
+      *LastVariableOffset = mVariableModuleGlobal->NonVolatileLastVariableOffset;
+      break;
+  }
+
+  return VariableStoreHeader;
+}
+
+/**
+  Hash a vendor GUID and variable name for the variable hash index.
+
+  @param[in] VendorGuid     Vendor GUID of the variable.
+  @param[in] VariableName   Name of the variable.
+  @param[in] NameSize       Size in bytes of the name, including the Null terminator.
+
+  @return The hash value.
+
+**/
+UINT32
+HashVariableName (
+  IN EFI_GUID                 *VendorGuid,
+  IN CHAR16                   *VariableName,
+  IN UINTN                    NameSize
+  )
+{
+  UINT32                      Hash;
+  UINT8                       *Bytes;
+  UINTN                       Index;
+
+  //
+  // FNV-1a over the GUID and the name.
+  //
+  Hash  = 0x811c9dc5;
+  Bytes = (UINT8 *) VendorGuid;
+  for (Index = 0; Index < sizeof (EFI_GUID); Index++) {
+    Hash = (Hash ^ Bytes[Index]) * 0x01000193;
+  }
+  Bytes = (UINT8 *) VariableName;
+  for (Index = 0; Index < NameSize; Index++) {
+    Hash = (Hash ^ Bytes[Index]) * 0x01000193;
+  }
+  return Hash;
+}
+
+/**
+  Drop all the entries of a variable hash index, so that the store is indexed
+  again from its start. It must be called whenever the store is rewritten
+  rather than appended to, as by Reclaim().
+
+  @param[in] Type   The variable store type.
+
+**/
+VOID
+ResetVariableIndex (
+  IN VARIABLE_STORE_TYPE      Type
+  )
+{
+  VARIABLE_STORE_INDEX        *Index;
+
+  Index = &mVariableModuleGlobal->VariableIndex[Type];
+  if (Index->Buckets == NULL) {
+    return;
+  }
+
+  SetMem (Index->Buckets, Index->BucketCount * sizeof (UINT32), 0xff);
+  Index->IndexedSize = 0;
+  Index->EntryCount  = 0;
+  Index->Valid       = TRUE;
+}
+
+/**
+  Allocate the hash indexes of the volatile, HOB and non-volatile variable stores.
+
+  The indexes are sized for the smallest possible variables, so they never need
+  to grow at runtime. An index that could not be allocated is left invalid and
+  lookups in its store walk the store.
+
+**/
+VOID
+InitializeVariableIndex (
+  VOID
+  )
+{
+  VARIABLE_STORE_TYPE         Type;
+  VARIABLE_STORE_INDEX        *Index;
+  VARIABLE_STORE_HEADER       *VariableStoreHeader;
+  UINTN                       LastVariableOffset;
+
+  if (!FeaturePcdGet (PcdEnableVariableHashIndex)) {
+    return;
+  }
+
+  for (Type = (VARIABLE_STORE_TYPE) 0; Type < VariableStoreTypeMax; Type++) {
+    VariableStoreHeader = GetVariableIndexStore (Type, &LastVariableOffset);
+    if (VariableStoreHeader == NULL) {
+      continue;
+    }
+
+    Index = &mVariableModuleGlobal->VariableIndex[Type];
+    Index->MaxEntries  = (UINT32) ((VariableStoreHeader->Size - sizeof (VARIABLE_STORE_HEADER)) /
+                                   (GetVariableHeaderSize () + 2 * sizeof (UINT32)));
+    Index->BucketCount = (UINT32) GetPowerOfTwo32 (MAX (Index->MaxEntries / 2, 16));
+    Index->Buckets     = AllocateRuntimePool (Index->BucketCount * sizeof (UINT32));
+    Index->Entries     = AllocateRuntimePool (Index->MaxEntries * sizeof (VARIABLE_INDEX_ENTRY));
+    if (Index->Buckets == NULL || Index->Entries == NULL) {
+      if (Index->Buckets != NULL) {
+        FreePool (Index->Buckets);
+      }
+      if (Index->Entries != NULL) {
+        FreePool (Index->Entries);
+      }
+      ZeroMem (Index, sizeof (*Index));
+      continue;
+    }
+
+    ResetVariableIndex (Type);
+  }
+}
+
+/**
+  Add the variables appended to a store since the last lookup to its hash index.
+
+  @param[in] Type                 The variable store type.
+  @param[in] VariableStoreHeader  The variable store header.
+  @param[in] LastVariableOffset   Offset of the end of the last variable in the store.
+
+**/
+VOID
+UpdateVariableIndex (
+  IN VARIABLE_STORE_TYPE      Type,
+  IN VARIABLE_STORE_HEADER    *VariableStoreHeader,
+  IN UINTN                    LastVariableOffset
+  )
+{
+  VARIABLE_STORE_INDEX        *Index;
+  VARIABLE_HEADER             *Variable;
+  VARIABLE_HEADER             *EndPtr;
+  UINT32                      Bucket;
+
+  Index = &mVariableModuleGlobal->VariableIndex[Type];
+  if (Index->IndexedSize > LastVariableOffset) {
+    //
+    // The store shrank behind our back, index it again.
+    //
+    ResetVariableIndex (Type);
+  }
+
+  if (Index->IndexedSize == 0) {
+    Variable = GetStartPointer (VariableStoreHeader);
+  } else {
+    Variable = (VARIABLE_HEADER *) ((UINTN) VariableStoreHeader + Index->IndexedSize);
+  }
+  EndPtr = (VARIABLE_HEADER *) ((UINTN) VariableStoreHeader + LastVariableOffset);
+  if (EndPtr > GetEndPointer (VariableStoreHeader)) {
+    EndPtr = GetEndPointer (VariableStoreHeader);
+  }
+
+  while (IsValidVariableHeader (Variable, EndPtr)) {
+    if (Index->EntryCount == Index->MaxEntries) {
+      Index->Valid = FALSE;
+      return;
+    }
+
+    Bucket = HashVariableName (
+               GetVendorGuidPtr (Variable),
+               GetVariableNamePtr (Variable),
+               NameSizeOfVariable (Variable)
+               ) & (Index->BucketCount - 1);
+    Index->Entries[Index->EntryCount].Offset = (UINT32) ((UINTN) Variable - (UINTN) VariableStoreHeader);
+    Index->Entries[Index->EntryCount].Next   = Index->Buckets[Bucket];
+    Index->Buckets[Bucket] = Index->EntryCount;
+    Index->EntryCount++;
+
+    Variable = GetNextVariablePtr (Variable);
+  }
+
+  Index->IndexedSize = (UINT32) ((UINTN) Variable - (UINTN) VariableStoreHeader);
+}
+
+/**
+  Find the variable in the specified variable store through its hash index.
+
+  The result is the same as the one of the linear walk in FindVariableEx(). The
+  bucket chains run from the latest variable to the earliest one.
+
+  @param[in]       VariableName        Name of the variable to be found, not an empty string.
+  @param[in]       VendorGuid          Vendor GUID to be found.
+  @param[in]       IgnoreRtCheck       Ignore EFI_VARIABLE_RUNTIME_ACCESS attribute
+                                       check at runtime when searching variable.
+  @param[in, out]  PtrTrack            Variable Track Pointer structure that contains Variable Information.
+
+  @retval          EFI_SUCCESS         Variable found successfully
+  @retval          EFI_NOT_FOUND       Variable not found
+  @retval          EFI_UNSUPPORTED     The range in PtrTrack is not an indexed store.
+
+**/
+EFI_STATUS
+FindVariableInIndex (
+  IN     CHAR16                  *VariableName,
+  IN     EFI_GUID                *VendorGuid,
+  IN     BOOLEAN                 IgnoreRtCheck,
+  IN OUT VARIABLE_POINTER_TRACK  *PtrTrack
+  )
+{
+  VARIABLE_STORE_TYPE            Type;
+  VARIABLE_STORE_INDEX           *Index;
+  VARIABLE_STORE_HEADER          *VariableStoreHeader;
+  VARIABLE_HEADER                *Variable;
+  VARIABLE_HEADER                *AddedVariable;
+  VARIABLE_HEADER                *InDeletedVariable;
+  UINTN                          LastVariableOffset;
+  UINTN                          NameSize;
+  UINT32                         Pass;
+  UINT32                         Entry;
+
+  if (!FeaturePcdGet (PcdEnableVariableHashIndex) || mVariableModuleGlobal == NULL) {
+    return EFI_UNSUPPORTED;
+  }
+
+  for (Type = (VARIABLE_STORE_TYPE) 0; Type < VariableStoreTypeMax; Type++) {
+    VariableStoreHeader = GetVariableIndexStore (Type, &LastVariableOffset);
+    if ((VariableStoreHeader != NULL) &&
+        (PtrTrack->StartPtr == GetStartPointer (VariableStoreHeader)) &&
+        (PtrTrack->EndPtr == GetEndPointer (VariableStoreHeader))) {
+      break;
+    }
+  }
+  if (Type == VariableStoreTypeMax) {
+    return EFI_UNSUPPORTED;
+  }
+
+  Index = &mVariableModuleGlobal->VariableIndex[Type];
+  if (!Index->Valid) {
+    return EFI_UNSUPPORTED;
+  }
+  UpdateVariableIndex (Type, VariableStoreHeader, LastVariableOffset);
+  if (!Index->Valid) {
+    return EFI_UNSUPPORTED;
+  }
+
+  //
+  // The first pass finds the earliest ADDED variable and the latest IN_DELETED_TRANSITION
+  // one. If there is an ADDED variable, the second pass finds the latest IN_DELETED_TRANSITION
+  // variable before it.
+  //
+  NameSize          = StrSize (VariableName);
+  AddedVariable     = NULL;
+  InDeletedVariable = NULL;
+  for (Pass = 0; Pass < 2; Pass++) {
+    for (Entry = Index->Buckets[HashVariableName (VendorGuid, VariableName, NameSize) & (Index->BucketCount - 1)];
+         Entry != VARIABLE_INDEX_END;
+         Entry = Index->Entries[Entry].Next) {
+      Variable = (VARIABLE_HEADER *) ((UINTN) VariableStoreHeader + Index->Entries[Entry].Offset);
+      if ((Variable->State != VAR_ADDED) && (Variable->State != (VAR_IN_DELETED_TRANSITION & VAR_ADDED))) {
+        continue;
+      }
+      if (!IgnoreRtCheck && AtRuntime () && ((Variable->Attributes & EFI_VARIABLE_RUNTIME_ACCESS) == 0)) {
+        continue;
+      }
+      if (!CompareGuid (VendorGuid, GetVendorGuidPtr (Variable))) {
+        continue;
+      }
+      ASSERT (NameSizeOfVariable (Variable) != 0);
+      if (CompareMem (VariableName, GetVariableNamePtr (Variable), NameSizeOfVariable (Variable)) != 0) {
+        continue;
+      }
+
+      if (Pass == 0) {
+        if (Variable->State == VAR_ADDED) {
+          AddedVariable = Variable;
+        } else if (InDeletedVariable == NULL) {
+          InDeletedVariable = Variable;
+        }
+      } else if ((Variable->State != VAR_ADDED) && (Variable < AddedVariable)) {
+        InDeletedVariable = Variable;
+        break;
+      }
+    }
+
+    if (AddedVariable == NULL) {
+      break;
+    }
+    if (Pass == 0) {
+      InDeletedVariable = NULL;
+    }
+  }
+
+  if (AddedVariable != NULL) {
+    PtrTrack->CurrPtr                = AddedVariable;
+    PtrTrack->InDeletedTransitionPtr = InDeletedVariable;
+    return EFI_SUCCESS;
+  }
+
+  PtrTrack->CurrPtr                = InDeletedVariable;
+  PtrTrack->InDeletedTransitionPtr = NULL;
+  return (InDeletedVariable == NULL) ? EFI_NOT_FOUND : EFI_SUCCESS;
+}
+
 /**
 
   Variable store garbage collection and reclaim operation.
@@ -1225,6 +1557,12 @@ Done:
     CopyMem (mNvVariableCache, (UINT8 *)(UINTN)VariableBase, VariableStoreHeader->Size);
   }
 
+  //
+  // The variables have moved, index the store again on the next lookup.
+  //
+  ResetVariableIndex (IsVolatile ? VariableStoreTypeVolatile : VariableStoreTypeNv);
+  mVariableModuleGlobal->StoreGeneration++;
+
   return Status;
 }
 
@@ -1250,6 +1588,14 @@ FindVariableEx (
 {
   VARIABLE_HEADER                *InDeletedVariable;
   VOID                           *Point;
+  EFI_STATUS                     Status;
+
+  if (VariableName[0] != 0) {
+    Status = FindVariableInIndex (VariableName, VendorGuid, IgnoreRtCheck, PtrTrack);
+    if (Status != EFI_UNSUPPORTED) {
+      return Status;
+    }
+  }
 
   PtrTrack->InDeletedTransitionPtr = NULL;
 
@@ -2885,6 +3231,90 @@ Done:
   return Status;
 }
 
+/**
+  Find the variable last returned by VariableServiceGetNextVariableInternal() through
+  the enumeration cursor.
+
+  The cursor is used only if no variable store has been written since it was recorded,
+  the runtime state is unchanged, and VariableName and VendorGuid are those of the
+  variable it points to. The variable found is then the one FindVariable() would find.
+
+  @param[in]  VariableName         Name of the variable to be found.
+  @param[in]  VendorGuid           Vendor GUID of the variable to be found.
+  @param[in]  VariableStoreHeader  Headers of the variable stores, indexed by store type.
+  @param[out] PtrTrack             VARIABLE_POINTER_TRACK structure for output,
+                                   including the range searched and the target position.
+
+  @retval TRUE   The variable was found through the cursor.
+  @retval FALSE  The cursor cannot be used, the variable has to be looked up.
+
+**/
+BOOLEAN
+FindVariableAtEnumerationCursor (
+  IN  CHAR16                  *VariableName,
+  IN  EFI_GUID                *VendorGuid,
+  IN  VARIABLE_STORE_HEADER   **VariableStoreHeader,
+  OUT VARIABLE_POINTER_TRACK  *PtrTrack
+  )
+{
+  VARIABLE_ENUMERATION_CURSOR *Cursor;
+  VARIABLE_HEADER             *Variable;
+  UINTN                       NameSize;
+
+  Cursor = &mVariableModuleGlobal->EnumerationCursor;
+  if (!Cursor->Valid ||
+      (Cursor->Generation != mVariableModuleGlobal->StoreGeneration) ||
+      (Cursor->AtRuntime != AtRuntime ()) ||
+      (VariableStoreHeader[Cursor->Type] == NULL)) {
+    return FALSE;
+  }
+
+  PtrTrack->StartPtr = GetStartPointer (VariableStoreHeader[Cursor->Type]);
+  PtrTrack->EndPtr   = GetEndPointer (VariableStoreHeader[Cursor->Type]);
+  Variable           = (VARIABLE_HEADER *) ((UINTN) VariableStoreHeader[Cursor->Type] + Cursor->Offset);
+  if (!IsValidVariableHeader (Variable, PtrTrack->EndPtr)) {
+    return FALSE;
+  }
+
+  NameSize = StrSize (VariableName);
+  if ((NameSize != NameSizeOfVariable (Variable)) ||
+      !CompareGuid (VendorGuid, GetVendorGuidPtr (Variable)) ||
+      (CompareMem (VariableName, GetVariableNamePtr (Variable), NameSize) != 0)) {
+    return FALSE;
+  }
+
+  PtrTrack->CurrPtr                = Variable;
+  PtrTrack->InDeletedTransitionPtr = NULL;
+  PtrTrack->Volatile               = (BOOLEAN) (Cursor->Type == VariableStoreTypeVolatile);
+  return TRUE;
+}
+
+/**
+  Record the variable returned by VariableServiceGetNextVariableInternal() in the
+  enumeration cursor.
+
+  @param[in] Type                 Type of the variable store the variable is in.
+  @param[in] VariableStoreHeader  Header of the variable store the variable is in.
+  @param[in] Variable             Pointer to the variable header returned.
+
+**/
+VOID
+UpdateVariableEnumerationCursor (
+  IN VARIABLE_STORE_TYPE    Type,
+  IN VARIABLE_STORE_HEADER  *VariableStoreHeader,
+  IN VARIABLE_HEADER        *Variable
+  )
+{
+  VARIABLE_ENUMERATION_CURSOR *Cursor;
+
+  Cursor             = &mVariableModuleGlobal->EnumerationCursor;
+  Cursor->Valid      = TRUE;
+  Cursor->AtRuntime  = AtRuntime ();
+  Cursor->Type       = Type;
+  Cursor->Offset     = (UINT32) ((UINTN) Variable - (UINTN) VariableStoreHeader);
+  Cursor->Generation = mVariableModuleGlobal->StoreGeneration;
+}
+
 /**
   This code Finds the Next available variable.
 
@@ -2917,7 +3347,24 @@ VariableServiceGetNextVariableInternal (
   EFI_STATUS              Status;
   VARIABLE_STORE_HEADER   *VariableStoreHeader[VariableStoreTypeMax];
 
-  Status = FindVariable (VariableName, VendorGuid, &Variable, &mVariableModuleGlobal->VariableGlobal, FALSE);
+  //
+  // 0: Volatile, 1: HOB, 2: Non-Volatile.
+  // The index and attributes mapping must be kept in this order as FindVariable
+  // makes use of this mapping to implement search algorithm.
+  //
+  VariableStoreHeader[VariableStoreTypeVolatile] = (VARIABLE_STORE_HEADER *) (UINTN) mVariableModuleGlobal->VariableGlobal.VolatileVariableBase;
+  VariableStoreHeader[VariableStoreTypeHob]      = (VARIABLE_STORE_HEADER *) (UINTN) mVariableModuleGlobal->VariableGlobal.HobVariableBase;
+  VariableStoreHeader[VariableStoreTypeNv]       = mNvVariableCache;
+
+  //
+  // When the caller continues an enumeration, the previous variable is found through
+  // the cursor so that each step does not have to look it up again.
+  //
+  if ((VariableName[0] != 0) && FindVariableAtEnumerationCursor (VariableName, VendorGuid, VariableStoreHeader, &Variable)) {
+    Status = EFI_SUCCESS;
+  } else {
+    Status = FindVariable (VariableName, VendorGuid, &Variable, &mVariableModuleGlobal->VariableGlobal, FALSE);
+  }
   if (Variable.CurrPtr == NULL || EFI_ERROR (Status)) {
     //
     // For VariableName is an empty string, FindVariable() will try to find and return
@@ -2942,15 +3389,6 @@ VariableServiceGetNextVariableInternal (
     Variable.CurrPtr = GetNextVariablePtr (Variable.CurrPtr);
   }
 
-  //
-  // 0: Volatile, 1: HOB, 2: Non-Volatile.
-  // The index and attributes mapping must be kept in this order as FindVariable
-  // makes use of this mapping to implement search algorithm.
-  //
-  VariableStoreHeader[VariableStoreTypeVolatile] = (VARIABLE_STORE_HEADER *) (UINTN) mVariableModuleGlobal->VariableGlobal.VolatileVariableBase;
-  VariableStoreHeader[VariableStoreTypeHob]      = (VARIABLE_STORE_HEADER *) (UINTN) mVariableModuleGlobal->VariableGlobal.HobVariableBase;
-  VariableStoreHeader[VariableStoreTypeNv]       = mNvVariableCache;
-
   while (TRUE) {
     //
     // Switch from Volatile to HOB, to Non-Volatile.
@@ -3032,6 +3470,13 @@ VariableServiceGetNextVariableInternal (
           }
         }
 
+        for (Type = (VARIABLE_STORE_TYPE) 0; Type < VariableStoreTypeMax; Type++) {
+          if ((VariableStoreHeader[Type] != NULL) && (Variable.StartPtr == GetStartPointer (VariableStoreHeader[Type]))) {
+            UpdateVariableEnumerationCursor (Type, VariableStoreHeader[Type], Variable.CurrPtr);
+            break;
+          }
+        }
+
         *VariablePtr = Variable.CurrPtr;
         Status = EFI_SUCCESS;
         goto Done;
@@ -4086,6 +4531,7 @@ FlushHobVariableToFlash (
   // Flush the HOB variable to flash.
   //
   if (mVariableModuleGlobal->VariableGlobal.HobVariableBase != 0) {
+    mVariableModuleGlobal->StoreGeneration++;
     VariableStoreHeader = (VARIABLE_STORE_HEADER *) (UINTN) mVariableModuleGlobal->VariableGlobal.HobVariableBase;
     //
     // Set HobVariableBase to 0, it can avoid SetVariable to call back.
@@ -4533,6 +4979,8 @@ VariableCommonInitialize (
   VolatileVariableStore->Reserved    = 0;
   VolatileVariableStore->Reserved1   = 0;
 
+  InitializeVariableIndex ();
+
   return EFI_SUCCESS;
 }
 
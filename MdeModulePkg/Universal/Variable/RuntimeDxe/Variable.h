@@ -78,6 +78,47 @@ typedef struct {
   BOOLEAN         Volatile;
 } VARIABLE_POINTER_TRACK;
 
+#define VARIABLE_INDEX_END  MAX_UINT32
+
+///
+/// One variable header of a variable store, chained with the other headers
+/// whose vendor GUID and name hash to the same bucket.
+///
+typedef struct {
+  UINT32                Offset;     ///< Offset of the variable header from the store header.
+  UINT32                Next;       ///< Next entry in the bucket, or VARIABLE_INDEX_END.
+} VARIABLE_INDEX_ENTRY;
+
+///
+/// Hash index of the variable headers of one variable store, keyed by vendor GUID
+/// and name. Headers are indexed lazily in store order, up to IndexedSize. Entries
+/// hold offsets so that the index survives the virtual address change. An index that
+/// is not Valid is not used and lookups walk the store.
+///
+typedef struct {
+  BOOLEAN               Valid;
+  UINT32                IndexedSize;
+  UINT32                EntryCount;
+  UINT32                MaxEntries;
+  UINT32                BucketCount;
+  UINT32                *Buckets;
+  VARIABLE_INDEX_ENTRY  *Entries;
+} VARIABLE_STORE_INDEX;
+
+///
+/// Position of the variable last returned by GetNextVariableName(), so that the next
+/// call can step forward from it instead of looking the variable up again. The cursor
+/// is only used while Generation matches the store generation of the module global,
+/// which changes whenever a variable store is written.
+///
+typedef struct {
+  BOOLEAN               Valid;
+  BOOLEAN               AtRuntime;
+  VARIABLE_STORE_TYPE   Type;
+  UINT32                Offset;     ///< Offset of the variable header from the store header.
+  UINT32                Generation;
+} VARIABLE_ENUMERATION_CURSOR;
+
 typedef struct {
   EFI_PHYSICAL_ADDRESS  HobVariableBase;
   EFI_PHYSICAL_ADDRESS  VolatileVariableBase;
@@ -108,6 +149,9 @@ typedef struct {
   CHAR8           *PlatformLang;
   CHAR8           Lang[ISO_639_2_ENTRY_SIZE + 1];
   EFI_FIRMWARE_VOLUME_BLOCK_PROTOCOL *FvbInstance;
+  VARIABLE_STORE_INDEX VariableIndex[VariableStoreTypeMax];
+  UINT32          StoreGeneration;
+  VARIABLE_ENUMERATION_CURSOR EnumerationCursor;
 } VARIABLE_MODULE_GLOBAL;
 
 /**
@@ -35,6 +35,14 @@ BOOLEAN                                              mAtRuntime              = F
 UINT8                                                *mVariableBufferPayload = NULL;
 UINTN                                                mVariableBufferPayloadSize;
 
+//
+// The runtime caches of the variable wrapper driver, and the size of each store
+// that was copied to its cache at the last synchronization.
+//
+BOOLEAN                                                  mVariableRuntimeCacheReady = FALSE;
+SMM_VARIABLE_COMMUNICATE_RUNTIME_VARIABLE_CACHE_CONTEXT  mVariableRuntimeCacheContext;
+UINTN                                                    mVariableRuntimeCacheSyncedSize[VariableStoreTypeMax];
+
 /**
   SecureBoot Hook for SetVariable.
 
@@ -52,6 +60,196 @@ SecureBootHook (
   return ;
 }
 
+/**
+  Get the SMM variable store that backs the runtime cache of the given type.
+
+  @param[in]  Type              The variable store type.
+  @param[out] UsedSize          The size of the store, from its header up to the end
+                                of the last variable. Zero if the store does not exist.
+
+  @return The variable store header, or NULL if the store does not exist.
+
+**/
+VARIABLE_STORE_HEADER *
+GetRuntimeCacheSource (
+  IN  VARIABLE_STORE_TYPE                          Type,
+  OUT UINTN                                        *UsedSize
+  )
+{
+  VARIABLE_STORE_HEADER                            *VariableStoreHeader;
+
+  switch (Type) {
+    case VariableStoreTypeVolatile:
+      VariableStoreHeader = (VARIABLE_STORE_HEADER *) (UINTN) mVariableModuleGlobal->VariableGlobal.VolatileVariableBase;
+      *UsedSize           = mVariableModuleGlobal->VolatileLastVariableOffset;
+      break;
+
+    case VariableStoreTypeHob:
+      VariableStoreHeader = (VARIABLE_STORE_HEADER *) (UINTN) mVariableModuleGlobal->VariableGlobal.HobVariableBase;
+      *UsedSize           = (VariableStoreHeader == NULL) ? 0 : VariableStoreHeader->Size;
+      break;
+
+    default:
+      VariableStoreHeader = mNvVariableCache;
+      *UsedSize           = mVariableModuleGlobal->NonVolatileLastVariableOffset;
+      break;
+  }
+
+  if (VariableStoreHeader != NULL) {
+    *UsedSize = MIN (*UsedSize, VariableStoreHeader->Size);
+  }
+  return VariableStoreHeader;
+}
+
+/**
+  Get the runtime cache of the given type registered by the variable wrapper driver.
+
+  @param[in]  Type              The variable store type.
+
+  @return The runtime cache, or NULL if the store is not cached.
+
+**/
+VARIABLE_STORE_HEADER *
+GetRuntimeCache (
+  IN  VARIABLE_STORE_TYPE                          Type
+  )
+{
+  switch (Type) {
+    case VariableStoreTypeVolatile:
+      return mVariableRuntimeCacheContext.RuntimeVolatileCache;
+    case VariableStoreTypeHob:
+      return mVariableRuntimeCacheContext.RuntimeHobCache;
+    default:
+      return mVariableRuntimeCacheContext.RuntimeNvCache;
+  }
+}
+
+/**
+  Copy the SMM variable stores to the runtime caches of the variable wrapper driver.
+
+  Only the part of each store that is in use now, or was in use at the previous
+  synchronization, is copied. The rest of a cache is still erased. If the wrapper
+  driver is reading the caches, nothing is copied and the update is left pending
+  for the wrapper driver to request it before its next read.
+
+**/
+VOID
+SynchronizeRuntimeVariableCache (
+  VOID
+  )
+{
+  VARIABLE_STORE_TYPE                              Type;
+  VARIABLE_STORE_HEADER                            *VariableStoreHeader;
+  VARIABLE_STORE_HEADER                            *RuntimeCache;
+  UINTN                                            UsedSize;
+
+  if (!mVariableRuntimeCacheReady) {
+    return;
+  }
+
+  if (*mVariableRuntimeCacheContext.ReadLock) {
+    *mVariableRuntimeCacheContext.PendingUpdate = TRUE;
+    return;
+  }
+
+  for (Type = (VARIABLE_STORE_TYPE) 0; Type < VariableStoreTypeMax; Type++) {
+    RuntimeCache = GetRuntimeCache (Type);
+    if (RuntimeCache == NULL) {
+      continue;
+    }
+
+    VariableStoreHeader = GetRuntimeCacheSource (Type, &UsedSize);
+    if (VariableStoreHeader == NULL) {
+      //
+      // The HOB variables have been flushed to the NV store and the HOB store
+      // released, erase the cached variables behind the store header.
+      //
+      if (mVariableRuntimeCacheSyncedSize[Type] > sizeof (VARIABLE_STORE_HEADER)) {
+        SetMem (
+          RuntimeCache + 1,
+          mVariableRuntimeCacheSyncedSize[Type] - sizeof (VARIABLE_STORE_HEADER),
+          0xff
+          );
+      }
+      mVariableRuntimeCacheSyncedSize[Type] = 0;
+      continue;
+    }
+
+    CopyMem (
+      RuntimeCache,
+      VariableStoreHeader,
+      MAX (UsedSize, mVariableRuntimeCacheSyncedSize[Type])
+      );
+    mVariableRuntimeCacheSyncedSize[Type] = UsedSize;
+  }
+
+  *mVariableRuntimeCacheContext.PendingUpdate = FALSE;
+}
+
+/**
+  Register the runtime caches of the variable wrapper driver and fill them.
+
+  Caution: This function may receive untrusted input.
+  All the buffers are external input, so they are checked to be outside of SMRAM
+  and as large as the variable stores they cache.
+
+  @param[in] Context            The runtime cache context, copied into SMRAM.
+
+  @retval EFI_SUCCESS           The runtime caches are registered and filled.
+  @retval EFI_ACCESS_DENIED     A buffer is invalid or overlaps SMRAM.
+
+**/
+EFI_STATUS
+InitializeRuntimeVariableCache (
+  IN SMM_VARIABLE_COMMUNICATE_RUNTIME_VARIABLE_CACHE_CONTEXT  *Context
+  )
+{
+  VARIABLE_STORE_TYPE                              Type;
+  VARIABLE_STORE_HEADER                            *VariableStoreHeader;
+  VARIABLE_STORE_HEADER                            *RuntimeCache;
+  UINTN                                            UsedSize;
+
+  if (!VariableSmmIsBufferOutsideSmmValid ((UINTN) Context->ReadLock, sizeof (BOOLEAN)) ||
+      !VariableSmmIsBufferOutsideSmmValid ((UINTN) Context->PendingUpdate, sizeof (BOOLEAN))) {
+    return EFI_ACCESS_DENIED;
+  }
+
+  CopyMem (&mVariableRuntimeCacheContext, Context, sizeof (mVariableRuntimeCacheContext));
+  for (Type = (VARIABLE_STORE_TYPE) 0; Type < VariableStoreTypeMax; Type++) {
+    RuntimeCache        = GetRuntimeCache (Type);
+    VariableStoreHeader = GetRuntimeCacheSource (Type, &UsedSize);
+    if (VariableStoreHeader == NULL || RuntimeCache == NULL) {
+      if (RuntimeCache != VariableStoreHeader) {
+        ZeroMem (&mVariableRuntimeCacheContext, sizeof (mVariableRuntimeCacheContext));
+        return EFI_ACCESS_DENIED;
+      }
+      continue;
+    }
+
+    if (!VariableSmmIsBufferOutsideSmmValid ((UINTN) RuntimeCache, VariableStoreHeader->Size)) {
+      ZeroMem (&mVariableRuntimeCacheContext, sizeof (mVariableRuntimeCacheContext));
+      return EFI_ACCESS_DENIED;
+    }
+  }
+
+  //
+  // Fill the whole caches once, later synchronizations only copy the used part.
+  //
+  for (Type = (VARIABLE_STORE_TYPE) 0; Type < VariableStoreTypeMax; Type++) {
+    RuntimeCache        = GetRuntimeCache (Type);
+    VariableStoreHeader = GetRuntimeCacheSource (Type, &UsedSize);
+    if (RuntimeCache != NULL) {
+      CopyMem (RuntimeCache, VariableStoreHeader, VariableStoreHeader->Size);
+      mVariableRuntimeCacheSyncedSize[Type] = UsedSize;
+    }
+  }
+
+  *mVariableRuntimeCacheContext.ReadLock      = FALSE;
+  *mVariableRuntimeCacheContext.PendingUpdate = FALSE;
+  mVariableRuntimeCacheReady = TRUE;
+  return EFI_SUCCESS;
+}
+
 /**
 
   This code sets variable in storage blocks (Volatile or Non-Volatile).
@@ -94,6 +292,7 @@ SmmVariableSetVariable (
                      Data
                      );
   mRequestSource = VarCheckFromUntrusted;
+  SynchronizeRuntimeVariableCache ();
   return Status;
 }
 
@@ -462,6 +661,8 @@ SmmVariableHandler (
   SMM_VARIABLE_COMMUNICATE_GET_NEXT_VARIABLE_NAME  *GetNextVariableName;
   SMM_VARIABLE_COMMUNICATE_QUERY_VARIABLE_INFO     *QueryVariableInfo;
   SMM_VARIABLE_COMMUNICATE_GET_PAYLOAD_SIZE        *GetPayloadSize;
+  SMM_VARIABLE_COMMUNICATE_GET_RUNTIME_CACHE_INFO  *GetRuntimeCacheInfo;
+  VARIABLE_STORE_HEADER                            *VariableStoreHeader;
   VARIABLE_INFO_ENTRY                              *VariableInfo;
   SMM_VARIABLE_COMMUNICATE_LOCK_VARIABLE           *VariableToLock;
   SMM_VARIABLE_COMMUNICATE_VAR_CHECK_VARIABLE_PROPERTY *CommVariableProperty;
@@ -647,6 +848,7 @@ SmmVariableHandler (
                  SmmVariableHeader->DataSize,
                  (UINT8 *)SmmVariableHeader->Name + SmmVariableHeader->NameSize
                  );
+      SynchronizeRuntimeVariableCache ();
       break;
 
     case SMM_VARIABLE_FUNCTION_QUERY_VARIABLE_INFO:
@@ -674,6 +876,58 @@ SmmVariableHandler (
       Status = EFI_SUCCESS;
       break;
 
+    case SMM_VARIABLE_FUNCTION_GET_RUNTIME_CACHE_INFO:
+      if (CommBufferPayloadSize < sizeof (SMM_VARIABLE_COMMUNICATE_GET_RUNTIME_CACHE_INFO)) {
+        DEBUG ((EFI_D_ERROR, "GetRuntimeCacheInfo: SMM communication buffer size invalid!\n"));
+        return EFI_SUCCESS;
+      }
+      if (!FeaturePcdGet (PcdEnableVariableRuntimeCache)) {
+        Status = EFI_UNSUPPORTED;
+        break;
+      }
+      GetRuntimeCacheInfo = (SMM_VARIABLE_COMMUNICATE_GET_RUNTIME_CACHE_INFO *) SmmVariableFunctionHeader->Data;
+      VariableStoreHeader = GetRuntimeCacheSource (VariableStoreTypeHob, &InfoSize);
+      GetRuntimeCacheInfo->TotalHobStorageSize        = (VariableStoreHeader == NULL) ? 0 : VariableStoreHeader->Size;
+      VariableStoreHeader = GetRuntimeCacheSource (VariableStoreTypeNv, &InfoSize);
+      GetRuntimeCacheInfo->TotalNvStorageSize         = VariableStoreHeader->Size;
+      VariableStoreHeader = GetRuntimeCacheSource (VariableStoreTypeVolatile, &InfoSize);
+      GetRuntimeCacheInfo->TotalVolatileStorageSize   = VariableStoreHeader->Size;
+      GetRuntimeCacheInfo->AuthenticatedVariableUsage = mVariableModuleGlobal->VariableGlobal.AuthFormat;
+      Status = EFI_SUCCESS;
+      break;
+
+    case SMM_VARIABLE_FUNCTION_INIT_RUNTIME_VARIABLE_CACHE_CONTEXT:
+      if (CommBufferPayloadSize < sizeof (SMM_VARIABLE_COMMUNICATE_RUNTIME_VARIABLE_CACHE_CONTEXT)) {
+        DEBUG ((EFI_D_ERROR, "InitRuntimeVariableCacheContext: SMM communication buffer size invalid!\n"));
+        return EFI_SUCCESS;
+      }
+      if (!FeaturePcdGet (PcdEnableVariableRuntimeCache)) {
+        Status = EFI_UNSUPPORTED;
+        break;
+      }
+      if (mEndOfDxe || mVariableRuntimeCacheReady) {
+        //
+        // The caches are written from SMM, only accept them once and before the end of DXE.
+        //
+        Status = EFI_ACCESS_DENIED;
+        break;
+      }
+      //
+      // Copy the input communicate buffer payload to pre-allocated SMM variable buffer payload.
+      //
+      CopyMem (mVariableBufferPayload, SmmVariableFunctionHeader->Data, sizeof (SMM_VARIABLE_COMMUNICATE_RUNTIME_VARIABLE_CACHE_CONTEXT));
+      Status = InitializeRuntimeVariableCache ((SMM_VARIABLE_COMMUNICATE_RUNTIME_VARIABLE_CACHE_CONTEXT *) mVariableBufferPayload);
+      break;
+
+    case SMM_VARIABLE_FUNCTION_SYNC_RUNTIME_CACHE:
+      if (!mVariableRuntimeCacheReady) {
+        Status = EFI_UNSUPPORTED;
+        break;
+      }
+      SynchronizeRuntimeVariableCache ();
+      Status = *mVariableRuntimeCacheContext.PendingUpdate ? EFI_NOT_READY : EFI_SUCCESS;
+      break;
+
     case SMM_VARIABLE_FUNCTION_READY_TO_BOOT:
       if (AtRuntime()) {
         Status = EFI_UNSUPPORTED;
@@ -689,6 +943,7 @@ SmmVariableHandler (
         InitializeVariableQuota ();
       }
       ReclaimForOS ();
+      SynchronizeRuntimeVariableCache ();
       Status = EFI_SUCCESS;
       break;
 
@@ -829,6 +1084,7 @@ SmmEndOfDxeCallback (
   if (PcdGetBool (PcdReclaimVariableSpaceAtEndOfDxe)) {
     ReclaimForOS ();
   }
+  SynchronizeRuntimeVariableCache ();
 
   return EFI_SUCCESS;
 }
@@ -849,6 +1105,11 @@ VariableWriteServiceInitializeSmm (
     DEBUG ((DEBUG_ERROR, "Variable write service initialization failed. Status = %r\n", Status));
   }
 
+  //
+  // The HOB variables may have been flushed to the NV store.
+  //
+  SynchronizeRuntimeVariableCache ();
+
   //
   // Notify the variable wrapper driver the variable write service is ready
   //
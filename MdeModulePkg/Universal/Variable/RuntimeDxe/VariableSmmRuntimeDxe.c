@@ -34,6 +34,7 @@ SPDX-License-Identifier: BSD-2-Clause-Patent
 #include <Library/DebugLib.h>
 #include <Library/UefiLib.h>
 #include <Library/BaseLib.h>
+#include <Library/PcdLib.h>
 
 #include <Guid/EventGroup.h>
 #include <Guid/SmmVariableCommon.h>
@@ -52,6 +53,23 @@ EFI_LOCK                         mVariableServicesLock;
 EDKII_VARIABLE_LOCK_PROTOCOL     mVariableLock;
 EDKII_VAR_CHECK_PROTOCOL         mVarCheck;
 
+//
+// The runtime copies of the SMM variable stores, indexed in the search order
+// of the SMM variable driver. They are kept coherent by the SMM variable driver.
+//
+typedef enum {
+  VariableStoreIndexVolatile,
+  VariableStoreIndexHob,
+  VariableStoreIndexNv,
+  VariableStoreIndexMax
+} VARIABLE_STORE_INDEX;
+
+BOOLEAN                          mVariableRuntimeCacheReady         = FALSE;
+BOOLEAN                          mVariableAuthFormat                = FALSE;
+BOOLEAN                          *mVariableRuntimeCacheReadLock     = NULL;
+BOOLEAN                          *mVariableRuntimeCachePendingUpdate = NULL;
+VARIABLE_STORE_HEADER            *mVariableRuntimeCaches[VariableStoreIndexMax];
+
 /**
   Some Secure Boot Policy Variable may update following other variable changes(SecureBoot follows PK change, etc).
   Record their initial State when variable write service is ready.
@@ -181,6 +199,562 @@ SendCommunicateBuffer (
   return  SmmVariableFunctionHeader->ReturnStatus;
 }
 
+/**
+  This code gets the size of variable header.
+
+  @return Size of variable header in bytes in type UINTN.
+
+**/
+UINTN
+GetVariableHeaderSize (
+  VOID
+  )
+{
+  if (mVariableAuthFormat) {
+    return sizeof (AUTHENTICATED_VARIABLE_HEADER);
+  }
+  return sizeof (VARIABLE_HEADER);
+}
+
+/**
+  This code checks if variable header is valid or not.
+
+  @param[in] Variable           Pointer to the Variable Header.
+  @param[in] VariableStoreEnd   Pointer to the Variable Store End.
+
+  @retval TRUE                  Variable header is valid.
+  @retval FALSE                 Variable header is not valid.
+
+**/
+BOOLEAN
+IsValidVariableHeader (
+  IN  VARIABLE_HEADER       *Variable,
+  IN  VARIABLE_HEADER       *VariableStoreEnd
+  )
+{
+  return (BOOLEAN) ((Variable != NULL) && (Variable < VariableStoreEnd) && (Variable->StartId == VARIABLE_DATA));
+}
+
+/**
+  This code gets the size of name of variable.
+
+  @param[in] Variable   Pointer to the Variable Header.
+
+  @return Size of variable name in bytes, zero if the header is not filled in.
+
+**/
+UINTN
+NameSizeOfVariable (
+  IN  VARIABLE_HEADER   *Variable
+  )
+{
+  AUTHENTICATED_VARIABLE_HEADER *AuthVariable;
+
+  AuthVariable = (AUTHENTICATED_VARIABLE_HEADER *) Variable;
+  if (mVariableAuthFormat) {
+    if (AuthVariable->State == (UINT8) (-1) ||
+        AuthVariable->DataSize == (UINT32) (-1) ||
+        AuthVariable->NameSize == (UINT32) (-1) ||
+        AuthVariable->Attributes == (UINT32) (-1)) {
+      return 0;
+    }
+    return (UINTN) AuthVariable->NameSize;
+  } else {
+    if (Variable->State == (UINT8) (-1) ||
+        Variable->DataSize == (UINT32) (-1) ||
+        Variable->NameSize == (UINT32) (-1) ||
+        Variable->Attributes == (UINT32) (-1)) {
+      return 0;
+    }
+    return (UINTN) Variable->NameSize;
+  }
+}
+
+/**
+  This code gets the size of variable data.
+
+  @param[in] Variable   Pointer to the Variable Header.
+
+  @return Size of variable data in bytes, zero if the header is not filled in.
+
+**/
+UINTN
+DataSizeOfVariable (
+  IN  VARIABLE_HEADER   *Variable
+  )
+{
+  AUTHENTICATED_VARIABLE_HEADER *AuthVariable;
+
+  AuthVariable = (AUTHENTICATED_VARIABLE_HEADER *) Variable;
+  if (mVariableAuthFormat) {
+    if (AuthVariable->State == (UINT8) (-1) ||
+        AuthVariable->DataSize == (UINT32) (-1) ||
+        AuthVariable->NameSize == (UINT32) (-1) ||
+        AuthVariable->Attributes == (UINT32) (-1)) {
+      return 0;
+    }
+    return (UINTN) AuthVariable->DataSize;
+  } else {
+    if (Variable->State == (UINT8) (-1) ||
+        Variable->DataSize == (UINT32) (-1) ||
+        Variable->NameSize == (UINT32) (-1) ||
+        Variable->Attributes == (UINT32) (-1)) {
+      return 0;
+    }
+    return (UINTN) Variable->DataSize;
+  }
+}
+
+/**
+  This code gets the pointer to the variable name.
+
+  @param[in] Variable   Pointer to the Variable Header.
+
+  @return Pointer to Variable Name which is Unicode encoding.
+
+**/
+CHAR16 *
+GetVariableNamePtr (
+  IN  VARIABLE_HEADER   *Variable
+  )
+{
+  return (CHAR16 *) ((UINTN) Variable + GetVariableHeaderSize ());
+}
+
+/**
+  This code gets the pointer to the variable guid.
+
+  @param[in] Variable   Pointer to the Variable Header.
+
+  @return A EFI_GUID* pointer to Vendor Guid.
+
+**/
+EFI_GUID *
+GetVendorGuidPtr (
+  IN VARIABLE_HEADER    *Variable
+  )
+{
+  if (mVariableAuthFormat) {
+    return &((AUTHENTICATED_VARIABLE_HEADER *) Variable)->VendorGuid;
+  }
+  return &Variable->VendorGuid;
+}
+
+/**
+  This code gets the pointer to the variable data.
+
+  @param[in] Variable   Pointer to the Variable Header.
+
+  @return Pointer to Variable Data.
+
+**/
+UINT8 *
+GetVariableDataPtr (
+  IN  VARIABLE_HEADER   *Variable
+  )
+{
+  UINTN Value;
+
+  //
+  // Be careful about pad size for alignment.
+  //
+  Value =  (UINTN) GetVariableNamePtr (Variable);
+  Value += NameSizeOfVariable (Variable);
+  Value += GET_PAD_SIZE (NameSizeOfVariable (Variable));
+
+  return (UINT8 *) Value;
+}
+
+/**
+  This code gets the pointer to the next variable header.
+
+  @param[in] Variable   Pointer to the Variable Header.
+
+  @return Pointer to next variable header.
+
+**/
+VARIABLE_HEADER *
+GetNextVariablePtr (
+  IN  VARIABLE_HEADER   *Variable
+  )
+{
+  UINTN Value;
+
+  Value =  (UINTN) GetVariableDataPtr (Variable);
+  Value += DataSizeOfVariable (Variable);
+  Value += GET_PAD_SIZE (DataSizeOfVariable (Variable));
+
+  //
+  // Be careful about pad size for alignment.
+  //
+  return (VARIABLE_HEADER *) HEADER_ALIGN (Value);
+}
+
+/**
+  Gets the pointer to the first variable header in given variable store area.
+
+  @param[in] VarStoreHeader  Pointer to the Variable Store Header.
+
+  @return Pointer to the first variable header.
+
+**/
+VARIABLE_HEADER *
+GetStartPointer (
+  IN VARIABLE_STORE_HEADER       *VarStoreHeader
+  )
+{
+  return (VARIABLE_HEADER *) HEADER_ALIGN (VarStoreHeader + 1);
+}
+
+/**
+  Gets the pointer to the end of the variable storage area.
+
+  @param[in] VarStoreHeader  Pointer to the Variable Store Header.
+
+  @return Pointer to the end of the variable storage area.
+
+**/
+VARIABLE_HEADER *
+GetEndPointer (
+  IN VARIABLE_STORE_HEADER       *VarStoreHeader
+  )
+{
+  return (VARIABLE_HEADER *) HEADER_ALIGN ((UINTN) VarStoreHeader + VarStoreHeader->Size);
+}
+
+/**
+  Find a variable in one runtime variable cache.
+
+  The search follows FindVariableEx() of the SMM variable driver: an ADDED variable
+  wins over an IN_DELETED_TRANSITION one, and variables without the
+  EFI_VARIABLE_RUNTIME_ACCESS attribute are not visible at runtime.
+
+  @param[in]  VariableName        Name of the variable to be found, or an empty string
+                                  to find the first visible variable.
+  @param[in]  VendorGuid          Vendor GUID to be found.
+  @param[in]  VariableStoreHeader The runtime variable cache to search.
+  @param[out] Variable            The variable found.
+
+  @retval EFI_SUCCESS             The variable is found.
+  @retval EFI_NOT_FOUND           The variable is not found.
+
+**/
+EFI_STATUS
+FindVariableInRuntimeCacheStore (
+  IN  CHAR16                  *VariableName,
+  IN  EFI_GUID                *VendorGuid,
+  IN  VARIABLE_STORE_HEADER   *VariableStoreHeader,
+  OUT VARIABLE_HEADER         **Variable
+  )
+{
+  VARIABLE_HEADER             *CurrPtr;
+  VARIABLE_HEADER             *EndPtr;
+  VARIABLE_HEADER             *InDeletedVariable;
+
+  InDeletedVariable = NULL;
+  EndPtr            = GetEndPointer (VariableStoreHeader);
+  for ( CurrPtr = GetStartPointer (VariableStoreHeader)
+      ; IsValidVariableHeader (CurrPtr, EndPtr)
+      ; CurrPtr = GetNextVariablePtr (CurrPtr)
+      ) {
+    if (CurrPtr->State != VAR_ADDED && CurrPtr->State != (VAR_IN_DELETED_TRANSITION & VAR_ADDED)) {
+      continue;
+    }
+    if (EfiAtRuntime () && ((CurrPtr->Attributes & EFI_VARIABLE_RUNTIME_ACCESS) == 0)) {
+      continue;
+    }
+    if (VariableName[0] != 0) {
+      if (!CompareGuid (VendorGuid, GetVendorGuidPtr (CurrPtr)) ||
+          NameSizeOfVariable (CurrPtr) == 0 ||
+          CompareMem (VariableName, GetVariableNamePtr (CurrPtr), NameSizeOfVariable (CurrPtr)) != 0) {
+        continue;
+      }
+    }
+    if (CurrPtr->State == (VAR_IN_DELETED_TRANSITION & VAR_ADDED)) {
+      InDeletedVariable = CurrPtr;
+    } else {
+      *Variable = CurrPtr;
+      return EFI_SUCCESS;
+    }
+  }
+
+  *Variable = InDeletedVariable;
+  return (InDeletedVariable == NULL) ? EFI_NOT_FOUND : EFI_SUCCESS;
+}
+
+/**
+  Find a variable in the runtime variable caches, in the same store order as
+  FindVariable() of the SMM variable driver: volatile, HOB, then non-volatile.
+
+  @param[in]  VariableName        Name of the variable to be found.
+  @param[in]  VendorGuid          Vendor GUID to be found.
+  @param[out] Variable            The variable found.
+  @param[out] StoreIndex          Index in mVariableRuntimeCaches of the cache holding it.
+
+  @retval EFI_SUCCESS             The variable is found.
+  @retval EFI_NOT_FOUND           The variable is not found.
+
+**/
+EFI_STATUS
+FindVariableInRuntimeCache (
+  IN  CHAR16                  *VariableName,
+  IN  EFI_GUID                *VendorGuid,
+  OUT VARIABLE_HEADER         **Variable,
+  OUT UINTN                   *StoreIndex
+  )
+{
+  UINTN                       Index;
+
+  for (Index = 0; Index < ARRAY_SIZE (mVariableRuntimeCaches); Index++) {
+    if (mVariableRuntimeCaches[Index] == NULL) {
+      continue;
+    }
+    if (!EFI_ERROR (FindVariableInRuntimeCacheStore (VariableName, VendorGuid, mVariableRuntimeCaches[Index], Variable))) {
+      *StoreIndex = Index;
+      return EFI_SUCCESS;
+    }
+  }
+  return EFI_NOT_FOUND;
+}
+
+/**
+  Start reading the runtime variable caches.
+
+  If the SMM variable driver left an update pending, the caches are synchronized
+  first. The caller must hold mVariableServicesLock.
+
+  @retval TRUE    The caches may be read until EndRuntimeCacheRead() is called.
+  @retval FALSE   The caches are not usable, the request must be sent to SMM.
+
+**/
+BOOLEAN
+BeginRuntimeCacheRead (
+  VOID
+  )
+{
+  EFI_STATUS                                Status;
+
+  if (!mVariableRuntimeCacheReady) {
+    return FALSE;
+  }
+
+  if (*mVariableRuntimeCacheReadLock) {
+    //
+    // A read of the caches is in progress further up the stack.
+    //
+    return FALSE;
+  }
+
+  if (*mVariableRuntimeCachePendingUpdate) {
+    Status = InitCommunicateBuffer (NULL, 0, SMM_VARIABLE_FUNCTION_SYNC_RUNTIME_CACHE);
+    if (!EFI_ERROR (Status)) {
+      Status = SendCommunicateBuffer (0);
+    }
+    if (Status == EFI_UNSUPPORTED) {
+      //
+      // The SMM variable driver does not maintain the caches any more.
+      //
+      mVariableRuntimeCacheReady = FALSE;
+    }
+    if (EFI_ERROR (Status)) {
+      return FALSE;
+    }
+  }
+
+  *mVariableRuntimeCacheReadLock = TRUE;
+  MemoryFence ();
+  return TRUE;
+}
+
+/**
+  Finish reading the runtime variable caches.
+
+**/
+VOID
+EndRuntimeCacheRead (
+  VOID
+  )
+{
+  MemoryFence ();
+  *mVariableRuntimeCacheReadLock = FALSE;
+}
+
+/**
+  Get a variable from the runtime variable caches.
+
+  @param[in]      VariableName       Name of Variable to be found.
+  @param[in]      VendorGuid         Variable vendor GUID.
+  @param[out]     Attributes         Attribute value of the variable found.
+  @param[in, out] DataSize           Size of Data found. If size is less than the
+                                     data, this value contains the required size.
+  @param[out]     Data               Data pointer.
+
+  @retval EFI_INVALID_PARAMETER      Invalid parameter.
+  @retval EFI_SUCCESS                Find the specified variable.
+  @retval EFI_NOT_FOUND              Not found.
+  @retval EFI_BUFFER_TO_SMALL        DataSize is too small for the result.
+
+**/
+EFI_STATUS
+GetVariableFromRuntimeCache (
+  IN      CHAR16                            *VariableName,
+  IN      EFI_GUID                          *VendorGuid,
+  OUT     UINT32                            *Attributes OPTIONAL,
+  IN OUT  UINTN                             *DataSize,
+  OUT     VOID                              *Data
+  )
+{
+  EFI_STATUS                                Status;
+  VARIABLE_HEADER                           *Variable;
+  UINTN                                     StoreIndex;
+  UINTN                                     VarDataSize;
+
+  if (VariableName[0] == 0) {
+    return EFI_NOT_FOUND;
+  }
+
+  Status = FindVariableInRuntimeCache (VariableName, VendorGuid, &Variable, &StoreIndex);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  VarDataSize = DataSizeOfVariable (Variable);
+  ASSERT (VarDataSize != 0);
+
+  if (*DataSize < VarDataSize) {
+    *DataSize = VarDataSize;
+    return EFI_BUFFER_TOO_SMALL;
+  }
+
+  if (Data == NULL) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  CopyMem (Data, GetVariableDataPtr (Variable), VarDataSize);
+  if (Attributes != NULL) {
+    *Attributes = Variable->Attributes;
+  }
+  *DataSize = VarDataSize;
+  return EFI_SUCCESS;
+}
+
+/**
+  Get the next variable name from the runtime variable caches.
+
+  The walk follows VariableServiceGetNextVariableInternal() of the SMM variable
+  driver, so the same variables are returned in the same order.
+
+  @param[in, out] VariableNameSize   Size of the variable name.
+  @param[in, out] VariableName       Pointer to variable name.
+  @param[in, out] VendorGuid         Variable Vendor Guid.
+
+  @retval EFI_INVALID_PARAMETER      Invalid parameter.
+  @retval EFI_SUCCESS                Find the specified variable.
+  @retval EFI_NOT_FOUND              Not found.
+  @retval EFI_BUFFER_TO_SMALL        DataSize is too small for the result.
+
+**/
+EFI_STATUS
+GetNextVariableNameFromRuntimeCache (
+  IN OUT  UINTN                             *VariableNameSize,
+  IN OUT  CHAR16                            *VariableName,
+  IN OUT  EFI_GUID                          *VendorGuid
+  )
+{
+  EFI_STATUS                                Status;
+  UINTN                                     MaxLen;
+  UINTN                                     VarNameSize;
+  UINTN                                     StoreIndex;
+  VARIABLE_HEADER                           *Variable;
+  VARIABLE_HEADER                           *EndPtr;
+  VARIABLE_HEADER                           *Found;
+  VARIABLE_STORE_HEADER                     *HobCache;
+
+  //
+  // Calculate the possible maximum length of name string, including the Null terminator.
+  //
+  MaxLen = *VariableNameSize / sizeof (CHAR16);
+  if ((MaxLen == 0) || (StrnLenS (VariableName, MaxLen) == MaxLen)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Status = FindVariableInRuntimeCache (VariableName, VendorGuid, &Variable, &StoreIndex);
+  if (EFI_ERROR (Status)) {
+    return (VariableName[0] != 0) ? EFI_INVALID_PARAMETER : Status;
+  }
+
+  if (VariableName[0] != 0) {
+    Variable = GetNextVariablePtr (Variable);
+  }
+
+  HobCache = mVariableRuntimeCaches[VariableStoreIndexHob];
+  EndPtr   = GetEndPointer (mVariableRuntimeCaches[StoreIndex]);
+  while (TRUE) {
+    //
+    // Switch from Volatile to HOB, to Non-Volatile.
+    //
+    while (!IsValidVariableHeader (Variable, EndPtr)) {
+      for (StoreIndex++; StoreIndex < ARRAY_SIZE (mVariableRuntimeCaches); StoreIndex++) {
+        if (mVariableRuntimeCaches[StoreIndex] != NULL) {
+          break;
+        }
+      }
+      if (StoreIndex == ARRAY_SIZE (mVariableRuntimeCaches)) {
+        return EFI_NOT_FOUND;
+      }
+      Variable = GetStartPointer (mVariableRuntimeCaches[StoreIndex]);
+      EndPtr   = GetEndPointer (mVariableRuntimeCaches[StoreIndex]);
+    }
+
+    if ((Variable->State == VAR_ADDED || Variable->State == (VAR_IN_DELETED_TRANSITION & VAR_ADDED)) &&
+        (!EfiAtRuntime () || ((Variable->Attributes & EFI_VARIABLE_RUNTIME_ACCESS) != 0))) {
+      //
+      // Skip an IN_DELETED_TRANSITION variable that has an ADDED copy, and an NV
+      // variable that the HOB overrides.
+      //
+      if (Variable->State == (VAR_IN_DELETED_TRANSITION & VAR_ADDED)) {
+        Status = FindVariableInRuntimeCacheStore (
+                   GetVariableNamePtr (Variable),
+                   GetVendorGuidPtr (Variable),
+                   mVariableRuntimeCaches[StoreIndex],
+                   &Found
+                   );
+        if (!EFI_ERROR (Status) && Found->State == VAR_ADDED) {
+          Variable = GetNextVariablePtr (Variable);
+          continue;
+        }
+      }
+      if (StoreIndex == VariableStoreIndexNv && HobCache != NULL) {
+        Status = FindVariableInRuntimeCacheStore (
+                   GetVariableNamePtr (Variable),
+                   GetVendorGuidPtr (Variable),
+                   HobCache,
+                   &Found
+                   );
+        if (!EFI_ERROR (Status)) {
+          Variable = GetNextVariablePtr (Variable);
+          continue;
+        }
+      }
+      break;
+    }
+
+    Variable = GetNextVariablePtr (Variable);
+  }
+
+  VarNameSize = NameSizeOfVariable (Variable);
+  ASSERT (VarNameSize != 0);
+  if (VarNameSize <= *VariableNameSize) {
+    CopyMem (VariableName, GetVariableNamePtr (Variable), VarNameSize);
+    CopyMem (VendorGuid, GetVendorGuidPtr (Variable), sizeof (EFI_GUID));
+    Status = EFI_SUCCESS;
+  } else {
+    Status = EFI_BUFFER_TOO_SMALL;
+  }
+  *VariableNameSize = VarNameSize;
+  return Status;
+}
+
 /**
   Mark a variable that will become read-only after leaving the DXE phase of execution.
 
@@ -476,6 +1050,12 @@ RuntimeServiceGetVariable (
 
   AcquireLockOnlyAtBootTime(&mVariableServicesLock);
 
+  if (BeginRuntimeCacheRead ()) {
+    Status = GetVariableFromRuntimeCache (VariableName, VendorGuid, Attributes, DataSize, Data);
+    EndRuntimeCacheRead ();
+    goto Done;
+  }
+
   //
   // Init the communicate buffer. The buffer data size is:
   // SMM_COMMUNICATE_HEADER_SIZE + SMM_VARIABLE_COMMUNICATE_HEADER_SIZE + PayloadSize.
@@ -583,6 +1163,12 @@ RuntimeServiceGetNextVariableName (
 
   AcquireLockOnlyAtBootTime(&mVariableServicesLock);
 
+  if (BeginRuntimeCacheRead ()) {
+    Status = GetNextVariableNameFromRuntimeCache (VariableNameSize, VariableName, VendorGuid);
+    EndRuntimeCacheRead ();
+    goto Done;
+  }
+
   //
   // Init the communicate buffer. The buffer data size is:
   // SMM_COMMUNICATE_HEADER_SIZE + SMM_VARIABLE_COMMUNICATE_HEADER_SIZE + PayloadSize.
@@ -891,8 +1477,15 @@ VariableAddressChangeEvent (
   IN VOID                                   *Context
   )
 {
+  UINTN  Index;
+
   EfiConvertPointer (0x0, (VOID **) &mVariableBuffer);
   EfiConvertPointer (0x0, (VOID **) &mSmmCommunication);
+  EfiConvertPointer (EFI_OPTIONAL_PTR, (VOID **) &mVariableRuntimeCacheReadLock);
+  EfiConvertPointer (EFI_OPTIONAL_PTR, (VOID **) &mVariableRuntimeCachePendingUpdate);
+  for (Index = 0; Index < ARRAY_SIZE (mVariableRuntimeCaches); Index++) {
+    EfiConvertPointer (EFI_OPTIONAL_PTR, (VOID **) &mVariableRuntimeCaches[Index]);
+  }
 }
 
 /**
@@ -969,6 +1562,99 @@ Done:
   return Status;
 }
 
+/**
+  Allocate the runtime copies of the SMM variable stores and register them with
+  the SMM variable driver, which fills them and keeps them coherent.
+
+  This must be done before the end of DXE, after which the SMM variable driver
+  does not accept the caches any more.
+
+  @retval EFI_SUCCESS           GetVariable() and GetNextVariableName() are served from the caches.
+  @retval EFI_OUT_OF_RESOURCES  The caches could not be allocated.
+  @retval Others                The SMM variable driver does not support or rejected the caches.
+
+**/
+EFI_STATUS
+InitVariableRuntimeCache (
+  VOID
+  )
+{
+  EFI_STATUS                                              Status;
+  SMM_VARIABLE_COMMUNICATE_GET_RUNTIME_CACHE_INFO         *CacheInfo;
+  SMM_VARIABLE_COMMUNICATE_RUNTIME_VARIABLE_CACHE_CONTEXT *CacheContext;
+  UINTN                                                   StoreSize[VariableStoreIndexMax];
+  UINTN                                                   TotalSize;
+  UINTN                                                   Index;
+  UINT8                                                   *Buffer;
+  BOOLEAN                                                 *Flags;
+
+  AcquireLockOnlyAtBootTime (&mVariableServicesLock);
+
+  Buffer    = NULL;
+  Flags     = NULL;
+  TotalSize = 0;
+  Status = InitCommunicateBuffer ((VOID **) &CacheInfo, sizeof (*CacheInfo), SMM_VARIABLE_FUNCTION_GET_RUNTIME_CACHE_INFO);
+  if (EFI_ERROR (Status)) {
+    goto Done;
+  }
+  Status = SendCommunicateBuffer (sizeof (*CacheInfo));
+  if (EFI_ERROR (Status)) {
+    goto Done;
+  }
+
+  mVariableAuthFormat                    = CacheInfo->AuthenticatedVariableUsage;
+  StoreSize[VariableStoreIndexVolatile]  = CacheInfo->TotalVolatileStorageSize;
+  StoreSize[VariableStoreIndexHob]       = CacheInfo->TotalHobStorageSize;
+  StoreSize[VariableStoreIndexNv]        = CacheInfo->TotalNvStorageSize;
+  for (Index = 0; Index < VariableStoreIndexMax; Index++) {
+    TotalSize += ALIGN_VALUE (StoreSize[Index], sizeof (UINT64));
+  }
+
+  Buffer = AllocateRuntimePages (EFI_SIZE_TO_PAGES (TotalSize));
+  Flags  = AllocateRuntimeZeroPool (2 * sizeof (BOOLEAN));
+  if (Buffer == NULL || Flags == NULL) {
+    Status = EFI_OUT_OF_RESOURCES;
+    goto Done;
+  }
+
+  for (Index = 0; Index < VariableStoreIndexMax; Index++) {
+    mVariableRuntimeCaches[Index] = (StoreSize[Index] == 0) ? NULL : (VARIABLE_STORE_HEADER *) Buffer;
+    Buffer += ALIGN_VALUE (StoreSize[Index], sizeof (UINT64));
+  }
+  Buffer -= TotalSize;
+  mVariableRuntimeCacheReadLock      = &Flags[0];
+  mVariableRuntimeCachePendingUpdate = &Flags[1];
+
+  Status = InitCommunicateBuffer ((VOID **) &CacheContext, sizeof (*CacheContext), SMM_VARIABLE_FUNCTION_INIT_RUNTIME_VARIABLE_CACHE_CONTEXT);
+  if (EFI_ERROR (Status)) {
+    goto Done;
+  }
+  CacheContext->ReadLock             = mVariableRuntimeCacheReadLock;
+  CacheContext->PendingUpdate        = mVariableRuntimeCachePendingUpdate;
+  CacheContext->RuntimeVolatileCache = mVariableRuntimeCaches[VariableStoreIndexVolatile];
+  CacheContext->RuntimeHobCache      = mVariableRuntimeCaches[VariableStoreIndexHob];
+  CacheContext->RuntimeNvCache       = mVariableRuntimeCaches[VariableStoreIndexNv];
+  Status = SendCommunicateBuffer (sizeof (*CacheContext));
+  if (!EFI_ERROR (Status)) {
+    mVariableRuntimeCacheReady = TRUE;
+  }
+
+Done:
+  if (EFI_ERROR (Status)) {
+    if (Buffer != NULL) {
+      FreePages (Buffer, EFI_SIZE_TO_PAGES (TotalSize));
+    }
+    if (Flags != NULL) {
+      FreePool (Flags);
+    }
+    ZeroMem (mVariableRuntimeCaches, sizeof (mVariableRuntimeCaches));
+    mVariableRuntimeCacheReadLock      = NULL;
+    mVariableRuntimeCachePendingUpdate = NULL;
+  }
+  ReleaseLockOnlyAtBootTime (&mVariableServicesLock);
+  return Status;
+}
+
 /**
   Initialize variable service and install Variable Architectural protocol.
 
@@ -1007,6 +1693,11 @@ SmmVariableReady (
   //
   mVariableBufferPhysical = mVariableBuffer;
 
+  if (FeaturePcdGet (PcdEnableVariableRuntimeCache)) {
+    Status = InitVariableRuntimeCache ();
+    DEBUG ((DEBUG_INFO, "Variable runtime cache: %r\n", Status));
+  }
+
   gRT->GetVariable         = RuntimeServiceGetVariable;
   gRT->GetNextVariableName = RuntimeServiceGetNextVariableName;
   gRT->SetVariable         = RuntimeServiceSetVariable;
@@ -0,0 +1,748 @@
+/** @file
+  Measures the GCD memory space services by replaying a recorded list of calls.
+
+    GcdReplayBench <CallList> [Count]
+
+  The call list is a text file with one call per line, in the order they were
+  made, e.g. as printed by the DXE core with DEBUG_GCD. Numbers are hexadecimal,
+  except for the alignment which is a bit count as in the GCD services, and
+  blank lines and lines starting with '#' are skipped:
+
+    AddMemorySpace <MemoryType> <Base> <Length> <Capabilities>
+    AllocateMemorySpace <AllocateType> <MemoryType> <Alignment> <Length> <Base>
+    SetMemorySpaceAttributes <Base> <Length> <Attributes>
+    FreeMemorySpace <Base> <Length>
+    RemoveMemorySpace <Base> <Length>
+
+  MemoryType is MMIO, Reserved or PersisMem. System memory is not accepted, the
+  DXE core would hand it out to the memory allocation services. AllocateType is
+  AtAddress, MaxAddressSearchTopDown or AnySearchTopDown, and Base is the
+  address, the maximum address, or ignored. Any searches are replayed below the
+  end of the ranges the list adds. Bottom up searches are not accepted, they
+  would allocate from the existing ranges of the platform.
+
+  The calls are replayed in a free range of the memory space, at the same
+  offset in a 1 GB aligned window as the first range added by the list. All the
+  addresses of the list have to be in the ranges it adds. The replay is run
+  Count times, 1 by default, and everything it added is removed after each run.
+
+  Copyright (c) 2020, Intel Corporation. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <PiDxe.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DxeServicesTableLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/ShellCEntryLib.h>
+#include <Library/ShellLib.h>
+#include <Library/TimerLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiRuntimeServicesTableLib.h>
+#include <Library/UefiLib.h>
+
+#define GCD_REPLAY_BENCH_DEFAULT_COUNT  1
+#define GCD_REPLAY_BENCH_WINDOW_ALIGN   SIZE_1GB
+
+typedef enum {
+  GcdReplayAddMemorySpace,
+  GcdReplayAllocateMemorySpace,
+  GcdReplaySetMemorySpaceAttributes,
+  GcdReplayFreeMemorySpace,
+  GcdReplayRemoveMemorySpace
+} GCD_REPLAY_FUNCTION;
+
+typedef struct {
+  GCD_REPLAY_FUNCTION     Function;
+  EFI_GCD_ALLOCATE_TYPE   AllocateType;
+  EFI_GCD_MEMORY_TYPE     MemoryType;
+  UINTN                   Alignment;
+  EFI_PHYSICAL_ADDRESS    BaseAddress;
+  UINT64                  Length;
+  //
+  // The capabilities of AddMemorySpace, the attributes of
+  // SetMemorySpaceAttributes.
+  //
+  UINT64                  Value;
+  UINTN                   LineNumber;
+} GCD_REPLAY_CALL;
+
+typedef struct {
+  CONST CHAR16            *Name;
+  UINTN                   Value;
+} GCD_REPLAY_NAME;
+
+STATIC CONST GCD_REPLAY_NAME mFunctionNames[] = {
+  { L"AddMemorySpace",           GcdReplayAddMemorySpace           },
+  { L"AllocateMemorySpace",      GcdReplayAllocateMemorySpace      },
+  { L"SetMemorySpaceAttributes", GcdReplaySetMemorySpaceAttributes },
+  { L"FreeMemorySpace",          GcdReplayFreeMemorySpace          },
+  { L"RemoveMemorySpace",        GcdReplayRemoveMemorySpace        },
+  { NULL,                        0                                 }
+};
+
+STATIC CONST GCD_REPLAY_NAME mMemoryTypeNames[] = {
+  { L"MMIO",                     EfiGcdMemoryTypeMemoryMappedIo    },
+  { L"Reserved",                 EfiGcdMemoryTypeReserved          },
+  { L"PersisMem",                EfiGcdMemoryTypePersistent        },
+  { NULL,                        0                                 }
+};
+
+STATIC CONST GCD_REPLAY_NAME mAllocateTypeNames[] = {
+  { L"AtAddress",                EfiGcdAllocateAddress                 },
+  { L"MaxAddressSearchTopDown",  EfiGcdAllocateMaxAddressSearchTopDown },
+  { L"AnySearchTopDown",         EfiGcdAllocateAnySearchTopDown        },
+  { NULL,                        0                                     }
+};
+
+/**
+  Returns the current time of the clock the benchmark is measured with.
+
+  This is the performance counter of the TimerLib instance if it reports a
+  frequency, the real time clock otherwise. Most real time clocks only count
+  whole seconds.
+
+  @return The time in nanoseconds since an arbitrary origin.
+**/
+STATIC
+UINT64
+GetBenchmarkTime (
+  VOID
+  )
+{
+  UINT64                StartValue;
+  UINT64                EndValue;
+  UINT64                Counter;
+  EFI_TIME              Time;
+  UINTN                 Year;
+  UINTN                 Month;
+  UINTN                 Days;
+
+  if (GetPerformanceCounterProperties (&StartValue, &EndValue) != 0) {
+    Counter = GetPerformanceCounter ();
+    if (EndValue < StartValue) {
+      return GetTimeInNanoSecond (StartValue - Counter);
+    }
+
+    return GetTimeInNanoSecond (Counter - StartValue);
+  }
+
+  if (EFI_ERROR (gRT->GetTime (&Time, NULL))) {
+    return 0;
+  }
+
+  //
+  // Count the days with years starting on March 1st, which puts the leap day
+  // at the end of the year.
+  //
+  Year  = Time.Year - ((Time.Month <= 2) ? 1 : 0);
+  Month = (Time.Month <= 2) ? Time.Month + 9 : Time.Month - 3;
+  Days  = Year * 365 + Year / 4 - Year / 100 + Year / 400 + (Month * 153 + 2) / 5 + Time.Day;
+
+  return MultU64x32 (
+           MultU64x32 (Days, 24 * 60 * 60) + Time.Hour * 60 * 60 + Time.Minute * 60 + Time.Second,
+           1000000000
+           ) + Time.Nanosecond;
+}
+
+/**
+  Cuts the next blank separated token off a line.
+
+  @param[in, out] Line  The rest of the line, moved past the token.
+
+  @return The token, or NULL if the line has no more tokens.
+**/
+STATIC
+CHAR16 *
+GetNextToken (
+  IN OUT CHAR16         **Line
+  )
+{
+  CHAR16                *Token;
+
+  Token = *Line;
+  while ((*Token == L' ') || (*Token == L'\t') || (*Token == L'\r')) {
+    Token++;
+  }
+  if ((*Token == L'\0') || (*Token == L'#')) {
+    *Line = Token;
+    return NULL;
+  }
+
+  *Line = Token;
+  while ((**Line != L'\0') && (**Line != L' ') && (**Line != L'\t') && (**Line != L'\r')) {
+    (*Line)++;
+  }
+  if (**Line != L'\0') {
+    **Line = L'\0';
+    (*Line)++;
+  }
+
+  return Token;
+}
+
+/**
+  Parses the next token of a line as a name of a table.
+
+  @param[in, out] Line  The rest of the line, moved past the token.
+  @param[in]      Names The table of the names, ended by a NULL name.
+  @param[out]     Value The value of the name.
+
+  @retval TRUE          The token is a name of the table.
+  @retval FALSE         The line has no more tokens, or the token is not in the
+                        table.
+**/
+STATIC
+BOOLEAN
+ParseName (
+  IN OUT CHAR16                 **Line,
+  IN     CONST GCD_REPLAY_NAME  *Names,
+  OUT    UINTN                  *Value
+  )
+{
+  CHAR16                        *Token;
+
+  Token = GetNextToken (Line);
+  if (Token == NULL) {
+    return FALSE;
+  }
+
+  for (; Names->Name != NULL; Names++) {
+    if (StrCmp (Token, Names->Name) == 0) {
+      *Value = Names->Value;
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+/**
+  Parses the next token of a line as a number.
+
+  @param[in, out] Line  The rest of the line, moved past the token.
+  @param[in]      Hex   TRUE if the number is hexadecimal, FALSE if decimal.
+  @param[out]     Value The number.
+
+  @retval TRUE          The token is a number.
+  @retval FALSE         The line has no more tokens, or the token is not a
+                        number.
+**/
+STATIC
+BOOLEAN
+ParseNumber (
+  IN OUT CHAR16         **Line,
+  IN     BOOLEAN        Hex,
+  OUT    UINT64         *Value
+  )
+{
+  CHAR16                *Token;
+  CHAR16                *End;
+  RETURN_STATUS         Status;
+
+  Token = GetNextToken (Line);
+  if (Token == NULL) {
+    return FALSE;
+  }
+
+  if (Hex) {
+    Status = StrHexToUint64S (Token, &End, Value);
+  } else {
+    Status = StrDecimalToUint64S (Token, &End, Value);
+  }
+
+  return (BOOLEAN) (!RETURN_ERROR (Status) && (End != Token) && (*End == L'\0'));
+}
+
+/**
+  Parses a line of the call list.
+
+  @param[in, out] Line  The line, which is modified.
+  @param[out]     Call  The call of the line.
+
+  @retval TRUE          The line is a call, or blank.
+  @retval FALSE         The line cannot be parsed.
+**/
+STATIC
+BOOLEAN
+ParseCall (
+  IN OUT CHAR16           *Line,
+  OUT    GCD_REPLAY_CALL  *Call
+  )
+{
+  UINTN                   Value;
+  UINT64                  Alignment;
+  BOOLEAN                 Parsed;
+
+  ZeroMem (Call, sizeof (*Call));
+  if (!ParseName (&Line, mFunctionNames, &Value)) {
+    return FALSE;
+  }
+
+  Call->Function = (GCD_REPLAY_FUNCTION) Value;
+  switch (Call->Function) {
+  case GcdReplayAddMemorySpace:
+    Parsed = (BOOLEAN) (ParseName (&Line, mMemoryTypeNames, &Value) &&
+                        ParseNumber (&Line, TRUE, &Call->BaseAddress) &&
+                        ParseNumber (&Line, TRUE, &Call->Length) &&
+                        ParseNumber (&Line, TRUE, &Call->Value));
+    Call->MemoryType = (EFI_GCD_MEMORY_TYPE) Value;
+    break;
+
+  case GcdReplayAllocateMemorySpace:
+    Parsed = (BOOLEAN) (ParseName (&Line, mAllocateTypeNames, &Value));
+    Call->AllocateType = (EFI_GCD_ALLOCATE_TYPE) Value;
+    Parsed = (BOOLEAN) (Parsed &&
+                        ParseName (&Line, mMemoryTypeNames, &Value) &&
+                        ParseNumber (&Line, FALSE, &Alignment) &&
+                        (Alignment < 64) &&
+                        ParseNumber (&Line, TRUE, &Call->Length) &&
+                        ParseNumber (&Line, TRUE, &Call->BaseAddress));
+    Call->MemoryType = (EFI_GCD_MEMORY_TYPE) Value;
+    Call->Alignment  = (UINTN) Alignment;
+    break;
+
+  case GcdReplaySetMemorySpaceAttributes:
+    Parsed = (BOOLEAN) (ParseNumber (&Line, TRUE, &Call->BaseAddress) &&
+                        ParseNumber (&Line, TRUE, &Call->Length) &&
+                        ParseNumber (&Line, TRUE, &Call->Value));
+    break;
+
+  default:
+    Parsed = (BOOLEAN) (ParseNumber (&Line, TRUE, &Call->BaseAddress) &&
+                        ParseNumber (&Line, TRUE, &Call->Length));
+    break;
+  }
+
+  return (BOOLEAN) (Parsed && (Call->Length != 0) && (GetNextToken (&Line) == NULL));
+}
+
+/**
+  Reads the call list from a file.
+
+  @param[in]  FileName      The name of the file.
+  @param[out] Calls         The calls, allocated with AllocatePool().
+  @param[out] CallCount     The number of calls.
+
+  @retval EFI_SUCCESS           The call list is read.
+  @retval EFI_INVALID_PARAMETER A line of the file cannot be parsed.
+  @retval EFI_OUT_OF_RESOURCES  No memory for the calls.
+  @return other                 The file cannot be opened.
+**/
+STATIC
+EFI_STATUS
+ReadCallList (
+  IN  CONST CHAR16        *FileName,
+  OUT GCD_REPLAY_CALL     **Calls,
+  OUT UINTN               *CallCount
+  )
+{
+  EFI_STATUS              Status;
+  SHELL_FILE_HANDLE       FileHandle;
+  BOOLEAN                 Ascii;
+  CHAR16                  *Line;
+  CHAR16                  *Rest;
+  UINTN                   LineNumber;
+  UINTN                   Capacity;
+  GCD_REPLAY_CALL         *NewCalls;
+
+  Status = ShellOpenFileByName (FileName, &FileHandle, EFI_FILE_MODE_READ, 0);
+  if (EFI_ERROR (Status)) {
+    Print (L"Cannot open %s - %r\n", FileName, Status);
+    return Status;
+  }
+
+  *Calls     = NULL;
+  *CallCount = 0;
+  Capacity   = 0;
+  Ascii      = FALSE;
+  //
+  // ShellFileHandleReturnLine() returns NULL at the end of the file.
+  //
+  for (LineNumber = 1; ; LineNumber++) {
+    Line = ShellFileHandleReturnLine (FileHandle, &Ascii);
+    if (Line == NULL) {
+      break;
+    }
+
+    Rest = Line;
+    if (GetNextToken (&Rest) == NULL) {
+      FreePool (Line);
+      continue;
+    }
+
+    if (*CallCount == Capacity) {
+      NewCalls = ReallocatePool (
+                   Capacity * sizeof (GCD_REPLAY_CALL),
+                   (Capacity + 256) * sizeof (GCD_REPLAY_CALL),
+                   *Calls
+                   );
+      if (NewCalls == NULL) {
+        FreePool (Line);
+        Status = EFI_OUT_OF_RESOURCES;
+        break;
+      }
+      *Calls    = NewCalls;
+      Capacity += 256;
+    }
+
+    if (!ParseCall (Line, &(*Calls)[*CallCount])) {
+      Print (L"%s, line %Lu: invalid call\n", FileName, (UINT64) LineNumber);
+      FreePool (Line);
+      Status = EFI_INVALID_PARAMETER;
+      break;
+    }
+    (*Calls)[*CallCount].LineNumber = LineNumber;
+    (*CallCount)++;
+    FreePool (Line);
+  }
+
+  ShellCloseFile (&FileHandle);
+  if (EFI_ERROR (Status) && (*Calls != NULL)) {
+    FreePool (*Calls);
+    *Calls = NULL;
+  }
+
+  return Status;
+}
+
+/**
+  Finds the range of the memory space the call list uses, and checks that all
+  the calls stay in it.
+
+  @param[in]  Calls         The calls.
+  @param[in]  CallCount     The number of calls.
+  @param[out] Base          The lowest address the calls add.
+  @param[out] Limit         The highest address the calls add.
+
+  @retval TRUE              All the calls address the ranges the list adds.
+  @retval FALSE             The list adds no range, or a call addresses memory
+                            outside of the ranges the list adds.
+**/
+STATIC
+BOOLEAN
+GetCallListRange (
+  IN  CONST GCD_REPLAY_CALL  *Calls,
+  IN  UINTN                  CallCount,
+  OUT EFI_PHYSICAL_ADDRESS   *Base,
+  OUT EFI_PHYSICAL_ADDRESS   *Limit
+  )
+{
+  UINTN                      Index;
+  EFI_PHYSICAL_ADDRESS       CallLimit;
+
+  *Base  = MAX_UINT64;
+  *Limit = 0;
+  for (Index = 0; Index < CallCount; Index++) {
+    if (Calls[Index].Function == GcdReplayAddMemorySpace) {
+      if (Calls[Index].Length - 1 > MAX_UINT64 - Calls[Index].BaseAddress) {
+        Print (L"Line %Lu: the range wraps around\n", (UINT64) Calls[Index].LineNumber);
+        return FALSE;
+      }
+      *Base  = MIN (*Base, Calls[Index].BaseAddress);
+      *Limit = MAX (*Limit, Calls[Index].BaseAddress + Calls[Index].Length - 1);
+    }
+  }
+  if (*Base > *Limit) {
+    Print (L"The call list adds no memory space\n");
+    return FALSE;
+  }
+
+  for (Index = 0; Index < CallCount; Index++) {
+    if ((Calls[Index].Function == GcdReplayAllocateMemorySpace) &&
+        (Calls[Index].AllocateType == EfiGcdAllocateAnySearchTopDown)) {
+      continue;
+    }
+
+    CallLimit = Calls[Index].BaseAddress;
+    if (!((Calls[Index].Function == GcdReplayAllocateMemorySpace) &&
+          (Calls[Index].AllocateType == EfiGcdAllocateMaxAddressSearchTopDown))) {
+      CallLimit += Calls[Index].Length - 1;
+    }
+    if ((Calls[Index].BaseAddress < *Base) || (CallLimit < Calls[Index].BaseAddress) || (CallLimit > *Limit)) {
+      Print (L"Line %Lu: the range is not added by the call list\n", (UINT64) Calls[Index].LineNumber);
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+/**
+  Finds a range of the memory space that does not exist, for the replay.
+
+  @param[in]  Base          The lowest address the calls add.
+  @param[in]  Limit         The highest address the calls add.
+  @param[out] Offset        The offset to add to the addresses of the calls.
+
+  @retval EFI_SUCCESS       The range [Base + Offset, Limit + Offset] does not
+                            exist.
+  @retval EFI_NOT_FOUND     The memory space has no such range.
+  @return other             The memory space map cannot be read.
+**/
+STATIC
+EFI_STATUS
+FindReplayWindow (
+  IN  EFI_PHYSICAL_ADDRESS  Base,
+  IN  EFI_PHYSICAL_ADDRESS  Limit,
+  OUT UINT64                *Offset
+  )
+{
+  EFI_STATUS                       Status;
+  EFI_GCD_MEMORY_SPACE_DESCRIPTOR  *Map;
+  UINTN                            NumberOfDescriptors;
+  UINTN                            Index;
+  EFI_PHYSICAL_ADDRESS             WindowBase;
+
+  Status = gDS->GetMemorySpaceMap (&NumberOfDescriptors, &Map);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  //
+  // Look from the top, away from the ranges the platform adds later.
+  //
+  Status = EFI_NOT_FOUND;
+  for (Index = NumberOfDescriptors; Index > 0; Index--) {
+    if (Map[Index - 1].GcdMemoryType != EfiGcdMemoryTypeNonExistent) {
+      continue;
+    }
+
+    WindowBase = ALIGN_VALUE (Map[Index - 1].BaseAddress, GCD_REPLAY_BENCH_WINDOW_ALIGN) +
+                 (Base & (GCD_REPLAY_BENCH_WINDOW_ALIGN - 1));
+    if ((WindowBase >= Map[Index - 1].BaseAddress) &&
+        (WindowBase <= Map[Index - 1].BaseAddress + Map[Index - 1].Length - 1) &&
+        (Limit - Base <= Map[Index - 1].BaseAddress + Map[Index - 1].Length - 1 - WindowBase)) {
+      *Offset = WindowBase - Base;
+      Status  = EFI_SUCCESS;
+      break;
+    }
+  }
+
+  FreePool (Map);
+  return Status;
+}
+
+/**
+  Frees and removes everything in a range of the memory space.
+
+  @param[in] Base           The lowest address of the range.
+  @param[in] Limit          The highest address of the range.
+**/
+STATIC
+VOID
+ClearReplayWindow (
+  IN EFI_PHYSICAL_ADDRESS   Base,
+  IN EFI_PHYSICAL_ADDRESS   Limit
+  )
+{
+  EFI_STATUS                       Status;
+  EFI_GCD_MEMORY_SPACE_DESCRIPTOR  *Map;
+  UINTN                            NumberOfDescriptors;
+  UINTN                            Index;
+  EFI_PHYSICAL_ADDRESS             RangeBase;
+  EFI_PHYSICAL_ADDRESS             RangeLimit;
+
+  Status = gDS->GetMemorySpaceMap (&NumberOfDescriptors, &Map);
+  if (EFI_ERROR (Status)) {
+    return;
+  }
+
+  for (Index = 0; Index < NumberOfDescriptors; Index++) {
+    RangeBase  = MAX (Map[Index].BaseAddress, Base);
+    RangeLimit = MIN (Map[Index].BaseAddress + Map[Index].Length - 1, Limit);
+    if ((RangeBase > RangeLimit) || (Map[Index].GcdMemoryType == EfiGcdMemoryTypeNonExistent)) {
+      continue;
+    }
+
+    if (Map[Index].ImageHandle != NULL) {
+      gDS->FreeMemorySpace (RangeBase, RangeLimit - RangeBase + 1);
+    }
+    gDS->RemoveMemorySpace (RangeBase, RangeLimit - RangeBase + 1);
+  }
+
+  FreePool (Map);
+}
+
+/**
+  Replays the calls of the list.
+
+  @param[in]  Calls         The calls.
+  @param[in]  CallCount     The number of calls.
+  @param[in]  Offset        The offset to add to the addresses of the calls.
+  @param[in]  Base          The lowest address of the replay window.
+  @param[in]  Limit         The highest address of the replay window.
+
+  @return The number of calls that failed.
+**/
+STATIC
+UINTN
+ReplayCalls (
+  IN CONST GCD_REPLAY_CALL  *Calls,
+  IN UINTN                  CallCount,
+  IN UINT64                 Offset,
+  IN EFI_PHYSICAL_ADDRESS   Base,
+  IN EFI_PHYSICAL_ADDRESS   Limit
+  )
+{
+  EFI_STATUS                Status;
+  UINTN                     Index;
+  UINTN                     FailedCount;
+  EFI_PHYSICAL_ADDRESS      BaseAddress;
+
+  FailedCount = 0;
+  for (Index = 0; Index < CallCount; Index++) {
+    BaseAddress = Calls[Index].BaseAddress + Offset;
+    switch (Calls[Index].Function) {
+    case GcdReplayAddMemorySpace:
+      Status = gDS->AddMemorySpace (
+                      Calls[Index].MemoryType,
+                      BaseAddress,
+                      Calls[Index].Length,
+                      Calls[Index].Value
+                      );
+      break;
+
+    case GcdReplayAllocateMemorySpace:
+      if (Calls[Index].AllocateType == EfiGcdAllocateAnySearchTopDown) {
+        BaseAddress = Limit;
+      }
+      Status = gDS->AllocateMemorySpace (
+                      (Calls[Index].AllocateType == EfiGcdAllocateAddress) ?
+                        EfiGcdAllocateAddress : EfiGcdAllocateMaxAddressSearchTopDown,
+                      Calls[Index].MemoryType,
+                      Calls[Index].Alignment,
+                      Calls[Index].Length,
+                      &BaseAddress,
+                      gImageHandle,
+                      NULL
+                      );
+      //
+      // A search that runs out of the window found a range of the platform.
+      //
+      if (!EFI_ERROR (Status) && (BaseAddress < Base)) {
+        gDS->FreeMemorySpace (BaseAddress, Calls[Index].Length);
+        Status = EFI_OUT_OF_RESOURCES;
+      }
+      break;
+
+    case GcdReplaySetMemorySpaceAttributes:
+      Status = gDS->SetMemorySpaceAttributes (BaseAddress, Calls[Index].Length, Calls[Index].Value);
+      break;
+
+    case GcdReplayFreeMemorySpace:
+      Status = gDS->FreeMemorySpace (BaseAddress, Calls[Index].Length);
+      break;
+
+    default:
+      Status = gDS->RemoveMemorySpace (BaseAddress, Calls[Index].Length);
+      break;
+    }
+
+    if (EFI_ERROR (Status)) {
+      if (FailedCount == 0) {
+        Print (L"  Line %Lu failed - %r\n", (UINT64) Calls[Index].LineNumber, Status);
+      }
+      FailedCount++;
+    }
+  }
+
+  return FailedCount;
+}
+
+/**
+  UEFI application entry point which has an interface similar to a
+  standard C main function.
+
+  The ShellCEntryLib library instance wrappers the actual UEFI application
+  entry point and calls this ShellAppMain function.
+
+  @param[in] Argc     The number of items in Argv.
+  @param[in] Argv     Array of pointers to strings.
+
+  @retval  0               The application exited normally.
+  @retval  Other           An error occurred.
+**/
+INTN
+EFIAPI
+ShellAppMain (
+  IN UINTN                  Argc,
+  IN CHAR16                 **Argv
+  )
+{
+  EFI_STATUS                Status;
+  GCD_REPLAY_CALL           *Calls;
+  UINTN                     CallCount;
+  UINTN                     Count;
+  UINTN                     Run;
+  UINTN                     FailedCount;
+  EFI_PHYSICAL_ADDRESS      Base;
+  EFI_PHYSICAL_ADDRESS      Limit;
+  UINT64                    Offset;
+  UINT64                    Begin;
+  UINT64                    Elapsed;
+
+  if ((Argc != 2) && (Argc != 3)) {
+    Print (L"Usage: GcdReplayBench <CallList> [Count]\n");
+    return (INTN) EFI_INVALID_PARAMETER;
+  }
+
+  Count = GCD_REPLAY_BENCH_DEFAULT_COUNT;
+  if (Argc == 3) {
+    Count = StrDecimalToUintn (Argv[2]);
+    if (Count == 0) {
+      Print (L"Count must be at least 1\n");
+      return (INTN) EFI_INVALID_PARAMETER;
+    }
+  }
+
+  Status = ReadCallList (Argv[1], &Calls, &CallCount);
+  if (EFI_ERROR (Status)) {
+    return (INTN) Status;
+  }
+
+  if (!GetCallListRange (Calls, CallCount, &Base, &Limit)) {
+    Status = EFI_INVALID_PARAMETER;
+    goto Done;
+  }
+
+  Status = FindReplayWindow (Base, Limit, &Offset);
+  if (EFI_ERROR (Status)) {
+    Print (L"No free memory space for 0x%Lx bytes - %r\n", Limit - Base + 1, Status);
+    goto Done;
+  }
+
+  Print (
+    L"Replaying %Lu calls at 0x%Lx-0x%Lx, %Lu times\n",
+    (UINT64) CallCount,
+    Base + Offset,
+    Limit + Offset,
+    (UINT64) Count
+    );
+  if (GetPerformanceCounterProperties (NULL, NULL) == 0) {
+    Print (L"No performance counter, timing with the real time clock\n");
+  }
+
+  for (Run = 0; Run < Count; Run++) {
+    Begin       = GetBenchmarkTime ();
+    FailedCount = ReplayCalls (Calls, CallCount, Offset, Base + Offset, Limit + Offset);
+    Elapsed     = GetBenchmarkTime () - Begin;
+    ClearReplayWindow (Base + Offset, Limit + Offset);
+
+    Print (
+      L"  Run %Lu: %Lu us, %Lu ns per call, %Lu calls failed\n",
+      (UINT64) Run + 1,
+      DivU64x32 (Elapsed, 1000),
+      DivU64x32 (Elapsed, (UINT32) CallCount),
+      (UINT64) FailedCount
+      );
+  }
+
+Done:
+  if (Calls != NULL) {
+    FreePool (Calls);
+  }
+  return (INTN) Status;
+}
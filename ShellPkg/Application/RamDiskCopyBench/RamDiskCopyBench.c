@@ -0,0 +1,382 @@
+/** @file
+  Measures how fast the shell copies a file to a FAT file system on a RAM disk.
+
+  The application loads a FAT image into memory, registers it as a RAM disk with
+  the RAM disk protocol, and times the shell "cp" command copying a file to the
+  root directory of the file system that the FAT driver mounts on it.
+
+    RamDiskCopyBench <FatImage> <File> [Count]
+
+  The image can be made on the host, e.g. with "mkfs.fat -C Fat.img 262144", and
+  has to be large enough to hold the file. The copy is run Count times, 3 by
+  default, and deleted after each run. The time is measured with the counter of
+  the TimerLib instance of the platform.
+
+  Copyright (c) 2020, Intel Corporation. All rights reserved.<BR>
+  SPDX-License-Identifier: BSD-2-Clause-Patent
+
+**/
+
+#include <Uefi.h>
+#include <Protocol/RamDisk.h>
+#include <Protocol/SimpleFileSystem.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DevicePathLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/ShellCEntryLib.h>
+#include <Library/ShellLib.h>
+#include <Library/TimerLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiRuntimeServicesTableLib.h>
+#include <Library/UefiLib.h>
+
+#define RAM_DISK_COPY_BENCH_DEFAULT_COUNT  3
+
+/**
+  Reads a whole file into a buffer allocated from boot services data.
+
+  @param[in]  FileName    The name of the file.
+  @param[out] Buffer      Returns the buffer that holds the file.
+  @param[out] Size        Returns the size of the file.
+
+  @retval EFI_SUCCESS     The file was read.
+  @return Others          The file could not be opened, allocated or read.
+**/
+STATIC
+EFI_STATUS
+ReadWholeFile (
+  IN  CONST CHAR16      *FileName,
+  OUT VOID              **Buffer,
+  OUT UINT64            *Size
+  )
+{
+  EFI_STATUS            Status;
+  SHELL_FILE_HANDLE     FileHandle;
+  UINTN                 ReadSize;
+
+  Status = ShellOpenFileByName (FileName, &FileHandle, EFI_FILE_MODE_READ, 0);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  *Buffer = NULL;
+  Status  = ShellGetFileSize (FileHandle, Size);
+  if (!EFI_ERROR (Status) && ((*Size == 0) || (*Size > MAX_UINTN))) {
+    Status = EFI_BAD_BUFFER_SIZE;
+  }
+
+  if (!EFI_ERROR (Status)) {
+    *Buffer = AllocatePool ((UINTN) *Size);
+    if (*Buffer == NULL) {
+      Status = EFI_OUT_OF_RESOURCES;
+    }
+  }
+
+  if (!EFI_ERROR (Status)) {
+    ReadSize = (UINTN) *Size;
+    Status   = ShellReadFile (FileHandle, &ReadSize, *Buffer);
+    if (!EFI_ERROR (Status) && (ReadSize != *Size)) {
+      Status = EFI_DEVICE_ERROR;
+    }
+  }
+
+  ShellCloseFile (&FileHandle);
+  if (EFI_ERROR (Status) && (*Buffer != NULL)) {
+    FreePool (*Buffer);
+    *Buffer = NULL;
+  }
+
+  return Status;
+}
+
+/**
+  Finds the shell mapping of the file system on a RAM disk.
+
+  @param[in] RamDiskPath  The device path of the RAM disk.
+
+  @return The mapping, e.g. "FS2:", or NULL if the RAM disk holds no file
+          system. The caller frees it.
+**/
+STATIC
+CHAR16 *
+GetRamDiskMapping (
+  IN EFI_DEVICE_PATH_PROTOCOL   *RamDiskPath
+  )
+{
+  EFI_STATUS                    Status;
+  EFI_HANDLE                    *Handles;
+  UINTN                         HandleCount;
+  UINTN                         Index;
+  UINTN                         PathSize;
+  EFI_DEVICE_PATH_PROTOCOL      *DevicePath;
+  CONST CHAR16                  *Mappings;
+  CHAR16                        *Mapping;
+  UINTN                         Length;
+
+  //
+  // The file system is on the RAM disk itself or on a partition of it.
+  //
+  Status = gBS->LocateHandleBuffer (
+                  ByProtocol,
+                  &gEfiSimpleFileSystemProtocolGuid,
+                  NULL,
+                  &HandleCount,
+                  &Handles
+                  );
+  if (EFI_ERROR (Status)) {
+    return NULL;
+  }
+
+  Mapping  = NULL;
+  PathSize = GetDevicePathSize (RamDiskPath) - END_DEVICE_PATH_LENGTH;
+  for (Index = 0; (Index < HandleCount) && (Mapping == NULL); Index++) {
+    DevicePath = DevicePathFromHandle (Handles[Index]);
+    if ((DevicePath == NULL) || (GetDevicePathSize (DevicePath) < PathSize) ||
+        (CompareMem (DevicePath, RamDiskPath, PathSize) != 0)) {
+      continue;
+    }
+
+    Mappings = gEfiShellProtocol->GetMapFromDevicePath (&DevicePath);
+    if (Mappings == NULL) {
+      continue;
+    }
+
+    //
+    // The mappings of a device are separated by ';', take the first one.
+    //
+    for (Length = 0; (Mappings[Length] != L'\0') && (Mappings[Length] != L';'); Length++) {
+    }
+    Mapping = AllocateCopyPool ((Length + 1) * sizeof (CHAR16), Mappings);
+    if (Mapping != NULL) {
+      Mapping[Length] = L'\0';
+    }
+  }
+
+  FreePool (Handles);
+  return Mapping;
+}
+
+/**
+  Returns the current time of the clock the benchmark is measured with.
+
+  This is the performance counter of the TimerLib instance if it reports a
+  frequency, the real time clock otherwise. Most real time clocks only count
+  whole seconds.
+
+  @return The time in nanoseconds since an arbitrary origin.
+**/
+STATIC
+UINT64
+GetBenchmarkTime (
+  VOID
+  )
+{
+  UINT64                StartValue;
+  UINT64                EndValue;
+  UINT64                Counter;
+  EFI_TIME              Time;
+  UINTN                 Year;
+  UINTN                 Month;
+  UINTN                 Days;
+
+  if (GetPerformanceCounterProperties (&StartValue, &EndValue) != 0) {
+    Counter = GetPerformanceCounter ();
+    if (EndValue < StartValue) {
+      return GetTimeInNanoSecond (StartValue - Counter);
+    }
+
+    return GetTimeInNanoSecond (Counter - StartValue);
+  }
+
+  if (EFI_ERROR (gRT->GetTime (&Time, NULL))) {
+    return 0;
+  }
+
+  //
+  // Count the days with years starting on March 1st, which puts the leap day
+  // at the end of the year.
+  //
+  Year  = Time.Year - ((Time.Month <= 2) ? 1 : 0);
+  Month = (Time.Month <= 2) ? Time.Month + 9 : Time.Month - 3;
+  Days  = Year * 365 + Year / 4 - Year / 100 + Year / 400 + (Month * 153 + 2) / 5 + Time.Day;
+
+  return MultU64x32 (
+           MultU64x32 (Days, 24 * 60 * 60) + Time.Hour * 60 * 60 + Time.Minute * 60 + Time.Second,
+           1000000000
+           ) + Time.Nanosecond;
+}
+
+/**
+  UEFI application entry point which has an interface similar to a
+  standard C main function.
+
+  The ShellCEntryLib library instance wrappers the actual UEFI application
+  entry point and calls this ShellAppMain function.
+
+  @param  Argc             Argument count
+  @param  Argv             The parsed arguments
+
+  @retval  0               The application exited normally.
+  @retval  Other           An error occurred.
+
+**/
+INTN
+EFIAPI
+ShellAppMain (
+  IN UINTN              Argc,
+  IN CHAR16             **Argv
+  )
+{
+  EFI_STATUS                Status;
+  EFI_STATUS                CommandStatus;
+  EFI_RAM_DISK_PROTOCOL     *RamDisk;
+  EFI_DEVICE_PATH_PROTOCOL  *RamDiskPath;
+  VOID                      *Image;
+  UINT64                    ImageSize;
+  UINT64                    FileSize;
+  SHELL_FILE_HANDLE         FileHandle;
+  UINTN                     Count;
+  UINTN                     Run;
+  CHAR16                    *Mapping;
+  CONST CHAR16              *FileName;
+  CHAR16                    *CopyCommand;
+  CHAR16                    *DeleteCommand;
+  UINT64                    Begin;
+  UINT64                    Elapsed;
+  UINT64                    TotalElapsed;
+  UINT64                    TotalMicroSeconds;
+
+  if ((Argc != 3) && (Argc != 4)) {
+    Print (L"Usage: RamDiskCopyBench <FatImage> <File> [Count]\n");
+    return (INTN) EFI_INVALID_PARAMETER;
+  }
+
+  Count = RAM_DISK_COPY_BENCH_DEFAULT_COUNT;
+  if (Argc == 4) {
+    Count = StrDecimalToUintn (Argv[3]);
+    if (Count == 0) {
+      Print (L"Count must be at least 1\n");
+      return (INTN) EFI_INVALID_PARAMETER;
+    }
+  }
+
+  Status = ShellOpenFileByName (Argv[2], &FileHandle, EFI_FILE_MODE_READ, 0);
+  if (!EFI_ERROR (Status)) {
+    Status = ShellGetFileSize (FileHandle, &FileSize);
+    ShellCloseFile (&FileHandle);
+  }
+  if (EFI_ERROR (Status)) {
+    Print (L"Cannot open %s - %r\n", Argv[2], Status);
+    return (INTN) Status;
+  }
+
+  Status = gBS->LocateProtocol (&gEfiRamDiskProtocolGuid, NULL, (VOID **) &RamDisk);
+  if (EFI_ERROR (Status)) {
+    Print (L"No RAM disk protocol - %r\n", Status);
+    return (INTN) Status;
+  }
+
+  Status = ReadWholeFile (Argv[1], &Image, &ImageSize);
+  if (EFI_ERROR (Status)) {
+    Print (L"Cannot read %s - %r\n", Argv[1], Status);
+    return (INTN) Status;
+  }
+
+  //
+  // Registering the RAM disk connects the FAT driver to it. Let the shell map
+  // the new file system before looking for it.
+  //
+  Status = RamDisk->Register (
+                      (UINT64) (UINTN) Image,
+                      ImageSize,
+                      &gEfiVirtualDiskGuid,
+                      NULL,
+                      &RamDiskPath
+                      );
+  if (EFI_ERROR (Status)) {
+    Print (L"Cannot register the RAM disk - %r\n", Status);
+    FreePool (Image);
+    return (INTN) Status;
+  }
+
+  ShellExecute (&gImageHandle, L"map -r", FALSE, NULL, &CommandStatus);
+  Mapping = GetRamDiskMapping (RamDiskPath);
+  if (Mapping == NULL) {
+    Print (L"No file system on the RAM disk, is %s a FAT image?\n", Argv[1]);
+    Status = EFI_NOT_FOUND;
+    goto Done;
+  }
+
+  //
+  // The copy goes to the root directory, and keeps the name of the file.
+  //
+  FileName = Argv[2] + StrLen (Argv[2]);
+  while ((FileName > Argv[2]) && (FileName[-1] != L'\\') && (FileName[-1] != L'/') && (FileName[-1] != L':')) {
+    FileName--;
+  }
+
+  CopyCommand   = CatSPrint (NULL, L"cp -q \"%s\" %s\\", Argv[2], Mapping);
+  DeleteCommand = CatSPrint (NULL, L"rm -q \"%s\\%s\"", Mapping, FileName);
+  if ((CopyCommand == NULL) || (DeleteCommand == NULL)) {
+    Status = EFI_OUT_OF_RESOURCES;
+    goto FreeCommands;
+  }
+
+  Print (L"Copying %s (%Lu bytes) to %s, %Lu times\n", Argv[2], FileSize, Mapping, (UINT64) Count);
+  if (GetPerformanceCounterProperties (NULL, NULL) == 0) {
+    Print (L"No performance counter, timing with the real time clock\n");
+  }
+  TotalElapsed = 0;
+  for (Run = 0; Run < Count; Run++) {
+    Begin   = GetBenchmarkTime ();
+    Status  = ShellExecute (&gImageHandle, CopyCommand, FALSE, NULL, &CommandStatus);
+    Elapsed = GetBenchmarkTime () - Begin;
+    if (!EFI_ERROR (Status)) {
+      Status = CommandStatus;
+    }
+    if (EFI_ERROR (Status)) {
+      Print (L"cp failed - %r\n", Status);
+      break;
+    }
+
+    TotalElapsed += Elapsed;
+    Print (L"  Run %Lu: %Lu us\n", (UINT64) Run + 1, DivU64x32 (Elapsed, 1000));
+    ShellExecute (&gImageHandle, DeleteCommand, FALSE, NULL, &CommandStatus);
+  }
+
+  //
+  // Copies shorter than the resolution of the real time clock measure no
+  // time at all.
+  //
+  TotalMicroSeconds = DivU64x32 (TotalElapsed, 1000);
+  if (!EFI_ERROR (Status) && (TotalMicroSeconds != 0)) {
+    Print (
+      L"Average: %Lu us, %Lu KB/s\n",
+      DivU64x32 (TotalMicroSeconds, (UINT32) Count),
+      DivU64x64Remainder (
+        MultU64x32 (DivU64x32 (MultU64x32 (FileSize, (UINT32) Count), SIZE_1KB), 1000000),
+        TotalMicroSeconds,
+        NULL
+        )
+      );
+  }
+
+FreeCommands:
+  if (CopyCommand != NULL) {
+    FreePool (CopyCommand);
+  }
+  if (DeleteCommand != NULL) {
+    FreePool (DeleteCommand);
+  }
+  FreePool (Mapping);
+
+Done:
+  //
+  // The RAM disk driver frees the device path that it returned.
+  //
+  RamDisk->Unregister (RamDiskPath);
+  FreePool (Image);
+  ShellExecute (&gImageHandle, L"map -r", FALSE, NULL, &CommandStatus);
+  return (INTN) Status;
+}